@@ -12,6 +12,9 @@
 
 #define BENCODE_HASH_BUCKETS		31 /* prime numbers work best */
 
+/* largest piece kept around by bencode_buffer_reset() */
+#define BENCODE_MAX_RETAINED_LEN	(256 * 1024)
+
 struct __bencode_buffer_piece {
 	char *tail;
 	unsigned int left;
@@ -140,6 +143,37 @@ void bencode_buffer_free(bencode_buffer_t *buf) {
 	}
 }
 
+int bencode_buffer_reset(bencode_buffer_t *buf) {
+	struct __bencode_free_list *fl;
+	struct __bencode_buffer_piece *piece, *next;
+	unsigned long size = 0;
+
+	for (fl = buf->free_list; fl; fl = fl->next)
+		fl->func(fl->ptr);
+	buf->free_list = NULL;
+	buf->error = 0;
+
+	piece = buf->pieces;
+	if (piece && !piece->next && piece->tail - piece->buf + piece->left <= BENCODE_MAX_RETAINED_LEN) {
+		piece->left += piece->tail - piece->buf;
+		piece->tail = piece->buf;
+		return 0;
+	}
+
+	for (; piece; piece = next) {
+		next = piece->next;
+		size += piece->tail - piece->buf + piece->left;
+		BENCODE_FREE(piece);
+	}
+
+	if (size > BENCODE_MAX_RETAINED_LEN)
+		size = BENCODE_MAX_RETAINED_LEN;
+	buf->pieces = __bencode_piece_new(size);
+	if (!buf->pieces)
+		return -1;
+	return 0;
+}
+
 static bencode_item_t *__bencode_item_alloc(bencode_buffer_t *buf, unsigned int payload) {
 	bencode_item_t *ret;
 
@@ -0,0 +1,112 @@
+#include "buffer_pool.h"
+
+#include <glib.h>
+
+#include "aux.h"
+
+struct buffer_pool {
+	// owning thread only
+	struct packet_buf *free;
+	unsigned int num_free;
+
+	// buffers released by other threads, pushed lock-free
+	struct packet_buf * volatile remote;
+
+	atomic64 hits;
+	atomic64 exhausted;
+};
+
+static __thread struct buffer_pool *t_pool;
+
+static mutex_t buffer_pools_lock = MUTEX_STATIC_INIT;
+static GQueue buffer_pools = G_QUEUE_INIT;
+
+static struct buffer_pool *buffer_pool_get(void) {
+	if (G_LIKELY(t_pool))
+		return t_pool;
+
+	t_pool = g_slice_alloc0(sizeof(*t_pool));
+	// pools live until the process exits as pooling threads are never joined
+	mutex_lock(&buffer_pools_lock);
+	g_queue_push_tail(&buffer_pools, t_pool);
+	mutex_unlock(&buffer_pools_lock);
+	return t_pool;
+}
+
+static void __remote_push(struct buffer_pool *bp, struct packet_buf *pb) {
+	struct packet_buf *head;
+	do {
+		head = g_atomic_pointer_get(&bp->remote);
+		pb->next = head;
+	} while (!g_atomic_pointer_compare_and_exchange(&bp->remote, head, pb));
+}
+
+static struct packet_buf *__remote_grab(struct buffer_pool *bp) {
+	struct packet_buf *head;
+	do {
+		head = g_atomic_pointer_get(&bp->remote);
+		if (!head)
+			return NULL;
+	} while (!g_atomic_pointer_compare_and_exchange(&bp->remote, head, NULL));
+	return head;
+}
+
+struct packet_buf *packet_buf_new(void) {
+	struct buffer_pool *bp = buffer_pool_get();
+	struct packet_buf *pb = bp->free;
+
+	if (!pb) {
+		pb = bp->free = __remote_grab(bp);
+		for (struct packet_buf *n = pb; n; n = n->next)
+			bp->num_free++;
+	}
+
+	if (G_LIKELY(pb)) {
+		bp->free = pb->next;
+		bp->num_free--;
+		atomic64_add_na(&bp->hits, 1);
+	}
+	else {
+		pb = g_slice_alloc(sizeof(*pb));
+		pb->pool = bp;
+		atomic64_add_na(&bp->exhausted, 1);
+	}
+
+	pb->ref = 1;
+	pb->next = NULL;
+	return pb;
+}
+
+void packet_buf_put(struct packet_buf *pb) {
+	if (!pb)
+		return;
+	if (!g_atomic_int_dec_and_test(&pb->ref))
+		return;
+
+	struct buffer_pool *bp = pb->pool;
+
+	if (bp != t_pool) {
+		__remote_push(bp, pb);
+		return;
+	}
+
+	if (bp->num_free >= BUFFER_POOL_MAX_FREE) {
+		g_slice_free1(sizeof(*pb), pb);
+		return;
+	}
+
+	pb->next = bp->free;
+	bp->free = pb;
+	bp->num_free++;
+}
+
+void buffer_pool_stats(struct buffer_pool_stats *out) {
+	ZERO(*out);
+	mutex_lock(&buffer_pools_lock);
+	for (GList *l = buffer_pools.head; l; l = l->next) {
+		struct buffer_pool *bp = l->data;
+		out->hits += atomic64_get(&bp->hits);
+		out->exhausted += atomic64_get(&bp->exhausted);
+	}
+	mutex_unlock(&buffer_pools_lock);
+}
@@ -47,6 +47,7 @@
 #include "media_player.h"
 #include "jitter_buffer.h"
 #include "t38.h"
+#include "uring.h"
 
 
 struct iterator_helper {
@@ -65,9 +66,51 @@ struct xmlrpc_helper {
 /* XXX rework these */
 struct stats rtpe_statsps;
 struct stats rtpe_stats;
-
-rwlock_t rtpe_callhash_lock;
-GHashTable *rtpe_callhash;
+struct call_sweep_stats rtpe_sweep_stats;
+
+// The call hash is split up by call-ID so that signalling for different calls doesn't
+// contend on one lock. Shard locks are never held while waiting for a call's master_lock.
+#define CALL_SHARDS 64 // power of two
+
+static struct call_shard {
+	rwlock_t lock;
+	GHashTable *calls; // call-ID -> call, holding a reference
+} call_shards[CALL_SHARDS];
+
+static volatile unsigned int num_calls;
+
+INLINE struct call_shard *call_shard(const str *callid) {
+	unsigned int h = str_hash(callid);
+	return &call_shards[(h ^ (h >> 16)) & (CALL_SHARDS - 1)];
+}
+
+// One list of calls per call timer sweep thread, in round-robin order. Each thread
+// checks a slice of its list every tick. Each call is visited once per round, and a new
+// round is started at most once per second. The list is chosen by the call's shard, so
+// that creating and destroying calls doesn't contend on one lock. The counters are
+// consumed by call_timer() once per interval.
+static struct call_sweep {
+	mutex_t lock;
+	GQueue calls; // linked through call->sweep_link, no references held
+	unsigned int round; // visited calls are moved to the back with this number set
+	struct timeval round_start;
+	uint64_t transcoded_media;
+	// instrumentation
+	uint64_t swept;
+	uint64_t slices;
+	uint64_t time; // usec
+	uint64_t max_time;
+} *call_sweeps;
+static unsigned int num_call_sweeps;
+
+// without a kernel stats area: endpoint_t -> struct rtpengine_stats_slot,
+// read from the list of forwarding rules once per call_timer() run
+static mutex_t kernel_list_stats_lock;
+static GHashTable *kernel_list_stats;
+
+INLINE struct call_sweep *call_sweep(struct call_shard *sh) {
+	return &call_sweeps[(sh - call_shards) % num_call_sweeps];
+}
 
 /* ********** */
 
@@ -473,12 +516,11 @@ destroy:
 #define DS(x) do {							\
 		u_int64_t ks_val;					\
 		ks_val = atomic64_get(&ps->kernel_stats.x);		\
-		if (ke->stats.x < ks_val)				\
+		if (ks.x < ks_val)					\
 			diff_ ## x = 0;					\
 		else							\
-			diff_ ## x = ke->stats.x - ks_val;		\
+			diff_ ## x = ks.x - ks_val;			\
 		atomic64_add(&ps->stats.x, diff_ ## x);			\
-		atomic64_add(&rtpe_statsps.x, diff_ ## x);		\
 	} while (0)
 
 static void update_requests_per_second_stats(struct requests_ps *request, u_int64_t new_val) {
@@ -498,25 +540,238 @@ static void update_requests_per_second_stats(struct requests_ps *request, u_int6
 	mutex_unlock(&request->lock);
 }
 
-static void calls_build_list(void *k, void *v, void *d) {
-	GSList **list = d;
-	struct call *c = v;
-	*list = g_slist_prepend(*list, obj_get(c));
+/* sync stats of a kernelized stream from its slot in the kernel stats area, or from
+ * the list of forwarding rules given in `d` */
+static void call_timer_kernel_stats(void *k, void *v, void *d) {
+	struct stream_fd *sfd = v;
+	GHashTable *kernel_list_stats = d;
+	struct packet_stream *ps, *sink;
+	const struct rtpengine_stats_slot *slot;
+	struct rtpengine_stats_slot ks;
+	struct rtp_stats *rs;
+	unsigned int pt, j;
+	int update;
+
+	rwlock_lock_r(&sfd->call->master_lock);
+
+	ps = sfd->stream;
+	if (!ps || ps->selected_sfd != sfd)
+		goto out;
+
+	// the slot can be released and reused as soon as the stream is unkernelized
+	mutex_lock(&ps->in_lock);
+	slot = kernel_stats_slot(ps->kernel_stats_idx);
+	if (!slot && kernel_list_stats)
+		slot = g_hash_table_lookup(kernel_list_stats, &sfd->socket.local);
+	if (slot)
+		ks = *slot;
+	mutex_unlock(&ps->in_lock);
+	if (!slot)
+		goto out;
+
+	uint64_t diff_packets, diff_bytes, diff_errors;
+
+	DS(packets);
+	DS(bytes);
+	DS(errors);
+	stats_shard_add(sfd->local_intf->stats_idx, diff_packets, diff_bytes, diff_errors);
+
+
+	if (ks.packets != atomic64_get(&ps->kernel_stats.packets))
+		atomic64_set(&ps->last_packet, rtpe_now.tv_sec);
+
+	ps->stats.in_tos_tclass = ks.in_tos;
+
+#if (RE_HAS_MEASUREDELAY)
+	/* XXX fix atomicity */
+	ps->stats.delay_min = ks.delay_min;
+	ps->stats.delay_avg = ks.delay_avg;
+	ps->stats.delay_max = ks.delay_max;
+#endif
+
+	atomic64_set(&ps->kernel_stats.bytes, ks.bytes);
+	atomic64_set(&ps->kernel_stats.packets, ks.packets);
+	atomic64_set(&ps->kernel_stats.errors, ks.errors);
+
+	for (j = 0; j < ks.num_payload_types && j < G_N_ELEMENTS(ks.payload_types); j++) {
+		pt = ks.payload_types[j];
+		rs = rtp_stats_get(ps, pt);
+		if (!rs)
+			continue;
+		if (ks.rtp_stats[j].packets > atomic64_get(&rs->packets))
+			atomic64_add(&rs->packets,
+					ks.rtp_stats[j].packets - atomic64_get(&rs->packets));
+		if (ks.rtp_stats[j].bytes > atomic64_get(&rs->bytes))
+			atomic64_add(&rs->bytes,
+					ks.rtp_stats[j].bytes - atomic64_get(&rs->bytes));
+		atomic64_set(&rs->kernel_packets, ks.rtp_stats[j].packets);
+		atomic64_set(&rs->kernel_bytes, ks.rtp_stats[j].bytes);
+	}
+
+	update = 0;
+
+	sink = packet_stream_sink(ps);
+
+	if (!ks.non_forwarding && diff_packets) {
+		if (sink) {
+			mutex_lock(&sink->out_lock);
+			if (sink->crypto.params.crypto_suite && sink->ssrc_out
+					&& ntohl(ks.ssrc) == sink->ssrc_out->parent->h.ssrc
+					&& ks.encrypt_last_index - sink->ssrc_out->srtp_index > 0x4000)
+			{
+				sink->ssrc_out->srtp_index = ks.encrypt_last_index;
+				update = 1;
+			}
+			mutex_unlock(&sink->out_lock);
+		}
+
+		mutex_lock(&ps->in_lock);
+
+		if (ps->ssrc_in && ntohl(ks.ssrc) == ps->ssrc_in->parent->h.ssrc) {
+			atomic64_add(&ps->ssrc_in->octets, diff_bytes);
+			atomic64_add(&ps->ssrc_in->packets, diff_packets);
+			atomic64_set(&ps->ssrc_in->last_seq, ks.decrypt_last_index);
+			ps->ssrc_in->srtp_index = ks.decrypt_last_index;
+
+			if (sfd->crypto.params.crypto_suite
+					&& ks.decrypt_last_index
+					- ps->ssrc_in->srtp_index > 0x4000)
+				update = 1;
+		}
+		mutex_unlock(&ps->in_lock);
+	}
+
+	rwlock_unlock_r(&sfd->call->master_lock);
+
+	if (update) {
+			redis_update_onekey(ps->call, rtpe_redis_write);
+	}
+
+	obj_put(sfd);
+	return;
+
+out:
+	rwlock_unlock_r(&sfd->call->master_lock);
+	obj_put(sfd);
 }
 
-static void call_timer(void *ptr) {
+static void call_timer_sweep(struct call_sweep *sw) {
 	struct iterator_helper hlp;
-	GList *i, *l;
 	GSList *calls = NULL;
+	GHashTable *kl_stats;
+	struct timeval tv_start, tv_stop;
+	unsigned int num, i;
+
+	gettimeofday(&tv_start, NULL);
+	rtpe_now = tv_start;
+
+	// spread each round over all ticks, so that every call is visited about once per second
+	mutex_lock(&sw->lock);
+	num = (sw->calls.length + CALL_SWEEP_TICKS - 1) / CALL_SWEEP_TICKS;
+	for (i = 0; i < num; i++) {
+		GList *link = sw->calls.head;
+		if (!link)
+			break;
+		struct call *c = link->data;
+		if (c->sweep_round == sw->round) {
+			// everything has been visited in this round
+			if (timeval_diff(&tv_start, &sw->round_start) < 1000000)
+				break;
+			sw->round++;
+			sw->round_start = tv_start;
+		}
+		c->sweep_round = sw->round;
+		g_queue_unlink(&sw->calls, link);
+		g_queue_push_tail_link(&sw->calls, link);
+		calls = g_slist_prepend(calls, obj_get(c));
+	}
+	num = i;
+	mutex_unlock(&sw->lock);
+
+	mutex_lock(&kernel_list_stats_lock);
+	if ((kl_stats = kernel_list_stats))
+		g_hash_table_ref(kl_stats);
+	mutex_unlock(&kernel_list_stats_lock);
+
+	if (!calls)
+		goto out;
+
+	ZERO(hlp);
+	hlp.addr_sfd = g_hash_table_new(g_endpoint_hash, g_endpoint_eq);
+
+	while (calls) {
+		struct call *c = calls->data;
+		call_timer_iterator(c, &hlp);
+		calls = g_slist_delete_link(calls, calls);
+	}
+
+	// releases the references
+	g_hash_table_foreach(hlp.addr_sfd, call_timer_kernel_stats, kl_stats);
+	g_hash_table_destroy(hlp.addr_sfd);
+
+	kill_calls_timer(hlp.del_scheduled, NULL);
+	kill_calls_timer(hlp.del_timeout, rtpe_config.b2b_url);
+
+	gettimeofday(&tv_stop, NULL);
+	uint64_t duration = timeval_diff(&tv_stop, &tv_start);
+
+	mutex_lock(&sw->lock);
+	sw->transcoded_media += hlp.transcoded_media;
+	sw->swept += num;
+	sw->slices++;
+	sw->time += duration;
+	if (duration > sw->max_time)
+		sw->max_time = duration;
+	mutex_unlock(&sw->lock);
+
+out:
+	if (kl_stats)
+		g_hash_table_unref(kl_stats);
+}
+
+// without a kernel stats area, reads the stats of all forwarding rules for the sweep threads
+static void call_timer_kernel_list(void) {
+	GHashTable *ht, *old;
 	struct rtpengine_list_entry *ke;
-	struct packet_stream *ps, *sink;
+
+	ht = g_hash_table_new_full(g_endpoint_hash, g_endpoint_eq, g_free, g_free);
+
+	GList *l = kernel_list();
+	while (l) {
+		ke = l->data;
+
+		endpoint_t *ep = g_new(endpoint_t, 1);
+		struct rtpengine_stats_slot *ks = g_new(struct rtpengine_stats_slot, 1);
+		kernel2endpoint(ep, &ke->target.local);
+		kernel_list_entry_stats(ks, ke);
+		g_hash_table_replace(ht, ep, ks);
+
+		g_slice_free1(sizeof(*ke), ke);
+		l = g_list_delete_link(l, l);
+	}
+
+	mutex_lock(&kernel_list_stats_lock);
+	old = kernel_list_stats;
+	kernel_list_stats = ht;
+	mutex_unlock(&kernel_list_stats_lock);
+
+	if (old)
+		g_hash_table_unref(old);
+}
+
+void call_timer_loop(void *p) {
+	struct call_sweep *sw = &call_sweeps[GPOINTER_TO_UINT(p) % num_call_sweeps];
+
+	while (!rtpe_shutdown) {
+		usleep(1000000 / CALL_SWEEP_TICKS);
+		call_timer_sweep(sw);
+	}
+}
+
+static void call_timer(void *ptr) {
 	struct stats tmpstats;
-	int j, update;
-	struct stream_fd *sfd;
-	struct rtp_stats *rs;
-	unsigned int pt;
-	endpoint_t ep;
 	u_int64_t offers, answers, deletes;
+	u_int64_t transcoded_media, swept, slices, sweep_time, max_time, num_calls;
 	struct timeval tv_start;
 	long long run_diff;
 
@@ -539,19 +794,30 @@ static void call_timer(void *ptr) {
 	if (run_diff < 1)
 		run_diff = 1;
 
-	ZERO(hlp);
-	hlp.addr_sfd = g_hash_table_new(g_endpoint_hash, g_endpoint_eq);
-
-	/* obtain the call list and make a copy from it so not to hold the lock */
-	rwlock_lock_r(&rtpe_callhash_lock);
-	g_hash_table_foreach(rtpe_callhash, calls_build_list, &calls);
-	rwlock_unlock_r(&rtpe_callhash_lock);
-
-	while (calls) {
-		struct call *c = calls->data;
-		call_timer_iterator(c, &hlp);
-		calls = g_slist_delete_link(calls, calls);
-	}
+	/* take over what the sweep threads have collected since the last run */
+	transcoded_media = swept = slices = sweep_time = max_time = num_calls = 0;
+	for (unsigned int i = 0; i < num_call_sweeps; i++) {
+		struct call_sweep *sw = &call_sweeps[i];
+		mutex_lock(&sw->lock);
+		transcoded_media += sw->transcoded_media;
+		swept += sw->swept;
+		slices += sw->slices;
+		sweep_time += sw->time;
+		if (sw->max_time > max_time)
+			max_time = sw->max_time;
+		sw->transcoded_media = sw->swept = sw->slices = 0;
+		sw->time = sw->max_time = 0;
+		num_calls += sw->calls.length;
+		mutex_unlock(&sw->lock);
+	}
+
+	swept /= run_diff;
+	atomic64_set(&rtpe_sweep_stats.calls_ps, swept);
+	atomic64_set(&rtpe_sweep_stats.backlog, swept < num_calls ? num_calls - swept : 0);
+	atomic64_set(&rtpe_sweep_stats.avg_time, slices ? sweep_time / slices : 0);
+	atomic64_set(&rtpe_sweep_stats.max_time, max_time);
+
+	statistics_collect_shards(run_diff);
 
 	atomic64_local_copy_zero_struct(&tmpstats, &rtpe_statsps, bytes);
 	atomic64_local_copy_zero_struct(&tmpstats, &rtpe_statsps, packets);
@@ -572,118 +838,10 @@ static void call_timer(void *ptr) {
 	update_requests_per_second_stats(&rtpe_totalstats_interval.deletes_ps,	deletes / run_diff);
 
 	// stats derived while iterating calls
-	atomic64_set(&rtpe_stats.transcoded_media, hlp.transcoded_media);
-
-	i = kernel_list();
-	while (i) {
-		ke = i->data;
-
-		kernel2endpoint(&ep, &ke->target.local);
-		sfd = g_hash_table_lookup(hlp.addr_sfd, &ep);
-		if (!sfd)
-			goto next;
-
-		rwlock_lock_r(&sfd->call->master_lock);
-
-		ps = sfd->stream;
-		if (!ps || ps->selected_sfd != sfd) {
-			rwlock_unlock_r(&sfd->call->master_lock);
-			goto next;
-		}
-
-		uint64_t diff_packets, diff_bytes, diff_errors;
-
-		DS(packets);
-		DS(bytes);
-		DS(errors);
-
-
-		if (ke->stats.packets != atomic64_get(&ps->kernel_stats.packets))
-			atomic64_set(&ps->last_packet, rtpe_now.tv_sec);
-
-		ps->stats.in_tos_tclass = ke->stats.in_tos;
-
-#if (RE_HAS_MEASUREDELAY)
-		/* XXX fix atomicity */
-		ps->stats.delay_min = ke->stats.delay_min;
-		ps->stats.delay_avg = ke->stats.delay_avg;
-		ps->stats.delay_max = ke->stats.delay_max;
-#endif
-
-		atomic64_set(&ps->kernel_stats.bytes, ke->stats.bytes);
-		atomic64_set(&ps->kernel_stats.packets, ke->stats.packets);
-		atomic64_set(&ps->kernel_stats.errors, ke->stats.errors);
-
-		for (j = 0; j < ke->target.num_payload_types; j++) {
-			pt = ke->target.payload_types[j];
-			rs = g_hash_table_lookup(ps->rtp_stats, &pt);
-			if (!rs)
-				continue;
-			if (ke->rtp_stats[j].packets > atomic64_get(&rs->packets))
-				atomic64_add(&rs->packets,
-						ke->rtp_stats[j].packets - atomic64_get(&rs->packets));
-			if (ke->rtp_stats[j].bytes > atomic64_get(&rs->bytes))
-				atomic64_add(&rs->bytes,
-						ke->rtp_stats[j].bytes - atomic64_get(&rs->bytes));
-			atomic64_set(&rs->kernel_packets, ke->rtp_stats[j].packets);
-			atomic64_set(&rs->kernel_bytes, ke->rtp_stats[j].bytes);
-		}
-
-		update = 0;
-
-		sink = packet_stream_sink(ps);
-
-		if (!ke->target.non_forwarding && diff_packets) {
-			if (sink) {
-				mutex_lock(&sink->out_lock);
-				if (sink->crypto.params.crypto_suite && sink->ssrc_out
-						&& ntohl(ke->target.ssrc) == sink->ssrc_out->parent->h.ssrc
-						&& ke->target.encrypt.last_index - sink->ssrc_out->srtp_index > 0x4000)
-				{
-					sink->ssrc_out->srtp_index = ke->target.encrypt.last_index;
-					update = 1;
-				}
-				mutex_unlock(&sink->out_lock);
-			}
-
-			mutex_lock(&ps->in_lock);
+	atomic64_set(&rtpe_stats.transcoded_media, transcoded_media / run_diff);
 
-			if (ps->ssrc_in && ntohl(ke->target.ssrc) == ps->ssrc_in->parent->h.ssrc) {
-				atomic64_add(&ps->ssrc_in->octets, diff_bytes);
-				atomic64_add(&ps->ssrc_in->packets, diff_packets);
-				atomic64_set(&ps->ssrc_in->last_seq, ke->target.decrypt.last_index);
-				ps->ssrc_in->srtp_index = ke->target.decrypt.last_index;
-
-				if (sfd->crypto.params.crypto_suite
-						&& ke->target.decrypt.last_index
-						- ps->ssrc_in->srtp_index > 0x4000)
-					update = 1;
-			}
-			mutex_unlock(&ps->in_lock);
-		}
-
-		rwlock_unlock_r(&sfd->call->master_lock);
-
-		if (update) {
-				redis_update_onekey(ps->call, rtpe_redis_write);
-		}
-
-next:
-		g_hash_table_remove(hlp.addr_sfd, &ep);
-		g_slice_free1(sizeof(*ke), ke);
-		i = g_list_delete_link(i, i);
-		if (sfd)
-			obj_put(sfd);
-	}
-
-	l = g_hash_table_get_values(hlp.addr_sfd);
-	for (i = l; i; i = i->next)
-		obj_put((struct stream_fd *) i->data);
-	g_list_free(l);
-	g_hash_table_destroy(hlp.addr_sfd);
-
-	kill_calls_timer(hlp.del_scheduled, NULL);
-	kill_calls_timer(hlp.del_timeout, rtpe_config.b2b_url);
+	if (kernel.is_open && !kernel.num_stats_slots)
+		call_timer_kernel_list();
 
 	struct timeval tv_stop;
 	gettimeofday(&tv_stop, NULL);
@@ -705,10 +863,21 @@ next:
 
 
 int call_init() {
-	rtpe_callhash = g_hash_table_new(str_hash, str_equal);
-	if (!rtpe_callhash)
-		return -1;
-	rwlock_init(&rtpe_callhash_lock);
+	for (unsigned int i = 0; i < CALL_SHARDS; i++) {
+		struct call_shard *sh = &call_shards[i];
+		sh->calls = g_hash_table_new(str_hash, str_equal);
+		if (!sh->calls)
+			return -1;
+		rwlock_init(&sh->lock);
+	}
+
+	num_call_sweeps = MAX(rtpe_config.timer_sweep_threads, 1);
+	call_sweeps = g_new0(struct call_sweep, num_call_sweeps);
+	for (unsigned int i = 0; i < num_call_sweeps; i++) {
+		mutex_init(&call_sweeps[i].lock);
+		g_queue_init(&call_sweeps[i].calls);
+	}
+	mutex_init(&kernel_list_stats_lock);
 
 	poller_add_timer(rtpe_poller, call_timer, NULL);
 
@@ -924,10 +1093,6 @@ static int __wildcard_endpoint_map(struct call_media *media, unsigned int num_po
 	return 0;
 }
 
-static void __rtp_stats_free(void *p) {
-	g_slice_free1(sizeof(struct rtp_stats), p);
-}
-
 struct packet_stream *__packet_stream_new(struct call *call) {
 	struct packet_stream *stream;
 
@@ -936,7 +1101,7 @@ struct packet_stream *__packet_stream_new(struct call *call) {
 	mutex_init(&stream->out_lock);
 	stream->call = call;
 	atomic64_set_na(&stream->last_packet, rtpe_now.tv_sec);
-	stream->rtp_stats = g_hash_table_new_full(g_int_hash, g_int_equal, NULL, __rtp_stats_free);
+	stream->kernel_stats_idx = UNINIT_IDX;
 	recording_init_stream(stream);
 	stream->send_timer = send_timer_new(stream);
 
@@ -1091,25 +1256,27 @@ static int __init_stream(struct packet_stream *ps) {
 	return 0;
 }
 
-void __rtp_stats_update(GHashTable *dst, GHashTable *src) {
+void __rtp_stats_update(struct rtp_stats **dst, GHashTable *src) {
 	struct rtp_stats *rs;
 	struct rtp_payload_type *pt;
 	GList *values, *l;
 
 	/* "src" is a call_media->codecs table, while "dst" is a
-	 * packet_stream->rtp_stats table */
+	 * packet_stream->rtp_stats array */
 
 	values = g_hash_table_get_values(src);
 
 	for (l = values; l; l = l->next) {
 		pt = l->data;
-		rs = g_hash_table_lookup(dst, &pt->payload_type);
-		if (rs)
+		if (pt->payload_type < 0 || pt->payload_type >= RTP_STATS_PT_SLOTS)
+			continue;
+		if (dst[pt->payload_type])
 			continue;
 
 		rs = g_slice_alloc0(sizeof(*rs));
 		rs->payload_type = pt->payload_type;
-		g_hash_table_insert(dst, &rs->payload_type, rs);
+		// published to the lock-free readers in the media path
+		g_atomic_pointer_set(&dst[pt->payload_type], rs);
 	}
 
 	g_list_free(values);
@@ -2184,22 +2351,10 @@ error_intf:
 }
 
 
-static int __rtp_stats_sort(const void *ap, const void *bp) {
-	const struct rtp_stats *a = ap, *b = bp;
-
-	/* descending order */
-	if (atomic64_get(&a->packets) > atomic64_get(&b->packets))
-		return -1;
-	if (atomic64_get(&a->packets) < atomic64_get(&b->packets))
-		return 1;
-	return 0;
-}
-
 const struct rtp_payload_type *__rtp_stats_codec(struct call_media *m) {
 	struct packet_stream *ps;
-	GList *values;
-	struct rtp_stats *rtp_s;
-	const struct rtp_payload_type *rtp_pt = NULL;
+	struct rtp_stats *rtp_s, *max = NULL;
+	u_int64_t packets, max_packets = 0;
 
 	/* we only use the primary packet stream for the time being */
 	if (!m->streams.head)
@@ -2207,22 +2362,22 @@ const struct rtp_payload_type *__rtp_stats_codec(struct call_media *m) {
 
 	ps = m->streams.head->data;
 
-	values = g_hash_table_get_values(ps->rtp_stats);
-	if (!values)
-		return NULL;
-
-	values = g_list_sort(values, __rtp_stats_sort);
-
 	/* payload type with the most packets */
-	rtp_s = values->data;
-	if (atomic64_get(&rtp_s->packets) == 0)
-		goto out;
+	for (unsigned int i = 0; i < RTP_STATS_PT_SLOTS; i++) {
+		rtp_s = rtp_stats_get(ps, i);
+		if (!rtp_s)
+			continue;
+		packets = atomic64_get(&rtp_s->packets);
+		if (packets <= max_packets)
+			continue;
+		max = rtp_s;
+		max_packets = packets;
+	}
 
-	rtp_pt = rtp_payload_type(rtp_s->payload_type, m->codecs_recv);
+	if (!max)
+		return NULL;
 
-out:
-	g_list_free(values);
-	return rtp_pt; /* may be NULL */
+	return rtp_payload_type(max->payload_type, m->codecs_recv); /* may be NULL */
 }
 
 void add_total_calls_duration_in_interval(struct timeval *interval_tv) {
@@ -2239,19 +2394,17 @@ void add_total_calls_duration_in_interval(struct timeval *interval_tv) {
 static struct timeval add_ongoing_calls_dur_in_interval(struct timeval *interval_start,
 		struct timeval *interval_duration)
 {
-	GHashTableIter iter;
-	gpointer key, value;
+	GQueue calls = G_QUEUE_INIT;
 	struct timeval call_duration, res = {0};
 	struct call *call;
 	struct call_monologue *ml;
 
-	rwlock_lock_r(&rtpe_callhash_lock);
-	g_hash_table_iter_init(&iter, rtpe_callhash);
+	call_get_all_calls(&calls);
 
-	while (g_hash_table_iter_next(&iter, &key, &value)) {
-		call = (struct call*) value;
+	while ((call = g_queue_pop_head(&calls))) {
+		rwlock_lock_r(&call->master_lock);
 		if (!call->monologues.head || IS_FOREIGN_CALL(call))
-			continue;
+			goto next;
 		ml = call->monologues.head->data;
 		if (timercmp(interval_start, &ml->started, >)) {
 			timeval_add(&res, &res, interval_duration);
@@ -2259,8 +2412,10 @@ static struct timeval add_ongoing_calls_dur_in_interval(struct timeval *interval
 			timeval_subtract(&call_duration, &rtpe_now, &ml->started);
 			timeval_add(&res, &res, &call_duration);
 		}
+next:
+		rwlock_unlock_r(&call->master_lock);
+		obj_put(call);
 	}
-	rwlock_unlock_r(&rtpe_callhash_lock);
 	return res;
 }
 
@@ -2279,11 +2434,19 @@ void call_destroy(struct call *c) {
 		return;
 	}
 
-	rwlock_lock_w(&rtpe_callhash_lock);
-	ret = (g_hash_table_lookup(rtpe_callhash, &c->callid) == c);
-	if (ret)
-		g_hash_table_remove(rtpe_callhash, &c->callid);
-	rwlock_unlock_w(&rtpe_callhash_lock);
+	struct call_shard *sh = call_shard(&c->callid);
+	rwlock_lock_w(&sh->lock);
+	ret = (g_hash_table_lookup(sh->calls, &c->callid) == c);
+	if (ret) {
+		g_hash_table_remove(sh->calls, &c->callid);
+		g_atomic_int_add(&num_calls, -1);
+		g_atomic_int_set(&c->unlinked, 1);
+		struct call_sweep *sw = call_sweep(sh);
+		mutex_lock(&sw->lock);
+		g_queue_unlink(&sw->calls, &c->sweep_link);
+		mutex_unlock(&sw->lock);
+	}
+	rwlock_unlock_w(&sh->lock);
 
 	// if call not found in callhash => previously deleted
 	if (!ret)
@@ -2442,7 +2605,10 @@ no_stats_output:
 
 	while (c->stream_fds.head) {
 		sfd = g_queue_pop_head(&c->stream_fds);
-		poller_del_item(rtpe_poller, sfd->socket.fd);
+		if (sfd->uring)
+			uring_del_sfd(sfd);
+		else
+			poller_del_item(c->poller, sfd->socket.fd);
 		obj_put(sfd);
 	}
 
@@ -2541,7 +2707,10 @@ static void __call_free(void *p) {
 		ps = g_queue_pop_head(&c->streams);
 		crypto_cleanup(&ps->crypto);
 		g_queue_clear(&ps->sfds);
-		g_hash_table_destroy(ps->rtp_stats);
+		for (unsigned int i = 0; i < RTP_STATS_PT_SLOTS; i++) {
+			if (ps->rtp_stats[i])
+				g_slice_free1(sizeof(struct rtp_stats), ps->rtp_stats[i]);
+		}
 		ssrc_ctx_put(&ps->ssrc_in);
 		ssrc_ctx_put(&ps->ssrc_out);
 		g_slice_free1(sizeof(*ps), ps);
@@ -2554,6 +2723,17 @@ static void __call_free(void *p) {
 	assert(c->stream_fds.head == NULL);
 }
 
+// all sockets of a call are handled by the same poller, and thus the same thread
+static struct poller *call_poller(void) {
+	static volatile int rr;
+
+	if (!rtpe_config.media_pollers || !rtpe_media_pollers)
+		return rtpe_poller;
+
+	unsigned int idx = g_atomic_int_add(&rr, 1);
+	return rtpe_media_pollers[idx % rtpe_config.media_pollers];
+}
+
 static struct call *call_create(const str *callid) {
 	struct call *c;
 
@@ -2570,6 +2750,8 @@ static struct call *call_create(const str *callid) {
 	c->dtls_cert = dtls_cert();
 	c->tos = rtpe_config.default_tos;
 	c->ssrc_hash = create_ssrc_hash_call();
+	c->poller = call_poller();
+	c->uring = uring_get();
 
 	return c;
 }
@@ -2577,36 +2759,40 @@ static struct call *call_create(const str *callid) {
 /* returns call with master_lock held in W */
 struct call *call_get_or_create(const str *callid, enum call_type type) {
 	struct call *c;
+	struct call_shard *sh = call_shard(callid);
 
 restart:
-	rwlock_lock_r(&rtpe_callhash_lock);
-	c = g_hash_table_lookup(rtpe_callhash, callid);
-	if (!c) {
-		rwlock_unlock_r(&rtpe_callhash_lock);
-		/* completely new call-id, create call */
-		c = call_create(callid);
-		rwlock_lock_w(&rtpe_callhash_lock);
-		if (g_hash_table_lookup(rtpe_callhash, callid)) {
-			/* preempted */
-			rwlock_unlock_w(&rtpe_callhash_lock);
-			obj_put(c);
-			goto restart;
-		}
-		g_hash_table_insert(rtpe_callhash, &c->callid, obj_get(c));
-
-		if (type == CT_FOREIGN_CALL)  /* foreign call*/
-					c->foreign_call = 1;
+	c = call_get(callid);
+	if (c)
+		return c;
 
-		statistics_update_foreignown_inc(c);
+	/* completely new call-id, create call */
+	c = call_create(callid);
+	/* nobody else can see the call yet, so this doesn't block */
+	rwlock_lock_w(&c->master_lock);
 
-		rwlock_lock_w(&c->master_lock);
-		rwlock_unlock_w(&rtpe_callhash_lock);
-	}
-	else {
-		obj_hold(c);
-		rwlock_lock_w(&c->master_lock);
-		rwlock_unlock_r(&rtpe_callhash_lock);
+	rwlock_lock_w(&sh->lock);
+	if (g_hash_table_lookup(sh->calls, callid)) {
+		/* preempted */
+		rwlock_unlock_w(&sh->lock);
+		rwlock_unlock_w(&c->master_lock);
+		obj_put(c);
+		goto restart;
 	}
+	g_hash_table_insert(sh->calls, &c->callid, obj_get(c));
+	g_atomic_int_inc(&num_calls);
+	c->sweep_link.data = c;
+	struct call_sweep *sw = call_sweep(sh);
+	mutex_lock(&sw->lock);
+	g_queue_push_tail_link(&sw->calls, &c->sweep_link);
+	mutex_unlock(&sw->lock);
+
+	if (type == CT_FOREIGN_CALL)  /* foreign call*/
+		c->foreign_call = 1;
+
+	statistics_update_foreignown_inc(c);
+
+	rwlock_unlock_w(&sh->lock);
 
 	log_info_call(c);
 	return c;
@@ -2615,17 +2801,26 @@ restart:
 /* returns call with master_lock held in W, or NULL if not found */
 struct call *call_get(const str *callid) {
 	struct call *ret;
+	struct call_shard *sh = call_shard(callid);
 
-	rwlock_lock_r(&rtpe_callhash_lock);
-	ret = g_hash_table_lookup(rtpe_callhash, callid);
+restart:
+	rwlock_lock_r(&sh->lock);
+	ret = g_hash_table_lookup(sh->calls, callid);
 	if (!ret) {
-		rwlock_unlock_r(&rtpe_callhash_lock);
+		rwlock_unlock_r(&sh->lock);
 		return NULL;
 	}
+	obj_hold(ret);
+	rwlock_unlock_r(&sh->lock);
 
 	rwlock_lock_w(&ret->master_lock);
-	obj_hold(ret);
-	rwlock_unlock_r(&rtpe_callhash_lock);
+
+	/* destroyed while we were waiting for the lock? */
+	if (G_UNLIKELY(g_atomic_int_get(&ret->unlinked))) {
+		rwlock_unlock_w(&ret->master_lock);
+		obj_put(ret);
+		goto restart;
+	}
 
 	log_info_call(ret);
 	return ret;
@@ -3045,8 +3240,14 @@ static void call_get_all_calls_interator(void *key, void *val, void *ptr) {
 }
 
 void call_get_all_calls(GQueue *q) {
-	rwlock_lock_r(&rtpe_callhash_lock);
-	g_hash_table_foreach(rtpe_callhash, call_get_all_calls_interator, q);
-	rwlock_unlock_r(&rtpe_callhash_lock);
+	for (unsigned int i = 0; i < CALL_SHARDS; i++) {
+		struct call_shard *sh = &call_shards[i];
+		rwlock_lock_r(&sh->lock);
+		g_hash_table_foreach(sh->calls, call_get_all_calls_interator, q);
+		rwlock_unlock_r(&sh->lock);
+	}
+}
 
+unsigned int call_num_calls(void) {
+	return g_atomic_int_get(&num_calls);
 }
@@ -995,8 +995,7 @@ static enum load_limit_reasons call_offer_session_limit(void) {
 
 	rwlock_lock_r(&rtpe_config.config_lock);
 	if (rtpe_config.max_sessions>=0) {
-		rwlock_lock_r(&rtpe_callhash_lock);
-		if (g_hash_table_size(rtpe_callhash) -
+		if (call_num_calls() -
 				atomic64_get(&rtpe_stats.foreign_sessions) >= rtpe_config.max_sessions)
 		{
 			/* foreign calls can't get rejected
@@ -1007,7 +1006,6 @@ static enum load_limit_reasons call_offer_session_limit(void) {
 
 			ret = LOAD_LIMIT_MAX_SESSIONS;
 		}
-		rwlock_unlock_r(&rtpe_callhash_lock);
 	}
 
 	if (ret == LOAD_LIMIT_NONE && rtpe_config.load_limit) {
@@ -1536,17 +1534,18 @@ stats:
 }
 
 static void ng_list_calls(bencode_item_t *output, long long int limit) {
-	GHashTableIter iter;
-	gpointer key, value;
+	GQueue calls = G_QUEUE_INIT;
+	struct call *c;
 
-	rwlock_lock_r(&rtpe_callhash_lock);
+	call_get_all_calls(&calls);
 
-	g_hash_table_iter_init (&iter, rtpe_callhash);
-	while (limit-- && g_hash_table_iter_next (&iter, &key, &value)) {
-		bencode_list_add_str_dup(output, key);
+	while ((c = g_queue_pop_head(&calls))) {
+		if (limit) {
+			bencode_list_add_str_dup(output, &c->callid);
+			limit--;
+		}
+		obj_put(c);
 	}
-
-	rwlock_unlock_r(&rtpe_callhash_lock);
 }
 
 
@@ -25,6 +25,7 @@
 #include "str.h"
 #include "statistics.h"
 #include "main.h"
+#include "load.h"
 #include "media_socket.h"
 #include "rtplib.h"
 #include "ssrc.h"
@@ -172,41 +173,29 @@ static void cli_handler_do(const cli_handler_t *handlers, str *instr,
 static void destroy_own_foreign_calls(unsigned int foreign_call, unsigned int uint_keyspace_db) {
 	struct call *c = NULL;
 	struct call_monologue *ml = NULL;
+	GQueue all_calls = G_QUEUE_INIT;
 	GQueue call_list = G_QUEUE_INIT;
-	GHashTableIter iter;
-	gpointer key, value;
 	GList *i;
 
-	// lock read
-	rwlock_lock_r(&rtpe_callhash_lock);
-
-	g_hash_table_iter_init(&iter, rtpe_callhash);
-	while (g_hash_table_iter_next(&iter, &key, &value)) {
-		c = (struct call*)value;
-		if (!c) {
-			continue;
-		}
+	call_get_all_calls(&all_calls);
 
+	while ((c = g_queue_pop_head(&all_calls))) {
 		// match foreign_call flag
 		if ((foreign_call != UNDEFINED) && !(foreign_call == IS_FOREIGN_CALL(c))) {
+			obj_put(c);
 			continue;
 		}
 
 		// match uint_keyspace_db, if some given
 		if ((uint_keyspace_db != UNDEFINED) && !(uint_keyspace_db == c->redis_hosted_db)) {
+			obj_put(c);
 			continue;
 		}
-		
-		// increase ref counter
-		obj_get(c);
 
 		// save call reference
 		g_queue_push_tail(&call_list, c);
 	}
 
-	// unlock read
-	rwlock_unlock_r(&rtpe_callhash_lock);
-
 	// destroy calls
 	while ((c = g_queue_pop_head(&call_list))) {
 		if (!c->ml_deleted) {
@@ -418,11 +407,10 @@ static void cli_incoming_list_totals(str *instr, struct streambuf *replybuffer)
 }
 
 static void cli_incoming_list_numsessions(str *instr, struct streambuf *replybuffer) {
-       rwlock_lock_r(&rtpe_callhash_lock);
-       streambuf_printf(replybuffer, "Current sessions own: "UINT64F"\n", g_hash_table_size(rtpe_callhash) - atomic64_get(&rtpe_stats.foreign_sessions));
+       unsigned int num_calls = call_num_calls();
+       streambuf_printf(replybuffer, "Current sessions own: "UINT64F"\n", num_calls - atomic64_get(&rtpe_stats.foreign_sessions));
        streambuf_printf(replybuffer, "Current sessions foreign: "UINT64F"\n", atomic64_get(&rtpe_stats.foreign_sessions));
-       streambuf_printf(replybuffer, "Current sessions total: %i\n", g_hash_table_size(rtpe_callhash));
-       rwlock_unlock_r(&rtpe_callhash_lock);
+       streambuf_printf(replybuffer, "Current sessions total: %u\n", num_calls);
        streambuf_printf(replybuffer, "Current transcoded media: "UINT64F"\n", atomic64_get(&rtpe_stats.transcoded_media));
 }
 
@@ -615,9 +603,7 @@ static void cli_incoming_list_callid(str *instr, struct streambuf *replybuffer)
 }
 
 static void cli_incoming_list_sessions(str *instr, struct streambuf *replybuffer) {
-	GHashTableIter iter;
-	gpointer key, value;
-	str *ptrkey;
+	GQueue calls = G_QUEUE_INIT;
 	struct call *call;
 	int found_own = 0, found_foreign = 0;
 
@@ -630,43 +616,30 @@ static void cli_incoming_list_sessions(str *instr, struct streambuf *replybuffer
 		return;
 	}
 
-	rwlock_lock_r(&rtpe_callhash_lock);
-
-	if (g_hash_table_size(rtpe_callhash)==0) {
+	if (call_num_calls() == 0) {
 		streambuf_printf(replybuffer, "No sessions on this media relay.\n");
-		rwlock_unlock_r(&rtpe_callhash_lock);
 		return;
 	}
 
-	g_hash_table_iter_init (&iter, rtpe_callhash);
-	while (g_hash_table_iter_next(&iter, &key, &value)) {
-		ptrkey = (str*)key;
-		call = (struct call*)value;
+	// otherwise expect callid parameter
+	if (!str_cmp(instr, LIST_ALL) || !str_cmp(instr, LIST_OWN) || !str_cmp(instr, LIST_FOREIGN))
+		call_get_all_calls(&calls);
 
-		if (str_cmp(instr, LIST_ALL) == 0) {
-			if (!call) {
-				continue;
-			}
-		} else if (str_cmp(instr, LIST_OWN) == 0) {
-			if (!call || IS_FOREIGN_CALL(call)) {
-				continue;
-			} else {
-				found_own = 1;
-			}
+	while ((call = g_queue_pop_head(&calls))) {
+		if (str_cmp(instr, LIST_OWN) == 0) {
+			if (IS_FOREIGN_CALL(call))
+				goto next;
+			found_own = 1;
 		} else if (str_cmp(instr, LIST_FOREIGN) == 0) {
-			if (!call || !IS_FOREIGN_CALL(call)) {
-				continue;
-			} else {
-				found_foreign = 1;
-			}
-		} else {
-			// expect callid parameter
-			break;
+			if (!IS_FOREIGN_CALL(call))
+				goto next;
+			found_foreign = 1;
 		}
 
-		streambuf_printf(replybuffer, "callid: %60s | deletionmark:%4s | created:%12i | proxy:%s | redis_keyspace:%i | foreign:%s\n", ptrkey->s, call->ml_deleted?"yes":"no", (int)call->created.tv_sec, call->created_from, call->redis_hosted_db, IS_FOREIGN_CALL(call)?"yes":"no");
+		streambuf_printf(replybuffer, "callid: %60s | deletionmark:%4s | created:%12i | proxy:%s | redis_keyspace:%i | foreign:%s\n", call->callid.s, call->ml_deleted?"yes":"no", (int)call->created.tv_sec, call->created_from, call->redis_hosted_db, IS_FOREIGN_CALL(call)?"yes":"no");
+next:
+		obj_put(call);
 	}
-	rwlock_unlock_r(&rtpe_callhash_lock);
 
 	if (str_cmp(instr, LIST_ALL) == 0) {
 		;
@@ -1311,6 +1284,14 @@ static void cli_incoming_list_interfaces(str *instr, struct streambuf *replybuff
 				r - f, r, (double) (r - f) * 100.0 / r);
 		streambuf_printf(replybuffer, " Last port used: %5u\n",
 				l);
+		streambuf_printf(replybuffer, " Packets/bytes/errors per second: " UINT64F " / " UINT64F " / " UINT64F "\n",
+				atomic64_get(&lif->stats.ps.packets),
+				atomic64_get(&lif->stats.ps.bytes),
+				atomic64_get(&lif->stats.ps.errors));
+		streambuf_printf(replybuffer, " Total packets/bytes/errors: " UINT64F " / " UINT64F " / " UINT64F "\n",
+				atomic64_get(&lif->stats.totals.packets),
+				atomic64_get(&lif->stats.totals.bytes),
+				atomic64_get(&lif->stats.totals.errors));
 	}
 }
 
@@ -1335,6 +1316,10 @@ static void cli_incoming_list_jsonstats(str *instr, struct streambuf *replybuffe
 }
 
 static void cli_incoming_list_transcoders(str *instr, struct streambuf *replybuffer) {
+	if (rtpe_config.degrade_cpu)
+		streambuf_printf(replybuffer, "Degradation level: %i of %i\n",
+				g_atomic_int_get(&transcode_degradation), TRANSCODE_DEGRADE_MAX);
+
 	mutex_lock(&rtpe_codec_stats_lock);
 
 	GList *chains = g_hash_table_get_keys(rtpe_codec_stats);
@@ -1347,11 +1332,17 @@ static void cli_incoming_list_transcoders(str *instr, struct streambuf *replybuf
 			char *chain = l->data;
 			struct codec_stats *stats_entry = g_hash_table_lookup(rtpe_codec_stats, chain);
 			streambuf_printf(replybuffer, "%s: %i transcoders\n", chain, g_atomic_int_get(&stats_entry->num_transcoders));
+			streambuf_printf(replybuffer, "     " UINT64F " codec instances reused, " UINT64F " created\n",
+					atomic64_get(&stats_entry->pool_hits), atomic64_get(&stats_entry->pool_misses));
 			if (g_atomic_int_get(&stats_entry->last_tv_sec[idx]) != last_tv_sec)
 				continue;
 			streambuf_printf(replybuffer, "     " UINT64F " packets/s\n", atomic64_get(&stats_entry->packets_input[idx]));
 			streambuf_printf(replybuffer, "     " UINT64F " bytes/s\n", atomic64_get(&stats_entry->bytes_input[idx]));
 			streambuf_printf(replybuffer, "     " UINT64F " samples/s\n", atomic64_get(&stats_entry->pcm_samples[idx]));
+			u_int64_t worker_packets = atomic64_get(&stats_entry->worker_packets[idx]);
+			if (worker_packets)
+				streambuf_printf(replybuffer, "     " UINT64F " us avg latency in codec threads\n",
+						atomic64_get(&stats_entry->worker_latency_us[idx]) / worker_packets);
 		}
 	}
 
@@ -1369,7 +1360,6 @@ static void cli_incoming_list_controltos(str *instr, struct streambuf *replybuff
 static void cli_incoming_set_controltos(str *instr, struct streambuf *replybuffer) {
 	long tos;
 	char *endptr;
-	int i;
 
 	if (str_shift(instr, 1)) {
 		streambuf_printf(replybuffer, "%s\n", "More parameters required.");
@@ -1387,11 +1377,8 @@ static void cli_incoming_set_controltos(str *instr, struct streambuf *replybuffe
 	rtpe_config.control_tos = tos;
 	rwlock_unlock_w(&rtpe_config.config_lock);
 
-	for (i=0; i < G_N_ELEMENTS(rtpe_control_ng->udp_listeners); i++) {
-		if (rtpe_control_ng->udp_listeners[i].fd != -1) {
-			set_tos(&rtpe_control_ng->udp_listeners[i],tos);
-		}
-	}
+	if (rtpe_control_ng)
+		control_ng_set_tos(rtpe_control_ng, tos);
 
 	streambuf_printf(replybuffer,  "Success setting redis-connect-timeout to %ld\n", tos);
 }
@@ -14,6 +14,9 @@
 #include "dtmflib.h"
 #include "t38.h"
 #include "media_player.h"
+#include "buffer_pool.h"
+#include "codec_worker.h"
+#include "poller.h"
 
 
 
@@ -67,6 +70,7 @@ struct codec_ssrc_handler {
 	struct codec_handler *handler;
 	decoder_t *decoder;
 	encoder_t *encoder;
+	char *decoder_key, *encoder_key; // for the codec instance pool
 	format_t encoder_format;
 	int bitrate;
 	int ptime;
@@ -104,6 +108,7 @@ struct transcode_packet {
 
 static codec_handler_func handler_func_passthrough_ssrc;
 static codec_handler_func handler_func_transcode;
+static codec_handler_func handler_func_g711;
 static codec_handler_func handler_func_playback;
 static codec_handler_func handler_func_inject_dtmf;
 static codec_handler_func handler_func_dtmf;
@@ -197,8 +202,54 @@ static void __make_passthrough_ssrc(struct codec_handler *handler) {
 	handler->ssrc_hash = create_ssrc_hash_full(__ssrc_handler_new, handler);
 }
 
-static void __make_transcoder(struct codec_handler *handler, struct rtp_payload_type *dest,
-		GHashTable *output_transcoders, int dtmf_payload_type, int pcm_dtmf_detect)
+static void __handler_stats_entry(struct codec_handler *handler, struct rtp_payload_type *dest) {
+	if (asprintf(&handler->stats_chain, STR_FORMAT " -> " STR_FORMAT,
+				STR_FMT(&handler->source_pt.encoding_with_params),
+				STR_FMT(&dest->encoding_with_params)) < 0)
+	{
+		ilog(LOG_ERR, "asprintf error");
+		return;
+	}
+
+	mutex_lock(&rtpe_codec_stats_lock);
+	struct codec_stats *stats_entry =
+		g_hash_table_lookup(rtpe_codec_stats, handler->stats_chain);
+	if (!stats_entry) {
+		stats_entry = g_slice_alloc0(sizeof(*stats_entry));
+		stats_entry->chain = strdup(handler->stats_chain);
+		g_hash_table_insert(rtpe_codec_stats, stats_entry->chain, stats_entry);
+		if (asprintf(&stats_entry->chain_brief, STR_FORMAT "_" STR_FORMAT,
+				STR_FMT(&handler->source_pt.encoding_with_params),
+				STR_FMT(&dest->encoding_with_params)) < 0)
+			stats_entry->chain_brief = "xxx";
+	}
+	handler->stats_entry = stats_entry;
+	mutex_unlock(&rtpe_codec_stats_lock);
+
+	g_atomic_int_inc(&stats_entry->num_transcoders);
+}
+
+// G.711 to G.711 with the same format and packetisation doesn't need the full decoder and
+// encoder chain, as each byte can simply be mapped to its counterpart
+static int __g711_fast_path(struct codec_handler *handler, struct rtp_payload_type *dest,
+		int pcm_dtmf_detect)
+{
+	struct rtp_payload_type *src = &handler->source_pt;
+
+	if (pcm_dtmf_detect)
+		return 0;
+	if (!g711_transcode_table(src->codec_def, dest->codec_def))
+		return 0;
+	if (src->clock_rate != dest->clock_rate || src->channels != dest->channels)
+		return 0;
+	if (src->ptime && dest->ptime && src->ptime != dest->ptime)
+		return 0;
+	return 1;
+}
+
+static void __make_transcoder_full(struct codec_handler *handler, struct rtp_payload_type *dest,
+		GHashTable *output_transcoders, int dtmf_payload_type, int pcm_dtmf_detect,
+		int allow_g711)
 {
 	assert(handler->source_pt.codec_def != NULL);
 	assert(dest->codec_def != NULL);
@@ -207,12 +258,16 @@ static void __make_transcoder(struct codec_handler *handler, struct rtp_payload_
 	if (dtmf_payload_type == -1 && dest->codec_def && dest->codec_def->dtmf)
 		dtmf_payload_type = dest->payload_type;
 
+	codec_handler_func *func = handler_func_transcode;
+	if (allow_g711 && __g711_fast_path(handler, dest, pcm_dtmf_detect))
+		func = handler_func_g711;
+
 	// don't reset handler if it already matches what we want
 	if (!handler->transcoder)
 		goto reset;
 	if (rtp_payload_type_cmp(dest, &handler->dest_pt))
 		goto reset;
-	if (handler->func != handler_func_transcode)
+	if (handler->func != func)
 		goto reset;
 
 	ilog(LOG_DEBUG, "Leaving transcode context for " STR_FORMAT " -> " STR_FORMAT " intact",
@@ -225,8 +280,18 @@ reset:
 	__handler_shutdown(handler);
 
 	handler->dest_pt = *dest;
-	handler->func = handler_func_transcode;
+	handler->func = func;
 	handler->transcoder = 1;
+
+	if (func == handler_func_g711) {
+		ilog(LOG_DEBUG, "Created G.711 transcode context for " STR_FORMAT " -> " STR_FORMAT,
+				STR_FMT(&handler->source_pt.encoding_with_params),
+				STR_FMT(&dest->encoding_with_params));
+		handler->ssrc_hash = create_ssrc_hash_full(__ssrc_handler_new, handler);
+		__handler_stats_entry(handler, dest);
+		goto check_output;
+	}
+
 	if (dtmf_payload_type != -1)
 		handler->dtmf_payload_type = dtmf_payload_type;
 	handler->pcm_dtmf_detect = pcm_dtmf_detect ? 1 : 0;
@@ -246,31 +311,15 @@ reset:
 
 	handler->ssrc_hash = create_ssrc_hash_full(__ssrc_handler_transcode_new, handler);
 
-	// stats entry
-	if (asprintf(&handler->stats_chain, STR_FORMAT " -> " STR_FORMAT,
-				STR_FMT(&handler->source_pt.encoding_with_params),
-				STR_FMT(&dest->encoding_with_params)) < 0)
-		ilog(LOG_ERR, "asprintf error");
-	else {
-		mutex_lock(&rtpe_codec_stats_lock);
-		struct codec_stats *stats_entry =
-			g_hash_table_lookup(rtpe_codec_stats, handler->stats_chain);
-		if (!stats_entry) {
-			stats_entry = g_slice_alloc0(sizeof(*stats_entry));
-			stats_entry->chain = strdup(handler->stats_chain);
-			g_hash_table_insert(rtpe_codec_stats, stats_entry->chain, stats_entry);
-			if (asprintf(&stats_entry->chain_brief, STR_FORMAT "_" STR_FORMAT,
-					STR_FMT(&handler->source_pt.encoding_with_params),
-					STR_FMT(&dest->encoding_with_params)) < 0)
-				stats_entry->chain_brief = "xxx";
-		}
-		handler->stats_entry = stats_entry;
-		mutex_unlock(&rtpe_codec_stats_lock);
+	__handler_stats_entry(handler, dest);
 
-		g_atomic_int_inc(&stats_entry->num_transcoders);
+check_output:;
+	// without an encoder, the G.711 handler can't take output from other decoders
+	if (handler->func == handler_func_g711) {
+		handler->output_handler = handler;
+		return;
 	}
 
-check_output:;
 	// check if we have multiple decoders transcoding to the same output PT
 	struct codec_handler *output_handler = NULL;
 	if (output_transcoders)
@@ -286,6 +335,25 @@ check_output:;
 		handler->output_handler = handler; // make sure we don't have a stale pointer
 	}
 }
+// no G.711 fast path
+static void __make_transcoder(struct codec_handler *handler, struct rtp_payload_type *dest,
+		GHashTable *output_transcoders, int dtmf_payload_type, int pcm_dtmf_detect)
+{
+	__make_transcoder_full(handler, dest, output_transcoders, dtmf_payload_type, pcm_dtmf_detect, 0);
+}
+
+// DTMF transcoded to PCM must go through the same encoder as the audio
+static void __g711_fast_path_shutdown(struct call_media *receiver, GHashTable *output_transcoders,
+		int dtmf_payload_type, int pcm_dtmf_detect)
+{
+	for (GList *l = receiver->codec_handlers_store.head; l; l = l->next) {
+		struct codec_handler *handler = l->data;
+		if (handler->func != handler_func_g711)
+			continue;
+		struct rtp_payload_type dest = handler->dest_pt;
+		__make_transcoder(handler, &dest, output_transcoders, dtmf_payload_type, pcm_dtmf_detect);
+	}
+}
 
 struct codec_handler *codec_handler_make_playback(const struct rtp_payload_type *src_pt,
 		const struct rtp_payload_type *dst_pt, unsigned long last_ts)
@@ -961,6 +1029,9 @@ void codec_handlers_update(struct call_media *receiver, struct call_media *sink,
 			&& !g_hash_table_lookup(receiver->codecs_send, &dtmf_payload_type))
 		pcm_dtmf_detect = 1;
 
+	// injected DTMF needs the encoder of the audio output
+	int allow_g711 = (flags && flags->inject_dtmf) ? 0 : 1;
+
 
 	for (GList *l = receiver->codecs_prefs_recv.head; l; ) {
 		struct rtp_payload_type *pt = l->data;
@@ -1065,7 +1136,8 @@ transcode:;
 				dest_pt->bitrate = reverse_pt->bitrate;
 		}
 		MEDIA_SET(receiver, TRANSCODE);
-		__make_transcoder(handler, dest_pt, output_transcoders, dtmf_payload_type, pcm_dtmf_detect);
+		__make_transcoder_full(handler, dest_pt, output_transcoders, dtmf_payload_type, pcm_dtmf_detect,
+				allow_g711);
 
 next:
 		l = l->next;
@@ -1091,6 +1163,10 @@ next:
 			l = __delete_receiver_codec(receiver, l);
 		}
 
+		if (transcode_dtmf)
+			__g711_fast_path_shutdown(receiver, output_transcoders, dtmf_payload_type,
+					pcm_dtmf_detect);
+
 		// we have to translate RTCP packets
 		receiver->rtcp_handler = rtcp_transcode_handler;
 
@@ -1193,6 +1269,9 @@ void codec_add_raw_packet(struct media_packet *mp) {
 	struct codec_packet *p = g_slice_alloc0(sizeof(*p));
 	p->s = mp->raw;
 	p->free_func = NULL;
+	// hold on to the received buffer in case the packet gets queued for sending
+	if (mp->buf && packet_buf_contains(mp->buf, &mp->raw))
+		p->buf = packet_buf_get(mp->buf);
 	if (mp->rtp && mp->ssrc_out) {
 		p->ssrc_out = ssrc_ctx_get(mp->ssrc_out);
 		p->rtp = mp->rtp;
@@ -1493,6 +1572,10 @@ static int handler_func_dtmf(struct codec_handler *h, struct media_packet *mp) {
 
 	assert((mp->rtp->m_pt & 0x7f) == h->source_pt.payload_type);
 
+	// shares the sequencer with the audio codec, so must go to the same codec thread
+	if (codec_worker_defer(mp))
+		return 0;
+
 	// create new packet and insert it into sequencer queue
 
 	ilog(LOG_DEBUG, "Received DTMF RTP packet: SSRC %" PRIx32 ", PT %u, seq %u, TS %u, len %i",
@@ -1523,10 +1606,10 @@ static int handler_func_dtmf(struct codec_handler *h, struct media_packet *mp) {
 	packet->handler = h;
 	packet->rtp = *mp->rtp;
 
-	if (sequencer_h->kernelize) {
-		// this sequencer doesn't actually keep track of RTP seq properly. instruct
-		// the sequencer not to wait for the next in-seq packet but always return
-		// them immediately
+	if (sequencer_h->kernelize || sequencer_h->func == handler_func_g711) {
+		// this sequencer doesn't actually keep track of RTP seq properly, as audio
+		// packets bypass it (passthrough or G.711 table). instruct the sequencer not
+		// to wait for the next in-seq packet but always return them immediately
 		packet->ignore_seq = 1;
 	}
 
@@ -1547,6 +1630,7 @@ void codec_packet_free(void *pp) {
 	struct codec_packet *p = pp;
 	if (p->free_func)
 		p->free_func(p->s.s);
+	packet_buf_put(p->buf);
 	ssrc_ctx_put(&p->ssrc_out);
 	g_slice_free1(sizeof(*p), p);
 }
@@ -1649,6 +1733,30 @@ void codec_init_payload_type(struct rtp_payload_type *ret, struct call_media *me
 #ifdef WITH_TRANSCODING
 
 
+static void __handler_stats_input(struct codec_handler *h, struct media_packet *mp) {
+	if (!h->stats_entry)
+		return;
+
+	unsigned int idx = rtpe_now.tv_sec & 1;
+	int last_tv_sec = g_atomic_int_get(&h->stats_entry->last_tv_sec[idx]);
+	if (last_tv_sec != (int) rtpe_now.tv_sec) {
+		if (g_atomic_int_compare_and_exchange(&h->stats_entry->last_tv_sec[idx],
+					last_tv_sec, rtpe_now.tv_sec))
+		{
+			// new second - zero out stats. slight race condition here
+			atomic64_set(&h->stats_entry->packets_input[idx], 0);
+			atomic64_set(&h->stats_entry->bytes_input[idx], 0);
+			atomic64_set(&h->stats_entry->pcm_samples[idx], 0);
+			atomic64_set(&h->stats_entry->worker_packets[idx], 0);
+			atomic64_set(&h->stats_entry->worker_latency_us[idx], 0);
+		}
+	}
+	atomic64_inc(&h->stats_entry->packets_input[idx]);
+	atomic64_add(&h->stats_entry->bytes_input[idx], mp->payload.len);
+	atomic64_inc(&h->stats_entry->packets_input[2]);
+	atomic64_add(&h->stats_entry->bytes_input[2], mp->payload.len);
+}
+
 static int handler_func_passthrough_ssrc(struct codec_handler *h, struct media_packet *mp) {
 	if (G_UNLIKELY(!mp->rtp))
 		return handler_func_passthrough(h, mp);
@@ -1667,6 +1775,38 @@ static int handler_func_passthrough_ssrc(struct codec_handler *h, struct media_p
 }
 
 
+// same as passthrough with new SSRC, plus the payload converted in place. no decoding,
+// encoding or resequencing takes place, so RTP timestamps and sequence numbers carry over.
+static int handler_func_g711(struct codec_handler *h, struct media_packet *mp) {
+	if (G_UNLIKELY(!mp->rtp))
+		return handler_func_passthrough(h, mp);
+	if (mp->call->block_media || mp->media->monologue->block_media)
+		return 0;
+
+	const unsigned char *table = g711_transcode_table(h->source_pt.codec_def, h->dest_pt.codec_def);
+	if (G_UNLIKELY(!table))
+		return handler_func_passthrough_ssrc(h, mp);
+
+	__handler_stats_input(h, mp);
+
+	g711_transcode(table, &mp->payload);
+
+	mp->rtp->m_pt = (mp->rtp->m_pt & 0x80) | h->dest_pt.payload_type;
+	mp->rtp->ssrc = htonl(mp->ssrc_in->ssrc_map_out);
+	mp->rtp->seq_num = htons(ntohs(mp->rtp->seq_num) + mp->ssrc_out->parent->seq_diff);
+	payload_tracker_add(&mp->ssrc_out->tracker, h->dest_pt.payload_type);
+
+	if (h->stats_entry) {
+		int idx = rtpe_now.tv_sec & 1;
+		atomic64_add(&h->stats_entry->pcm_samples[idx], mp->payload.len);
+		atomic64_add(&h->stats_entry->pcm_samples[2], mp->payload.len);
+	}
+
+	codec_add_raw_packet(mp);
+	return 0;
+}
+
+
 static void __transcode_packet_free(struct transcode_packet *p) {
 	free(p->payload);
 	g_slice_free1(sizeof(*p), p);
@@ -1719,6 +1859,158 @@ uint64_t codec_decoder_unskip_pts(struct codec_ssrc_handler *ch) {
 	return prev;
 }
 
+// idle encoder and decoder instances, keyed by their complete configuration.
+// opening a codec is expensive, so instances are reset and kept around for the next
+// call when an SSRC handler goes away. keys contain fmtp strings from the SDP, so the
+// total is limited too, with the least recently used instances closed first. instances
+// that haven't been used for a while are closed from a timer.
+#define CODEC_POOL_MAX_IDLE 32 // per key
+#define CODEC_POOL_MAX_TOTAL 512
+#define CODEC_POOL_MAX_AGE 60 // seconds
+
+struct codec_pool_entry {
+	void *inst;
+	int encoder;
+	gint64 idle_since; // monotonic, as rtpe_now is per thread and not updated everywhere
+	const char *key; // owned by codec_pool
+	GQueue *queue; // value of codec_pool for this key
+	GList key_link; // in queue, most recently used first
+	GList lru_link; // in codec_pool_lru, least recently used first
+};
+
+static mutex_t codec_pool_lock = MUTEX_STATIC_INIT;
+static GHashTable *codec_pool; // key -> GQueue of struct codec_pool_entry
+static GQueue codec_pool_lru = G_QUEUE_INIT;
+
+static void __encoder_close(encoder_t *enc);
+
+/* lock must be held */
+static void __codec_pool_unlink(struct codec_pool_entry *e) {
+	g_queue_unlink(e->queue, &e->key_link);
+	g_queue_unlink(&codec_pool_lru, &e->lru_link);
+	if (!e->queue->length)
+		g_hash_table_remove(codec_pool, e->key);
+	e->queue = NULL;
+	e->key = NULL;
+}
+
+static void codec_pool_entry_close(void *p) {
+	struct codec_pool_entry *e = p;
+	if (e->encoder)
+		__encoder_close(e->inst);
+	else
+		decoder_close(e->inst);
+	g_slice_free1(sizeof(*e), e);
+}
+
+static void *codec_pool_get(const char *key, struct codec_stats *stats_entry) {
+	void *ret = NULL;
+	struct codec_pool_entry *e = NULL;
+
+	mutex_lock(&codec_pool_lock);
+	GQueue *q = codec_pool ? g_hash_table_lookup(codec_pool, key) : NULL;
+	if (q) {
+		e = g_queue_peek_head(q);
+		__codec_pool_unlink(e);
+	}
+	mutex_unlock(&codec_pool_lock);
+
+	if (e) {
+		ret = e->inst;
+		g_slice_free1(sizeof(*e), e);
+	}
+
+	if (stats_entry) {
+		if (ret)
+			atomic64_inc(&stats_entry->pool_hits);
+		else
+			atomic64_inc(&stats_entry->pool_misses);
+	}
+	return ret;
+}
+// returns 0 if the instance was taken
+static int codec_pool_put(const char *key, void *inst, int encoder) {
+	GQueue evicted = G_QUEUE_INIT;
+	const char *key_dup;
+
+	mutex_lock(&codec_pool_lock);
+	if (!codec_pool)
+		codec_pool = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+				(GDestroyNotify) g_queue_free);
+	GQueue *q = g_hash_table_lookup(codec_pool, key);
+	if (!q) {
+		q = g_queue_new();
+		key_dup = g_strdup(key);
+		g_hash_table_insert(codec_pool, (char *) key_dup, q);
+	}
+	else if (q->length >= CODEC_POOL_MAX_IDLE) {
+		mutex_unlock(&codec_pool_lock);
+		return -1;
+	}
+	else
+		key_dup = ((struct codec_pool_entry *) q->head->data)->key;
+
+	struct codec_pool_entry *e = g_slice_alloc0(sizeof(*e));
+	e->inst = inst;
+	e->encoder = encoder;
+	e->idle_since = g_get_monotonic_time();
+	e->key = key_dup;
+	e->queue = q;
+	e->key_link.data = e;
+	e->lru_link.data = e;
+	g_queue_push_head_link(q, &e->key_link);
+	g_queue_push_tail_link(&codec_pool_lru, &e->lru_link);
+
+	while (codec_pool_lru.length > CODEC_POOL_MAX_TOTAL) {
+		struct codec_pool_entry *old = g_queue_peek_head(&codec_pool_lru);
+		__codec_pool_unlink(old);
+		g_queue_push_tail(&evicted, old);
+	}
+	mutex_unlock(&codec_pool_lock);
+
+	g_queue_clear_full(&evicted, codec_pool_entry_close);
+
+	return 0;
+}
+
+static void codec_pool_expire(void *dummy) {
+	GQueue expired = G_QUEUE_INIT;
+	struct codec_pool_entry *e;
+	gint64 now = g_get_monotonic_time();
+
+	mutex_lock(&codec_pool_lock);
+	while ((e = g_queue_peek_head(&codec_pool_lru))) {
+		if (now - e->idle_since < CODEC_POOL_MAX_AGE * 1000000LL)
+			break;
+		__codec_pool_unlink(e);
+		g_queue_push_tail(&expired, e);
+	}
+	mutex_unlock(&codec_pool_lock);
+
+	g_queue_clear_full(&expired, codec_pool_entry_close);
+}
+
+void codec_pool_timer(struct poller *p) {
+	poller_add_timer(p, codec_pool_expire, NULL);
+}
+
+void codec_pool_free(void) {
+	GQueue all = G_QUEUE_INIT;
+	struct codec_pool_entry *e;
+
+	mutex_lock(&codec_pool_lock);
+	while ((e = g_queue_peek_head(&codec_pool_lru))) {
+		__codec_pool_unlink(e);
+		g_queue_push_tail(&all, e);
+	}
+	if (codec_pool)
+		g_hash_table_destroy(codec_pool);
+	codec_pool = NULL;
+	mutex_unlock(&codec_pool_lock);
+
+	g_queue_clear_full(&all, codec_pool_entry_close);
+}
+
 static struct ssrc_entry *__ssrc_handler_transcode_new(void *p) {
 	struct codec_handler *h = p;
 
@@ -1747,14 +2039,24 @@ static struct ssrc_entry *__ssrc_handler_transcode_new(void *p) {
 		.channels = h->dest_pt.channels,
 		.format = -1,
 	};
-	ch->encoder = encoder_new();
-	if (!ch->encoder)
-		goto err;
-	if (encoder_config_fmtp(ch->encoder, h->dest_pt.codec_def,
-				ch->bitrate,
-				ch->ptime,
-				&enc_format, &ch->encoder_format, &h->dest_pt.format_parameters))
-		goto err;
+	if (h->dest_pt.codec_def->reusable)
+		ch->encoder_key = g_strdup_printf("enc/%s/%i/%i/%i/%i/" STR_FORMAT,
+				h->dest_pt.codec_def->rtpname, enc_format.clockrate, enc_format.channels,
+				ch->bitrate, ch->ptime, STR_FMT(&h->dest_pt.format_parameters));
+	if (ch->encoder_key)
+		ch->encoder = codec_pool_get(ch->encoder_key, h->stats_entry);
+	if (ch->encoder)
+		ch->encoder_format = ch->encoder->actual_format;
+	else {
+		ch->encoder = encoder_new();
+		if (!ch->encoder)
+			goto err;
+		if (encoder_config_fmtp(ch->encoder, h->dest_pt.codec_def,
+					ch->bitrate,
+					ch->ptime,
+					&enc_format, &ch->encoder_format, &h->dest_pt.format_parameters))
+			goto err;
+	}
 
 	if (h->pcm_dtmf_detect) {
 		ilog(LOG_DEBUG, "Inserting DTMF DSP for output payload type %i", h->dtmf_payload_type);
@@ -1766,9 +2068,18 @@ static struct ssrc_entry *__ssrc_handler_transcode_new(void *p) {
 			dtmf_rx_set_realtime_callback(ch->dtmf_dsp, __dtmf_dsp_callback, ch);
 	}
 
-	ch->decoder = decoder_new_fmtp(h->source_pt.codec_def, h->source_pt.clock_rate, h->source_pt.channels,
-			h->source_pt.ptime,
-			&ch->encoder_format, &h->source_pt.format_parameters);
+	if (h->source_pt.codec_def->reusable)
+		ch->decoder_key = g_strdup_printf("dec/%s/%i/%i/%i/%i/%i/%i/" STR_FORMAT,
+				h->source_pt.codec_def->rtpname, h->source_pt.clock_rate,
+				h->source_pt.channels, h->source_pt.ptime,
+				ch->encoder_format.clockrate, ch->encoder_format.channels,
+				ch->encoder_format.format, STR_FMT(&h->source_pt.format_parameters));
+	if (ch->decoder_key)
+		ch->decoder = codec_pool_get(ch->decoder_key, h->stats_entry);
+	if (!ch->decoder)
+		ch->decoder = decoder_new_fmtp(h->source_pt.codec_def, h->source_pt.clock_rate,
+				h->source_pt.channels, h->source_pt.ptime,
+				&ch->encoder_format, &h->source_pt.format_parameters);
 	if (!ch->decoder)
 		goto err;
 
@@ -1792,19 +2103,29 @@ static int __encoder_flush(encoder_t *enc, void *u1, void *u2) {
 	*going = 1;
 	return 0;
 }
+static void __encoder_close(encoder_t *enc) {
+	// flush out queue to avoid ffmpeg warnings
+	int going;
+	do {
+		going = 0;
+		encoder_input_data(enc, NULL, __encoder_flush, &going, NULL);
+	} while (going);
+	encoder_free(enc);
+}
 static void __free_ssrc_handler(void *chp) {
 	struct codec_ssrc_handler *ch = chp;
-	if (ch->decoder)
-		decoder_close(ch->decoder);
+	if (ch->decoder) {
+		if (!ch->decoder_key || decoder_reset(ch->decoder)
+				|| codec_pool_put(ch->decoder_key, ch->decoder, 0))
+			decoder_close(ch->decoder);
+	}
 	if (ch->encoder) {
-		// flush out queue to avoid ffmpeg warnings
-		int going;
-		do {
-			going = 0;
-			encoder_input_data(ch->encoder, NULL, __encoder_flush, &going, NULL);
-		} while (going);
-		encoder_free(ch->encoder);
+		if (!ch->encoder_key || encoder_reset(ch->encoder)
+				|| codec_pool_put(ch->encoder_key, ch->encoder, 1))
+			__encoder_close(ch->encoder);
 	}
+	g_free(ch->decoder_key);
+	g_free(ch->encoder_key);
 	if (ch->sample_buffer)
 		g_string_free(ch->sample_buffer, TRUE);
 	if (ch->dtmf_dsp)
@@ -1894,7 +2215,7 @@ static void __dtmf_detect(struct codec_ssrc_handler *ch, AVFrame *frame) {
 		return;
 	}
 
-	AVFrame *dsp_frame = resample_frame(&ch->dtmf_resampler, frame, &ch->dtmf_format);
+	AVFrame *dsp_frame = resample_frame_noalloc(&ch->dtmf_resampler, frame, &ch->dtmf_format);
 	if (!dsp_frame) {
 		ilog(LOG_ERR | LOG_FLAG_LIMIT, "Failed to resample audio for DTMF DSP");
 		return;
@@ -1925,7 +2246,6 @@ static void __dtmf_detect(struct codec_ssrc_handler *ch, AVFrame *frame) {
 		num_samples = ret;
 	}
 	ch->dtmf_ts = dsp_frame->pts + dsp_frame->nb_samples;
-	av_frame_free(&dsp_frame);
 }
 
 static int packet_decoded_common(decoder_t *decoder, AVFrame *frame, void *u1, void *u2,
@@ -2008,30 +2328,17 @@ static int handler_func_transcode(struct codec_handler *h, struct media_packet *
 	if (mp->call->block_media || mp->media->monologue->block_media)
 		return 0;
 
+	// hand it over to a codec thread if we have any
+	if (codec_worker_defer(mp))
+		return 0;
+
 	// create new packet and insert it into sequencer queue
 
 	ilog(LOG_DEBUG, "Received RTP packet: SSRC %" PRIx32 ", PT %u, seq %u, TS %u, len %i",
 			ntohl(mp->rtp->ssrc), mp->rtp->m_pt, ntohs(mp->rtp->seq_num),
 			ntohl(mp->rtp->timestamp), mp->payload.len);
 
-	if (h->stats_entry) {
-		unsigned int idx = rtpe_now.tv_sec & 1;
-		int last_tv_sec = g_atomic_int_get(&h->stats_entry->last_tv_sec[idx]);
-		if (last_tv_sec != (int) rtpe_now.tv_sec) {
-			if (g_atomic_int_compare_and_exchange(&h->stats_entry->last_tv_sec[idx],
-						last_tv_sec, rtpe_now.tv_sec))
-			{
-				// new second - zero out stats. slight race condition here
-				atomic64_set(&h->stats_entry->packets_input[idx], 0);
-				atomic64_set(&h->stats_entry->bytes_input[idx], 0);
-				atomic64_set(&h->stats_entry->pcm_samples[idx], 0);
-			}
-		}
-		atomic64_inc(&h->stats_entry->packets_input[idx]);
-		atomic64_add(&h->stats_entry->bytes_input[idx], mp->payload.len);
-		atomic64_inc(&h->stats_entry->packets_input[2]);
-		atomic64_add(&h->stats_entry->bytes_input[2], mp->payload.len);
-	}
+	__handler_stats_input(h, mp);
 
 	struct transcode_packet *packet = g_slice_alloc0(sizeof(*packet));
 	packet->func = packet_decode;
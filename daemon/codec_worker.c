@@ -0,0 +1,223 @@
+#include "codec_worker.h"
+
+#include <glib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "aux.h"
+#include "log.h"
+#include "log_funcs.h"
+#include "main.h"
+#include "call.h"
+#include "codec.h"
+#include "ssrc.h"
+#include "media_socket.h"
+#include "buffer_pool.h"
+#include "statistics.h"
+#include "sdp.h"
+
+#define CODEC_WORKER_MAX_QUEUE 1000
+
+struct codec_work {
+	struct media_packet mp;
+	struct packet_buf *buf; // holds mp.raw
+	int payload_type;
+};
+
+struct codec_worker {
+	mutex_t lock;
+	cond_t cond;
+	GQueue queue; // struct codec_work
+
+	atomic64 processed;
+	atomic64 dropped;
+};
+
+static struct codec_worker *codec_workers;
+static unsigned int num_codec_workers;
+static volatile unsigned int codec_workers_launched;
+
+// set in codec worker threads, so that they do the work instead of queuing it again
+static __thread struct codec_worker *t_codec_worker;
+
+
+void codec_workers_init(void) {
+	if (rtpe_config.codec_threads <= 0)
+		return;
+
+	num_codec_workers = rtpe_config.codec_threads;
+	codec_workers = g_malloc0(sizeof(*codec_workers) * num_codec_workers);
+	for (unsigned int i = 0; i < num_codec_workers; i++) {
+		struct codec_worker *cw = &codec_workers[i];
+		mutex_init(&cw->lock);
+		cond_init(&cw->cond);
+		g_queue_init(&cw->queue);
+	}
+}
+
+
+static void codec_work_free(struct codec_work *w) {
+	packet_buf_put(w->buf);
+	ssrc_ctx_put(&w->mp.ssrc_in);
+	ssrc_ctx_put(&w->mp.ssrc_out);
+	if (w->mp.sfd)
+		obj_put(w->mp.sfd);
+	g_slice_free1(sizeof(*w), w);
+}
+
+
+int codec_worker_defer(struct media_packet *mp) {
+	if (!num_codec_workers || t_codec_worker)
+		return 0;
+	if (!mp->rtp || !mp->sfd || !mp->ssrc_in || !mp->ssrc_out)
+		return 0;
+	if (!(mp->buf && packet_buf_contains(mp->buf, &mp->raw)) && mp->raw.len > MAX_RTP_PACKET_SIZE)
+		return 0;
+
+	mp->codec_deferred = 1;
+	return 1;
+}
+
+
+void codec_worker_push(struct media_packet *mp) {
+	struct codec_work *w = g_slice_alloc0(sizeof(*w));
+	w->mp = *mp;
+	g_queue_init(&w->mp.packets_out);
+	w->payload_type = mp->rtp->m_pt & 0x7f;
+
+	if (mp->buf && packet_buf_contains(mp->buf, &mp->raw))
+		w->buf = packet_buf_get(mp->buf);
+	else {
+		// RTP header and payload point into the raw packet, so move them along
+		w->buf = packet_buf_new();
+		str_init_len(&w->mp.raw, packet_buf_data(w->buf), mp->raw.len);
+		memcpy(w->mp.raw.s, mp->raw.s, mp->raw.len);
+		w->mp.rtp = (void *) (w->mp.raw.s + ((char *) mp->rtp - mp->raw.s));
+		w->mp.payload.s = w->mp.raw.s + (mp->payload.s - mp->raw.s);
+	}
+	w->mp.buf = w->buf;
+	w->mp.codec_deferred = 0;
+
+	obj_hold(w->mp.sfd);
+	ssrc_ctx_get(w->mp.ssrc_in);
+	ssrc_ctx_get(w->mp.ssrc_out);
+
+	// packets of the same SSRC always go to the same thread to keep them in order
+	unsigned int idx = (g_direct_hash(mp->call) ^ mp->ssrc_in->parent->h.ssrc) % num_codec_workers;
+	struct codec_worker *cw = &codec_workers[idx];
+
+	mutex_lock(&cw->lock);
+	if (G_UNLIKELY(cw->queue.length >= CODEC_WORKER_MAX_QUEUE)) {
+		mutex_unlock(&cw->lock);
+		atomic64_inc(&cw->dropped);
+		ilog(LOG_WARN | LOG_FLAG_LIMIT, "Codec worker queue is full, dropping RTP packet");
+		codec_work_free(w);
+		return;
+	}
+	g_queue_push_tail(&cw->queue, w);
+	cond_signal(&cw->cond);
+	mutex_unlock(&cw->lock);
+}
+
+
+// same as stream_packet() from the codec handler onwards, with no locks held. the packet has
+// already passed decryption and the source address checks before it was queued
+static void codec_work_run(struct codec_work *w) {
+	struct media_packet *mp = &w->mp;
+	struct call *call = mp->sfd->call;
+
+	mp->call = call;
+
+	log_info_stream_fd(mp->sfd);
+	rwlock_lock_r(&call->master_lock);
+
+	mp->stream = mp->sfd->stream;
+	if (G_UNLIKELY(!mp->stream))
+		goto out;
+	mp->media = mp->stream->media;
+
+	struct packet_stream *sink = mp->stream->rtp_sink;
+	if (G_UNLIKELY(!sink || !sink->selected_sfd || !mp->stream->handler))
+		goto out;
+
+	// the handler we were queued from may have been replaced in the meantime
+	struct codec_handler *h = codec_handler_get(mp->media, w->payload_type);
+	if (h->func(h, mp))
+		goto out;
+
+	if (media_packet_encrypt(mp->stream->handler->out->rtp_crypt, sink, mp) & 0x01)
+		goto out;
+
+	mutex_lock(&sink->out_lock);
+	// sink may have been reset while the packet was queued
+	if (sink->advertised_endpoint.port
+			&& (!is_addr_unspecified(&sink->advertised_endpoint.address)
+				|| is_trickle_ice_address(&sink->advertised_endpoint)))
+		media_socket_dequeue(mp, sink);
+	mutex_unlock(&sink->out_lock);
+
+	if (h->stats_entry) {
+		struct timeval now;
+		gettimeofday(&now, NULL);
+		unsigned int idx = rtpe_now.tv_sec & 1;
+		atomic64_inc(&h->stats_entry->worker_packets[idx]);
+		atomic64_add(&h->stats_entry->worker_latency_us[idx], timeval_diff(&now, &mp->tv));
+		atomic64_inc(&h->stats_entry->worker_packets[2]);
+		atomic64_add(&h->stats_entry->worker_latency_us[2], timeval_diff(&now, &mp->tv));
+	}
+
+out:
+	rwlock_unlock_r(&call->master_lock);
+	g_queue_clear_full(&mp->packets_out, codec_packet_free);
+	log_info_clear();
+}
+
+
+void codec_worker_loop(void *p) {
+	unsigned int idx = g_atomic_int_add(&codec_workers_launched, 1);
+	struct codec_worker *cw = &codec_workers[idx % num_codec_workers];
+	struct codec_work *w;
+	struct timeval tv;
+
+	ilog(LOG_DEBUG, "codec_worker_loop");
+
+	t_codec_worker = cw;
+
+	mutex_lock(&cw->lock);
+
+	while (!rtpe_shutdown) {
+		w = g_queue_pop_head(&cw->queue);
+		if (!w) {
+			gettimeofday(&tv, NULL);
+			timeval_add_usec(&tv, 100000);
+			cond_timedwait(&cw->cond, &cw->lock, &tv);
+			continue;
+		}
+		mutex_unlock(&cw->lock);
+
+		gettimeofday(&rtpe_now, NULL);
+		codec_work_run(w);
+		codec_work_free(w);
+		atomic64_inc(&cw->processed);
+
+		mutex_lock(&cw->lock);
+	}
+
+	while ((w = g_queue_pop_head(&cw->queue)))
+		codec_work_free(w);
+
+	mutex_unlock(&cw->lock);
+}
+
+
+void codec_worker_stats(struct codec_worker_stats *out) {
+	ZERO(*out);
+	for (unsigned int i = 0; i < num_codec_workers; i++) {
+		struct codec_worker *cw = &codec_workers[i];
+		mutex_lock(&cw->lock);
+		out->queued += cw->queue.length;
+		mutex_unlock(&cw->lock);
+		out->processed += atomic64_get(&cw->processed);
+		out->dropped += atomic64_get(&cw->dropped);
+	}
+}
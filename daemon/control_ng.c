@@ -22,6 +22,35 @@ mutex_t rtpe_cngs_lock;
 GHashTable *rtpe_cngs_hash;
 struct control_ng *rtpe_control_ng;
 
+const unsigned int ng_timing_bucket_ms[NG_TIMING_BUCKETS - 1] = {
+	1, 2, 5, 10, 20, 50, 100, 200, 500, 1000,
+};
+const char *ng_command_strings[__NGC_LAST] = {
+	[NGC_PING] = "ping",
+	[NGC_OFFER] = "offer",
+	[NGC_ANSWER] = "answer",
+	[NGC_DELETE] = "delete",
+	[NGC_QUERY] = "query",
+	[NGC_LIST] = "list",
+	[NGC_START_RECORDING] = "start recording",
+	[NGC_STOP_RECORDING] = "stop recording",
+	[NGC_START_FORWARDING] = "start forwarding",
+	[NGC_STOP_FORWARDING] = "stop forwarding",
+	[NGC_BLOCK_DTMF] = "block DTMF",
+	[NGC_UNBLOCK_DTMF] = "unblock DTMF",
+	[NGC_BLOCK_MEDIA] = "block media",
+	[NGC_UNBLOCK_MEDIA] = "unblock media",
+	[NGC_PLAY_MEDIA] = "play media",
+	[NGC_STOP_MEDIA] = "stop media",
+	[NGC_PLAY_DTMF] = "play DTMF",
+	[NGC_STATISTICS] = "statistics",
+};
+atomic64 rtpe_ng_timings[__NGC_LAST][NG_TIMING_BUCKETS];
+
+// kept between commands, so that they don't need to allocate their own
+static __thread bencode_buffer_t t_bencbuf;
+static __thread int t_bencbuf_ok;
+
 const char magic_load_limit_strings[__LOAD_LIMIT_MAX][64] = {
 	[LOAD_LIMIT_MAX_SESSIONS] = "Parallel session limit reached",
 	[LOAD_LIMIT_CPU] = "CPU usage limit exceeded",
@@ -54,6 +83,26 @@ static void timeval_update_request_time(struct request_time *request, const stru
 	mutex_unlock(&request->lock);
 }
 
+static void ng_timing_add(enum ng_command ngc, const struct timeval *diff) {
+	long long ms = timeval_us(diff) / 1000;
+	int i;
+
+	for (i = 0; i < NG_TIMING_BUCKETS - 1; i++) {
+		if (ms < ng_timing_bucket_ms[i])
+			break;
+	}
+	atomic64_inc(&rtpe_ng_timings[ngc][i]);
+}
+
+static bencode_buffer_t *control_ng_buffer(void) {
+	if (!t_bencbuf_ok) {
+		if (bencode_buffer_init(&t_bencbuf))
+			return NULL;
+		t_bencbuf_ok = 1;
+	}
+	return &t_bencbuf;
+}
+
 
 static void pretty_print(bencode_item_t *el, GString *s) {
 	bencode_item_t *chld;
@@ -115,11 +164,10 @@ struct control_ng_stats* get_control_ng_stats(struct control_ng* c, const sockad
 	return cur;
 }
 
-static void control_ng_incoming(struct obj *obj, str *buf, const endpoint_t *sin, char *addr,
+static void control_ng_process(struct control_ng *c, str *buf, const endpoint_t *sin, char *addr,
 		socket_t *ul)
 {
-	struct control_ng *c = (void *) obj;
-	bencode_buffer_t bencbuf;
+	bencode_buffer_t *bencbuf;
 	bencode_item_t *dict, *resp;
 	str cmd = STR_NULL, cookie, data, reply, *to_send, callid;
 	const char *errstr, *resultstr;
@@ -127,6 +175,7 @@ static void control_ng_incoming(struct obj *obj, str *buf, const endpoint_t *sin
 	unsigned int iovlen;
 	GString *log_str;
 	struct timeval cmd_start, cmd_stop, cmd_process_time;
+	enum ng_command ngc = __NGC_LAST;
 	struct control_ng_stats* cur = get_control_ng_stats(c,&sin->address);
 
 	str_chr_str(&data, buf, ' ');
@@ -136,10 +185,9 @@ static void control_ng_incoming(struct obj *obj, str *buf, const endpoint_t *sin
 		return;
 	}
 
-	int ret = bencode_buffer_init(&bencbuf);
-	assert(ret == 0);
-	(void) ret;
-	resp = bencode_dictionary(&bencbuf);
+	bencbuf = control_ng_buffer();
+	assert(bencbuf != NULL);
+	resp = bencode_dictionary(bencbuf);
 	assert(resp != NULL);
 
 	cookie = *buf;
@@ -158,7 +206,7 @@ static void control_ng_incoming(struct obj *obj, str *buf, const endpoint_t *sin
 		goto send_only;
 	}
 
-	dict = bencode_decode_expect_str(&bencbuf, &data, BENCODE_DICTIONARY);
+	dict = bencode_decode_expect_str(bencbuf, &data, BENCODE_DICTIONARY);
 	errstr = "Could not decode dictionary";
 	if (!dict)
 		goto err_send;
@@ -194,74 +242,92 @@ static void control_ng_incoming(struct obj *obj, str *buf, const endpoint_t *sin
 
 	switch (cmdcode) {
 		case CSH_LOOKUP("ping"):
+			ngc = NGC_PING;
 			resultstr = "pong";
 			g_atomic_int_inc(&cur->ping);
 			break;
 		case CSH_LOOKUP("offer"):
+			ngc = NGC_OFFER;
 			errstr = call_offer_ng(dict, resp, addr, sin);
 			g_atomic_int_inc(&cur->offer);
 			break;
 		case CSH_LOOKUP("answer"):
+			ngc = NGC_ANSWER;
 			errstr = call_answer_ng(dict, resp);
 			g_atomic_int_inc(&cur->answer);
 			break;
 		case CSH_LOOKUP("delete"):
+			ngc = NGC_DELETE;
 			errstr = call_delete_ng(dict, resp);
 			g_atomic_int_inc(&cur->delete);
 			break;
 		case CSH_LOOKUP("query"):
+			ngc = NGC_QUERY;
 			errstr = call_query_ng(dict, resp);
 			g_atomic_int_inc(&cur->query);
 			break;
 		case CSH_LOOKUP("list"):
+			ngc = NGC_LIST;
 			errstr = call_list_ng(dict, resp);
 			g_atomic_int_inc(&cur->list);
 			break;
 		case CSH_LOOKUP("start recording"):
+			ngc = NGC_START_RECORDING;
 			errstr = call_start_recording_ng(dict, resp);
 			g_atomic_int_inc(&cur->start_recording);
 			break;
 		case CSH_LOOKUP("stop recording"):
+			ngc = NGC_STOP_RECORDING;
 			errstr = call_stop_recording_ng(dict, resp);
 			g_atomic_int_inc(&cur->stop_recording);
 			break;
 		case CSH_LOOKUP("start forwarding"):
+			ngc = NGC_START_FORWARDING;
 			errstr = call_start_forwarding_ng(dict, resp);
 			g_atomic_int_inc(&cur->start_forwarding);
 			break;
 		case CSH_LOOKUP("stop forwarding"):
+			ngc = NGC_STOP_FORWARDING;
 			errstr = call_stop_forwarding_ng(dict, resp);
 			g_atomic_int_inc(&cur->stop_forwarding);
 			break;
 		case CSH_LOOKUP("block DTMF"):
+			ngc = NGC_BLOCK_DTMF;
 			errstr = call_block_dtmf_ng(dict, resp);
 			g_atomic_int_inc(&cur->block_dtmf);
 			break;
 		case CSH_LOOKUP("unblock DTMF"):
+			ngc = NGC_UNBLOCK_DTMF;
 			errstr = call_unblock_dtmf_ng(dict, resp);
 			g_atomic_int_inc(&cur->unblock_dtmf);
 			break;
 		case CSH_LOOKUP("block media"):
+			ngc = NGC_BLOCK_MEDIA;
 			errstr = call_block_media_ng(dict, resp);
 			g_atomic_int_inc(&cur->block_media);
 			break;
 		case CSH_LOOKUP("unblock media"):
+			ngc = NGC_UNBLOCK_MEDIA;
 			errstr = call_unblock_media_ng(dict, resp);
 			g_atomic_int_inc(&cur->unblock_media);
 			break;
 		case CSH_LOOKUP("play media"):
+			ngc = NGC_PLAY_MEDIA;
 			errstr = call_play_media_ng(dict, resp);
 			g_atomic_int_inc(&cur->play_media);
 			break;
 		case CSH_LOOKUP("stop media"):
+			ngc = NGC_STOP_MEDIA;
 			errstr = call_stop_media_ng(dict, resp);
 			g_atomic_int_inc(&cur->stop_media);
 			break;
 		case CSH_LOOKUP("play DTMF"):
+			ngc = NGC_PLAY_DTMF;
 			errstr = call_play_dtmf_ng(dict, resp);
 			g_atomic_int_inc(&cur->play_dtmf);
 			break;
 		case CSH_LOOKUP("statistics"):
+			ngc = NGC_STATISTICS;
 			errstr = statistics_ng(dict, resp);
 			g_atomic_int_inc(&cur->statistics);
 			break;
@@ -273,6 +339,8 @@ static void control_ng_incoming(struct obj *obj, str *buf, const endpoint_t *sin
 	gettimeofday(&cmd_stop, NULL);
 	//print command duration
 	timeval_from_us(&cmd_process_time, timeval_diff(&cmd_stop, &cmd_start));
+	if (ngc != __NGC_LAST)
+		ng_timing_add(ngc, &cmd_process_time);
 
 	if (errstr)
 		goto err_send;
@@ -320,7 +388,7 @@ send_resp:
 		ilog(LOG_INFO, "Replying to '"STR_FORMAT"' from %s (elapsed time %llu.%06llu sec)", STR_FMT(&cmd), addr, (unsigned long long)cmd_process_time.tv_sec, (unsigned long long)cmd_process_time.tv_usec);
 
 		if (get_log_level() >= LOG_DEBUG) {
-			dict = bencode_decode_expect_str(&bencbuf, to_send, BENCODE_DICTIONARY);
+			dict = bencode_decode_expect_str(bencbuf, to_send, BENCODE_DICTIONARY);
 			if (dict) {
 				log_str = g_string_sized_new(256);
 				g_string_append_printf(log_str, "Response dump for '"STR_FORMAT"' to %s: %s",
@@ -354,10 +422,55 @@ send_only:
 	goto out;
 
 out:
-	bencode_buffer_free(&bencbuf);
+	if (bencode_buffer_reset(bencbuf))
+		t_bencbuf_ok = 0;
 	log_info_clear();
 }
 
+// a received command waiting for a control thread
+struct control_ng_job {
+	struct control_ng *c; // holds a reference
+	socket_t *ul;
+	endpoint_t sin;
+	char addr[64];
+	str buf;
+	char data[0];
+};
+
+static void control_ng_job_run(void *p, void *u) {
+	struct control_ng_job *j = p;
+
+	gettimeofday(&rtpe_now, NULL);
+	control_ng_process(j->c, &j->buf, &j->sin, j->addr, j->ul);
+
+	obj_put(j->c);
+	g_free(j);
+}
+
+static void control_ng_incoming(struct obj *obj, str *buf, const endpoint_t *sin, char *addr,
+		socket_t *ul)
+{
+	struct control_ng *c = (void *) obj;
+	struct control_ng_job *j;
+
+	if (!c->pool) {
+		control_ng_process(c, buf, sin, addr, ul);
+		return;
+	}
+
+	// the receive buffer is reused for the next packet
+	j = g_malloc(sizeof(*j) + buf->len + 1);
+	j->c = obj_get(c);
+	j->ul = ul;
+	j->sin = *sin;
+	g_strlcpy(j->addr, addr, sizeof(j->addr));
+	memcpy(j->data, buf->s, buf->len);
+	j->data[buf->len] = '\0';
+	str_init_len(&j->buf, j->data, buf->len);
+
+	g_thread_pool_push(c->pool, j, NULL);
+}
+
 
 
 struct control_ng *control_ng_new(struct poller *p, endpoint_t *ep, unsigned char tos) {
@@ -368,7 +481,7 @@ struct control_ng *control_ng_new(struct poller *p, endpoint_t *ep, unsigned cha
 
 	c = obj_alloc0("control_ng", sizeof(*c), NULL);
 
-	cookie_cache_init(&c->cookie_cache);
+	cookie_cache_init(&c->cookie_cache, (size_t) rtpe_config.cookie_cache_size << 20);
 	c->udp_listeners[0].fd = -1;
 	c->udp_listeners[1].fd = -1;
 
@@ -390,6 +503,22 @@ fail2:
 
 }
 
+// Commands are received by the main threads and handed to a pool of control threads, so that
+// a slow command only holds up one of them. Doing this from one socket, rather than letting
+// the kernel spread them across several, also spreads the commands of a single proxy.
+void control_ng_launch(struct control_ng *c) {
+	if (!c || rtpe_config.control_threads <= 0)
+		return;
+	c->pool = g_thread_pool_new(control_ng_job_run, NULL, rtpe_config.control_threads, TRUE, NULL);
+}
+
+void control_ng_set_tos(struct control_ng *c, unsigned char tos) {
+	for (unsigned int i = 0; i < G_N_ELEMENTS(c->udp_listeners); i++) {
+		if (c->udp_listeners[i].fd != -1)
+			set_tos(&c->udp_listeners[i], tos);
+	}
+}
+
 
 void control_ng_init() {
 	mutex_init(&rtpe_cngs_lock);
@@ -19,6 +19,7 @@
 #include "call_interfaces.h"
 #include "socket.h"
 #include "log_funcs.h"
+#include "main.h"
 
 
 static void control_udp_incoming(struct obj *obj, str *buf, const endpoint_t *sin, char *addr,
@@ -163,7 +164,7 @@ struct control_udp *control_udp_new(struct poller *p, endpoint_t *ep) {
 	if (!c->parse_re || !c->fallback_re)
 		goto fail2;
 
-	cookie_cache_init(&c->cookie_cache);
+	cookie_cache_init(&c->cookie_cache, (size_t) rtpe_config.cookie_cache_size << 20);
 
 	if (udp_listener_init(&c->udp_listeners[0], p, ep, control_udp_incoming, &c->obj))
 		goto fail2;
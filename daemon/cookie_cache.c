@@ -8,71 +8,165 @@
 #include "poller.h"
 #include "str.h"
 
-static const char *cookie_in_use = "MAGIC";
+#define COOKIE_CACHE_MAX_AGE 30
 
-INLINE void cookie_cache_state_init(struct cookie_cache_state *s) {
-	s->cookies = g_hash_table_new(str_hash, str_equal);
-	s->chunks = g_string_chunk_new(4 * 1024);
+struct cookie_cache_entry {
+	str cookie; // points into buf
+	str *reply; // NULL while the first request is still being processed
+	time_t time;
+	GList link; // in stripe->done once there is a reply
+	cond_t cond; // signalled when the reply arrives or the entry goes away
+	unsigned int refs; // one for the hash table plus one for each waiter
+	char buf[0];
+};
+
+void cookie_cache_init(struct cookie_cache *c, size_t max_bytes) {
+	for (unsigned int i = 0; i < COOKIE_CACHE_STRIPES; i++) {
+		struct cookie_cache_stripe *st = &c->stripes[i];
+		mutex_init(&st->lock);
+		st->entries = g_hash_table_new(str_hash, str_equal);
+		g_queue_init(&st->done);
+		st->bytes = 0;
+	}
+	c->max_stripe_bytes = max_bytes / COOKIE_CACHE_STRIPES;
+	if (max_bytes && !c->max_stripe_bytes)
+		c->max_stripe_bytes = 1;
+}
+
+INLINE struct cookie_cache_stripe *cookie_cache_stripe(struct cookie_cache *c, const str *s) {
+	return &c->stripes[str_hash(s) % COOKIE_CACHE_STRIPES];
+}
+
+INLINE size_t cookie_cache_entry_size(struct cookie_cache_entry *e) {
+	return sizeof(*e) + e->cookie.len + (e->reply ? e->reply->len : 0);
 }
 
-void cookie_cache_init(struct cookie_cache *c) {
-	cookie_cache_state_init(&c->current);
-	cookie_cache_state_init(&c->old);
-	c->swap_time = rtpe_now.tv_sec;
-	mutex_init(&c->lock);
-	cond_init(&c->cond);
+/* lock must be held */
+static struct cookie_cache_entry *__cookie_cache_entry_new(struct cookie_cache_stripe *st, const str *s) {
+	struct cookie_cache_entry *e = g_malloc0(sizeof(*e) + s->len);
+	memcpy(e->buf, s->s, s->len);
+	str_init_len(&e->cookie, e->buf, s->len);
+	e->link.data = e;
+	cond_init(&e->cond);
+	e->refs = 1;
+	g_hash_table_insert(st->entries, &e->cookie, e);
+	st->bytes += cookie_cache_entry_size(e);
+	return e;
+}
+
+static void __cookie_cache_entry_put(struct cookie_cache_entry *e) {
+	if (--e->refs)
+		return;
+	free(e->reply);
+	g_free(e);
+}
+
+/* lock must be held */
+static void __cookie_cache_entry_remove(struct cookie_cache_stripe *st, struct cookie_cache_entry *e) {
+	g_hash_table_remove(st->entries, &e->cookie);
+	if (e->reply)
+		g_queue_unlink(&st->done, &e->link);
+	st->bytes -= cookie_cache_entry_size(e);
+	cond_broadcast(&e->cond);
+	__cookie_cache_entry_put(e);
 }
 
 /* lock must be held */
-static void __cookie_cache_check_swap(struct cookie_cache *c) {
-	if (rtpe_now.tv_sec - c->swap_time >= 30) {
-		g_hash_table_remove_all(c->old.cookies);
-		g_string_chunk_clear(c->old.chunks);
-		swap_ptrs(&c->old.chunks, &c->current.chunks);
-		swap_ptrs(&c->old.cookies, &c->current.cookies);
-		c->swap_time = rtpe_now.tv_sec;
+static void __cookie_cache_expire(struct cookie_cache *c, struct cookie_cache_stripe *st) {
+	struct cookie_cache_entry *e;
+
+	while ((e = g_queue_peek_head(&st->done))) {
+		if (rtpe_now.tv_sec - e->time < COOKIE_CACHE_MAX_AGE
+				&& (!c->max_stripe_bytes || st->bytes <= c->max_stripe_bytes))
+			break;
+		if (rtpe_now.tv_sec - e->time < COOKIE_CACHE_MAX_AGE)
+			atomic64_inc(&c->evicted);
+		__cookie_cache_entry_remove(st, e);
 	}
 }
 
 str *cookie_cache_lookup(struct cookie_cache *c, const str *s) {
+	struct cookie_cache_stripe *st = cookie_cache_stripe(c, s);
+	struct cookie_cache_entry *e;
+	int waited = 0;
 	str *ret;
 
-	mutex_lock(&c->lock);
+	mutex_lock(&st->lock);
 
-	__cookie_cache_check_swap(c);
+	__cookie_cache_expire(c, st);
 
 restart:
-	ret = g_hash_table_lookup(c->current.cookies, s);
-	if (!ret)
-		ret = g_hash_table_lookup(c->old.cookies, s);
-	if (ret) {
-		if (ret == (void *) cookie_in_use) {
-			/* another thread is working on this right now */
-			cond_wait(&c->cond, &c->lock);
-			goto restart;
-		}
-		ret = str_dup(ret);
-		mutex_unlock(&c->lock);
-		return ret;
+	e = g_hash_table_lookup(st->entries, s);
+	if (!e) {
+		__cookie_cache_entry_new(st, s);
+		mutex_unlock(&st->lock);
+		atomic64_inc(&c->misses);
+		return NULL;
+	}
+	if (!e->reply) {
+		/* another thread is working on this right now */
+		if (!waited)
+			atomic64_inc(&c->in_flight);
+		waited = 1;
+		e->refs++;
+		cond_wait(&e->cond, &st->lock);
+		__cookie_cache_entry_put(e);
+		goto restart;
 	}
-	g_hash_table_replace(c->current.cookies, (void *) s, (void *) cookie_in_use);
-	mutex_unlock(&c->lock);
-	return NULL;
+	ret = str_dup(e->reply);
+	mutex_unlock(&st->lock);
+	atomic64_inc(&c->hits);
+	return ret;
 }
 
 void cookie_cache_insert(struct cookie_cache *c, const str *s, const str *r) {
-	mutex_lock(&c->lock);
-	g_hash_table_replace(c->current.cookies, str_chunk_insert(c->current.chunks, s),
-		str_chunk_insert(c->current.chunks, r));
-	g_hash_table_remove(c->old.cookies, s);
-	cond_broadcast(&c->cond);
-	mutex_unlock(&c->lock);
+	struct cookie_cache_stripe *st = cookie_cache_stripe(c, s);
+	struct cookie_cache_entry *e;
+
+	mutex_lock(&st->lock);
+
+	e = g_hash_table_lookup(st->entries, s);
+	if (!e)
+		e = __cookie_cache_entry_new(st, s);
+	else if (e->reply) {
+		st->bytes -= e->reply->len;
+		free(e->reply);
+		g_queue_unlink(&st->done, &e->link);
+	}
+
+	e->reply = str_dup(r);
+	e->time = rtpe_now.tv_sec;
+	st->bytes += e->reply->len;
+	g_queue_push_tail_link(&st->done, &e->link);
+	cond_broadcast(&e->cond);
+
+	__cookie_cache_expire(c, st);
+
+	mutex_unlock(&st->lock);
 }
 
 void cookie_cache_remove(struct cookie_cache *c, const str *s) {
-	mutex_lock(&c->lock);
-	g_hash_table_remove(c->current.cookies, s);
-	g_hash_table_remove(c->old.cookies, s);
-	cond_broadcast(&c->cond);
-	mutex_unlock(&c->lock);
+	struct cookie_cache_stripe *st = cookie_cache_stripe(c, s);
+	struct cookie_cache_entry *e;
+
+	mutex_lock(&st->lock);
+	e = g_hash_table_lookup(st->entries, s);
+	if (e)
+		__cookie_cache_entry_remove(st, e);
+	mutex_unlock(&st->lock);
+}
+
+void cookie_cache_stats(struct cookie_cache *c, struct cookie_cache_stats *out) {
+	ZERO(*out);
+	out->hits = atomic64_get(&c->hits);
+	out->misses = atomic64_get(&c->misses);
+	out->in_flight = atomic64_get(&c->in_flight);
+	out->evicted = atomic64_get(&c->evicted);
+	for (unsigned int i = 0; i < COOKIE_CACHE_STRIPES; i++) {
+		struct cookie_cache_stripe *st = &c->stripes[i];
+		mutex_lock(&st->lock);
+		out->entries += g_hash_table_size(st->entries);
+		out->bytes += st->bytes;
+		mutex_unlock(&st->lock);
+	}
 }
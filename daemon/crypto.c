@@ -31,9 +31,15 @@ static int aes_f8_encrypt_rtp(struct crypto_context *c, struct rtp_header *r, st
 static int aes_f8_encrypt_rtcp(struct crypto_context *c, struct rtcp_packet *r, str *s, u_int64_t idx);
 static int aes_cm_session_key_init(struct crypto_context *c);
 static int aes_f8_session_key_init(struct crypto_context *c);
+static int null_session_key_init(struct crypto_context *c);
 static int evp_session_key_cleanup(struct crypto_context *c);
 static int null_crypt_rtp(struct crypto_context *c, struct rtp_header *r, str *s, u_int64_t idx);
 static int null_crypt_rtcp(struct crypto_context *c, struct rtcp_packet *r, str *s, u_int64_t idx);
+static int aes_gcm_encrypt_rtp(struct crypto_context *c, struct rtp_header *r, str *s, u_int64_t idx);
+static int aes_gcm_decrypt_rtp(struct crypto_context *c, struct rtp_header *r, str *s, u_int64_t idx);
+static int aes_gcm_encrypt_rtcp(struct crypto_context *c, struct rtcp_packet *r, str *s, u_int64_t idx);
+static int aes_gcm_decrypt_rtcp(struct crypto_context *c, struct rtcp_packet *r, str *s, u_int64_t idx);
+static int aes_gcm_session_key_init(struct crypto_context *c);
 
 /* all lengths are in bytes */
 struct crypto_suite __crypto_suites[] = {
@@ -250,6 +256,7 @@ struct crypto_suite __crypto_suites[] = {
 		.decrypt_rtcp		= null_crypt_rtcp,
 		.hash_rtp		= hmac_sha1_rtp,
 		.hash_rtcp		= hmac_sha1_rtcp,
+		.session_key_init	= null_session_key_init,
 		.session_key_cleanup	= evp_session_key_cleanup,
 	},
 	{
@@ -273,6 +280,57 @@ struct crypto_suite __crypto_suites[] = {
 		.decrypt_rtcp		= null_crypt_rtcp,
 		.hash_rtp		= hmac_sha1_rtp,
 		.hash_rtcp		= hmac_sha1_rtcp,
+		.session_key_init	= null_session_key_init,
+		.session_key_cleanup	= evp_session_key_cleanup,
+	},
+	{
+		.name			= "AEAD_AES_128_GCM",
+#if OPENSSL_VERSION_NUMBER >= 0x10100000L
+		.dtls_name		= "SRTP_AEAD_AES_128_GCM",
+#endif
+		.master_key_len		= 16,
+		.master_salt_len	= 12,
+		.session_key_len	= 16,
+		.session_salt_len	= 12,
+		.srtp_lifetime		= 1ULL << 48,
+		.srtcp_lifetime		= 1ULL << 31,
+		.kernel_cipher		= REC_AEAD_AES_GCM_128,
+		.kernel_hmac		= REH_NULL,
+		.srtp_auth_tag		= 0,
+		.srtcp_auth_tag		= 0,
+		.srtp_auth_key_len	= 0,
+		.srtcp_auth_key_len	= 0,
+		.aead_tag_len		= 16,
+		.encrypt_rtp		= aes_gcm_encrypt_rtp,
+		.decrypt_rtp		= aes_gcm_decrypt_rtp,
+		.encrypt_rtcp		= aes_gcm_encrypt_rtcp,
+		.decrypt_rtcp		= aes_gcm_decrypt_rtcp,
+		.session_key_init	= aes_gcm_session_key_init,
+		.session_key_cleanup	= evp_session_key_cleanup,
+	},
+	{
+		.name			= "AEAD_AES_256_GCM",
+#if OPENSSL_VERSION_NUMBER >= 0x10100000L
+		.dtls_name		= "SRTP_AEAD_AES_256_GCM",
+#endif
+		.master_key_len		= 32,
+		.master_salt_len	= 12,
+		.session_key_len	= 32,
+		.session_salt_len	= 12,
+		.srtp_lifetime		= 1ULL << 48,
+		.srtcp_lifetime		= 1ULL << 31,
+		.kernel_cipher		= REC_AEAD_AES_GCM_256,
+		.kernel_hmac		= REH_NULL,
+		.srtp_auth_tag		= 0,
+		.srtcp_auth_tag		= 0,
+		.srtp_auth_key_len	= 0,
+		.srtcp_auth_key_len	= 0,
+		.aead_tag_len		= 16,
+		.encrypt_rtp		= aes_gcm_encrypt_rtp,
+		.decrypt_rtp		= aes_gcm_decrypt_rtp,
+		.encrypt_rtcp		= aes_gcm_encrypt_rtcp,
+		.decrypt_rtcp		= aes_gcm_decrypt_rtcp,
+		.session_key_init	= aes_gcm_session_key_init,
 		.session_key_cleanup	= evp_session_key_cleanup,
 	},
 };
@@ -357,6 +415,22 @@ done:
 	;
 }
 
+/* whole-packet keystream in a single call, using native CTR mode. the counter
+ * block increments across all 128 bits, same as aes_ctr() above. */
+static void aes_ctr_packet(struct crypto_context *c, str *s, const unsigned char *iv) {
+	EVP_CIPHER_CTX *ctr = c->session_key_ctx[2];
+	int outlen;
+
+	if (G_UNLIKELY(!ctr)) {
+		aes_ctr((void *) s->s, s, c->session_key_ctx[0], iv);
+		return;
+	}
+
+	EVP_EncryptInit_ex(ctr, NULL, NULL, NULL, iv);
+	EVP_EncryptUpdate(ctr, (void *) s->s, &outlen, (void *) s->s, s->len);
+	assert(outlen == s->len);
+}
+
 static void aes_ctr_no_ctx(unsigned char *out, str *in, const unsigned char *key, const EVP_CIPHER *ciph,
 		const unsigned char *iv)
 {
@@ -418,7 +492,9 @@ int crypto_gen_session_key(struct crypto_context *c, str *out, unsigned char lab
 	 * key_derivation_rate == 0 --> r == 0 */
 
 	key_id[0] = label;
-	memcpy(x, c->params.master_salt, 14);
+	/* rfc 7714 section 11: shorter (96 bit) salts are padded with zeroes */
+	ZERO(x);
+	memcpy(x, c->params.master_salt, c->params.crypto_suite->master_salt_len);
 	for (i = 13 - index_len; i < 14; i++)
 		x[i] = key_id[i - (13 - index_len)] ^ x[i];
 
@@ -477,7 +553,7 @@ static int aes_cm_encrypt(struct crypto_context *c, u_int32_t ssrc, str *s, u_in
 	ivi[2] ^= idxh;
 	ivi[3] ^= idxl;
 
-	aes_ctr((void *) s->s, s, c->session_key_ctx[0], iv);
+	aes_ctr_packet(c, s, iv);
 
 	return 0;
 }
@@ -582,30 +658,174 @@ static int aes_f8_encrypt_rtcp(struct crypto_context *c, struct rtcp_packet *r,
 
 	return 0;
 }
+/* per-packet HMAC state. this is a copy of the keyed context prepared in
+ * hmac_session_key_init(), so the ipad/opad key schedule isn't redone for
+ * every packet. one per thread, kept for the lifetime of the thread. */
+#if OPENSSL_VERSION_NUMBER >= 0x10100000L
+static __thread HMAC_CTX *hmac_thread_ctx;
+
+static HMAC_CTX *hmac_sha1_begin(struct crypto_context *c, int key_len) {
+	if (G_UNLIKELY(!hmac_thread_ctx))
+		hmac_thread_ctx = HMAC_CTX_new();
+	if (G_LIKELY(c->session_auth_ctx && key_len == c->params.crypto_suite->srtp_auth_key_len))
+		HMAC_CTX_copy(hmac_thread_ctx, c->session_auth_ctx);
+	else
+		HMAC_Init_ex(hmac_thread_ctx, c->session_auth_key, key_len, EVP_sha1(), NULL);
+	return hmac_thread_ctx;
+}
+static void hmac_sha1_end(HMAC_CTX *hc) {
+}
+#else
+static __thread HMAC_CTX hmac_thread_ctx;
+
+static HMAC_CTX *hmac_sha1_begin(struct crypto_context *c, int key_len) {
+	HMAC_CTX_init(&hmac_thread_ctx);
+	if (G_LIKELY(c->session_auth_ctx && key_len == c->params.crypto_suite->srtp_auth_key_len))
+		HMAC_CTX_copy(&hmac_thread_ctx, c->session_auth_ctx);
+	else
+		HMAC_Init_ex(&hmac_thread_ctx, c->session_auth_key, key_len, EVP_sha1(), NULL);
+	return &hmac_thread_ctx;
+}
+static void hmac_sha1_end(HMAC_CTX *hc) {
+	HMAC_CTX_cleanup(hc);
+}
+#endif
+
+/* rfc 7714 section 8.1
+ * IV = (0x0000 || SSRC || ROC || SEQ) XOR salt */
+static void aes_gcm_iv_rtp(unsigned char *iv, struct crypto_context *c, struct rtp_header *r, u_int64_t idx) {
+	u_int32_t roc;
+	int i;
+
+	iv[0] = iv[1] = 0;
+	memcpy(&iv[2], &r->ssrc, 4);
+	roc = htonl((idx & 0xffffffff0000ULL) >> 16);
+	memcpy(&iv[6], &roc, 4);
+	memcpy(&iv[10], &r->seq_num, 2);
+	for (i = 0; i < 12; i++)
+		iv[i] ^= c->session_salt[i];
+}
+
+/* rfc 7714 section 9.1
+ * IV = (0x0000 || SSRC || 0x0000 || 0 || SRTCP index) XOR salt */
+static void aes_gcm_iv_rtcp(unsigned char *iv, struct crypto_context *c, struct rtcp_packet *r, u_int64_t idx) {
+	u_int32_t i32;
+	int i;
+
+	iv[0] = iv[1] = 0;
+	memcpy(&iv[2], &r->ssrc, 4);
+	iv[6] = iv[7] = 0;
+	i32 = htonl(idx & 0x7fffffffULL);
+	memcpy(&iv[8], &i32, 4);
+	for (i = 0; i < 12; i++)
+		iv[i] ^= c->session_salt[i];
+}
+
+/* encrypts in place and appends the tag, which the buffer must have room for */
+static int aes_gcm_encrypt(struct crypto_context *c, const unsigned char *iv, const unsigned char *aad,
+		int aad_len, str *s)
+{
+	EVP_CIPHER_CTX *ctx = c->session_key_ctx[0];
+	unsigned int tag_len = c->params.crypto_suite->aead_tag_len;
+	int len;
+
+	if (!ctx)
+		return -1;
+	if (!EVP_CipherInit_ex(ctx, NULL, NULL, NULL, iv, 1))
+		return -1;
+	if (!EVP_CipherUpdate(ctx, NULL, &len, aad, aad_len))
+		return -1;
+	if (!EVP_CipherUpdate(ctx, (unsigned char *) s->s, &len, (unsigned char *) s->s, s->len))
+		return -1;
+	if (!EVP_CipherFinal_ex(ctx, (unsigned char *) s->s + len, &len))
+		return -1;
+	if (!EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_GET_TAG, tag_len, s->s + s->len))
+		return -1;
+	s->len += tag_len;
+
+	return 0;
+}
+
+/* decrypts in place and strips the tag. the contents are undefined on failure */
+static int aes_gcm_decrypt(struct crypto_context *c, const unsigned char *iv, const unsigned char *aad,
+		int aad_len, str *s)
+{
+	EVP_CIPHER_CTX *ctx = c->session_key_ctx[0];
+	unsigned int tag_len = c->params.crypto_suite->aead_tag_len;
+	int len;
+
+	if (!ctx)
+		return -1;
+	if (s->len < tag_len)
+		return -1;
+	s->len -= tag_len;
+
+	if (!EVP_CipherInit_ex(ctx, NULL, NULL, NULL, iv, 0))
+		return -1;
+	if (!EVP_CipherUpdate(ctx, NULL, &len, aad, aad_len))
+		return -1;
+	if (!EVP_CipherUpdate(ctx, (unsigned char *) s->s, &len, (unsigned char *) s->s, s->len))
+		return -1;
+	if (!EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_TAG, tag_len, s->s + s->len))
+		return -1;
+	if (EVP_CipherFinal_ex(ctx, (unsigned char *) s->s + len, &len) <= 0)
+		return -1;
+
+	return 0;
+}
+
+/* rfc 7714 section 8.2: the AAD is the complete RTP header */
+static int aes_gcm_encrypt_rtp(struct crypto_context *c, struct rtp_header *r, str *s, u_int64_t idx) {
+	unsigned char iv[12];
+
+	aes_gcm_iv_rtp(iv, c, r, idx);
+	return aes_gcm_encrypt(c, iv, (void *) r, s->s - (char *) r, s);
+}
+
+static int aes_gcm_decrypt_rtp(struct crypto_context *c, struct rtp_header *r, str *s, u_int64_t idx) {
+	unsigned char iv[12];
+
+	aes_gcm_iv_rtp(iv, c, r, idx);
+	return aes_gcm_decrypt(c, iv, (void *) r, s->s - (char *) r, s);
+}
+
+/* rfc 7714 section 9.2: the AAD is the first 8 octets of the packet plus the E flag and SRTCP index */
+static void aes_gcm_aad_rtcp(unsigned char *aad, struct rtcp_packet *r, u_int64_t idx) {
+	u_int32_t i32;
+
+	memcpy(aad, r, 8);
+	i32 = htonl(0x80000000ULL | idx);
+	memcpy(&aad[8], &i32, 4);
+}
+
+static int aes_gcm_encrypt_rtcp(struct crypto_context *c, struct rtcp_packet *r, str *s, u_int64_t idx) {
+	unsigned char iv[12], aad[12];
+
+	aes_gcm_iv_rtcp(iv, c, r, idx);
+	aes_gcm_aad_rtcp(aad, r, idx);
+	return aes_gcm_encrypt(c, iv, aad, sizeof(aad), s);
+}
+
+static int aes_gcm_decrypt_rtcp(struct crypto_context *c, struct rtcp_packet *r, str *s, u_int64_t idx) {
+	unsigned char iv[12], aad[12];
+
+	aes_gcm_iv_rtcp(iv, c, r, idx);
+	aes_gcm_aad_rtcp(aad, r, idx);
+	return aes_gcm_decrypt(c, iv, aad, sizeof(aad), s);
+}
+
 /* rfc 3711, sections 4.2 and 4.2.1 */
 static int hmac_sha1_rtp(struct crypto_context *c, char *out, str *in, u_int64_t index) {
 	unsigned char hmac[20];
 	u_int32_t roc;
 	HMAC_CTX *hc;
 
-#if OPENSSL_VERSION_NUMBER >= 0x10100000L
-	hc = HMAC_CTX_new();
-#else
-	HMAC_CTX hc_s;
-	HMAC_CTX_init(&hc_s);
-	hc = &hc_s;
-#endif
-
-	HMAC_Init_ex(hc, c->session_auth_key, c->params.crypto_suite->srtp_auth_key_len, EVP_sha1(), NULL);
+	hc = hmac_sha1_begin(c, c->params.crypto_suite->srtp_auth_key_len);
 	HMAC_Update(hc, (unsigned char *) in->s, in->len);
 	roc = htonl((index & 0xffffffff0000ULL) >> 16);
 	HMAC_Update(hc, (unsigned char *) &roc, sizeof(roc));
 	HMAC_Final(hc, hmac, NULL);
-#if OPENSSL_VERSION_NUMBER >= 0x10100000L
-	HMAC_CTX_free(hc);
-#else
-	HMAC_CTX_cleanup(hc);
-#endif
+	hmac_sha1_end(hc);
 
 	assert(sizeof(hmac) >= c->params.crypto_suite->srtp_auth_tag);
 	memcpy(out, hmac, c->params.crypto_suite->srtp_auth_tag);
@@ -616,9 +836,12 @@ static int hmac_sha1_rtp(struct crypto_context *c, char *out, str *in, u_int64_t
 /* rfc 3711, sections 4.2 and 4.2.1 */
 static int hmac_sha1_rtcp(struct crypto_context *c, char *out, str *in) {
 	unsigned char hmac[20];
+	HMAC_CTX *hc;
 
-	HMAC(EVP_sha1(), c->session_auth_key, c->params.crypto_suite->srtcp_auth_key_len,
-			(unsigned char *) in->s, in->len, hmac, NULL);
+	hc = hmac_sha1_begin(c, c->params.crypto_suite->srtcp_auth_key_len);
+	HMAC_Update(hc, (unsigned char *) in->s, in->len);
+	HMAC_Final(hc, hmac, NULL);
+	hmac_sha1_end(hc);
 
 	assert(sizeof(hmac) >= c->params.crypto_suite->srtcp_auth_tag);
 	memcpy(out, hmac, c->params.crypto_suite->srtcp_auth_tag);
@@ -626,17 +849,52 @@ static int hmac_sha1_rtcp(struct crypto_context *c, char *out, str *in) {
 	return 0;
 }
 
-static int aes_cm_session_key_init(struct crypto_context *c) {
-	evp_session_key_cleanup(c);
+static EVP_CIPHER_CTX *evp_cipher_ctx_new(const EVP_CIPHER *ciph, const unsigned char *key) {
+	EVP_CIPHER_CTX *ctx;
+
+#if OPENSSL_VERSION_NUMBER >= 0x10100000L
+	ctx = EVP_CIPHER_CTX_new();
+#else
+	ctx = g_slice_alloc(sizeof(EVP_CIPHER_CTX));
+	EVP_CIPHER_CTX_init(ctx);
+#endif
+	EVP_EncryptInit_ex(ctx, ciph, NULL, key, NULL);
+	return ctx;
+}
+
+/* keyed HMAC template, copied for each packet by hmac_sha1_begin() */
+static void hmac_session_key_init(struct crypto_context *c) {
+	HMAC_CTX *hc;
+
+	if (!c->params.crypto_suite->srtp_auth_key_len)
+		return;
 
 #if OPENSSL_VERSION_NUMBER >= 0x10100000L
-	c->session_key_ctx[0] = EVP_CIPHER_CTX_new();
+	hc = HMAC_CTX_new();
 #else
-	c->session_key_ctx[0] = g_slice_alloc(sizeof(EVP_CIPHER_CTX));
-	EVP_CIPHER_CTX_init(c->session_key_ctx[0]);
+	hc = g_slice_alloc(sizeof(HMAC_CTX));
+	HMAC_CTX_init(hc);
 #endif
-	EVP_EncryptInit_ex(c->session_key_ctx[0], c->params.crypto_suite->lib_cipher_ptr, NULL,
-			(unsigned char *) c->session_key, NULL);
+	HMAC_Init_ex(hc, c->session_auth_key, c->params.crypto_suite->srtp_auth_key_len, EVP_sha1(), NULL);
+	c->session_auth_ctx = hc;
+}
+
+static int aes_ecb_session_key_init(struct crypto_context *c) {
+	evp_session_key_cleanup(c);
+
+	c->session_key_ctx[0] = evp_cipher_ctx_new(c->params.crypto_suite->lib_cipher_ptr,
+			(unsigned char *) c->session_key);
+	return 0;
+}
+
+static int aes_cm_session_key_init(struct crypto_context *c) {
+	aes_ecb_session_key_init(c);
+	hmac_session_key_init(c);
+
+	/* without a CTR cipher we fall back to block-by-block ECB in aes_ctr() */
+	if (c->params.crypto_suite->lib_cipher_ctr_ptr)
+		c->session_key_ctx[2] = evp_cipher_ctx_new(c->params.crypto_suite->lib_cipher_ctr_ptr,
+				(unsigned char *) c->session_key);
 	return 0;
 }
 
@@ -646,7 +904,8 @@ static int aes_f8_session_key_init(struct crypto_context *c) {
 	int k_e_len, k_s_len; /* n_e, n_s */
 	unsigned char *key;
 
-	aes_cm_session_key_init(c);
+	aes_ecb_session_key_init(c);
+	hmac_session_key_init(c);
 
 	k_e_len = c->params.crypto_suite->session_key_len;
 	k_s_len = c->params.crypto_suite->session_salt_len;
@@ -660,13 +919,7 @@ static int aes_f8_session_key_init(struct crypto_context *c) {
 	for (i = 0; i < k_e_len; i++)
 		m[i] ^= key[i];
 
-#if OPENSSL_VERSION_NUMBER >= 0x10100000L
-	c->session_key_ctx[1] = EVP_CIPHER_CTX_new();
-#else
-	c->session_key_ctx[1] = g_slice_alloc(sizeof(EVP_CIPHER_CTX));
-	EVP_CIPHER_CTX_init(c->session_key_ctx[1]);
-#endif
-	EVP_EncryptInit_ex(c->session_key_ctx[1], EVP_aes_128_ecb(), NULL, m, NULL);
+	c->session_key_ctx[1] = evp_cipher_ctx_new(EVP_aes_128_ecb(), m);
 
 	return 0;
 }
@@ -689,6 +942,32 @@ static int evp_session_key_cleanup(struct crypto_context *c) {
 		c->session_key_ctx[i] = NULL;
 	}
 
+	if (c->session_auth_ctx) {
+#if OPENSSL_VERSION_NUMBER >= 0x10100000L
+		HMAC_CTX_free(c->session_auth_ctx);
+#else
+		HMAC_CTX_cleanup(c->session_auth_ctx);
+		g_slice_free1(sizeof(HMAC_CTX), c->session_auth_ctx);
+#endif
+		c->session_auth_ctx = NULL;
+	}
+
+	return 0;
+}
+
+static int aes_gcm_session_key_init(struct crypto_context *c) {
+	evp_session_key_cleanup(c);
+
+	if (!c->params.crypto_suite->lib_aead_ptr)
+		return -1;
+	c->session_key_ctx[0] = evp_cipher_ctx_new(c->params.crypto_suite->lib_aead_ptr,
+			(unsigned char *) c->session_key);
+	return 0;
+}
+
+static int null_session_key_init(struct crypto_context *c) {
+	evp_session_key_cleanup(c);
+	hmac_session_key_init(c);
 	return 0;
 }
 
@@ -761,14 +1040,19 @@ void crypto_init_main() {
 		switch(cs->master_key_len) {
 		case 16:
 			cs->lib_cipher_ptr = EVP_aes_128_ecb();
+			cs->lib_cipher_ctr_ptr = EVP_aes_128_ctr();
 			break;
 		case 24:
 			cs->lib_cipher_ptr = EVP_aes_192_ecb();
+			cs->lib_cipher_ctr_ptr = EVP_aes_192_ctr();
 			break;
 		case 32:
 			cs->lib_cipher_ptr = EVP_aes_256_ecb();
+			cs->lib_cipher_ctr_ptr = EVP_aes_256_ctr();
 			break;
 		}
+		if (cs->aead_tag_len)
+			cs->lib_aead_ptr = (cs->master_key_len == 32) ? EVP_aes_256_gcm() : EVP_aes_128_gcm();
 	}
 }
 
@@ -22,6 +22,7 @@
 #include "socket.h"
 #include "statistics.h"
 #include "main.h"
+#include "load.h"
 
 struct timeval rtpe_latest_graphite_interval_start;
 
@@ -141,17 +142,15 @@ static int send_graphite_data(struct totalstats *sent_data) {
 	ts->answers_ps = clear_requests_per_second(&rtpe_totalstats_interval.answers_ps);
 	ts->deletes_ps = clear_requests_per_second(&rtpe_totalstats_interval.deletes_ps);
 
-	rwlock_lock_r(&rtpe_callhash_lock);
 	mutex_lock(&rtpe_totalstats_interval.managed_sess_lock);
 	ts->managed_sess_max = rtpe_totalstats_interval.managed_sess_max;
 	ts->managed_sess_min = rtpe_totalstats_interval.managed_sess_min;
-        ts->total_sessions = g_hash_table_size(rtpe_callhash);
+        ts->total_sessions = call_num_calls();
         ts->foreign_sessions = atomic64_get(&rtpe_stats.foreign_sessions);
 	ts->own_sessions = ts->total_sessions - ts->foreign_sessions;
 	rtpe_totalstats_interval.managed_sess_max = ts->own_sessions;;
 	rtpe_totalstats_interval.managed_sess_min = ts->own_sessions;
 	mutex_unlock(&rtpe_totalstats_interval.managed_sess_lock);
-	rwlock_unlock_r(&rtpe_callhash_lock);
 
 	// compute average offer/answer/delete time
 	timeval_divide(&ts->offer.time_avg, &ts->offer.time_avg, ts->offer.count);
@@ -191,6 +190,10 @@ static int send_graphite_data(struct totalstats *sent_data) {
 	GPF("current_sessions_own "UINT64F, ts->own_sessions);
 	GPF("current_sessions_foreign "UINT64F, ts->foreign_sessions);
 	GPF("current_transcoded_media "UINT64F, atomic64_get(&rtpe_stats.transcoded_media));
+	GPF("transcode_degradation %i", g_atomic_int_get(&transcode_degradation));
+	GPF("packets_ps "UINT64F, atomic64_get(&rtpe_stats.packets));
+	GPF("bytes_ps "UINT64F, atomic64_get(&rtpe_stats.bytes));
+	GPF("errors_ps "UINT64F, atomic64_get(&rtpe_stats.errors));
 	GPF("nopacket_relayed_sess "UINT64F, atomic64_get_na(&ts->total_nopacket_relayed_sess));
 	GPF("oneway_stream_sess "UINT64F, atomic64_get_na(&ts->total_oneway_stream_sess));
 	GPF("regular_term_sess "UINT64F, atomic64_get_na(&ts->total_regular_term_sess));
@@ -226,6 +229,15 @@ static int send_graphite_data(struct totalstats *sent_data) {
 		GPF("ports_used_%s_%s %i", lif->logical->name.s,
 				sockaddr_print_buf(&lif->spec->local_address.addr),
 				num_ports - g_atomic_int_get(&lif->spec->port_pool.free_ports));
+		GPF("packets_ps_%s_%s "UINT64F, lif->logical->name.s,
+				sockaddr_print_buf(&lif->spec->local_address.addr),
+				atomic64_get(&lif->stats.ps.packets));
+		GPF("bytes_ps_%s_%s "UINT64F, lif->logical->name.s,
+				sockaddr_print_buf(&lif->spec->local_address.addr),
+				atomic64_get(&lif->stats.ps.bytes));
+		GPF("errors_ps_%s_%s "UINT64F, lif->logical->name.s,
+				sockaddr_print_buf(&lif->spec->local_address.addr),
+				atomic64_get(&lif->stats.ps.errors));
 	}
 
 	mutex_lock(&rtpe_codec_stats_lock);
@@ -534,7 +534,7 @@ static void __agent_schedule_abs(struct ice_agent *ag, const struct timeval *tv)
 
 	nxt = *tv;
 
-	mutex_lock(&ice_agents_timer_thread.lock);
+	timerthread_obj_lock(&ag->tt_obj);
 	if (ag->tt_obj.last_run.tv_sec) {
 		/* make sure we don't run more often than we should */
 		diff = timeval_diff(&nxt, &ag->tt_obj.last_run);
@@ -542,7 +542,7 @@ static void __agent_schedule_abs(struct ice_agent *ag, const struct timeval *tv)
 			timeval_add_usec(&nxt, TIMER_RUN_INTERVAL * 1000 - diff);
 	}
 	timerthread_obj_schedule_abs_nl(&ag->tt_obj, &nxt);
-	mutex_unlock(&ice_agents_timer_thread.lock);
+	timerthread_obj_unlock(&ag->tt_obj);
 }
 static void __agent_deschedule(struct ice_agent *ag) {
 	if (ag)
@@ -551,7 +551,7 @@ static void __agent_deschedule(struct ice_agent *ag) {
 
 void ice_init(void) {
 	random_string((void *) &tie_breaker, sizeof(tie_breaker));
-	timerthread_init(&ice_agents_timer_thread, ice_agents_timer_run);
+	timerthread_init(&ice_agents_timer_thread, 1, ice_agents_timer_run);
 }
 
 
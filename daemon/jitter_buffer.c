@@ -4,6 +4,7 @@
 #include "call.h"
 #include "codec.h"
 #include "main.h"
+#include "buffer_pool.h"
 #include <math.h>
 #include <errno.h>
 
@@ -20,7 +21,7 @@ static struct timerthread jitter_buffer_thread;
 
 void jitter_buffer_init(void) {
 	ilog(LOG_DEBUG, "jitter_buffer_init");
-	timerthread_init(&jitter_buffer_thread, timerthread_queue_run);
+	timerthread_init(&jitter_buffer_thread, rtpe_config.media_num_threads, timerthread_queue_run);
 }
 
 static void jitter_buffer_flush(struct jitter_buffer *jb) {
@@ -50,7 +51,7 @@ static void reset_jitter_buffer(struct jitter_buffer *jb) {
 	jb->prev_seq            = 0;
 
 	jb->num_resets++;
-	if(g_tree_nnodes(jb->ttq.entries) > 0)
+	if(jb->ttq.num_entries > 0)
 		jitter_buffer_flush(jb);
 
 	//disable jitter buffer in case of more than 2 resets
@@ -93,20 +94,27 @@ static int get_clock_rate(struct media_packet *mp, int payload_type) {
 }
 
 static struct jb_packet* get_jb_packet(struct media_packet *mp, const str *s) {
-	char *buf = malloc(s->len + RTP_BUFFER_HEAD_ROOM + RTP_BUFFER_TAIL_ROOM);
-	if (!buf) {
-		ilog(LOG_ERROR, "Failed to allocate memory: %s", strerror(errno));
-		return NULL;
-	}
-
 	struct jb_packet *p = g_slice_alloc0(sizeof(*p));
 
-	p->buf = buf;
 	p->mp = *mp;
 	obj_hold(p->mp.sfd);
 
-	str_init_len(&p->mp.raw, buf + RTP_BUFFER_HEAD_ROOM, s->len);
-	memcpy(p->mp.raw.s, s->s, s->len);
+	if (mp->buf && packet_buf_contains(mp->buf, s)) {
+		// the receive path is done with the packet once we've taken it
+		p->buf = packet_buf_get(mp->buf);
+		p->mp.raw = *s;
+	}
+	else {
+		if (s->len > MAX_RTP_PACKET_SIZE) {
+			ilog(LOG_ERROR, "Packet too large for jitter buffer (%i bytes)", s->len);
+			jb_packet_free(&p);
+			return NULL;
+		}
+		p->buf = packet_buf_new();
+		str_init_len(&p->mp.raw, packet_buf_data(p->buf), s->len);
+		memcpy(p->mp.raw.s, s->s, s->len);
+	}
+	p->mp.buf = p->buf;
 
 	if(rtp_payload(&p->mp.rtp, &p->mp.payload, &p->mp.raw)) {
 		jb_packet_free(&p);
@@ -118,7 +126,7 @@ static struct jb_packet* get_jb_packet(struct media_packet *mp, const str *s) {
 
 // jb is locked
 static void check_buffered_packets(struct jitter_buffer *jb) {
-	if (g_tree_nnodes(jb->ttq.entries) >= (3* rtpe_config.jb_length)) {
+	if (jb->ttq.num_entries >= (3* rtpe_config.jb_length)) {
 		ilog(LOG_DEBUG, "Jitter reset due to buffer overflow");
 		reset_jitter_buffer(jb);
 	}
@@ -434,7 +442,7 @@ void jb_packet_free(struct jb_packet **jbp) {
 	if (!jbp || !*jbp)
 		return;
 
-	free((*jbp)->buf);
+	packet_buf_put((*jbp)->buf);
 	if ((*jbp)->mp.sfd)
 		obj_put((*jbp)->mp.sfd);
 	g_slice_free1(sizeof(**jbp), *jbp);
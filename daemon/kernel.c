@@ -8,6 +8,8 @@
 #include <unistd.h>
 #include <glib.h>
 #include <errno.h>
+#include <sys/mman.h>
+#include <assert.h>
 
 #include "xt_RTPENGINE.h"
 
@@ -24,11 +26,19 @@
 
 struct kernel_interface kernel;
 
+// free slots in the shared stats area, in the order they were released. The kernel
+// refuses a slot until one RCU grace period after its previous rule was removed, so
+// the oldest one is reused first.
+static mutex_t stats_slots_lock = MUTEX_STATIC_INIT;
+static unsigned int *stats_slots_free; // ring
+static unsigned int stats_slots_free_head;
+static unsigned int stats_slots_num_free;
 
 
 
 
-static int kernel_action_table(const char *action, unsigned int id) {
+
+static int kernel_action_table(const char *action, unsigned int id, unsigned int arg) {
 	char str[64];
 	int saved_errno;
 	int fd;
@@ -37,7 +47,10 @@ static int kernel_action_table(const char *action, unsigned int id) {
 	fd = open(PREFIX "/control", O_WRONLY | O_TRUNC);
 	if (fd == -1)
 		return -1;
-	i = snprintf(str, sizeof(str), "%s %u\n", action, id);
+	if (arg)
+		i = snprintf(str, sizeof(str), "%s %u %u\n", action, id, arg);
+	else
+		i = snprintf(str, sizeof(str), "%s %u\n", action, id);
 	if (i >= sizeof(str))
 		goto fail;
 	i = write(fd, str, strlen(str));
@@ -54,12 +67,12 @@ fail:
 	return -1;
 }
 
-static int kernel_create_table(unsigned int id) {
-	return kernel_action_table("add", id);
+static int kernel_create_table(unsigned int id, unsigned int stats_slots) {
+	return kernel_action_table("add", id, stats_slots);
 }
 
 static int kernel_delete_table(unsigned int id) {
-	return kernel_action_table("del", id);
+	return kernel_action_table("del", id, 0);
 }
 
 static int kernel_open_table(unsigned int id) {
@@ -89,7 +102,50 @@ fail:
 	return -1;
 }
 
-int kernel_setup_table(unsigned int id) {
+static int kernel_open_stats(unsigned int id) {
+	char str[64];
+	int fd;
+	struct stat st;
+	void *p;
+
+	sprintf(str, PREFIX "/%u/stats", id);
+	fd = open(str, O_RDONLY);
+	if (fd == -1)
+		return -1;
+	if (fstat(fd, &st))
+		goto fail;
+	errno = ENOSPC;
+	if (st.st_size < sizeof(struct rtpengine_stats_slot))
+		goto fail;
+	// the kernel reports the exact size of its slot array
+	errno = EINVAL;
+	if (st.st_size % sizeof(struct rtpengine_stats_slot))
+		goto fail;
+
+	p = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	if (p == MAP_FAILED)
+		goto fail;
+	close(fd);
+
+	kernel.stats = p;
+	kernel.num_stats_slots = st.st_size / sizeof(struct rtpengine_stats_slot);
+
+	stats_slots_free = g_new(unsigned int, kernel.num_stats_slots);
+	for (unsigned int i = 0; i < kernel.num_stats_slots; i++)
+		stats_slots_free[i] = i;
+	stats_slots_free_head = 0;
+	stats_slots_num_free = kernel.num_stats_slots;
+
+	return 0;
+
+fail:;
+	int saved_errno = errno;
+	close(fd);
+	errno = saved_errno;
+	return -1;
+}
+
+int kernel_setup_table(unsigned int id, unsigned int stats_slots) {
 	if (kernel.is_wanted)
 		abort();
 
@@ -100,7 +156,7 @@ int kernel_setup_table(unsigned int id) {
 				id, strerror(errno));
 		return -1;
 	}
-	if (kernel_create_table(id)) {
+	if (kernel_create_table(id, stats_slots)) {
 		ilog(LOG_ERR, "FAILED TO CREATE KERNEL TABLE %i (%s), KERNEL FORWARDING DISABLED",
 				id, strerror(errno));
 		return -1;
@@ -112,6 +168,11 @@ int kernel_setup_table(unsigned int id) {
 		return -1;
 	}
 
+	if (kernel_open_stats(id))
+		ilog(LOG_WARN, "Failed to map kernel stats area for table %i (%s), reading stats "
+				"from the list of forwarding rules instead",
+				id, strerror(errno));
+
 	kernel.fd = fd;
 	kernel.table = id;
 	kernel.is_open = 1;
@@ -159,7 +220,8 @@ int kernel_del_stream(const struct re_address *a) {
 	return -1;
 }
 
-GList *kernel_list() {
+// without a stats area only: all forwarding rules with their stats
+GList *kernel_list(void) {
 	char str[64];
 	int fd;
 	struct rtpengine_list_entry *buf;
@@ -174,7 +236,6 @@ GList *kernel_list() {
 	if (fd == -1)
 		return NULL;
 
-
 	for (;;) {
 		buf = g_slice_alloc(sizeof(*buf));
 		ret = read(fd, buf, sizeof(*buf));
@@ -189,6 +250,57 @@ GList *kernel_list() {
 	return li;
 }
 
+// the same information as a slot in the stats area would hold
+void kernel_list_entry_stats(struct rtpengine_stats_slot *ks, const struct rtpengine_list_entry *ke) {
+	ZERO(*ks);
+	ks->packets = ke->stats.packets;
+	ks->bytes = ke->stats.bytes;
+	ks->errors = ke->stats.errors;
+	ks->delay_min = ke->stats.delay_min;
+	ks->delay_avg = ke->stats.delay_avg;
+	ks->delay_max = ke->stats.delay_max;
+	ks->in_tos = ke->stats.in_tos;
+	ks->decrypt_last_index = ke->target.decrypt.last_index;
+	ks->encrypt_last_index = ke->target.encrypt.last_index;
+	ks->ssrc = ke->target.ssrc;
+	ks->non_forwarding = ke->target.non_forwarding;
+	ks->num_payload_types = ke->target.num_payload_types;
+	memcpy(ks->payload_types, ke->target.payload_types, sizeof(ks->payload_types));
+	memcpy(ks->rtp_stats, ke->rtp_stats, sizeof(ks->rtp_stats));
+}
+
+unsigned int kernel_stats_slot_get(void) {
+	unsigned int ret = UNINIT_IDX;
+
+	mutex_lock(&stats_slots_lock);
+	if (stats_slots_num_free) {
+		ret = stats_slots_free[stats_slots_free_head];
+		stats_slots_free_head = (stats_slots_free_head + 1) % kernel.num_stats_slots;
+		stats_slots_num_free--;
+	}
+	mutex_unlock(&stats_slots_lock);
+
+	return ret;
+}
+
+void kernel_stats_slot_put(unsigned int idx) {
+	if (idx == UNINIT_IDX)
+		return;
+
+	mutex_lock(&stats_slots_lock);
+	assert(stats_slots_num_free < kernel.num_stats_slots);
+	stats_slots_free[(stats_slots_free_head + stats_slots_num_free) % kernel.num_stats_slots] = idx;
+	stats_slots_num_free++;
+	mutex_unlock(&stats_slots_lock);
+}
+
+// counters are updated by the kernel while we read them
+const struct rtpengine_stats_slot *kernel_stats_slot(unsigned int idx) {
+	if (idx >= kernel.num_stats_slots)
+		return NULL;
+	return &kernel.stats[idx];
+}
+
 unsigned int kernel_add_call(const char *id) {
 	struct rtpengine_message msg;
 	int ret;
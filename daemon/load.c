@@ -8,12 +8,49 @@
 #include "aux.h"
 #include "log.h"
 #include "main.h"
+#ifdef WITH_TRANSCODING
+#include "codeclib.h"
+#include "resample.h"
+#endif
+
+#define DEGRADE_STEP		1000 // 10% CPU usage per level
+#define DEGRADE_HYSTERESIS	500
 
 int load_average; // times 100
 int cpu_usage; // percent times 100 (0 - 9999)
+int transcode_degradation;
 
 static long used_last, idle_last;
 
+static void transcode_degrade(void) {
+	int cpu = g_atomic_int_get(&cpu_usage);
+	int level = g_atomic_int_get(&transcode_degradation);
+	int new_level = level;
+
+	// go up or down one level at a time
+	if (level < TRANSCODE_DEGRADE_MAX && cpu >= rtpe_config.degrade_cpu + level * DEGRADE_STEP)
+		new_level++;
+	else if (level > 0 && cpu < rtpe_config.degrade_cpu + (level - 1) * DEGRADE_STEP - DEGRADE_HYSTERESIS)
+		new_level--;
+	if (new_level == level)
+		return;
+
+	ilog(new_level > level ? LOG_WARN : LOG_INFO, "CPU usage at %.1f%%, changing transcoding "
+			"degradation level from %i to %i",
+			(double) cpu / 100.0, level, new_level);
+	g_atomic_int_set(&transcode_degradation, new_level);
+
+#ifdef WITH_TRANSCODING
+	int complexity = -1;
+	if (new_level >= TRANSCODE_DEGRADE_MIN_COMPLEXITY)
+		complexity = 0;
+	else if (new_level >= TRANSCODE_DEGRADE_COMPLEXITY)
+		complexity = 5; // default is 10
+	g_atomic_int_set(&encoder_complexity, complexity);
+	g_atomic_int_set(&resample_low_quality, new_level >= TRANSCODE_DEGRADE_RESAMPLE);
+#endif
+}
+
 void load_thread(void *dummy) {
 	while (!rtpe_shutdown) {
 		if (rtpe_config.load_limit) {
@@ -24,7 +61,7 @@ void load_thread(void *dummy) {
 				ilog(LOG_WARN, "Failed to obtain load average: %s", strerror(errno));
 		}
 
-		if (rtpe_config.cpu_limit) {
+		if (rtpe_config.cpu_limit || rtpe_config.degrade_cpu) {
 			FILE *f;
 			f = fopen("/proc/stat", "r");
 			if (f) {
@@ -48,6 +85,9 @@ void load_thread(void *dummy) {
 			}
 		}
 
+		if (rtpe_config.degrade_cpu)
+			transcode_degrade();
+
 		usleep(500000);
 	}
 }
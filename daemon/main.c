@@ -45,10 +45,14 @@
 #include "media_player.h"
 #include "dtmf.h"
 #include "jitter_buffer.h"
+#include "uring.h"
+#include "codec_worker.h"
+#include "codec.h"
 
 
 
 struct poller *rtpe_poller;
+struct poller **rtpe_media_pollers;
 struct rtpengine_config initial_rtpe_config;
 
 struct rtpengine_config rtpe_config = {
@@ -69,6 +73,8 @@ struct rtpengine_config rtpe_config = {
 	.redis_disable_time = 10,
 	.redis_connect_timeout = 1000,
 	.media_num_threads = -1,
+	.timer_sweep_threads = 2,
+	.cookie_cache_size = 64,
 	.dtls_rsa_key_size = 2048,
 	.dtls_signature = 256,
 };
@@ -309,6 +315,7 @@ static void options(int *argc, char ***argv) {
 	int codecs = 0;
 	double max_load = 0;
 	double max_cpu = 0;
+	double degrade_cpu = 0;
 	AUTO_CLEANUP_GBUF(dtmf_udp_ep);
 	AUTO_CLEANUP_GBUF(endpoint_learning);
 	AUTO_CLEANUP_GBUF(dtls_sig);
@@ -351,12 +358,24 @@ static void options(int *argc, char ***argv) {
 		{ "xmlrpc-format",'x', 0, G_OPTION_ARG_INT,	&rtpe_config.fmt,	"XMLRPC timeout request format to use. 0: SEMS DI, 1: call-id only, 2: Kamailio",	"INT"	},
 		{ "num-threads",  0, 0, G_OPTION_ARG_INT,	&rtpe_config.num_threads,	"Number of worker threads to create",	"INT"	},
 		{ "media-num-threads",  0, 0, G_OPTION_ARG_INT,	&rtpe_config.media_num_threads,	"Number of worker threads for media playback",	"INT"	},
+		{ "io-uring-threads",  0, 0, G_OPTION_ARG_INT,	&rtpe_config.io_uring_threads,	"Number of io_uring threads to handle media sockets, instead of epoll",	"INT"	},
+		{ "media-pollers",  0, 0, G_OPTION_ARG_INT,	&rtpe_config.media_pollers,	"Number of separate pollers (with one thread each) for media sockets",	"INT"	},
+		{ "timer-sweep-threads",  0, 0, G_OPTION_ARG_INT,	&rtpe_config.timer_sweep_threads,	"Number of threads checking calls for timeouts",	"INT"	},
+		{ "control-threads",  0, 0, G_OPTION_ARG_INT,	&rtpe_config.control_threads,	"Number of threads to handle NG control commands",	"INT"	},
+		{ "cookie-cache-size",  0, 0, G_OPTION_ARG_INT,	&rtpe_config.cookie_cache_size,	"Memory limit in MB for cached replies to control commands",	"INT"	},
+		{ "socket-pool",  0, 0, G_OPTION_ARG_INT,	&rtpe_config.socket_pool,	"Number of RTP/RTCP socket pairs to keep open in advance on each interface",	"INT"	},
+#ifdef WITH_TRANSCODING
+		{ "codec-threads",  0, 0, G_OPTION_ARG_INT,	&rtpe_config.codec_threads,	"Number of threads to do transcoding in, instead of the media threads",	"INT"	},
+#endif
+		{ "recv-batch",	0, 0,	G_OPTION_ARG_INT,	&rtpe_config.recv_batch,	"Max number of packets to receive per recvmmsg() call",	"INT"	},
+		{ "send-batch",	0, 0,	G_OPTION_ARG_INT,	&rtpe_config.send_batch,	"Max number of packets to queue up for one sendmmsg() call",	"INT"	},
 		{ "delete-delay",  'd', 0, G_OPTION_ARG_INT,    &rtpe_config.delete_delay,  "Delay for deleting a session from memory.",    "INT"   },
 		{ "sip-source",  0,  0, G_OPTION_ARG_NONE,	&sip_source,	"Use SIP source address by default",	NULL	},
 		{ "dtls-passive", 0, 0, G_OPTION_ARG_NONE,	&dtls_passive_def,"Always prefer DTLS passive role",	NULL	},
 		{ "max-sessions", 0, 0, G_OPTION_ARG_INT,	&rtpe_config.max_sessions,	"Limit of maximum number of sessions",	"INT"	},
 		{ "max-load",	0, 0,	G_OPTION_ARG_DOUBLE,	&max_load,	"Reject new sessions if load averages exceeds this value",	"FLOAT"	},
 		{ "max-cpu",	0, 0,	G_OPTION_ARG_DOUBLE,	&max_cpu,	"Reject new sessions if CPU usage (in percent) exceeds this value",	"FLOAT"	},
+		{ "degrade-cpu",0, 0,	G_OPTION_ARG_DOUBLE,	&degrade_cpu,	"Lower the cost of running transcoders if CPU usage (in percent) exceeds this value",	"FLOAT"	},
 		{ "max-bandwidth",0, 0,	G_OPTION_ARG_INT64,	&rtpe_config.bw_limit,	"Reject new sessions if bandwidth usage (in bytes per second) exceeds this value",	"INT"	},
 		{ "homer",	0,  0, G_OPTION_ARG_STRING,	&homerp,	"Address of Homer server for RTCP stats","IP46|HOSTNAME:PORT"},
 		{ "homer-protocol",0,0,G_OPTION_ARG_STRING,	&homerproto,	"Transport protocol for Homer (default udp)",	"udp|tcp"	},
@@ -553,6 +572,7 @@ static void options(int *argc, char ***argv) {
 
 	rtpe_config.cpu_limit = max_cpu * 100;
 	rtpe_config.load_limit = max_load * 100;
+	rtpe_config.degrade_cpu = degrade_cpu * 100;
 
 	if (rtpe_config.mysql_query) {
 		// require exactly one %llu placeholder and allow no other % placeholders
@@ -604,6 +624,37 @@ static void options(int *argc, char ***argv) {
 	if (rtpe_config.jb_length < 0)
 		die("Invalid negative jitter buffer size");
 
+	if (rtpe_config.recv_batch < 0 || rtpe_config.recv_batch > MAX_RECVMMSG)
+		die("Invalid --recv-batch (%i), must be between 0 and %i", rtpe_config.recv_batch, MAX_RECVMMSG);
+	if (rtpe_config.send_batch < 0 || rtpe_config.send_batch > MAX_SENDMMSG)
+		die("Invalid --send-batch (%i), must be between 0 and %i", rtpe_config.send_batch, MAX_SENDMMSG);
+
+	if (rtpe_config.media_pollers < 0)
+		die("Invalid negative number of media pollers");
+	if (rtpe_config.io_uring_threads < 0)
+		die("Invalid negative number of io_uring threads");
+	if (rtpe_config.timer_sweep_threads < 1)
+		die("Invalid --timer-sweep-threads (%i), must be at least 1", rtpe_config.timer_sweep_threads);
+	if (rtpe_config.codec_threads < 0)
+		die("Invalid negative number of codec threads");
+	if (rtpe_config.control_threads < 0)
+		die("Invalid negative number of control threads");
+	if (rtpe_config.cookie_cache_size < 0)
+		die("Invalid negative cookie cache size");
+	if (rtpe_config.socket_pool < 0)
+		die("Invalid negative socket pool size");
+
+	// resolved here as the timer threads shard their wheels by these
+	if (rtpe_config.num_threads < 1) {
+#ifdef _SC_NPROCESSORS_ONLN
+		rtpe_config.num_threads = sysconf( _SC_NPROCESSORS_ONLN ) + 3;
+#endif
+		if (rtpe_config.num_threads <= 1)
+			rtpe_config.num_threads = 4;
+	}
+	if (rtpe_config.media_num_threads < 0)
+		rtpe_config.media_num_threads = rtpe_config.num_threads;
+
 	// free local vars
 	if_a_global = if_a; // -> content is used; needs to be freed later
 }
@@ -630,6 +681,7 @@ void fill_initial_rtpe_cfg(struct rtpengine_config* ini_rtpe_cfg) {
 	ini_rtpe_cfg->max_sessions = rtpe_config.max_sessions;
 	ini_rtpe_cfg->cpu_limit = rtpe_config.cpu_limit;
 	ini_rtpe_cfg->load_limit = rtpe_config.load_limit;
+	ini_rtpe_cfg->degrade_cpu = rtpe_config.degrade_cpu;
 	ini_rtpe_cfg->bw_limit = rtpe_config.bw_limit;
 	ini_rtpe_cfg->timeout = rtpe_config.timeout;
 	ini_rtpe_cfg->silent_timeout = rtpe_config.silent_timeout;
@@ -651,6 +703,15 @@ void fill_initial_rtpe_cfg(struct rtpengine_config* ini_rtpe_cfg) {
 	ini_rtpe_cfg->no_redis_required = rtpe_config.no_redis_required;
 	ini_rtpe_cfg->num_threads = rtpe_config.num_threads;
 	ini_rtpe_cfg->media_num_threads = rtpe_config.media_num_threads;
+	ini_rtpe_cfg->recv_batch = rtpe_config.recv_batch;
+	ini_rtpe_cfg->send_batch = rtpe_config.send_batch;
+	ini_rtpe_cfg->media_pollers = rtpe_config.media_pollers;
+	ini_rtpe_cfg->io_uring_threads = rtpe_config.io_uring_threads;
+	ini_rtpe_cfg->timer_sweep_threads = rtpe_config.timer_sweep_threads;
+	ini_rtpe_cfg->codec_threads = rtpe_config.codec_threads;
+	ini_rtpe_cfg->control_threads = rtpe_config.control_threads;
+	ini_rtpe_cfg->cookie_cache_size = rtpe_config.cookie_cache_size;
+	ini_rtpe_cfg->socket_pool = rtpe_config.socket_pool;
 	ini_rtpe_cfg->fmt = rtpe_config.fmt;
 	ini_rtpe_cfg->log_format = rtpe_config.log_format;
 	ini_rtpe_cfg->redis_allowed_errors = rtpe_config.redis_allowed_errors;
@@ -748,10 +809,23 @@ static void init_everything(void) {
 	media_player_init();
 	dtmf_init();
 	jitter_buffer_init();
+	codec_workers_init();
 	t38_init();
 }
 
 
+// one kernel stats slot for each local port that can have a forwarding rule
+static unsigned int kernel_stats_slots(void) {
+	unsigned int ret = 0;
+
+	for (GList *l = all_intf_specs.head; l; l = l->next) {
+		struct intf_spec *spec = l->data;
+		ret += spec->port_pool.max - spec->port_pool.min + 1;
+	}
+
+	return ret;
+}
+
 static void create_everything(void) {
 	struct control_tcp *ct;
 	struct control_udp *cu;
@@ -762,7 +836,7 @@ static void create_everything(void) {
 
 	if (rtpe_config.kernel_table < 0)
 		goto no_kernel;
-	if (kernel_setup_table(rtpe_config.kernel_table)) {
+	if (kernel_setup_table(rtpe_config.kernel_table, kernel_stats_slots())) {
 		if (rtpe_config.no_fallback) {
 			ilog(LOG_CRIT, "Userspace fallback disallowed - exiting");
 			exit(-1);
@@ -774,8 +848,23 @@ no_kernel:
 	rtpe_poller = poller_new();
 	if (!rtpe_poller)
 		die("poller creation failed");
+	poller_set_batch_funcs(rtpe_poller, media_socket_sendq_begin, media_socket_sendq_end);
+
+	if (rtpe_config.media_pollers) {
+		rtpe_media_pollers = g_malloc0(sizeof(*rtpe_media_pollers) * rtpe_config.media_pollers);
+		for (int i = 0; i < rtpe_config.media_pollers; i++) {
+			rtpe_media_pollers[i] = poller_new();
+			if (!rtpe_media_pollers[i])
+				die("poller creation failed");
+			poller_set_batch_funcs(rtpe_media_pollers[i], media_socket_sendq_begin,
+					media_socket_sendq_end);
+		}
+	}
+
+	uring_init();
 
 	dtls_timer(rtpe_poller);
+	codec_pool_timer(rtpe_poller);
 
 	if (call_init())
 		abort();
@@ -897,6 +986,12 @@ int main(int argc, char **argv) {
 	thread_create_detach(sighandler, NULL);
 	thread_create_detach_prio(poller_timer_loop, rtpe_poller, rtpe_config.idle_scheduling, rtpe_config.idle_priority);
 	thread_create_detach_prio(load_thread, NULL, rtpe_config.idle_scheduling, rtpe_config.idle_priority);
+	if (rtpe_config.socket_pool > 0)
+		thread_create_detach_prio(socket_pool_loop, NULL, rtpe_config.idle_scheduling,
+				rtpe_config.idle_priority);
+	for (idx = 0; idx < rtpe_config.timer_sweep_threads; ++idx)
+		thread_create_detach_prio(call_timer_loop, GUINT_TO_POINTER(idx), rtpe_config.idle_scheduling,
+				rtpe_config.idle_priority);
 
 	if (!is_addr_unspecified(&rtpe_config.redis_ep.address) && rtpe_redis_notify)
 		thread_create_detach(redis_notify_loop, NULL);
@@ -906,21 +1001,16 @@ int main(int argc, char **argv) {
 
 	thread_create_detach(ice_thread_run, NULL);
 
-	if (rtpe_config.num_threads < 1) {
-#ifdef _SC_NPROCESSORS_ONLN
-		rtpe_config.num_threads = sysconf( _SC_NPROCESSORS_ONLN ) + 3;
-#endif
-		if (rtpe_config.num_threads <= 1)
-			rtpe_config.num_threads = 4;
-	}
-
 	service_notify("READY=1\n");
 
 	for (idx = 0; idx < rtpe_config.num_threads; ++idx)
 		thread_create_detach_prio(poller_loop, rtpe_poller, rtpe_config.scheduling, rtpe_config.priority);
+	for (idx = 0; idx < rtpe_config.media_pollers; ++idx)
+		thread_create_detach_prio(poller_loop, rtpe_media_pollers[idx], rtpe_config.scheduling,
+				rtpe_config.priority);
+	uring_launch();
+	control_ng_launch(rtpe_control_ng);
 
-	if (rtpe_config.media_num_threads < 0)
-		rtpe_config.media_num_threads = rtpe_config.num_threads;
 	for (idx = 0; idx < rtpe_config.media_num_threads; ++idx) {
 #ifdef WITH_TRANSCODING
 		thread_create_detach_prio(media_player_loop, NULL, rtpe_config.scheduling, rtpe_config.priority);
@@ -930,6 +1020,8 @@ int main(int argc, char **argv) {
 			thread_create_detach_prio(jitter_buffer_loop, NULL, rtpe_config.scheduling,
 					rtpe_config.priority);
 	}
+	for (idx = 0; idx < rtpe_config.codec_threads; ++idx)
+		thread_create_detach_prio(codec_worker_loop, NULL, rtpe_config.scheduling, rtpe_config.priority);
 
 
 	while (!rtpe_shutdown) {
@@ -944,6 +1036,9 @@ int main(int argc, char **argv) {
 
 	threads_join_all(1);
 
+	codec_pool_free();
+	interfaces_free();
+
 	if (!is_addr_unspecified(&rtpe_config.redis_ep.address) && rtpe_redis_notify)
 		redis_notify_event_base_action(EVENT_BASE_FREE);
 
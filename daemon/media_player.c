@@ -227,8 +227,7 @@ static void __send_timer_send_common(struct send_timer *st, struct codec_packet
 				FMT_M(sockaddr_print_buf(&st->sink->endpoint.address),
 				st->sink->endpoint.port));
 
-	socket_sendto(&st->sink->selected_sfd->socket,
-			cp->s.s, cp->s.len, &st->sink->endpoint);
+	stream_fd_send_packet(st->sink->selected_sfd, cp, &st->sink->endpoint);
 
 	if (cp->ssrc_out && cp->rtp) {
 		atomic64_inc(&cp->ssrc_out->packets);
@@ -750,9 +749,9 @@ static void media_player_run(void *ptr) {
 
 void media_player_init(void) {
 #ifdef WITH_TRANSCODING
-	timerthread_init(&media_player_thread, media_player_run);
+	timerthread_init(&media_player_thread, rtpe_config.media_num_threads, media_player_run);
 #endif
-	timerthread_init(&send_timer_thread, timerthread_queue_run);
+	timerthread_init(&send_timer_thread, rtpe_config.media_num_threads, timerthread_queue_run);
 }
 
 
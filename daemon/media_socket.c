@@ -4,6 +4,7 @@
 #include <glib.h>
 #include <errno.h>
 #include <netinet/in.h>
+#include <sys/socket.h>
 #include "str.h"
 #include "ice.h"
 #include "socket.h"
@@ -27,6 +28,9 @@
 #include "codec.h"
 #include "media_player.h"
 #include "jitter_buffer.h"
+#include "uring.h"
+#include "buffer_pool.h"
+#include "codec_worker.h"
 
 
 #ifndef PORT_RANDOM_MIN
@@ -46,6 +50,18 @@ struct intf_rr {
 	GQueue logical_intfs;
 	struct logical_intf *singular; // set iff only one is present in the list - no lock needed
 };
+struct sendq_entry {
+	struct stream_fd *sfd; // holds a reference
+	endpoint_t dst;
+	struct iovec iov; // points into `buf` or `free_ptr`
+	struct packet_buf *buf; // holds a reference
+	void *free_ptr; // owned, released through free_func
+	void (*free_func)(void *);
+};
+struct sendq {
+	unsigned int len;
+	struct sendq_entry entries[MAX_SENDMMSG];
+};
 struct packet_handler_ctx {
 	// inputs:
 	str s; // raw input packet
@@ -381,6 +397,7 @@ static GHashTable *__local_intf_addr_type_hash; // addr + type -> GList of struc
 static GQueue __preferred_lists_for_family[__SF_LAST];
 
 GQueue all_local_interfaces = G_QUEUE_INIT;
+GQueue all_intf_specs = G_QUEUE_INIT; // values of __intf_spec_addr_type_hash
 
 
 
@@ -391,7 +408,8 @@ static int has_free_ports_loc(struct local_intf *loc, unsigned int num_ports) {
 		return 0;
 	}
 
-	if (num_ports > g_atomic_int_get(&loc->spec->port_pool.free_ports)) {
+	if (num_ports > g_atomic_int_get(&loc->spec->port_pool.free_ports)
+			+ 2 * g_atomic_int_get(&loc->spec->port_pool.sock_pool_pairs)) {
 		ilog(LOG_ERR, "Didn't find %d ports available for " STR_FORMAT "/%s",
 			num_ports, STR_FMT(&loc->logical->name),
 			sockaddr_print_buf(&loc->spec->local_address.addr));
@@ -666,15 +684,18 @@ static void __interface_append(struct intf_config *ifa, sockfamily_t *fam) {
 		spec->port_pool.min = ifa->port_min;
 		spec->port_pool.max = ifa->port_max;
 		spec->port_pool.free_ports = spec->port_pool.max - spec->port_pool.min + 1;
-		mutex_init(&spec->port_pool.free_list_lock);
+		port_ring_init(&spec->port_pool.free_pairs, spec->port_pool.min, spec->port_pool.max);
+		mutex_init(&spec->port_pool.sock_pool_lock);
 		g_hash_table_insert(__intf_spec_addr_type_hash, &spec->local_address, spec);
+		g_queue_push_tail(&all_intf_specs, spec);
 	}
 
-	ifc = uid_slice_alloc(ifc, &lif->list);
+	ifc = uid_slice_alloc0(ifc, &lif->list);
 	ice_foundation(&ifc->ice_foundation);
 	ifc->advertised_address = ifa->advertised_address;
 	ifc->spec = spec;
 	ifc->logical = lif;
+	ifc->stats_idx = g_queue_get_length(&all_local_interfaces);
 
 	g_hash_table_insert(lif->addr_hash, &spec->local_address, ifc);
 	g_queue_push_tail(&all_local_interfaces, ifc);
@@ -757,18 +778,9 @@ struct local_intf *get_any_interface_address(const struct logical_intf *lif, soc
 
 
 
-static int get_port(socket_t *r, unsigned int port, struct intf_spec *spec, const str *label) {
-	struct port_pool *pp;
-
-	__C_DBG("attempting to open port %u", port);
-
-	pp = &spec->port_pool;
-
-	if (bit_array_set(pp->ports_used, port)) {
-		__C_DBG("port %d in use", port);
-		return -1;
-	}
-	__C_DBG("port %d locked", port);
+/* port must already be marked as used */
+static int __get_port(socket_t *r, unsigned int port, struct intf_spec *spec, const str *label) {
+	struct port_pool *pp = &spec->port_pool;
 
 	if (open_socket(r, SOCK_DGRAM, port, &spec->local_address.addr)) {
 		__C_DBG("couldn't open port %d", port);
@@ -776,7 +788,9 @@ static int get_port(socket_t *r, unsigned int port, struct intf_spec *spec, cons
 		return -1;
 	}
 
-	iptables_add_rule(r, label);
+	// sockets opened for the socket pool get their rule once they're handed out
+	if (label)
+		iptables_add_rule(r, label);
 	socket_timestamping(r);
 
 	g_atomic_int_dec_and_test(&pp->free_ports);
@@ -786,6 +800,22 @@ static int get_port(socket_t *r, unsigned int port, struct intf_spec *spec, cons
 	return 0;
 }
 
+static int get_port(socket_t *r, unsigned int port, struct intf_spec *spec, const str *label) {
+	struct port_pool *pp;
+
+	__C_DBG("attempting to open port %u", port);
+
+	pp = &spec->port_pool;
+
+	if (bit_array_set(pp->ports_used, port)) {
+		__C_DBG("port %d in use", port);
+		return -1;
+	}
+	__C_DBG("port %d locked", port);
+
+	return __get_port(r, port, spec, label);
+}
+
 static void release_port(socket_t *r, struct intf_spec *spec) {
 	unsigned int port = r->local.port;
 	struct port_pool *pp = &spec->port_pool;
@@ -798,14 +828,7 @@ static void release_port(socket_t *r, struct intf_spec *spec) {
 		__C_DBG("port %u is released", port);
 		bit_array_clear(pp->ports_used, port);
 		g_atomic_int_inc(&pp->free_ports);
-		if ((port & 1) == 0) {
-			mutex_lock(&pp->free_list_lock);
-			if (!bit_array_isset(pp->free_list_used, port)) {
-				g_queue_push_tail(&pp->free_list, GUINT_TO_POINTER(port));
-				bit_array_set(pp->free_list_used, port);
-			}
-			mutex_unlock(&pp->free_list_lock);
-		}
+		port_ring_put(&pp->free_pairs, pp->ports_used, port);
 	} else {
 		__C_DBG("port %u is NOT released", port);
 	}
@@ -817,8 +840,48 @@ static void free_port(socket_t *r, struct intf_spec *spec) {
 
 
 
-/* puts list of socket_t into "out" */
-int __get_consecutive_ports(GQueue *out, unsigned int num_ports, unsigned int wanted_start_port,
+/* takes one of the longest unused pairs of ports from the ring, instead of searching the range */
+static int __get_free_pair(GQueue *out, struct intf_spec *spec, const str *label) {
+	struct port_pool *pp = &spec->port_pool;
+	socket_t *rtp, *rtcp;
+	int port;
+
+	// a few tries for ports that are in use outside of rtpengine
+	for (unsigned int i = 0; i < 8; i++) {
+		port = port_ring_get_pair(&pp->free_pairs, pp->ports_used);
+		if (port < 0)
+			return -1;
+
+		rtp = g_slice_alloc0(sizeof(*rtp));
+		rtp->fd = -1;
+		rtcp = g_slice_alloc0(sizeof(*rtcp));
+		rtcp->fd = -1;
+
+		// pairs that are in use outside of rtpengine go to the back of the ring, to be
+		// tried again once all other free pairs have had their turn
+		if (__get_port(rtp, port, spec, label)) {
+			bit_array_clear(pp->ports_used, port + 1);
+			port_ring_put(&pp->free_pairs, pp->ports_used, port);
+			g_slice_free1(sizeof(*rtp), rtp);
+			g_slice_free1(sizeof(*rtcp), rtcp);
+			continue;
+		}
+		if (__get_port(rtcp, port + 1, spec, label)) {
+			free_port(rtp, spec);
+			g_slice_free1(sizeof(*rtcp), rtcp);
+			continue;
+		}
+
+		g_queue_push_tail(out, rtp);
+		g_queue_push_tail(out, rtcp);
+		g_atomic_int_set(&pp->last_used, port + 2);
+		return 0;
+	}
+
+	return -1;
+}
+
+static int __get_free_ports(GQueue *out, unsigned int num_ports, unsigned int wanted_start_port,
 		struct intf_spec *spec, const str *label)
 {
 	int i, cycle = 0;
@@ -829,6 +892,9 @@ int __get_consecutive_ports(GQueue *out, unsigned int num_ports, unsigned int wa
 	if (num_ports == 0)
 		return 0;
 
+	if (num_ports == 2 && !wanted_start_port && !__get_free_pair(out, spec, label))
+		return 0;
+
 	pp = &spec->port_pool;
 
 	__C_DBG("wanted_start_port=%d", wanted_start_port);
@@ -845,22 +911,6 @@ int __get_consecutive_ports(GQueue *out, unsigned int num_ports, unsigned int wa
 		__C_DBG("after  randomization port=%d", port);
 	}
 
-	// debug msg if port is in the given interval
-	if (bit_array_isset(pp->ports_used, port)) {
-		__C_DBG("port %d is USED in port pool", port);
-		mutex_lock(&pp->free_list_lock);
-		unsigned int fport = GPOINTER_TO_UINT(g_queue_pop_head(&pp->free_list));
-		if (fport)
-			bit_array_clear(pp->free_list_used, fport);
-		mutex_unlock(&pp->free_list_lock);
-		if (fport) {
-			port = fport;
-			__C_DBG("Picked port %u from free list", port);
-		}
-	} else {
-		__C_DBG("port %d is NOT USED in port pool", port);
-	}
-
 	while (1) {
 		__C_DBG("cycle=%d, port=%d", cycle, port);
 		if (!wanted_start_port) {
@@ -904,11 +954,125 @@ release_restart:
 	return 0;
 
 fail:
-	ilog(LOG_ERR, "Failed to get %u consecutive ports on interface %s for media relay (last error: %s)",
+	ilog(LOG_ERR | LOG_FLAG_LIMIT, "Failed to get %u consecutive ports on interface %s for media relay (last error: %s)",
 			num_ports, sockaddr_print_buf(&spec->local_address.addr), strerror(errno));
 	return -1;
 }
 
+
+
+static mutex_t socket_pool_lock = MUTEX_STATIC_INIT;
+static cond_t socket_pool_cond = COND_STATIC_INIT;
+
+// anything that arrived while the socket was sitting in the pool was meant for someone else
+static void socket_pool_drain(socket_t *sock) {
+	char buf[1];
+
+	for (unsigned int i = 0; i < 1000; i++) {
+		if (recv(sock->fd, buf, sizeof(buf), MSG_DONTWAIT | MSG_TRUNC) < 0)
+			break;
+	}
+}
+
+static int socket_pool_get(GQueue *out, struct intf_spec *spec, const str *label) {
+	struct port_pool *pp = &spec->port_pool;
+	socket_t *rtp, *rtcp;
+	unsigned int left = 0;
+
+	mutex_lock(&pp->sock_pool_lock);
+	rtp = g_queue_pop_head(&pp->sock_pool);
+	rtcp = g_queue_pop_head(&pp->sock_pool);
+	if (rtp)
+		left = g_atomic_int_add(&pp->sock_pool_pairs, -1) - 1;
+	mutex_unlock(&pp->sock_pool_lock);
+
+	if (!rtp) {
+		atomic64_inc(&pp->sock_pool_misses);
+		cond_signal(&socket_pool_cond);
+		return -1;
+	}
+
+	atomic64_inc(&pp->sock_pool_hits);
+	if (left <= rtpe_config.socket_pool / 2)
+		cond_signal(&socket_pool_cond);
+
+	socket_pool_drain(rtp);
+	socket_pool_drain(rtcp);
+	iptables_add_rule(rtp, label);
+	iptables_add_rule(rtcp, label);
+	g_queue_push_tail(out, rtp);
+	g_queue_push_tail(out, rtcp);
+
+	return 0;
+}
+
+void socket_pool_refill(struct intf_spec *spec) {
+	struct port_pool *pp = &spec->port_pool;
+	GQueue q = G_QUEUE_INIT;
+
+	while (!rtpe_shutdown && g_atomic_int_get(&pp->sock_pool_pairs) < rtpe_config.socket_pool) {
+		// leave the last ports to be allocated on demand
+		if (g_atomic_int_get(&pp->free_ports) < 2 * rtpe_config.socket_pool)
+			break;
+		if (__get_free_ports(&q, 2, 0, spec, NULL))
+			break;
+
+		mutex_lock(&pp->sock_pool_lock);
+		g_queue_push_tail(&pp->sock_pool, g_queue_pop_head(&q));
+		g_queue_push_tail(&pp->sock_pool, g_queue_pop_head(&q));
+		g_atomic_int_inc(&pp->sock_pool_pairs);
+		mutex_unlock(&pp->sock_pool_lock);
+
+		atomic64_inc(&pp->sock_pool_refills);
+	}
+}
+
+// keeps --socket-pool pairs of sockets ready on each interface address, so that
+// offers don't have to open and bind them
+void socket_pool_loop(void *p) {
+	struct timeval tv;
+
+	while (!rtpe_shutdown) {
+		for (GList *l = all_intf_specs.head; l; l = l->next)
+			socket_pool_refill(l->data);
+
+		mutex_lock(&socket_pool_lock);
+		gettimeofday(&tv, NULL);
+		timeval_add_usec(&tv, 100000);
+		cond_timedwait(&socket_pool_cond, &socket_pool_lock, &tv);
+		mutex_unlock(&socket_pool_lock);
+	}
+}
+
+// called during shutdown only
+void interfaces_free(void) {
+	socket_t *sock;
+
+	for (GList *l = all_intf_specs.head; l; l = l->next) {
+		struct intf_spec *spec = l->data;
+		struct port_pool *pp = &spec->port_pool;
+
+		mutex_lock(&pp->sock_pool_lock);
+		while ((sock = g_queue_pop_head(&pp->sock_pool)))
+			free_port(sock, spec);
+		pp->sock_pool_pairs = 0;
+		mutex_unlock(&pp->sock_pool_lock);
+
+		g_free(pp->free_pairs.slots);
+		pp->free_pairs.slots = NULL;
+	}
+}
+
+/* puts list of socket_t into "out" */
+int __get_consecutive_ports(GQueue *out, unsigned int num_ports, unsigned int wanted_start_port,
+		struct intf_spec *spec, const str *label)
+{
+	if (num_ports == 2 && !wanted_start_port && rtpe_config.socket_pool > 0
+			&& !socket_pool_get(out, spec, label))
+		return 0;
+	return __get_free_ports(out, num_ports, wanted_start_port, spec, label);
+}
+
 /* puts a list of "struct intf_list" into "out", containing socket_t list */
 int get_consecutive_ports(GQueue *out, unsigned int num_ports, const struct logical_intf *log,
 		const str *label)
@@ -1033,7 +1197,7 @@ static int __k_srtp_crypt(struct rtpengine_srtp *s, struct crypto_context *c, st
 	s->session_key_len = c->params.crypto_suite->session_key_len;
 	memcpy(s->master_salt, c->params.master_salt, c->params.crypto_suite->master_salt_len);
 
-	if (c->params.session_params.unencrypted_srtp)
+	if (c->params.session_params.unencrypted_srtp && !c->params.crypto_suite->aead_tag_len)
 		s->cipher = REC_NULL;
 	if (c->params.session_params.unauthenticated_srtp)
 		s->auth_tag_len = 0;
@@ -1051,16 +1215,6 @@ INLINE void __re_address_translate_ep(struct re_address *o, const endpoint_t *ep
 	ep->address.family->endpoint2kernel(o, ep);
 }
 
-static int __rtp_stats_pt_sort(const void *ap, const void *bp) {
-	const struct rtp_stats *a = ap, *b = bp;
-
-	if (a->payload_type < b->payload_type)
-		return -1;
-	if (a->payload_type > b->payload_type)
-		return 1;
-	return 0;
-}
-
 
 /* called with in_lock held */
 void kernelize(struct packet_stream *stream) {
@@ -1162,25 +1316,24 @@ void kernelize(struct packet_stream *stream) {
 	ZERO(stream->kernel_stats);
 
 	if (proto_is_rtp(media->protocol)) {
-		GList *values, *l;
 		struct rtp_stats *rs;
 
 		reti.rtp = 1;
-		values = g_hash_table_get_values(stream->rtp_stats);
-		values = g_list_sort(values, __rtp_stats_pt_sort);
-		for (l = values; l; l = l->next) {
+		// array is indexed by payload type, so this is sorted already
+		for (unsigned int i = 0; i < RTP_STATS_PT_SLOTS; i++) {
+			rs = rtp_stats_get(stream, i);
+			if (!rs)
+				continue;
 			if (reti.num_payload_types >= G_N_ELEMENTS(reti.payload_types)) {
 				ilog(LOG_WARNING, "Too many RTP payload types for kernel module");
 				break;
 			}
-			rs = l->data;
 			// only add payload types that are passthrough
 			struct codec_handler *ch = codec_handler_get(media, rs->payload_type);
 			if (!ch->kernelize)
 				continue;
 			reti.payload_types[reti.num_payload_types++] = rs->payload_type;
 		}
-		g_list_free(values);
 	}
 	else {
 		if (MEDIA_ISSET(media, TRANSCODE))
@@ -1189,7 +1342,22 @@ void kernelize(struct packet_stream *stream) {
 
 	recording_stream_kernel_info(stream, &reti);
 
-	kernel_add_stream(&reti, 0);
+	// without a stats area, the stats are read from the list of rules instead
+	if (kernel.num_stats_slots) {
+		nk_warn_msg = "no free slot in kernel stats area";
+		stream->kernel_stats_idx = kernel_stats_slot_get();
+		if (stream->kernel_stats_idx == UNINIT_IDX)
+			goto no_kernel_warn;
+		reti.stats_slot = 1;
+		reti.stats_idx = stream->kernel_stats_idx;
+	}
+
+	nk_warn_msg = "failed to push forwarding rule to kernel";
+	if (kernel_add_stream(&reti, 0)) {
+		kernel_stats_slot_put(stream->kernel_stats_idx);
+		stream->kernel_stats_idx = UNINIT_IDX;
+		goto no_kernel_warn;
+	}
 	PS_SET(stream, KERNELIZED);
 
 	return;
@@ -1214,6 +1382,8 @@ void __unkernelize(struct packet_stream *p) {
 		__re_address_translate_ep(&rea, &p->selected_sfd->socket.local);
 		kernel_del_stream(&rea);
 	}
+	kernel_stats_slot_put(p->kernel_stats_idx);
+	p->kernel_stats_idx = UNINIT_IDX;
 
 	PS_CLEAR(p, KERNELIZED);
 }
@@ -1474,20 +1644,16 @@ static void media_packet_rtp(struct packet_handler_ctx *phc)
 		if (G_LIKELY(phc->mp.ssrc_in))
 			payload_tracker_add(&phc->mp.ssrc_in->tracker, phc->payload_type);
 
-		// XXX yet another hash table per payload type -> combine
-		struct rtp_stats *rtp_s = g_atomic_pointer_get(&phc->mp.stream->rtp_stats_cache);
-		if (G_UNLIKELY(!rtp_s) || G_UNLIKELY(rtp_s->payload_type != phc->payload_type))
-			rtp_s = g_hash_table_lookup(phc->mp.stream->rtp_stats, &phc->payload_type);
+		struct rtp_stats *rtp_s = rtp_stats_get(phc->mp.stream, phc->payload_type);
 		if (!rtp_s) {
 			ilog(LOG_WARNING | LOG_FLAG_LIMIT,
 					"RTP packet with unknown payload type %u received", phc->payload_type);
 			atomic64_inc(&phc->mp.stream->stats.errors);
-			atomic64_inc(&rtpe_statsps.errors);
+			stats_shard_error(phc->mp.sfd->local_intf->stats_idx);
 		}
 		else {
 			atomic64_inc(&rtp_s->packets);
 			atomic64_add(&rtp_s->bytes, phc->s.len);
-			g_atomic_pointer_set(&phc->mp.stream->rtp_stats_cache, rtp_s);
 		}
 	}
 	else if (phc->rtcp && !rtcp_payload(&phc->mp.rtcp, NULL, &phc->s)) {
@@ -1772,6 +1938,133 @@ out:
 }
 
 
+static struct sendq __thread *t_sendq;
+static int __thread t_sendq_active;
+static void sendq_free(void *);
+static GPrivate sendq_key = G_PRIVATE_INIT(sendq_free); // frees the queue on thread exit
+
+static void sendq_send(socket_t *sock, struct iovec *iov, unsigned int num, endpoint_t *dst) {
+	int ret;
+
+	while (num) {
+		ret = socket_sendmmsg(sock, iov, num, dst);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			// the first message failed, skip it just like a failed sendto() would
+			ret = 1;
+		}
+		else if (ret == 0)
+			break;
+		iov += ret;
+		dst += ret;
+		num -= ret;
+	}
+}
+
+static void sendq_flush(struct sendq *q) {
+	struct iovec iov[MAX_SENDMMSG];
+	endpoint_t dst[MAX_SENDMMSG];
+	struct sendq_entry *e, *f;
+	struct stream_fd *sfd;
+	unsigned int i, j, num;
+
+	// send out everything in one go per source socket, preserving order for each
+	for (i = 0; i < q->len; i++) {
+		e = &q->entries[i];
+		sfd = e->sfd;
+		if (!sfd)
+			continue; // already sent as part of an earlier group
+
+		num = 0;
+		for (j = i; j < q->len; j++) {
+			f = &q->entries[j];
+			if (f->sfd != sfd)
+				continue;
+			iov[num] = f->iov;
+			dst[num] = f->dst;
+			num++;
+			if (j != i)
+				obj_put(f->sfd);
+			f->sfd = NULL;
+		}
+
+		sendq_send(&sfd->socket, iov, num, dst);
+		obj_put(sfd);
+	}
+
+	for (i = 0; i < q->len; i++) {
+		e = &q->entries[i];
+		packet_buf_put(e->buf);
+		if (e->free_func)
+			e->free_func(e->free_ptr);
+	}
+
+	q->len = 0;
+}
+
+static void sendq_free(void *p) {
+	struct sendq *q = p;
+	sendq_flush(q);
+	g_slice_free1(sizeof(*q), q);
+}
+
+void media_socket_sendq_begin(void) {
+	if (!rtpe_config.send_batch)
+		return;
+	if (G_UNLIKELY(!t_sendq)) {
+		t_sendq = g_slice_alloc0(sizeof(*t_sendq));
+		g_private_set(&sendq_key, t_sendq);
+	}
+	t_sendq_active = 1;
+}
+
+void media_socket_sendq_end(void) {
+	if (!t_sendq_active)
+		return;
+	sendq_flush(t_sendq);
+	t_sendq_active = 0;
+}
+
+// Queues up the packet if called from within a poller batch, sends it out immediately otherwise.
+// The queue doesn't copy the packet, but takes a reference to the pool buffer holding it, or
+// takes over its dynamically allocated buffer. Packets with neither are sent immediately.
+void stream_fd_send_packet(struct stream_fd *sfd, struct codec_packet *cp, const endpoint_t *dst) {
+	struct sendq *q = t_sendq;
+	struct sendq_entry *e;
+	struct packet_buf *pb = NULL;
+
+	if (t_sendq_active && cp->buf && packet_buf_contains(cp->buf, &cp->s))
+		pb = cp->buf;
+	else if (!t_sendq_active || !cp->free_func) {
+		socket_sendto(&sfd->socket, cp->s.s, cp->s.len, dst);
+		return;
+	}
+
+	if (q->len >= rtpe_config.send_batch)
+		sendq_flush(q);
+
+	e = &q->entries[q->len++];
+	e->sfd = obj_get(sfd);
+	e->dst = *dst;
+	e->iov.iov_base = cp->s.s;
+	e->iov.iov_len = cp->s.len;
+	if (pb) {
+		e->buf = packet_buf_get(pb);
+		e->free_ptr = NULL;
+		e->free_func = NULL;
+	}
+	else {
+		// the codec_packet no longer owns its buffer, but cp->rtp remains valid until
+		// the end of the batch
+		e->buf = NULL;
+		e->free_ptr = cp->s.s;
+		e->free_func = cp->free_func;
+		cp->free_func = NULL;
+	}
+}
+
+
 // appropriate locks must be held
 int media_socket_dequeue(struct media_packet *mp, struct packet_stream *sink) {
 	struct codec_packet *p;
@@ -1879,7 +2172,7 @@ static int stream_packet(struct packet_handler_ctx *phc) {
 	{
 		ilog(LOG_WARNING, "Media packet from %s%s%s discarded", FMT_M(endpoint_print_buf(&phc->mp.fsin)));
 		atomic64_inc(&phc->mp.stream->stats.errors);
-		atomic64_inc(&rtpe_statsps.errors);
+		stats_shard_error(phc->mp.sfd->local_intf->stats_idx);
 		goto out;
 	}
 
@@ -1929,6 +2222,12 @@ static int stream_packet(struct packet_handler_ctx *phc) {
 		goto drop;
 	}
 
+	if (phc->mp.codec_deferred) {
+		mutex_unlock(&phc->sink->out_lock);
+		codec_worker_push(&phc->mp);
+		goto drop;
+	}
+
 	ret = media_socket_dequeue(&phc->mp, phc->sink);
 
 	mutex_unlock(&phc->sink->out_lock);
@@ -1937,7 +2236,7 @@ static int stream_packet(struct packet_handler_ctx *phc) {
 		ret = -errno;
                 ilog(LOG_DEBUG,"Error when sending message. Error: %s",strerror(errno));
 		atomic64_inc(&phc->mp.stream->stats.errors);
-		atomic64_inc(&rtpe_statsps.errors);
+		stats_shard_error(phc->mp.sfd->local_intf->stats_idx);
 		goto out;
 	}
 
@@ -1947,8 +2246,7 @@ drop:
 	atomic64_inc(&phc->mp.stream->stats.packets);
 	atomic64_add(&phc->mp.stream->stats.bytes, phc->s.len);
 	atomic64_set(&phc->mp.stream->last_packet, rtpe_now.tv_sec);
-	atomic64_inc(&rtpe_statsps.packets);
-	atomic64_add(&rtpe_statsps.bytes, phc->s.len);
+	stats_shard_packet(phc->mp.sfd->local_intf->stats_idx, phc->s.len);
 
 out:
 	if (phc->unkernelize) {
@@ -1968,9 +2266,127 @@ out:
 }
 
 
+static void stream_fd_packet(struct packet_handler_ctx *phc, int *update) {
+	int ret;
+
+	if (phc->s.len >= MAX_RTP_PACKET_SIZE)
+		ilog(LOG_WARNING, "UDP packet possibly truncated");
+
+	if (phc->mp.sfd->stream && phc->mp.sfd->stream->jb) {
+		ret = buffer_packet(&phc->mp, &phc->s);
+		if (ret == 1)
+			ret = stream_packet(phc);
+	}
+	else
+		ret = stream_packet(phc);
+
+	if (G_UNLIKELY(ret < 0))
+		ilog(LOG_WARNING, "Write error on media socket: %s", strerror(-ret));
+	else if (phc->update)
+		*update = 1;
+}
+
+// drains the socket using recvmmsg(), returns -1 if the socket was closed
+static int stream_fd_readable_batch(struct stream_fd *sfd, int *update) {
+	struct packet_buf *bufs[MAX_RECVMMSG];
+	struct iovec iov[MAX_RECVMMSG];
+	endpoint_t fsin[MAX_RECVMMSG];
+	struct timeval tv[MAX_RECVMMSG];
+	unsigned int num, i, iters = 0;
+	int ret;
+
+	num = rtpe_config.recv_batch;
+	if (num > MAX_RECVMMSG)
+		num = MAX_RECVMMSG;
+
+	while (1) {
+#if MAX_RECV_ITERS
+		if (iters >= MAX_RECV_ITERS) {
+			ilog(LOG_ERROR, "Too many packets in UDP receive queue (more than %u), "
+					"aborting loop. Dropped packets possible", iters);
+			break;
+		}
+#endif
+
+		for (i = 0; i < num; i++) {
+			bufs[i] = packet_buf_new();
+			iov[i].iov_base = packet_buf_data(bufs[i]);
+			iov[i].iov_len = MAX_RTP_PACKET_SIZE;
+		}
+
+		ret = socket_recvmmsg_ts(&sfd->socket, iov, num, fsin, tv);
+
+		if (ret <= 0) {
+			for (i = 0; i < num; i++)
+				packet_buf_put(bufs[i]);
+			if (ret == 0)
+				break;
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				break;
+			return -1;
+		}
+
+		for (i = 0; i < ret; i++) {
+			struct packet_handler_ctx phc;
+			ZERO(phc);
+			phc.mp.sfd = sfd;
+			phc.mp.fsin = fsin[i];
+			phc.mp.tv = tv[i];
+			phc.mp.buf = bufs[i];
+			str_init_len(&phc.s, iov[i].iov_base, iov[i].iov_len);
+
+			stream_fd_packet(&phc, update);
+		}
+		// anything that wants to keep a packet has taken its own reference
+		for (i = 0; i < num; i++)
+			packet_buf_put(bufs[i]);
+
+		iters += ret;
+
+		// short read: receive queue is empty, save ourselves the EAGAIN
+		if (ret < num)
+			break;
+	}
+
+	return 0;
+}
+
+// entry points for io_uring, which does the receiving itself
+void stream_fd_recv_packet(struct stream_fd *sfd, struct packet_buf *pb, char *buf, size_t len,
+		const endpoint_t *fsin, const struct timeval *tv)
+{
+	struct packet_handler_ctx phc;
+	int update = 0;
+
+	log_info_stream_fd(sfd);
+
+	ZERO(phc);
+	phc.mp.sfd = sfd;
+	phc.mp.fsin = *fsin;
+	phc.mp.tv = *tv;
+	phc.mp.buf = pb;
+	str_init_len(&phc.s, buf, len);
+
+	stream_fd_packet(&phc, &update);
+
+	if (sfd->call && update)
+		redis_update_onekey(sfd->call, rtpe_redis_write);
+
+	log_info_clear();
+}
+
+void stream_fd_recv_error(struct stream_fd *sfd, int err) {
+	log_info_stream_fd(sfd);
+	ilog(LOG_WARNING, "Receive error on media socket: %s", strerror(err));
+	stream_fd_closed(sfd->socket.fd, sfd, 0);
+	log_info_clear();
+}
+
 static void stream_fd_readable(int fd, void *p, uintptr_t u) {
 	struct stream_fd *sfd = p;
-	char buf[RTP_BUFFER_SIZE];
+	struct packet_buf *buf;
 	int ret, iters;
 	int update = 0;
 	struct call *ca;
@@ -1980,6 +2396,12 @@ static void stream_fd_readable(int fd, void *p, uintptr_t u) {
 
 	log_info_stream_fd(sfd);
 
+	if (rtpe_config.recv_batch > 1) {
+		if (stream_fd_readable_batch(sfd, &update))
+			goto closed;
+		goto out;
+	}
+
 	for (iters = 0; ; iters++) {
 #if MAX_RECV_ITERS
 		if (iters >= MAX_RECV_ITERS) {
@@ -1993,34 +2415,24 @@ static void stream_fd_readable(int fd, void *p, uintptr_t u) {
 		ZERO(phc);
 		phc.mp.sfd = sfd;
 
-		ret = socket_recvfrom_ts(&sfd->socket, buf + RTP_BUFFER_HEAD_ROOM, MAX_RTP_PACKET_SIZE,
+		buf = packet_buf_new();
+		ret = socket_recvfrom_ts(&sfd->socket, packet_buf_data(buf), MAX_RTP_PACKET_SIZE,
 				&phc.mp.fsin, &phc.mp.tv);
 
 		if (ret < 0) {
+			packet_buf_put(buf);
 			if (errno == EINTR)
 				continue;
 			if (errno == EAGAIN || errno == EWOULDBLOCK)
 				break;
-			stream_fd_closed(fd, sfd, 0);
-			goto done;
+			goto closed;
 		}
-		if (ret >= MAX_RTP_PACKET_SIZE)
-			ilog(LOG_WARNING, "UDP packet possibly truncated");
 
-		str_init_len(&phc.s, buf + RTP_BUFFER_HEAD_ROOM, ret);
+		phc.mp.buf = buf;
+		str_init_len(&phc.s, packet_buf_data(buf), ret);
 
-		if (sfd->stream && sfd->stream->jb) {
-			ret = buffer_packet(&phc.mp, &phc.s);
-			if (ret == 1)
-				ret = stream_packet(&phc);
-		}
-		else
-			ret = stream_packet(&phc);
-
-		if (G_UNLIKELY(ret < 0))
-			ilog(LOG_WARNING, "Write error on media socket: %s", strerror(-ret));
-		else if (phc.update)
-			update = 1;
+		stream_fd_packet(&phc, &update);
+		packet_buf_put(buf);
 	}
 
 out:
@@ -2031,6 +2443,11 @@ out:
 	}
 done:
 	log_info_clear();
+	return;
+
+closed:
+	stream_fd_closed(fd, sfd, 0);
+	goto done;
 }
 
 
@@ -2066,7 +2483,10 @@ struct stream_fd *stream_fd_new(socket_t *fd, struct call *call, const struct lo
 	pi.readable = stream_fd_readable;
 	pi.closed = stream_fd_closed;
 
-	if (poller_add_item(rtpe_poller, &pi))
+	if (call->uring && !uring_add_sfd(call->uring, sfd))
+		return sfd;
+
+	if (poller_add_item(call->poller, &pi))
 		ilog(LOG_ERR, "Failed to add stream_fd to poller");
 
 	return sfd;
@@ -44,6 +44,9 @@ struct poller {
 	mutex_t				timers_add_del_lock; /* nested below timers_lock */
 	GSList				*timers_add;
 	GSList				*timers_del;
+
+	void				(*batch_begin)(void);
+	void				(*batch_end)(void);
 };
 
 
@@ -293,13 +296,8 @@ int poller_poll(struct poller *p, int timeout) {
 	if (!p)
 		return -1;
 
-	mutex_lock(&p->lock);
-
-	ret = -1;
-	if (!p->items || !p->items_size)
-		goto out;
-
-	mutex_unlock(&p->lock);
+	// a poller without any items (e.g. a media poller before the first call) simply
+	// sleeps in epoll_wait() instead of returning immediately
 	errno = 0;
 	ret = epoll_wait(p->fd, evs, sizeof(evs) / sizeof(*evs), timeout);
 	mutex_lock(&p->lock);
@@ -313,6 +311,9 @@ int poller_poll(struct poller *p, int timeout) {
 
 	gettimeofday(&rtpe_now, NULL);
 
+	if (p->batch_begin)
+		p->batch_begin();
+
 	for (i = 0; i < ret; i++) {
 		ev = &evs[i];
 
@@ -359,6 +360,12 @@ next:
 		mutex_lock(&p->lock);
 	}
 
+	mutex_unlock(&p->lock);
+
+	if (p->batch_end)
+		p->batch_end();
+
+	return ret;
 
 out:
 	mutex_unlock(&p->lock);
@@ -366,6 +373,13 @@ out:
 }
 
 
+/* must be set before any thread runs poller_poll() on this poller */
+void poller_set_batch_funcs(struct poller *p, void (*begin)(void), void (*end)(void)) {
+	p->batch_begin = begin;
+	p->batch_end = end;
+}
+
+
 void poller_blocked(struct poller *p, void *fdp) {
 	int fd = GPOINTER_TO_INT(fdp);
 	struct epoll_event e;
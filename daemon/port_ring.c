@@ -0,0 +1,140 @@
+#include "port_ring.h"
+
+#include <glib.h>
+
+#include "aux.h"
+
+// upper limit for the number of free pairs passed over for each allocation, which makes
+// the next port to be handed out unpredictable
+#define PORT_RING_MAX_SKIP 8
+
+// bounded multi-producer multi-consumer queue: each slot's sequence number tells whether
+// it's ready to be pushed to or popped from for the current round of head/tail
+
+static int port_ring_push(struct port_ring *r, unsigned int port) {
+	struct port_ring_slot *slot;
+	unsigned int pos = g_atomic_int_get(&r->tail);
+
+	while (1) {
+		slot = &r->slots[pos & r->mask];
+		int dif = (int) (g_atomic_int_get(&slot->seq) - pos);
+		if (dif == 0) {
+			if (g_atomic_int_compare_and_exchange(&r->tail, (gint) pos, (gint) (pos + 1)))
+				break;
+		}
+		else if (dif < 0) {
+			// either full, or the last pop from this slot hasn't finished yet
+			if ((int) (pos - g_atomic_int_get(&r->head)) > (int) r->mask)
+				return -1;
+		}
+		pos = g_atomic_int_get(&r->tail);
+	}
+
+	slot->port = port;
+	g_atomic_int_set(&slot->seq, pos + 1);
+	return 0;
+}
+
+static int port_ring_pop(struct port_ring *r, unsigned int *port) {
+	struct port_ring_slot *slot;
+	unsigned int pos = g_atomic_int_get(&r->head);
+
+	while (1) {
+		slot = &r->slots[pos & r->mask];
+		int dif = (int) (g_atomic_int_get(&slot->seq) - (pos + 1));
+		if (dif == 0) {
+			if (g_atomic_int_compare_and_exchange(&r->head, (gint) pos, (gint) (pos + 1)))
+				break;
+		}
+		else if (dif < 0)
+			return -1; // empty
+		pos = g_atomic_int_get(&r->head);
+	}
+
+	*port = slot->port;
+	g_atomic_int_set(&slot->seq, pos + r->mask + 1);
+	return 0;
+}
+
+void port_ring_init(struct port_ring *r, unsigned int min, unsigned int max) {
+	unsigned int first = (min + 1) & ~1U;
+	unsigned int num = 0, size = 1;
+
+	if (max > 0xffff)
+		max = 0xffff;
+	if (max > first)
+		num = (max - first + 1) / 2;
+	while (size < num)
+		size <<= 1;
+
+	r->slots = g_malloc0(sizeof(*r->slots) * size);
+	r->mask = size - 1;
+	r->min = min;
+	r->max = max;
+	r->head = r->tail = 0;
+	for (unsigned int i = 0; i < size; i++)
+		r->slots[i].seq = i;
+
+	// queued in random order
+	unsigned int *ports = g_malloc(sizeof(*ports) * (num ? num : 1));
+	for (unsigned int i = 0; i < num; i++)
+		ports[i] = first + i * 2;
+	for (unsigned int i = num; i > 1; i--) {
+		unsigned int j = ssl_random() % i;
+		unsigned int tmp = ports[i - 1];
+		ports[i - 1] = ports[j];
+		ports[j] = tmp;
+	}
+
+	for (unsigned int i = 0; i < num; i++) {
+		bit_array_set(r->queued, ports[i]);
+		port_ring_push(r, ports[i]);
+	}
+
+	g_free(ports);
+}
+
+int port_ring_get_pair(struct port_ring *r, volatile unsigned int *ports_used) {
+	unsigned int port;
+
+	// moves a random number of pairs from the head to the back of the ring
+	unsigned int skip = ssl_random() % PORT_RING_MAX_SKIP;
+	for (unsigned int i = 0; i < skip; i++) {
+		if (port_ring_pop(r, &port))
+			break;
+		// stays marked as queued
+		if (port_ring_push(r, port))
+			bit_array_clear(r->queued, port);
+	}
+
+	// skips over pairs that were claimed through other means since they were queued
+	for (unsigned int i = 0; i <= r->mask; i++) {
+		if (port_ring_pop(r, &port))
+			return -1;
+		bit_array_clear(r->queued, port);
+
+		if (bit_array_set(ports_used, port))
+			continue; // requeued by whoever releases it
+		if (!bit_array_set(ports_used, port + 1))
+			return port;
+
+		bit_array_clear(ports_used, port);
+		// the odd port may have been released in the meantime
+		port_ring_put(r, ports_used, port);
+	}
+
+	return -1;
+}
+
+void port_ring_put(struct port_ring *r, volatile unsigned int *ports_used, unsigned int port) {
+	port &= ~1U;
+	if (port < r->min || port + 1 > r->max)
+		return;
+	if (bit_array_isset(ports_used, port) || bit_array_isset(ports_used, port + 1))
+		return;
+	if (bit_array_set(r->queued, port))
+		return; // already queued
+	// can't fail, as there's room for all pairs of the range
+	if (port_ring_push(r, port))
+		bit_array_clear(r->queued, port);
+}
@@ -21,6 +21,7 @@
 #include "rtplib.h"
 #include "cdr.h"
 #include "log.h"
+#include "buffer_pool.h"
 
 
 
@@ -551,17 +552,9 @@ static void pcap_eth_header(unsigned char *pkt, struct packet_stream *stream) {
 	hdr16[6] = htons(stream->selected_sfd->socket.local.address.family->ethertype);
 }
 
-/**
- * Write out a PCAP packet with payload string.
- * A fair amount extraneous of packet data is spoofed.
- */
-static void stream_pcap_dump(struct media_packet *mp, const str *s) {
-	pcap_dumper_t *pdumper = mp->call->recording->u.pcap.recording_pdumper;
-	if (!pdumper)
-		return;
-
-	unsigned char pkt[s->len + MAX_PACKET_HEADER_LEN + pcap_format->headerlen];
-	unsigned int pkt_len = fake_ip_header(pkt + pcap_format->headerlen, mp, s) + pcap_format->headerlen;
+static void __pcap_dump(pcap_dumper_t *pdumper, struct media_packet *mp, unsigned char *pkt,
+		unsigned int pkt_len)
+{
 	if (pcap_format->header)
 		pcap_format->header(pkt, mp->stream);
 
@@ -577,6 +570,33 @@ static void stream_pcap_dump(struct media_packet *mp, const str *s) {
 	pcap_dump((unsigned char *)pdumper, &header, pkt);
 }
 
+/**
+ * Write out a PCAP packet with payload string.
+ * A fair amount extraneous of packet data is spoofed.
+ */
+static void stream_pcap_dump(struct media_packet *mp, const str *s) {
+	pcap_dumper_t *pdumper = mp->call->recording->u.pcap.recording_pdumper;
+	if (!pdumper)
+		return;
+
+	unsigned int hdr_room = MAX_PACKET_HEADER_LEN + pcap_format->headerlen;
+
+	if (mp->buf && packet_buf_head_room(mp->buf, s) >= hdr_room) {
+		// build the fake headers in place in front of the packet data
+		unsigned char hdr[MAX_PACKET_HEADER_LEN];
+		unsigned int hdr_len = endpoint_packet_header(hdr, &mp->fsin, &mp->sfd->socket.local, s->len);
+		assert(hdr_len <= MAX_PACKET_HEADER_LEN);
+		unsigned char *pkt = (unsigned char *) s->s - hdr_len - pcap_format->headerlen;
+		memcpy(pkt + pcap_format->headerlen, hdr, hdr_len);
+		__pcap_dump(pdumper, mp, pkt, s->len + hdr_len + pcap_format->headerlen);
+		return;
+	}
+
+	unsigned char pkt[s->len + hdr_room];
+	unsigned int pkt_len = fake_ip_header(pkt + pcap_format->headerlen, mp, s) + pcap_format->headerlen;
+	__pcap_dump(pdumper, mp, pkt, pkt_len);
+}
+
 static void dump_packet_pcap(struct media_packet *mp, const str *s) {
 	struct recording *recording = mp->call->recording;
 	mutex_lock(&recording->u.pcap.recording_lock);
@@ -836,6 +836,7 @@ int rtcp_avp2savp(str *s, struct crypto_context *c, struct ssrc_ctx *ssrc_ctx) {
 	struct rtcp_packet *rtcp;
 	u_int32_t *idx;
 	str to_auth, payload;
+	int encrypt;
 
 	if (G_UNLIKELY(!ssrc_ctx))
 		return -1;
@@ -844,31 +845,36 @@ int rtcp_avp2savp(str *s, struct crypto_context *c, struct ssrc_ctx *ssrc_ctx) {
 	if (check_session_keys(c))
 		return -1;
 
+	/* AEAD suites are always encrypted */
+	encrypt = !c->params.session_params.unencrypted_srtcp || c->params.crypto_suite->aead_tag_len;
+
 	crypto_debug_init(1);
 	crypto_debug_printf("RTCP SSRC %" PRIx32 ", idx %" PRIu64 ", plain pl: ",
 			rtcp->ssrc, ssrc_ctx->srtcp_index);
 	crypto_debug_dump(&payload);
 
-	if (!c->params.session_params.unencrypted_srtcp && crypto_encrypt_rtcp(c, rtcp, &payload,
-				ssrc_ctx->srtcp_index))
+	if (encrypt && crypto_encrypt_rtcp(c, rtcp, &payload, ssrc_ctx->srtcp_index))
 		return -1;
+	/* AEAD suites append their tag to the payload */
+	s->len = payload.s + payload.len - s->s;
 
 	crypto_debug_printf(", enc pl: ");
 	crypto_debug_dump(&payload);
 
 	idx = (void *) s->s + s->len;
-	*idx = htonl((c->params.session_params.unencrypted_srtcp ? 0ULL : 0x80000000ULL) |
-			ssrc_ctx->srtcp_index++);
+	*idx = htonl((encrypt ? 0x80000000ULL : 0ULL) | ssrc_ctx->srtcp_index++);
 	s->len += sizeof(*idx);
 
 	to_auth = *s;
 
 	rtp_append_mki(s, c);
 
-	c->params.crypto_suite->hash_rtcp(c, s->s + s->len, &to_auth);
-	crypto_debug_printf(", auth: ");
-	crypto_debug_dump_raw(s->s + s->len, c->params.crypto_suite->srtcp_auth_tag);
-	s->len += c->params.crypto_suite->srtcp_auth_tag;
+	if (c->params.crypto_suite->srtcp_auth_tag) {
+		c->params.crypto_suite->hash_rtcp(c, s->s + s->len, &to_auth);
+		crypto_debug_printf(", auth: ");
+		crypto_debug_dump_raw(s->s + s->len, c->params.crypto_suite->srtcp_auth_tag);
+		s->len += c->params.crypto_suite->srtcp_auth_tag;
+	}
 
 	crypto_debug_finish();
 
@@ -911,28 +917,36 @@ int rtcp_savp2avp(str *s, struct crypto_context *c, struct ssrc_ctx *ssrc_ctx) {
 
 	crypto_debug_printf(", idx %" PRIu32, idx);
 
-	assert(sizeof(hmac) >= auth_tag.len);
-	c->params.crypto_suite->hash_rtcp(c, hmac, &to_auth);
+	if (auth_tag.len) {
+		assert(sizeof(hmac) >= auth_tag.len);
+		c->params.crypto_suite->hash_rtcp(c, hmac, &to_auth);
+
+		crypto_debug_printf(", rcv hmac: ");
+		crypto_debug_dump(&auth_tag);
+		crypto_debug_printf(", calc hmac: ");
+		crypto_debug_dump_raw(hmac, auth_tag.len);
 
-	crypto_debug_printf(", rcv hmac: ");
-	crypto_debug_dump(&auth_tag);
-	crypto_debug_printf(", calc hmac: ");
-	crypto_debug_dump_raw(hmac, auth_tag.len);
+		err = "authentication failed";
+		if (str_memcmp(&auth_tag, hmac))
+			goto error;
+	}
 
-	err = "authentication failed";
-	if (str_memcmp(&auth_tag, hmac))
+	err = "unencrypted SRTCP with AEAD suite";
+	if (!(idx & 0x80000000ULL) && c->params.crypto_suite->aead_tag_len)
 		goto error;
 
 	if ((idx & 0x80000000ULL)) {
+		/* AEAD suites authenticate while decrypting and strip their tag */
+		err = "authentication failed";
 		if (crypto_decrypt_rtcp(c, rtcp, &to_decrypt, idx & 0x7fffffffULL))
-			return -1;
+			goto error;
 
 		crypto_debug_printf(", dec pl: ");
 		crypto_debug_dump(&to_decrypt);
 	}
 
 	*s = to_auth;
-	s->len -= sizeof(idx);
+	s->len = to_decrypt.s + to_decrypt.len - s->s;
 
 	crypto_debug_finish();
 
@@ -118,8 +118,11 @@ int rtp_avp2savp(str *s, struct crypto_context *c, struct ssrc_ctx *ssrc_ctx) {
 	crypto_debug_dump(&payload);
 
 	/* rfc 3711 section 3.1 */
-	if (!c->params.session_params.unencrypted_srtp && crypto_encrypt_rtp(c, rtp, &payload, index))
+	if ((!c->params.session_params.unencrypted_srtp || c->params.crypto_suite->aead_tag_len)
+			&& crypto_encrypt_rtp(c, rtp, &payload, index))
 		return -1;
+	/* AEAD suites append their tag to the payload */
+	s->len = payload.s + payload.len - s->s;
 
 	crypto_debug_printf(", enc pl: ");
 	crypto_debug_dump(&payload);
@@ -213,13 +216,16 @@ int rtp_savp2avp(str *s, struct crypto_context *c, struct ssrc_ctx *ssrc_ctx) {
 decrypt_idx:
 	ssrc_ctx->srtp_index = index;
 decrypt:
-	if (!c->params.session_params.unencrypted_srtp && crypto_decrypt_rtp(c, rtp, &to_decrypt, index))
-		return -1;
+	/* AEAD suites authenticate while decrypting and strip their tag */
+	if ((!c->params.session_params.unencrypted_srtp || c->params.crypto_suite->aead_tag_len)
+			&& crypto_decrypt_rtp(c, rtp, &to_decrypt, index))
+		goto error;
 
 	crypto_debug_printf(", dec pl: ");
 	crypto_debug_dump(&to_decrypt);
 
 	*s = to_auth;
+	s->len = to_decrypt.s + to_decrypt.len - s->s;
 
 	crypto_debug_finish();
 
@@ -3,6 +3,8 @@
 #include "graphite.h"
 #include "main.h"
 #include "control_ng.h"
+#include "buffer_pool.h"
+#include "codec_worker.h"
 
 
 struct totalstats       rtpe_totalstats;
@@ -14,6 +16,11 @@ struct totalstats       rtpe_totalstats_lastinterval;
 mutex_t rtpe_codec_stats_lock;
 GHashTable *rtpe_codec_stats;
 
+__thread struct stats_shard *rtpe_stats_shard;
+
+static mutex_t stats_shards_lock = MUTEX_STATIC_INIT;
+static GQueue stats_shards = G_QUEUE_INIT;
+
 
 static void timeval_totalstats_average_add(struct totalstats *s, const struct timeval *add) {
 	struct timeval dp, oa;
@@ -97,7 +104,7 @@ void statistics_update_foreignown_dec(struct call* c) {
 	if(IS_OWN_CALL(c)) 	{
 		mutex_lock(&rtpe_totalstats_interval.managed_sess_lock);
 		rtpe_totalstats_interval.managed_sess_min = MIN(rtpe_totalstats_interval.managed_sess_min,
-				g_hash_table_size(rtpe_callhash) - atomic64_get(&rtpe_stats.foreign_sessions));
+				call_num_calls() - atomic64_get(&rtpe_stats.foreign_sessions));
 		mutex_unlock(&rtpe_totalstats_interval.managed_sess_lock);
 	}
 
@@ -108,7 +115,7 @@ void statistics_update_foreignown_inc(struct call* c) {
 		mutex_lock(&rtpe_totalstats_interval.managed_sess_lock);
 		rtpe_totalstats_interval.managed_sess_max = MAX(
 				rtpe_totalstats_interval.managed_sess_max,
-				g_hash_table_size(rtpe_callhash)
+				call_num_calls()
 						- atomic64_get(&rtpe_stats.foreign_sessions));
 		mutex_unlock(&rtpe_totalstats_interval.managed_sess_lock);
 	}
@@ -348,6 +355,64 @@ void statistics_update_oneway(struct call* c) {
 		SM_PUSH(ret, m); \
 	} while (0)
 
+static void control_ng_socket_metrics(GQueue *ret, socket_t *listeners, unsigned int num) {
+	for (unsigned int i = 0; i < num; i++) {
+		socket_t *sock = &listeners[i];
+		if (sock->fd == -1)
+			continue;
+		int queued = socket_rx_queued(sock);
+		METRICl("", " %30s | %12i", endpoint_print_buf(&sock->local), queued);
+		HEADER("{", NULL);
+		METRICsva("address", "\"%s\"", endpoint_print_buf(&sock->local));
+		METRICs("queuedbytes", "%i", queued);
+		HEADER("}", NULL);
+	}
+}
+
+static void control_ng_timing_metrics(GQueue *ret) {
+	GString *line = g_string_new("");
+	char label[32];
+
+	g_string_append_printf(line, " %20s", "Command");
+	for (unsigned int i = 0; i < NG_TIMING_BUCKETS - 1; i++) {
+		snprintf(label, sizeof(label), "<%ums", ng_timing_bucket_ms[i]);
+		g_string_append_printf(line, " | %8s", label);
+	}
+	snprintf(label, sizeof(label), ">=%ums", ng_timing_bucket_ms[NG_TIMING_BUCKETS - 2]);
+	g_string_append_printf(line, " | %8s", label);
+	HEADERl("%s", line->str);
+
+	for (unsigned int c = 0; c < __NGC_LAST; c++) {
+		u_int64_t counts[NG_TIMING_BUCKETS];
+		u_int64_t total = 0;
+
+		for (unsigned int i = 0; i < NG_TIMING_BUCKETS; i++) {
+			counts[i] = atomic64_get(&rtpe_ng_timings[c][i]);
+			total += counts[i];
+		}
+		if (!total)
+			continue;
+
+		g_string_truncate(line, 0);
+		g_string_append_printf(line, " %20s", ng_command_strings[c]);
+		for (unsigned int i = 0; i < NG_TIMING_BUCKETS; i++)
+			g_string_append_printf(line, " | %8" G_GUINT64_FORMAT, counts[i]);
+		METRICl("", "%s", line->str);
+
+		HEADER("{", NULL);
+		METRICsva("command", "\"%s\"", ng_command_strings[c]);
+		for (unsigned int i = 0; i < NG_TIMING_BUCKETS - 1; i++) {
+			snprintf(label, sizeof(label), "lt%ums", ng_timing_bucket_ms[i]);
+			METRICs(label, UINT64F, counts[i]);
+		}
+		snprintf(label, sizeof(label), "ge%ums", ng_timing_bucket_ms[NG_TIMING_BUCKETS - 2]);
+		METRICs(label, UINT64F, counts[NG_TIMING_BUCKETS - 1]);
+		HEADER("}", NULL);
+	}
+
+	g_string_free(line, TRUE);
+}
+
 GQueue *statistics_gather_metrics(void) {
 	GQueue *ret = g_queue_new();
 
@@ -355,6 +420,8 @@ GQueue *statistics_gather_metrics(void) {
 	u_int64_t cur_sessions, num_sessions, min_sess_iv, max_sess_iv;
 	struct request_time offer_iv, answer_iv, delete_iv;
 	struct requests_ps offers_ps, answers_ps, deletes_ps;
+	struct buffer_pool_stats bp_stats;
+	struct codec_worker_stats cw_stats;
 
 	mutex_lock(&rtpe_totalstats.total_average_lock);
 	avg = rtpe_totalstats.total_average_call_dur;
@@ -365,19 +432,65 @@ GQueue *statistics_gather_metrics(void) {
 	HEADER("currentstatistics", "Statistics over currently running sessions:");
 	HEADER("{", "");
 
-	rwlock_lock_r(&rtpe_callhash_lock);
-	cur_sessions = g_hash_table_size(rtpe_callhash);
-	rwlock_unlock_r(&rtpe_callhash_lock);
+	cur_sessions = call_num_calls();
 
 	METRIC("sessionsown", "Owned sessions", UINT64F, UINT64F, cur_sessions - atomic64_get(&rtpe_stats.foreign_sessions));
 	METRIC("sessionsforeign", "Foreign sessions", UINT64F, UINT64F, atomic64_get(&rtpe_stats.foreign_sessions));
 	METRIC("sessionstotal", "Total sessions", UINT64F, UINT64F, cur_sessions);
 	METRIC("transcodedmedia", "Transcoded media", UINT64F, UINT64F, atomic64_get(&rtpe_stats.transcoded_media));
+	METRIC("timersweeprate", "Calls checked by timer per second", UINT64F, UINT64F, atomic64_get(&rtpe_sweep_stats.calls_ps));
+	METRIC("timersweepbacklog", "Calls not checked by timer within one second", UINT64F, UINT64F, atomic64_get(&rtpe_sweep_stats.backlog));
+	METRIC("timersweepavgtime", "Average timer sweep slice duration", UINT64F, UINT64F " us", atomic64_get(&rtpe_sweep_stats.avg_time));
+	METRIC("timersweepmaxtime", "Maximum timer sweep slice duration", UINT64F, UINT64F " us", atomic64_get(&rtpe_sweep_stats.max_time));
 
 	METRIC("packetrate", "Packets per second", UINT64F, UINT64F, atomic64_get(&rtpe_stats.packets));
 	METRIC("byterate", "Bytes per second", UINT64F, UINT64F, atomic64_get(&rtpe_stats.bytes));
 	METRIC("errorrate", "Errors per second", UINT64F, UINT64F, atomic64_get(&rtpe_stats.errors));
 
+	codec_worker_stats(&cw_stats);
+	METRIC("codecqueue", "Packets queued for codec threads", UINT64F, UINT64F, cw_stats.queued);
+
+	HEADER("interfaces", NULL);
+	HEADER("[", NULL);
+	for (GList *l = all_local_interfaces.head; l; l = l->next) {
+		struct local_intf *lif = l->data;
+		// only show first-order interface entries: socket families must match
+		if (lif->logical->preferred_family != lif->spec->local_address.addr.family)
+			continue;
+		HEADER("{", NULL);
+		METRICsva("name", "\"%s\"", lif->logical->name.s);
+		METRICsva("address", "\"%s\"", sockaddr_print_buf(&lif->spec->local_address.addr));
+		HEADERl("Interface '%s' address '%s':", lif->logical->name.s,
+				sockaddr_print_buf(&lif->spec->local_address.addr));
+		METRIC("packetrate", " Packets per second", UINT64F, UINT64F, atomic64_get(&lif->stats.ps.packets));
+		METRIC("byterate", " Bytes per second", UINT64F, UINT64F, atomic64_get(&lif->stats.ps.bytes));
+		METRIC("errorrate", " Errors per second", UINT64F, UINT64F, atomic64_get(&lif->stats.ps.errors));
+		METRIC("packets", " Total packets", UINT64F, UINT64F, atomic64_get(&lif->stats.totals.packets));
+		METRIC("bytes", " Total bytes", UINT64F, UINT64F, atomic64_get(&lif->stats.totals.bytes));
+		METRIC("errors", " Total errors", UINT64F, UINT64F, atomic64_get(&lif->stats.totals.errors));
+		HEADER("}", NULL);
+	}
+	HEADER("]", NULL);
+
+	// one pool per local address, which can be shared by several logical interfaces
+	if (rtpe_config.socket_pool > 0) {
+		HEADER("socketpools", NULL);
+		HEADER("[", NULL);
+		for (GList *l = all_intf_specs.head; l; l = l->next) {
+			struct intf_spec *spec = l->data;
+			struct port_pool *pp = &spec->port_pool;
+			HEADER("{", NULL);
+			METRICsva("address", "\"%s\"", sockaddr_print_buf(&spec->local_address.addr));
+			HEADERl("Socket pool for address '%s':", sockaddr_print_buf(&spec->local_address.addr));
+			METRIC("socketpool", " Socket pairs in pool", "%u", "%u", g_atomic_int_get(&pp->sock_pool_pairs));
+			METRIC("socketpoolhits", " Socket pairs taken from pool", UINT64F, UINT64F, atomic64_get(&pp->sock_pool_hits));
+			METRIC("socketpoolmisses", " Socket pool misses", UINT64F, UINT64F, atomic64_get(&pp->sock_pool_misses));
+			METRIC("socketpoolrefills", " Socket pairs added to pool", UINT64F, UINT64F, atomic64_get(&pp->sock_pool_refills));
+			HEADER("}", NULL);
+		}
+		HEADER("]", NULL);
+	}
+
 	mutex_lock(&rtpe_totalstats.total_average_lock);
 	avg = rtpe_totalstats.total_average_call_dur;
 	num_sessions = rtpe_totalstats.total_managed_sess;
@@ -401,6 +514,11 @@ GQueue *statistics_gather_metrics(void) {
 	METRIC("relayedpacketerrors", "Total relayed packet errors", UINT64F, UINT64F, atomic64_get(&rtpe_totalstats.total_relayed_errors));
 	METRIC("zerowaystreams", "Total number of streams with no relayed packets", UINT64F, UINT64F, atomic64_get(&rtpe_totalstats.total_nopacket_relayed_sess));
 	METRIC("onewaystreams", "Total number of 1-way streams", UINT64F, UINT64F,atomic64_get(&rtpe_totalstats.total_oneway_stream_sess));
+	buffer_pool_stats(&bp_stats);
+	METRIC("bufferpoolhits", "Total packet buffers served from pool", UINT64F, UINT64F, bp_stats.hits);
+	METRIC("bufferpoolexhausted", "Total packet buffers allocated due to empty pool", UINT64F, UINT64F, bp_stats.exhausted);
+	METRIC("codecprocessed", "Total packets processed by codec threads", UINT64F, UINT64F, cw_stats.processed);
+	METRIC("codecdropped", "Total packets dropped due to full codec thread queues", UINT64F, UINT64F, cw_stats.dropped);
 	METRICva("avgcallduration", "Average call duration", "%ld.%06ld", "%ld.%06ld", avg.tv_sec, avg.tv_usec);
 
 	mutex_lock(&rtpe_totalstats_lastinterval_lock);
@@ -572,6 +690,33 @@ GQueue *statistics_gather_metrics(void) {
 	METRICs("totalstatistics", "%u", total.statistics);
 	METRICs("totalerrorcount", "%u", total.errors);
 
+	if (rtpe_control_ng) {
+		struct cookie_cache_stats cc_stats;
+		cookie_cache_stats(&rtpe_control_ng->cookie_cache, &cc_stats);
+		METRIC("cookiecachehits", "Commands answered from the cookie cache", UINT64F, UINT64F, cc_stats.hits);
+		METRIC("cookiecachemisses", "Commands not found in the cookie cache", UINT64F, UINT64F, cc_stats.misses);
+		METRIC("cookiecacheinflight", "Duplicate commands that waited for the first one to finish", UINT64F, UINT64F, cc_stats.in_flight);
+		METRIC("cookiecacheevicted", "Cached replies dropped early due to the size limit", UINT64F, UINT64F, cc_stats.evicted);
+		METRIC("cookiecacheentries", "Cookie cache entries", UINT64F, UINT64F, cc_stats.entries);
+		METRIC("cookiecachebytes", "Cookie cache size", UINT64F, UINT64F " bytes", cc_stats.bytes);
+		if (rtpe_control_ng->pool)
+			METRIC("controlqueue", "Commands waiting for a control thread", "%u", "%u",
+					g_thread_pool_unprocessed(rtpe_control_ng->pool));
+	}
+
+	HEADER("sockets", "");
+	HEADER("[", NULL);
+	HEADERl(" %30s | %12s ", "Socket", "Queued bytes");
+	if (rtpe_control_ng)
+		control_ng_socket_metrics(ret, rtpe_control_ng->udp_listeners,
+				G_N_ELEMENTS(rtpe_control_ng->udp_listeners));
+	HEADER("]", "");
+
+	HEADER("commandtimes", "Command processing times:");
+	HEADER("[", NULL);
+	control_ng_timing_metrics(ret);
+	HEADER("]", "");
+
 	HEADER("}", "");
 	HEADER("}", NULL);
 
@@ -617,6 +762,88 @@ void statistics_init() {
 	rtpe_codec_stats = g_hash_table_new(g_str_hash, g_str_equal);
 }
 
+// rounded up to whole cache lines
+static void *stats_alloc_aligned(size_t size) {
+	void *p;
+	size = (size + STATS_CACHE_LINE - 1) & ~((size_t) STATS_CACHE_LINE - 1);
+	if (posix_memalign(&p, STATS_CACHE_LINE, size))
+		abort();
+	memset(p, 0, size);
+	return p;
+}
+
+struct stats_shard *stats_shard_new(void) {
+	// interfaces are fixed at startup, before any media is handled
+	unsigned int num_intfs = g_queue_get_length(&all_local_interfaces);
+
+	// the owner's counters go in one block, the collector's in another
+	struct stats_shard *s = stats_alloc_aligned(sizeof(*s)
+			+ sizeof(struct stats_counters) * num_intfs);
+	s->num_intfs = num_intfs;
+	s->intf = (void *) (s + 1);
+	s->last = stats_alloc_aligned(sizeof(struct stats_counters) * (num_intfs + 1));
+
+	// shards are never freed as media threads live until shutdown
+	mutex_lock(&stats_shards_lock);
+	g_queue_push_tail(&stats_shards, s);
+	mutex_unlock(&stats_shards_lock);
+
+	rtpe_stats_shard = s;
+	return s;
+}
+
+static void __shard_collect(struct stats_counters *out, const struct stats_counters *cur,
+		struct stats_counters *last)
+{
+#define SC(x) do { \
+		u_int64_t __v = atomic64_get(&cur->x); \
+		atomic64_add_na(&out->x, __v - atomic64_get_na(&last->x)); \
+		atomic64_set_na(&last->x, __v); \
+	} while (0)
+	SC(packets);
+	SC(bytes);
+	SC(errors);
+#undef SC
+}
+
+// called from call_timer() only
+void statistics_collect_shards(long long run_diff) {
+	struct stats_counters global;
+	GList *l, *k;
+	unsigned int idx;
+
+	ZERO(global);
+
+	mutex_lock(&stats_shards_lock);
+	for (l = stats_shards.head; l; l = l->next) {
+		struct stats_shard *s = l->data;
+		__shard_collect(&global, &s->global, &s->last[0]);
+		for (k = all_local_interfaces.head, idx = 0; k && idx < s->num_intfs; k = k->next, idx++) {
+			struct local_intf *lif = k->data;
+			__shard_collect(&lif->stats.interval, &s->intf[idx], &s->last[idx + 1]);
+		}
+	}
+	mutex_unlock(&stats_shards_lock);
+
+	atomic64_add(&rtpe_statsps.packets, atomic64_get_na(&global.packets));
+	atomic64_add(&rtpe_statsps.bytes, atomic64_get_na(&global.bytes));
+	atomic64_add(&rtpe_statsps.errors, atomic64_get_na(&global.errors));
+
+	for (k = all_local_interfaces.head; k; k = k->next) {
+		struct intf_stats *is = &((struct local_intf *) k->data)->stats;
+#define SPS(x) do { \
+		u_int64_t __v = atomic64_get_na(&is->interval.x); \
+		atomic64_set_na(&is->interval.x, 0); \
+		atomic64_add(&is->totals.x, __v); \
+		atomic64_set(&is->ps.x, __v / run_diff); \
+	} while (0)
+		SPS(packets);
+		SPS(bytes);
+		SPS(errors);
+#undef SPS
+	}
+}
+
 const char *statistics_ng(bencode_item_t *input, bencode_item_t *output) {
 	AUTO_CLEANUP_INIT(GQueue *metrics, statistics_free_metrics, statistics_gather_metrics());
 	AUTO_CLEANUP_INIT(GQueue bstack, g_queue_clear, G_QUEUE_INIT);
@@ -2,58 +2,241 @@
 #include "aux.h"
 
 
-static int tt_obj_cmp(const void *a, const void *b) {
-	const struct timerthread_obj *A = a, *B = b;
-	return timeval_cmp_ptr(&A->next_check, &B->next_check);
+#define TT_WHEEL_MASK (TT_WHEEL_SLOTS - 1)
+#define TT_WHEEL_RANGE (1ULL << (TT_WHEEL_BITS * TT_WHEEL_LEVELS))
+// if we fall further behind than this (clock jump), re-sort the wheel instead of walking it
+#define TT_WHEEL_MAX_LAG (TT_WHEEL_SLOTS * TT_WHEEL_SLOTS)
+
+
+INLINE u_int64_t tv_tick(const struct timeval *tv) {
+	return ((u_int64_t) tv->tv_sec * 1000000ULL + tv->tv_usec) >> TT_WHEEL_TICK_SHIFT;
+}
+INLINE void tick_tv(struct timeval *tv, u_int64_t tick) {
+	u_int64_t us = tick << TT_WHEEL_TICK_SHIFT;
+	tv->tv_sec = us / 1000000ULL;
+	tv->tv_usec = us % 1000000ULL;
+}
+
+static void wheel_link(struct timerthread_obj **head, struct timerthread_obj *tt_obj) {
+	tt_obj->wheel_next = *head;
+	if (*head)
+		(*head)->wheel_pprev = &tt_obj->wheel_next;
+	*head = tt_obj;
+	tt_obj->wheel_pprev = head;
+}
+static void wheel_unlink(struct timerthread_obj *tt_obj) {
+	*tt_obj->wheel_pprev = tt_obj->wheel_next;
+	if (tt_obj->wheel_next)
+		tt_obj->wheel_next->wheel_pprev = tt_obj->wheel_pprev;
+	tt_obj->wheel_next = NULL;
+	tt_obj->wheel_pprev = NULL;
+}
+
+// lock must be held
+static void wheel_insert(struct timerthread_thread *t, struct timerthread_obj *tt_obj) {
+	u_int64_t expires = tv_tick(&tt_obj->next_check);
+	if (expires <= t->cur_tick)
+		expires = t->cur_tick + 1;
+	u_int64_t delta = expires - t->cur_tick;
+	if (delta >= TT_WHEEL_RANGE) {
+		// beyond what the wheel covers: park it in the top level, it gets re-inserted
+		// when it comes up as its exact time will still be in the future
+		delta = TT_WHEEL_RANGE - 1;
+		expires = t->cur_tick + delta;
+	}
+
+	unsigned int level = 0;
+	while (delta >= (1ULL << (TT_WHEEL_BITS * (level + 1))))
+		level++;
+
+	wheel_link(&t->slots[level][(expires >> (TT_WHEEL_BITS * level)) & TT_WHEEL_MASK], tt_obj);
+}
+
+// moves all objects from the given list either to the expired list or back into the wheel
+static void wheel_sort(struct timerthread_thread *t, struct timerthread_obj *list, const struct timeval *now) {
+	while (list) {
+		struct timerthread_obj *tt_obj = list;
+		list = list->wheel_next;
+		if (timeval_cmp(&tt_obj->next_check, now) <= 0)
+			wheel_link(&t->expired, tt_obj);
+		else
+			wheel_insert(t, tt_obj);
+	}
+}
+
+static struct timerthread_obj *wheel_take(struct timerthread_obj **slot) {
+	struct timerthread_obj *list = *slot;
+	*slot = NULL;
+	return list;
+}
+
+static void wheel_rebase(struct timerthread_thread *t, u_int64_t now_tick, const struct timeval *now) {
+	struct timerthread_obj *all = NULL;
+
+	for (unsigned int level = 0; level < TT_WHEEL_LEVELS; level++) {
+		for (unsigned int slot = 0; slot < TT_WHEEL_SLOTS; slot++) {
+			struct timerthread_obj *list = wheel_take(&t->slots[level][slot]);
+			while (list) {
+				struct timerthread_obj *tt_obj = list;
+				list = list->wheel_next;
+				wheel_link(&all, tt_obj);
+			}
+		}
+	}
+
+	t->cur_tick = now_tick;
+	wheel_sort(t, all, now);
+}
+
+// lock must be held
+static void wheel_advance(struct timerthread_thread *t, const struct timeval *now) {
+	u_int64_t now_tick = tv_tick(now);
+
+	if (!t->num_objs) {
+		if (now_tick > t->cur_tick)
+			t->cur_tick = now_tick;
+		return;
+	}
+
+	if (now_tick > t->cur_tick + TT_WHEEL_MAX_LAG) {
+		wheel_rebase(t, now_tick, now);
+		return;
+	}
+
+	while (t->cur_tick < now_tick) {
+		u_int64_t tick = ++t->cur_tick;
+
+		// cascade higher levels down when we wrap around
+		for (unsigned int level = 1; level < TT_WHEEL_LEVELS; level++) {
+			if (tick & ((1ULL << (TT_WHEEL_BITS * level)) - 1))
+				break;
+			unsigned int slot = (tick >> (TT_WHEEL_BITS * level)) & TT_WHEEL_MASK;
+			struct timerthread_obj *list = wheel_take(&t->slots[level][slot]);
+			while (list) {
+				struct timerthread_obj *tt_obj = list;
+				list = list->wheel_next;
+				wheel_insert(t, tt_obj);
+			}
+		}
+
+		wheel_sort(t, wheel_take(&t->slots[0][tick & TT_WHEEL_MASK]), now);
+	}
+
+	// the upcoming tick is checked with microsecond precision
+	struct timerthread_obj *tt_obj = t->slots[0][(t->cur_tick + 1) & TT_WHEEL_MASK];
+	while (tt_obj) {
+		struct timerthread_obj *next = tt_obj->wheel_next;
+		if (timeval_cmp(&tt_obj->next_check, now) <= 0) {
+			wheel_unlink(tt_obj);
+			wheel_link(&t->expired, tt_obj);
+		}
+		tt_obj = next;
+	}
 }
 
-void timerthread_init(struct timerthread *tt, void (*func)(void *)) {
-	tt->tree = g_tree_new(tt_obj_cmp);
-	mutex_init(&tt->lock);
-	cond_init(&tt->cond);
+// lock must be held
+static void wheel_next_wake(struct timerthread_thread *t, const struct timeval *now, struct timeval *out) {
+	struct timeval tv;
+
+	*out = *now;
+	if (t->expired)
+		return;
+
+	timeval_add_usec(out, 100000); /* 100 ms at the most */
+	if (!t->num_objs)
+		return;
+
+	for (unsigned int i = 1; i < TT_WHEEL_SLOTS; i++) {
+		struct timerthread_obj *tt_obj = t->slots[0][(t->cur_tick + i) & TT_WHEEL_MASK];
+		if (!tt_obj)
+			continue;
+		// first populated slot: earliest exact time within it
+		for (; tt_obj; tt_obj = tt_obj->wheel_next) {
+			if (timeval_cmp(&tt_obj->next_check, out) < 0)
+				*out = tt_obj->next_check;
+		}
+		return;
+	}
+
+	// nothing in the lowest level: wake up for the next cascade
+	tick_tv(&tv, ((t->cur_tick >> TT_WHEEL_BITS) + 1) << TT_WHEEL_BITS);
+	if (timeval_cmp(&tv, out) < 0)
+		*out = tv;
+}
+
+void timerthread_init(struct timerthread *tt, unsigned int num_threads, void (*func)(void *)) {
+	struct timeval now;
+
+	if (num_threads < 1)
+		num_threads = 1;
+
+	gettimeofday(&now, NULL);
+
+	tt->num_threads = num_threads;
+	tt->threads = g_new0(struct timerthread_thread, num_threads);
+	for (unsigned int i = 0; i < num_threads; i++) {
+		struct timerthread_thread *t = &tt->threads[i];
+		t->tt = tt;
+		mutex_init(&t->lock);
+		cond_init(&t->cond);
+		t->cur_tick = tv_tick(&now);
+	}
 	tt->func = func;
 }
 
+struct timerthread_thread *__timerthread_obj_assign(struct timerthread_obj *tt_obj) {
+	struct timerthread *tt = tt_obj->tt;
+	unsigned int idx = g_atomic_int_add(&tt->next_thread, 1);
+	struct timerthread_thread *t = &tt->threads[idx % tt->num_threads];
+	if (!g_atomic_pointer_compare_and_exchange(&tt_obj->thread, NULL, t))
+		t = g_atomic_pointer_get(&tt_obj->thread);
+	return t;
+}
+
 void timerthread_run(void *p) {
 	struct timerthread *tt = p;
 
-	mutex_lock(&tt->lock);
+	unsigned int idx = g_atomic_int_add(&tt->launched, 1);
+	if (idx >= tt->num_threads)
+		ilog(LOG_WARN, "More timer threads launched than initialised (%u), sharing timer wheels",
+				tt->num_threads);
+	struct timerthread_thread *t = &tt->threads[idx % tt->num_threads];
+
+	mutex_lock(&t->lock);
 
 	while (!rtpe_shutdown) {
 		gettimeofday(&rtpe_now, NULL);
 
-		/* lock our list and get the first element */
-		struct timerthread_obj *tt_obj = g_tree_find_first(tt->tree, NULL, NULL);
-		/* scheduled to run? if not, we just go to sleep, otherwise we remove it from the tree,
+		wheel_advance(t, &rtpe_now);
+
+		/* anything due? if not, we just go to sleep, otherwise we remove it from the wheel,
 		 * steal the reference and run it */
+		struct timerthread_obj *tt_obj = t->expired;
 		if (!tt_obj)
 			goto sleep;
-		if (timeval_cmp(&rtpe_now, &tt_obj->next_check) < 0)
-			goto sleep;
 
 		// steal reference
-		g_tree_remove(tt->tree, tt_obj);
+		wheel_unlink(tt_obj);
+		t->num_objs--;
 		ZERO(tt_obj->next_check);
 		tt_obj->last_run = rtpe_now;
-		mutex_unlock(&tt->lock);
+		mutex_unlock(&t->lock);
 
 		// run and release
 		tt->func(tt_obj);
 		obj_put(tt_obj);
 
-		mutex_lock(&tt->lock);
+		mutex_lock(&t->lock);
 		continue;
 
 sleep:;
 		/* figure out how long we should sleep */
-		long long sleeptime = tt_obj ? timeval_diff(&tt_obj->next_check, &rtpe_now) : 100000;
-		sleeptime = MIN(100000, sleeptime); /* 100 ms at the most */
-		struct timeval tv = rtpe_now;
-		timeval_add_usec(&tv, sleeptime);
-		cond_timedwait(&tt->cond, &tt->lock, &tv);
+		wheel_next_wake(t, &rtpe_now, &t->sleep_until);
+		cond_timedwait(&t->cond, &t->lock, &t->sleep_until);
+		ZERO(t->sleep_until);
 	}
 
-	mutex_unlock(&tt->lock);
+	mutex_unlock(&t->lock);
 }
 
 void timerthread_obj_schedule_abs_nl(struct timerthread_obj *tt_obj, const struct timeval *tv) {
@@ -63,30 +246,41 @@ void timerthread_obj_schedule_abs_nl(struct timerthread_obj *tt_obj, const struc
 	ilog(LOG_DEBUG, "scheduling timer object at %llu.%06lu", (unsigned long long) tv->tv_sec,
 			(unsigned long) tv->tv_usec);
 
-	struct timerthread *tt = tt_obj->tt;
+	struct timerthread_thread *t = timerthread_obj_thread(tt_obj);
 	if (tt_obj->next_check.tv_sec && timeval_cmp(&tt_obj->next_check, tv) <= 0)
 		return; /* already scheduled sooner */
-	if (!g_tree_remove(tt->tree, tt_obj))
-		obj_hold(tt_obj); /* if it wasn't removed, we make a new reference */
+	if (tt_obj->wheel_pprev)
+		wheel_unlink(tt_obj);
+	else {
+		obj_hold(tt_obj); /* if it wasn't scheduled, we make a new reference */
+		t->num_objs++;
+	}
 	tt_obj->next_check = *tv;
-	g_tree_insert(tt->tree, tt_obj, tt_obj);
-	cond_broadcast(&tt->cond);
+	wheel_insert(t, tt_obj);
+	// wake up the thread if it's sleeping past this
+	if (t->sleep_until.tv_sec && timeval_cmp(tv, &t->sleep_until) < 0)
+		cond_broadcast(&t->cond);
 }
 
 void timerthread_obj_deschedule(struct timerthread_obj *tt_obj) {
 	if (!tt_obj)
 		return;
 
-	struct timerthread *tt = tt_obj->tt;
-	mutex_lock(&tt->lock);
-	if (!tt_obj->next_check.tv_sec)
-		goto nope; /* already descheduled */
-	int ret = g_tree_remove(tt->tree, tt_obj);
+	struct timerthread_thread *t = g_atomic_pointer_get(&tt_obj->thread);
+	if (!t)
+		return; /* never scheduled */
+
+	mutex_lock(&t->lock);
+	if (!tt_obj->wheel_pprev) {
+		mutex_unlock(&t->lock);
+		return; /* already descheduled */
+	}
+	wheel_unlink(tt_obj);
+	t->num_objs--;
 	ZERO(tt_obj->next_check);
-	if (ret)
-		obj_put(tt_obj);
-nope:
-	mutex_unlock(&tt->lock);
+	mutex_unlock(&t->lock);
+
+	obj_put(tt_obj);
 }
 
 static int timerthread_queue_run_one(struct timerthread_queue *ttq,
@@ -100,6 +294,92 @@ static int timerthread_queue_run_one(struct timerthread_queue *ttq,
 	return 0;
 }
 
+INLINE u_int64_t ttq_tick(const struct timeval *tv) {
+	return ((u_int64_t) tv->tv_sec * 1000000ULL + tv->tv_usec) / TTQ_TICK_US;
+}
+
+// ttq->lock must be held. Entries are mostly pushed in order, so within their slot
+// we look for the insert position from the back.
+static void ttq_insert(struct timerthread_queue *ttq, struct timerthread_queue_entry *ttqe) {
+	u_int64_t tick = ttq_tick(&ttqe->when);
+	GQueue *q = &ttq->slots[tick % TTQ_SLOTS];
+	GList *link = &ttqe->link;
+	GList *l;
+
+	link->data = ttqe;
+
+	if (!ttq->num_entries || tick < ttq->cur_tick)
+		ttq->cur_tick = tick;
+	ttq->num_entries++;
+
+	for (l = q->tail; l; l = l->prev) {
+		struct timerthread_queue_entry *e = l->data;
+		if (timeval_cmp(&e->when, &ttqe->when) <= 0)
+			break;
+	}
+
+	// insert after `l`
+	if (!l) {
+		g_queue_push_head_link(q, link);
+		return;
+	}
+	if (!l->next) {
+		g_queue_push_tail_link(q, link);
+		return;
+	}
+	link->prev = l;
+	link->next = l->next;
+	l->next->prev = link;
+	l->next = link;
+	q->length++;
+}
+
+// ttq->lock must be held. Returns the earliest entry without removing it.
+static struct timerthread_queue_entry *ttq_first(struct timerthread_queue *ttq) {
+	if (!ttq->num_entries)
+		return NULL;
+
+	// each slot is ordered, so the first head that's due in the tick we're
+	// looking at is the earliest entry
+	for (unsigned int i = 0; i < TTQ_SLOTS; i++) {
+		u_int64_t tick = ttq->cur_tick + i;
+		GList *l = ttq->slots[tick % TTQ_SLOTS].head;
+		if (!l)
+			continue;
+		struct timerthread_queue_entry *e = l->data;
+		if (ttq_tick(&e->when) > tick)
+			continue; // a later round
+		ttq->cur_tick = tick;
+		return e;
+	}
+
+	// nothing within one round: compare all slot heads
+	struct timerthread_queue_entry *first = NULL;
+	for (unsigned int i = 0; i < TTQ_SLOTS; i++) {
+		GList *l = ttq->slots[i].head;
+		if (!l)
+			continue;
+		struct timerthread_queue_entry *e = l->data;
+		if (!first || timeval_cmp(&e->when, &first->when) < 0)
+			first = e;
+	}
+	ttq->cur_tick = ttq_tick(&first->when);
+	return first;
+}
+
+// ttq->lock must be held
+static void ttq_unlink(struct timerthread_queue *ttq, struct timerthread_queue_entry *ttqe) {
+	g_queue_unlink(&ttq->slots[ttq_tick(&ttqe->when) % TTQ_SLOTS], &ttqe->link);
+	ttq->num_entries--;
+}
+
+// ttq->lock must be held
+static struct timerthread_queue_entry *ttq_pop(struct timerthread_queue *ttq) {
+	struct timerthread_queue_entry *ttqe = ttq_first(ttq);
+	if (ttqe)
+		ttq_unlink(ttq, ttqe);
+	return ttqe;
+}
 
 void timerthread_queue_run(void *ptr) {
 	struct timerthread_queue *ttq = ptr;
@@ -110,11 +390,8 @@ void timerthread_queue_run(void *ptr) {
 
 	mutex_lock(&ttq->lock);
 
-	while (g_tree_nnodes(ttq->entries)) {
-		struct timerthread_queue_entry *ttqe = g_tree_find_first(ttq->entries, NULL, NULL);
-		assert(ttqe != NULL);
-		g_tree_remove(ttq->entries, ttqe);
-
+	struct timerthread_queue_entry *ttqe;
+	while ((ttqe = ttq_pop(ttq))) {
 		mutex_unlock(&ttq->lock);
 
 		int ret = timerthread_queue_run_one(ttq, ttqe, ttq->run_later_func);
@@ -124,7 +401,7 @@ void timerthread_queue_run(void *ptr) {
 		if (!ret)
 			continue;
 		// couldn't send the last one. remember time to schedule
-		g_tree_insert(ttq->entries, ttqe, ttqe);
+		ttq_insert(ttq, ttqe);
 		next_send = ttqe->when;
 		break;
 	}
@@ -135,27 +412,18 @@ void timerthread_queue_run(void *ptr) {
 		timerthread_obj_schedule_abs(&ttq->tt_obj, &next_send);
 }
 
-static int ttqe_free_all(void *k, void *v, void *d) {
-	struct timerthread_queue *ttq = d;
-	ttq->entry_free_func(k);
-	return FALSE;
-}
-
 static void __timerthread_queue_free(void *p) {
 	struct timerthread_queue *ttq = p;
-	g_tree_foreach(ttq->entries, ttqe_free_all, ttq);
-	g_tree_destroy(ttq->entries);
+	GList *link;
+	for (unsigned int i = 0; i < TTQ_SLOTS; i++) {
+		while ((link = g_queue_pop_head_link(&ttq->slots[i])))
+			ttq->entry_free_func(link->data);
+	}
 	mutex_destroy(&ttq->lock);
 	if (ttq->free_func)
 		ttq->free_func(p);
 }
 
-static int ttqe_compare(const void *a, const void *b) {
-	const struct timerthread_queue_entry *t1 = a;
-	const struct timerthread_queue_entry *t2 = b;
-	return timeval_cmp_ptr(&t1->when, &t2->when);
-}
- 
 void *timerthread_queue_new(const char *type, size_t size,
 		struct timerthread *tt,
 		void (*run_now_func)(struct timerthread_queue *, void *),
@@ -174,7 +442,6 @@ void *timerthread_queue_new(const char *type, size_t size,
 	ttq->free_func = free_func;
 	ttq->entry_free_func = entry_free_func;
 	mutex_init(&ttq->lock);
-	ttq->entries = g_tree_new(ttqe_compare);
 	return ttq;
 }
 
@@ -201,19 +468,15 @@ void timerthread_queue_push(struct timerthread_queue *ttq, struct timerthread_qu
 	mutex_lock(&ttq->lock);
 	// this hands over ownership of cp, so we must copy the timeval out
 	struct timeval tv_send = ttqe->when;
-	g_tree_insert(ttq->entries, ttqe, ttqe);
-	struct timerthread_queue_entry *first_ttqe = g_tree_find_first(ttq->entries, NULL, NULL);
+	ttq_insert(ttq, ttqe);
+	int first = (ttq_first(ttq) == ttqe);
 	mutex_unlock(&ttq->lock);
 
 	// first packet in? we're probably not scheduled yet
-	if (first_ttqe == ttqe)
+	if (first)
 		timerthread_obj_schedule_abs(&ttq->tt_obj, &tv_send);
 }
 
-static int ttqe_ptr_match(const void *ent, const void *ptr) {
-	const struct timerthread_queue_entry *ttqe = ent;
-	return ttqe->source == ptr;
-}
 unsigned int timerthread_queue_flush(struct timerthread_queue *ttq, void *ptr) {
 	if (!ttq)
 		return 0;
@@ -221,14 +484,19 @@ unsigned int timerthread_queue_flush(struct timerthread_queue *ttq, void *ptr) {
 	mutex_lock(&ttq->lock);
 
 	unsigned int num = 0;
-	GQueue matches = G_QUEUE_INIT;
-	g_tree_find_all(&matches, ttq->entries, ttqe_ptr_match, ptr);
-
-	while (matches.length) {
-		struct timerthread_queue_entry *ttqe = g_queue_pop_head(&matches);
-		g_tree_remove(ttq->entries, ttqe);
-		ttq->entry_free_func(ttqe);
-		num++;
+
+	for (unsigned int i = 0; i < TTQ_SLOTS; i++) {
+		GList *l = ttq->slots[i].head;
+		while (l) {
+			GList *next = l->next;
+			struct timerthread_queue_entry *ttqe = l->data;
+			if (ttqe->source == ptr) {
+				ttq_unlink(ttq, ttqe);
+				ttq->entry_free_func(ttqe);
+				num++;
+			}
+			l = next;
+		}
 	}
 
 	mutex_unlock(&ttq->lock);
@@ -242,11 +510,8 @@ void timerthread_queue_flush_data(void *ptr) {
         ilog(LOG_DEBUG, "timerthread_queue_flush_data");
 
         mutex_lock(&ttq->lock);
-        while (g_tree_nnodes(ttq->entries)) {
-                struct timerthread_queue_entry *ttqe = g_tree_find_first(ttq->entries, NULL, NULL);
-                assert(ttqe != NULL);
-                g_tree_remove(ttq->entries, ttqe);
-
+        struct timerthread_queue_entry *ttqe;
+        while ((ttqe = ttq_pop(ttq))) {
                 mutex_unlock(&ttq->lock);
 
                 ttq->run_later_func(ttq, ttqe);
@@ -0,0 +1,409 @@
+#include "uring.h"
+#include <glib.h>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include "aux.h"
+#include "log.h"
+#include "main.h"
+#include "obj.h"
+#include "call.h"
+#include "media_socket.h"
+#include "buffer_pool.h"
+
+#ifdef HAVE_LIBURING
+
+#include <liburing.h>
+
+
+#define URING_ENTRIES 1024
+#define URING_NUM_BUFS 256 // must be a power of two
+#define URING_BGID 1
+#define URING_NAME_LEN 32 // sizeof(struct sockaddr_in6), rounded up to keep the cmsg aligned
+#define URING_CTRL_LEN 64
+// header, source address and control data go into the head room of a pool buffer,
+// so that the payload ends up where packet_buf_data() expects it
+#define URING_HDR_LEN (sizeof(struct io_uring_recvmsg_out) + URING_NAME_LEN + URING_CTRL_LEN)
+#define URING_BUF_LEN (URING_HDR_LEN + MAX_RTP_PACKET_SIZE)
+
+
+struct uring {
+	struct io_uring ring;
+	mutex_t lock; // protects the submission queue
+	struct io_uring_buf_ring *br;
+	struct packet_buf *bufs[URING_NUM_BUFS]; // indexed by buffer ID
+	struct msghdr msg; // template for multishot recvmsg
+};
+
+
+static struct uring **urings;
+static unsigned int num_urings;
+
+
+INLINE char *uring_buf(struct uring *u, unsigned int bid) {
+	return packet_buf_data(u->bufs[bid]) - URING_HDR_LEN;
+}
+
+INLINE void uring_buf_add(struct uring *u, unsigned int bid, unsigned int offset) {
+	io_uring_buf_ring_add(u->br, uring_buf(u, bid), URING_BUF_LEN, bid,
+			io_uring_buf_ring_mask(URING_NUM_BUFS), offset);
+}
+
+static void uring_bufs_init(struct uring *u) {
+	G_STATIC_ASSERT(URING_HDR_LEN <= RTP_BUFFER_HEAD_ROOM);
+
+	for (unsigned int i = 0; i < URING_NUM_BUFS; i++) {
+		u->bufs[i] = packet_buf_new();
+		uring_buf_add(u, i, i);
+	}
+	io_uring_buf_ring_advance(u->br, URING_NUM_BUFS);
+}
+
+// u->lock must be held. If the SQ is full, flushes it and retries
+static struct io_uring_sqe *__uring_get_sqe(struct uring *u) {
+	struct io_uring_sqe *sqe = io_uring_get_sqe(&u->ring);
+	if (G_LIKELY(sqe))
+		return sqe;
+	io_uring_submit(&u->ring);
+	return io_uring_get_sqe(&u->ring);
+}
+
+// u->lock must be held
+static int __uring_arm(struct uring *u, int fd, void *data) {
+	struct io_uring_sqe *sqe = __uring_get_sqe(u);
+	if (!sqe)
+		return -1;
+	io_uring_prep_recvmsg_multishot(sqe, fd, &u->msg, 0);
+	sqe->flags |= IOSQE_BUFFER_SELECT;
+	sqe->buf_group = URING_BGID;
+	io_uring_sqe_set_data(sqe, data);
+	return 0;
+}
+
+// hands the buffer used by a completion back to the kernel, outside of the main loop
+static void uring_buf_return(struct uring *u, struct io_uring_cqe *cqe) {
+	if (!(cqe->flags & IORING_CQE_F_BUFFER))
+		return;
+	uring_buf_add(u, cqe->flags >> IORING_CQE_BUFFER_SHIFT, 0);
+	io_uring_buf_ring_advance(u->br, 1);
+}
+
+// multishot recvmsg with provided buffers needs kernel 6.0. try it out on a socket pair
+static int uring_probe(struct uring *u) {
+	int fds[2];
+	int ret = -1, active = 0, done;
+	struct io_uring_cqe *cqe;
+	struct io_uring_sqe *sqe;
+	static char probe_tag;
+
+	if (socketpair(AF_UNIX, SOCK_DGRAM, 0, fds))
+		return -1;
+
+	if (__uring_arm(u, fds[0], &probe_tag))
+		goto out;
+	if (io_uring_submit(&u->ring) != 1)
+		goto out;
+	active = 1;
+	if (send(fds[1], "", 1, 0) != 1)
+		goto out;
+	if (io_uring_wait_cqe(&u->ring, &cqe))
+		goto out;
+
+	if (cqe->res >= 0 && (cqe->flags & IORING_CQE_F_BUFFER) && (cqe->flags & IORING_CQE_F_MORE))
+		ret = 0;
+	if (!(cqe->flags & IORING_CQE_F_MORE))
+		active = 0;
+	uring_buf_return(u, cqe);
+	io_uring_cqe_seen(&u->ring, cqe);
+
+out:
+	if (active) {
+		// cancel the probe request and wait for it to terminate
+		sqe = __uring_get_sqe(u);
+		if (!sqe) {
+			// can't happen with an otherwise idle ring, but don't wait forever
+			ret = -1;
+			goto close;
+		}
+		io_uring_prep_cancel(sqe, &probe_tag, 0);
+		io_uring_sqe_set_data(sqe, NULL);
+		io_uring_submit(&u->ring);
+		while (!io_uring_wait_cqe(&u->ring, &cqe)) {
+			done = (io_uring_cqe_get_data(cqe) == &probe_tag
+					&& !(cqe->flags & IORING_CQE_F_MORE));
+			uring_buf_return(u, cqe);
+			io_uring_cqe_seen(&u->ring, cqe);
+			if (done)
+				break;
+		}
+	}
+
+close:
+	close(fds[0]);
+	close(fds[1]);
+
+	return ret;
+}
+
+static void uring_free(struct uring *u) {
+	if (u->br)
+		io_uring_free_buf_ring(&u->ring, u->br, URING_NUM_BUFS, URING_BGID);
+	io_uring_queue_exit(&u->ring);
+	for (unsigned int i = 0; i < URING_NUM_BUFS; i++)
+		packet_buf_put(u->bufs[i]);
+	mutex_destroy(&u->lock);
+	g_slice_free1(sizeof(*u), u);
+}
+
+static struct uring *uring_new(void) {
+	struct uring *u;
+	struct io_uring_params params;
+	int ret;
+
+	u = g_slice_alloc0(sizeof(*u));
+	mutex_init(&u->lock);
+
+	ZERO(params);
+	ret = io_uring_queue_init_params(URING_ENTRIES, &u->ring, &params);
+	if (ret) {
+		ilog(LOG_WARN, "Failed to create io_uring: %s", strerror(-ret));
+		mutex_destroy(&u->lock);
+		g_slice_free1(sizeof(*u), u);
+		return NULL;
+	}
+	// we need to wait for completions without touching the submission queue
+	if (!(params.features & IORING_FEAT_EXT_ARG)) {
+		ilog(LOG_WARN, "Kernel io_uring doesn't support extended arguments");
+		goto err;
+	}
+
+	u->br = io_uring_setup_buf_ring(&u->ring, URING_NUM_BUFS, URING_BGID, 0, &ret);
+	if (!u->br) {
+		ilog(LOG_WARN, "Failed to set up io_uring provided buffer ring: %s", strerror(-ret));
+		goto err;
+	}
+	uring_bufs_init(u);
+
+	u->msg.msg_namelen = URING_NAME_LEN;
+	u->msg.msg_controllen = URING_CTRL_LEN;
+
+	if (uring_probe(u)) {
+		ilog(LOG_WARN, "Kernel io_uring doesn't support multishot receive with provided buffers");
+		goto err;
+	}
+
+	return u;
+
+err:
+	uring_free(u);
+	return NULL;
+}
+
+
+int uring_init(void) {
+	if (!rtpe_config.io_uring_threads)
+		return 0;
+
+	urings = g_malloc0(sizeof(*urings) * rtpe_config.io_uring_threads);
+
+	for (num_urings = 0; num_urings < rtpe_config.io_uring_threads; num_urings++) {
+		urings[num_urings] = uring_new();
+		if (!urings[num_urings])
+			goto fallback;
+	}
+
+	ilog(LOG_INFO, "Using io_uring for media sockets with %u threads", num_urings);
+	return 0;
+
+fallback:
+	ilog(LOG_WARN, "io_uring is not available, falling back to epoll for media sockets");
+	while (num_urings)
+		uring_free(urings[--num_urings]);
+	g_free(urings);
+	urings = NULL;
+	rtpe_config.io_uring_threads = 0;
+	return -1;
+}
+
+struct uring *uring_get(void) {
+	static volatile int rr;
+
+	if (!num_urings)
+		return NULL;
+
+	unsigned int idx = g_atomic_int_add(&rr, 1);
+	return urings[idx % num_urings];
+}
+
+
+int uring_add_sfd(struct uring *u, struct stream_fd *sfd) {
+	int ret;
+
+	mutex_lock(&u->lock);
+	ret = __uring_arm(u, sfd->socket.fd, sfd);
+	if (!ret) {
+		sfd->uring = u;
+		obj_hold(sfd); // released when the multishot request terminates
+		io_uring_submit(&u->ring);
+	}
+	mutex_unlock(&u->lock);
+
+	return ret;
+}
+
+void uring_del_sfd(struct stream_fd *sfd) {
+	struct uring *u = sfd->uring;
+	struct io_uring_sqe *sqe;
+
+	mutex_lock(&u->lock);
+	sfd->uring_closed = 1;
+	sqe = __uring_get_sqe(u);
+	// if this fails, the recv request is still cleaned up after the next packet or error
+	if (sqe) {
+		io_uring_prep_cancel(sqe, sfd, 0);
+		io_uring_sqe_set_data(sqe, NULL);
+		io_uring_submit(&u->ring);
+	}
+	mutex_unlock(&u->lock);
+}
+
+
+static void uring_packet(struct uring *u, struct stream_fd *sfd, struct packet_buf *pb, char *buf, int len) {
+	struct io_uring_recvmsg_out *out;
+	struct cmsghdr *cm;
+	struct timeval tv;
+	endpoint_t fsin;
+
+	out = io_uring_recvmsg_validate(buf, len, &u->msg);
+	if (!out)
+		return;
+
+	sfd->socket.family->sockaddr2endpoint(&fsin, io_uring_recvmsg_name(out));
+
+	ZERO(tv);
+	for (cm = io_uring_recvmsg_cmsg_firsthdr(out, &u->msg); cm;
+			cm = io_uring_recvmsg_cmsg_nexthdr(out, &u->msg, cm))
+	{
+		if (cm->cmsg_level == SOL_SOCKET && cm->cmsg_type == SO_TIMESTAMP) {
+			tv = *((struct timeval *) CMSG_DATA(cm));
+			break;
+		}
+	}
+	if (G_UNLIKELY((out->flags & MSG_TRUNC)))
+		ilog(LOG_WARNING, "Kernel indicates that data was truncated");
+
+	stream_fd_recv_packet(sfd, pb, io_uring_recvmsg_payload(out, &u->msg),
+			io_uring_recvmsg_payload_length(out, len, &u->msg), &fsin, &tv);
+}
+
+// returns the number of buffers handed back to the kernel
+static unsigned int uring_cqe(struct uring *u, struct io_uring_cqe *cqe, unsigned int buf_offset) {
+	struct stream_fd *sfd = io_uring_cqe_get_data(cqe);
+	unsigned int ret = 0;
+
+	if (!sfd)
+		return 0; // completion of a cancel request
+
+	if ((cqe->flags & IORING_CQE_F_BUFFER)) {
+		unsigned int bid = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+		struct packet_buf *pb = u->bufs[bid];
+		if (cqe->res >= 0 && !sfd->uring_closed)
+			uring_packet(u, sfd, pb, uring_buf(u, bid), cqe->res);
+		// anything that wants to keep the packet has taken its own reference,
+		// in which case the kernel gets a fresh buffer
+		if (g_atomic_int_get(&pb->ref) != 1) {
+			packet_buf_put(pb);
+			u->bufs[bid] = packet_buf_new();
+		}
+		uring_buf_add(u, bid, buf_offset);
+		ret = 1;
+	}
+
+	if ((cqe->flags & IORING_CQE_F_MORE))
+		return ret;
+
+	// multishot request has terminated
+	if (cqe->res < 0 && cqe->res != -ENOBUFS && cqe->res != -ECANCELED && !sfd->uring_closed)
+		stream_fd_recv_error(sfd, -cqe->res);
+
+	mutex_lock(&u->lock);
+	if (sfd->uring_closed || __uring_arm(u, sfd->socket.fd, sfd)) {
+		mutex_unlock(&u->lock);
+		obj_put(sfd);
+		return ret;
+	}
+	mutex_unlock(&u->lock);
+
+	return ret;
+}
+
+static void uring_loop(void *p) {
+	struct uring *u = p;
+	struct io_uring_cqe *cqe;
+	struct __kernel_timespec ts;
+	unsigned int head, num, bufs;
+	int ret;
+
+	while (!rtpe_shutdown) {
+		ts.tv_sec = 0;
+		ts.tv_nsec = 100000000;
+		ret = io_uring_wait_cqe_timeout(&u->ring, &cqe, &ts);
+		if (ret == -ETIME || ret == -EINTR)
+			continue;
+		if (ret < 0) {
+			ilog(LOG_ERR, "Failed to wait for io_uring completion: %s", strerror(-ret));
+			usleep(100000);
+			continue;
+		}
+
+		gettimeofday(&rtpe_now, NULL);
+		media_socket_sendq_begin();
+
+		num = bufs = 0;
+		io_uring_for_each_cqe(&u->ring, head, cqe) {
+			bufs += uring_cqe(u, cqe, bufs);
+			num++;
+		}
+		io_uring_cq_advance(&u->ring, num);
+		if (bufs)
+			io_uring_buf_ring_advance(u->br, bufs);
+
+		media_socket_sendq_end();
+
+		// submit re-armed receive requests
+		mutex_lock(&u->lock);
+		io_uring_submit(&u->ring);
+		mutex_unlock(&u->lock);
+	}
+}
+
+void uring_launch(void) {
+	for (unsigned int i = 0; i < num_urings; i++)
+		thread_create_detach_prio(uring_loop, urings[i], rtpe_config.scheduling, rtpe_config.priority);
+}
+
+
+#else
+
+
+int uring_init(void) {
+	if (!rtpe_config.io_uring_threads)
+		return 0;
+	ilog(LOG_WARN, "Support for io_uring not compiled in, falling back to epoll for media sockets");
+	rtpe_config.io_uring_threads = 0;
+	return -1;
+}
+void uring_launch(void) {
+}
+struct uring *uring_get(void) {
+	return NULL;
+}
+int uring_add_sfd(struct uring *u, struct stream_fd *sfd) {
+	return -1;
+}
+void uring_del_sfd(struct stream_fd *sfd) {
+}
+
+
+#endif
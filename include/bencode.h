@@ -71,6 +71,13 @@ void *bencode_buffer_alloc(bencode_buffer_t *, unsigned int);
  * and all objects created through it become invalid. */
 void bencode_buffer_free(bencode_buffer_t *buf);
 
+/* Makes all objects created through a bencode_buffer_t object invalid, as bencode_buffer_free() does,
+ * but keeps memory around for the next use of the same object. If more than one piece of memory was
+ * needed, they're replaced by a single piece large enough for all of it, so that a buffer used
+ * repeatedly for similar data stops allocating after the first use.
+ * Returns 0 on success or -1 on failure, in which case the object must be initialized again. */
+int bencode_buffer_reset(bencode_buffer_t *buf);
+
 /* Creates a new empty dictionary object. Memory will be allocated from the bencode_buffer_t object.
  * Returns NULL if no memory could be allocated. */
 bencode_item_t *bencode_dictionary(bencode_buffer_t *buf);
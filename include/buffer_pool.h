@@ -0,0 +1,53 @@
+#ifndef _BUFFER_POOL_H_
+#define _BUFFER_POOL_H_
+
+#include <glib.h>
+#include "aux.h"
+#include "call.h"
+
+// idle buffers kept per thread, the rest is freed
+#define BUFFER_POOL_MAX_FREE 256
+
+struct buffer_pool;
+
+// Fixed-size packet buffer with RTP_BUFFER_HEAD_ROOM and RTP_BUFFER_TAIL_ROOM around
+// MAX_RTP_PACKET_SIZE bytes of packet data. Buffers come from a per-thread pool and
+// are reference counted, so that the jitter buffer, the send timer, codec passthrough
+// and recording can hold on to a received packet without making a copy. The last
+// reference returns the buffer to the pool of the thread that allocated it.
+struct packet_buf {
+	volatile gint ref;
+	struct buffer_pool *pool;
+	struct packet_buf *next;
+	char buf[RTP_BUFFER_SIZE];
+};
+
+struct buffer_pool_stats {
+	u_int64_t hits; // served from a pool
+	u_int64_t exhausted; // pool was empty, newly allocated
+};
+
+struct packet_buf *packet_buf_new(void);
+void packet_buf_put(struct packet_buf *);
+void buffer_pool_stats(struct buffer_pool_stats *);
+
+INLINE struct packet_buf *packet_buf_get(struct packet_buf *pb) {
+	g_atomic_int_inc(&pb->ref);
+	return pb;
+}
+// start of packet data, after the head room
+INLINE char *packet_buf_data(struct packet_buf *pb) {
+	return pb->buf + RTP_BUFFER_HEAD_ROOM;
+}
+// whether the given packet data lies within the buffer
+INLINE int packet_buf_contains(const struct packet_buf *pb, const str *s) {
+	return s->s >= pb->buf && s->s + s->len <= pb->buf + sizeof(pb->buf);
+}
+// how many bytes are available in front of the given packet data
+INLINE unsigned int packet_buf_head_room(const struct packet_buf *pb, const str *s) {
+	if (!packet_buf_contains(pb, s))
+		return 0;
+	return s->s - pb->buf;
+}
+
+#endif
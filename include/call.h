@@ -73,6 +73,8 @@ enum call_type {
 #define RTP_BUFFER_TAIL_ROOM	512
 #define RTP_BUFFER_SIZE		(MAX_RTP_PACKET_SIZE + RTP_BUFFER_HEAD_ROOM + RTP_BUFFER_TAIL_ROOM)
 
+#define CALL_SWEEP_TICKS	10 /* per second, for each call timer sweep thread */
+
 #ifndef RTP_LOOP_PROTECT
 #define RTP_LOOP_PROTECT	28 /* number of bytes */
 #define RTP_LOOP_PACKETS	2  /* number of packets */
@@ -275,9 +277,10 @@ struct packet_stream {
 
 	struct stats		stats;
 	struct stats		kernel_stats;
+	unsigned int		kernel_stats_idx; /* slot in kernel stats area, LOCK: in_lock */
 	atomic64		last_packet;
-	GHashTable		*rtp_stats;	/* LOCK: call->master_lock */
-	struct rtp_stats	*rtp_stats_cache;
+	struct rtp_stats	*rtp_stats[RTP_STATS_PT_SLOTS]; /* indexed by PT, set under call->master_lock,
+							   read without; entries are never removed */
 
 #if RTP_LOOP_PROTECT
 	/* LOCK: in_lock: */
@@ -372,6 +375,9 @@ struct call {
 
 	mutex_t			buffer_lock;
 	call_buffer_t		buffer;
+	GList			sweep_link; /* protected by the lock of the call's sweep list */
+	unsigned int		sweep_round; /* last sweep round that visited this call, same lock */
+	volatile int		unlinked; /* removed from the call hash by call_destroy() */
 
 	/* everything below protected by master_lock */
 	rwlock_t		master_lock;
@@ -385,6 +391,8 @@ struct call {
 	GQueue			endpoint_maps;
 	struct dtls_cert	*dtls_cert; /* for outgoing */
 	struct ssrc_hash	*ssrc_hash;
+	struct poller		*poller; /* RO, handles all stream_fds of this call */
+	struct uring		*uring; /* RO, ditto if io_uring is in use */
 
 	str			callid;
 	struct timeval		created;
@@ -411,15 +419,16 @@ struct call {
 
 
 
-extern rwlock_t rtpe_callhash_lock;
-extern GHashTable *rtpe_callhash;
-
 extern struct stats rtpe_statsps;	/* per second stats, running timer */
 extern struct stats rtpe_stats;		/* copied from statsps once a second */
+extern struct call_sweep_stats rtpe_sweep_stats;
 
 
 int call_init(void);
+void call_timer_loop(void *);
+// takes a reference to each call
 void call_get_all_calls(GQueue *q);
+unsigned int call_num_calls(void);
 
 struct call_monologue *__monologue_create(struct call *call);
 void __monologue_tag(struct call_monologue *ml, const str *tag);
@@ -448,7 +457,7 @@ int call_stream_address46(char *o, struct packet_stream *ps, enum stream_address
 void add_total_calls_duration_in_interval(struct timeval *interval_tv);
 
 void payload_type_free(struct rtp_payload_type *p);
-void __rtp_stats_update(GHashTable *dst, GHashTable *src);
+void __rtp_stats_update(struct rtp_stats **dst, GHashTable *src);
 
 const struct rtp_payload_type *__rtp_stats_codec(struct call_media *m);
 
@@ -511,6 +520,11 @@ INLINE struct packet_stream *packet_stream_sink(struct packet_stream *ps) {
 		ret = ps->rtcp_sink;
 	return ret;
 }
+INLINE struct rtp_stats *rtp_stats_get(struct packet_stream *ps, unsigned int payload_type) {
+	if (G_UNLIKELY(payload_type >= RTP_STATS_PT_SLOTS))
+		return NULL;
+	return g_atomic_pointer_get(&ps->rtp_stats[payload_type]);
+}
 INLINE void __call_unkernelize(struct call *call) {
 	for (GList *l = call->monologues.head; l; l = l->next) {
 		struct call_monologue *ml = l->data;
@@ -19,6 +19,8 @@ struct sdp_ng_flags;
 struct codec_ssrc_handler;
 struct rtp_header;
 struct stream_params;
+struct packet_buf;
+struct poller;
 
 
 typedef int codec_handler_func(struct codec_handler *, struct media_packet *);
@@ -56,6 +58,7 @@ struct codec_packet {
 	unsigned long ts;
 	struct ssrc_ctx *ssrc_out;
 	void (*free_func)(void *);
+	struct packet_buf *buf; // referenced if set
 };
 
 
@@ -93,11 +96,16 @@ uint64_t codec_encoder_pts(struct codec_ssrc_handler *ch);
 void codec_decoder_skip_pts(struct codec_ssrc_handler *ch, uint64_t);
 uint64_t codec_decoder_unskip_pts(struct codec_ssrc_handler *ch);
 
+void codec_pool_timer(struct poller *);
+void codec_pool_free(void);
+
 #else
 
 INLINE void codec_handlers_update(struct call_media *receiver, struct call_media *sink,
 		const struct sdp_ng_flags *flags, const struct stream_params *sp) { }
 INLINE void codec_handler_free(struct codec_handler **handler) { }
+INLINE void codec_pool_timer(struct poller *p) { }
+INLINE void codec_pool_free(void) { }
 
 #endif
 
@@ -0,0 +1,31 @@
+#ifndef _CODEC_WORKER_H_
+#define _CODEC_WORKER_H_
+
+#include <glib.h>
+#include "aux.h"
+
+struct media_packet;
+
+struct codec_worker_stats {
+	u_int64_t queued; // packets currently waiting in all queues
+	u_int64_t processed;
+	u_int64_t dropped; // queue was full
+};
+
+// Optional pool of threads doing the transcoding work for received RTP packets, so that
+// the media poller threads can go on forwarding packets of other calls. Packets of one
+// SSRC always go to the same thread and so are processed in the order they were received.
+
+void codec_workers_init(void);
+void codec_worker_loop(void *);
+
+// Called by codec handlers instead of transcoding. Returns 1 and marks the packet if it's
+// to be processed by a codec thread, or 0 if transcoding should be done inline. A marked
+// packet is handed over through codec_worker_push() once it has passed the same checks
+// as any packet that is forwarded, or discarded if it doesn't.
+int codec_worker_defer(struct media_packet *mp);
+// Takes over the received packet for later processing.
+void codec_worker_push(struct media_packet *mp);
+void codec_worker_stats(struct codec_worker_stats *);
+
+#endif
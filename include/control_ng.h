@@ -32,13 +32,45 @@ struct control_ng_stats {
 	int errors;
 };
 
+enum ng_command {
+	NGC_PING = 0,
+	NGC_OFFER,
+	NGC_ANSWER,
+	NGC_DELETE,
+	NGC_QUERY,
+	NGC_LIST,
+	NGC_START_RECORDING,
+	NGC_STOP_RECORDING,
+	NGC_START_FORWARDING,
+	NGC_STOP_FORWARDING,
+	NGC_BLOCK_DTMF,
+	NGC_UNBLOCK_DTMF,
+	NGC_BLOCK_MEDIA,
+	NGC_UNBLOCK_MEDIA,
+	NGC_PLAY_MEDIA,
+	NGC_STOP_MEDIA,
+	NGC_PLAY_DTMF,
+	NGC_STATISTICS,
+
+	__NGC_LAST
+};
+
+// upper bounds in ms of the processing time histogram buckets, plus one for everything above
+#define NG_TIMING_BUCKETS 11
+extern const unsigned int ng_timing_bucket_ms[NG_TIMING_BUCKETS - 1];
+extern const char *ng_command_strings[__NGC_LAST];
+extern atomic64 rtpe_ng_timings[__NGC_LAST][NG_TIMING_BUCKETS];
+
 struct control_ng {
 	struct obj obj;
 	struct cookie_cache cookie_cache;
 	socket_t udp_listeners[2];
+	GThreadPool *pool; // with --control-threads, runs the received commands
 };
 
 struct control_ng *control_ng_new(struct poller *, endpoint_t *, unsigned char);
+void control_ng_launch(struct control_ng *);
+void control_ng_set_tos(struct control_ng *, unsigned char);
 void control_ng_init(void);
 
 extern mutex_t rtpe_cngs_lock;
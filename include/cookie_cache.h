@@ -6,21 +6,39 @@
 #include "aux.h"
 #include "str.h"
 
-struct cookie_cache_state {
-	GHashTable *cookies;
-	GStringChunk *chunks;
+#define COOKIE_CACHE_STRIPES 16
+
+struct cookie_cache_stripe {
+	mutex_t lock;
+	GHashTable *entries; // str -> struct cookie_cache_entry
+	GQueue done; // entries with a reply, oldest first
+	size_t bytes;
 };
 
 struct cookie_cache {
-	mutex_t lock;
-	cond_t cond;
-	struct cookie_cache_state current, old;
-	time_t swap_time;
+	struct cookie_cache_stripe stripes[COOKIE_CACHE_STRIPES];
+	size_t max_stripe_bytes; // 0 = unlimited
+	atomic64 hits;
+	atomic64 misses;
+	atomic64 in_flight; // duplicates that had to wait for the first one to finish
+	atomic64 evicted; // dropped early to stay within the size limit
+};
+
+struct cookie_cache_stats {
+	u_int64_t hits;
+	u_int64_t misses;
+	u_int64_t in_flight;
+	u_int64_t evicted;
+	u_int64_t entries;
+	u_int64_t bytes;
 };
 
-void cookie_cache_init(struct cookie_cache *);
+// entries are split by cookie hash across stripes with their own locks, and the
+// size limit is applied to each stripe separately
+void cookie_cache_init(struct cookie_cache *, size_t max_bytes);
 str *cookie_cache_lookup(struct cookie_cache *, const str *);
 void cookie_cache_insert(struct cookie_cache *, const str *, const str *);
 void cookie_cache_remove(struct cookie_cache *, const str *);
+void cookie_cache_stats(struct cookie_cache *, struct cookie_cache_stats *);
 
 #endif
@@ -41,7 +41,8 @@ struct crypto_suite {
 		srtp_auth_tag,		/* n_a */
 		srtcp_auth_tag,
 		srtp_auth_key_len,	/* n_a */
-		srtcp_auth_key_len;
+		srtcp_auth_key_len,
+		aead_tag_len;		/* AEAD suites only, tag is part of the cipher text */
 	unsigned long long int
 		srtp_lifetime,
 		srtcp_lifetime;
@@ -57,6 +58,8 @@ struct crypto_suite {
 	session_key_cleanup_func session_key_cleanup;
 	//const char *dtls_profile_code; // unused
 	const void *lib_cipher_ptr;
+	const void *lib_cipher_ctr_ptr; // NULL if CTR mode isn't available
+	const void *lib_aead_ptr; // for AEAD suites
 	unsigned int idx; // filled in during crypto_init_main()
 	str name_str; // same as `name`
 };
@@ -92,7 +95,9 @@ struct crypto_context {
 	/* XXX replay list */
 	/* <from, to>? */
 
-	void *session_key_ctx[2];
+	/* [0] = ECB with k_e (or GCM for AEAD), [1] = f8 IV' cipher, [2] = CTR with k_e (AES-CM only) */
+	void *session_key_ctx[3];
+	void *session_auth_ctx; /* HMAC_CTX keyed with session_auth_key */
 
 	int have_session_key:1;
 };
@@ -13,7 +13,7 @@ struct media_packet;
 //
 struct jb_packet {
 	struct timerthread_queue_entry ttq_entry;
-	char *buf;
+	struct packet_buf *buf;
 	struct media_packet mp;
 };
 
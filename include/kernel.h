@@ -17,6 +17,8 @@
 
 struct rtpengine_target_info;
 struct re_address;
+struct rtpengine_stats_slot;
+struct rtpengine_list_entry;
 
 
 
@@ -25,16 +27,24 @@ struct kernel_interface {
 	int fd;
 	int is_open;
 	int is_wanted;
+	const struct rtpengine_stats_slot *stats; // mapped, read-only, or NULL
+	unsigned int num_stats_slots;
 };
 extern struct kernel_interface kernel;
 
 
 
-int kernel_setup_table(unsigned int);
+int kernel_setup_table(unsigned int, unsigned int);
 
 int kernel_add_stream(struct rtpengine_target_info *, int);
 int kernel_del_stream(const struct re_address *);
+
 GList *kernel_list(void);
+void kernel_list_entry_stats(struct rtpengine_stats_slot *, const struct rtpengine_list_entry *);
+
+unsigned int kernel_stats_slot_get(void);
+void kernel_stats_slot_put(unsigned int);
+const struct rtpengine_stats_slot *kernel_stats_slot(unsigned int);
 
 unsigned int kernel_add_call(const char *id);
 int kernel_del_call(unsigned int);
@@ -3,6 +3,13 @@
 
 extern int load_average; // times 100
 extern int cpu_usage; // times 100
+extern int transcode_degradation; // 0 - TRANSCODE_DEGRADE_MAX
+
+// levels of --degrade-cpu, each one includes the previous ones
+#define TRANSCODE_DEGRADE_COMPLEXITY	1 // lower Opus encoder complexity
+#define TRANSCODE_DEGRADE_RESAMPLE	2 // low quality resampling
+#define TRANSCODE_DEGRADE_MIN_COMPLEXITY	3 // lowest Opus encoder complexity
+#define TRANSCODE_DEGRADE_MAX		3
 
 void load_thread(void *);
 
@@ -74,12 +74,22 @@ struct rtpengine_config {
 	char			*redis_write_auth;
 	int			num_threads;
 	int			media_num_threads;
+	int			recv_batch;
+	int			send_batch;
+	int			media_pollers;
+	int			io_uring_threads;
+	int			timer_sweep_threads;
+	int			codec_threads;
+	int			control_threads;
+	int			cookie_cache_size;
+	int			socket_pool;
 	char			*spooldir;
 	char			*rec_method;
 	char			*rec_format;
 	char			*iptables_chain;
 	int			load_limit;
 	int			cpu_limit;
+	int			degrade_cpu;
 	uint64_t		bw_limit;
 	char			*scheduling;
 	int			priority;
@@ -104,6 +114,7 @@ struct rtpengine_config {
 
 struct poller;
 extern struct poller *rtpe_poller; // main global poller instance XXX convert to struct instead of pointer?
+extern struct poller **rtpe_media_pollers; // rtpe_config.media_pollers entries, one thread each
 
 
 extern struct rtpengine_config rtpe_config;
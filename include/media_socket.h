@@ -11,6 +11,8 @@
 #include "dtls.h"
 #include "crypto.h"
 #include "socket.h"
+#include "statistics.h"
+#include "port_ring.h"
 
 
 
@@ -20,6 +22,8 @@ struct transport_protocol;
 struct ssrc_ctx;
 struct rtpengine_srtp;
 struct jb_packet;
+struct packet_buf;
+struct codec_packet;
 
 typedef int rtcp_filter_func(struct media_packet *, GQueue *);
 typedef int (*rewrite_func)(str *, struct packet_stream *, struct stream_fd *, const endpoint_t *,
@@ -81,9 +85,15 @@ struct port_pool {
 
 	unsigned int			min, max;
 
-	mutex_t				free_list_lock;
-	GQueue				free_list;
-	BIT_ARRAY_DECLARE(free_list_used, 0x10000);
+	struct port_ring		free_pairs;
+
+	// pre-opened pairs of consecutive ports, see --socket-pool
+	mutex_t				sock_pool_lock;
+	GQueue				sock_pool; // socket_t, each even port followed by the next odd one
+	volatile unsigned int		sock_pool_pairs;
+	atomic64			sock_pool_hits;
+	atomic64			sock_pool_misses;
+	atomic64			sock_pool_refills;
 };
 struct intf_address {
 	socktype_t			*type;
@@ -107,6 +117,8 @@ struct local_intf {
 	unsigned int			unique_id; /* starting with 0 - serves as preference */
 	const struct logical_intf	*logical;
 	str				ice_foundation;
+	unsigned int			stats_idx;	/* RO, index into per-thread stats shards */
+	struct intf_stats		stats;
 };
 struct intf_list {
 	const struct local_intf		*local_intf;
@@ -121,9 +133,12 @@ struct stream_fd {
 	struct packet_stream		*stream;	/* LOCK: call->master_lock */
 	struct crypto_context		crypto;		/* IN direction, LOCK: stream->in_lock */
 	struct dtls_connection		dtls;		/* LOCK: stream->in_lock */
+	struct uring			*uring;		/* RO, set if handled by io_uring instead of the poller */
+	volatile int			uring_closed;
 };
 struct media_packet {
 	str raw;
+	struct packet_buf *buf; // pool buffer holding `raw` if any, not referenced
 
 	endpoint_t fsin; // source address of received packet
 	struct timeval tv; // timestamp when packet was received
@@ -138,15 +153,18 @@ struct media_packet {
 	str payload;
 
 	GQueue packets_out;
+	int codec_deferred; // to be passed to a codec thread, see codec_worker_defer()
 };
 
 
 
 extern GQueue all_local_interfaces; // read-only during runtime
+extern GQueue all_intf_specs; // read-only during runtime
 
 
 
 void interfaces_init(GQueue *interfaces);
+void interfaces_free(void);
 
 struct logical_intf *get_logical_interface(const str *name, sockfamily_t *fam, int num_ports);
 struct local_intf *get_interface_address(const struct logical_intf *lif, sockfamily_t *fam);
@@ -164,6 +182,8 @@ struct stream_fd *stream_fd_new(socket_t *fd, struct call *call, const struct lo
 
 void free_intf_list(struct intf_list *il);
 void free_socket_intf_list(struct intf_list *il);
+void socket_pool_loop(void *);
+void socket_pool_refill(struct intf_spec *);
 
 INLINE int open_intf_socket(socket_t *r, unsigned int port, const struct local_intf *lif) {
 	return open_socket(r, SOCK_DGRAM, port, &lif->spec->local_address.addr);
@@ -175,6 +195,12 @@ void unkernelize(struct packet_stream *);
 void __stream_unconfirm(struct packet_stream *);
 
 int media_socket_dequeue(struct media_packet *mp, struct packet_stream *sink);
+void media_socket_sendq_begin(void);
+void media_socket_sendq_end(void);
+void stream_fd_send_packet(struct stream_fd *, struct codec_packet *, const endpoint_t *);
+void stream_fd_recv_packet(struct stream_fd *, struct packet_buf *, char *, size_t, const endpoint_t *,
+		const struct timeval *);
+void stream_fd_recv_error(struct stream_fd *, int);
 const struct streamhandler *determine_handler(const struct transport_protocol *in_proto,
 		struct call_media *out_media, int must_recrypt);
 int media_packet_encrypt(rewrite_func encrypt_func, struct packet_stream *out, struct media_packet *mp);
@@ -35,6 +35,9 @@ int poller_add_item(struct poller *, struct poller_item *);
 int poller_update_item(struct poller *, struct poller_item *);
 int poller_del_item(struct poller *, int);
 
+// called from the polling thread before and after a batch of events is processed
+void poller_set_batch_funcs(struct poller *, void (*)(void), void (*)(void));
+
 void poller_blocked(struct poller *, void *);
 int poller_isblocked(struct poller *, void *);
 void poller_error(struct poller *, void *);
@@ -0,0 +1,36 @@
+#ifndef _PORT_RING_H_
+#define _PORT_RING_H_
+
+#include <glib.h>
+#include "aux.h"
+
+// Lock-free queue of the even ports of a port range whose pair (the even port and the one
+// following it) is believed to be free, roughly oldest released first. Handing out a pair is
+// a pop plus claiming both ports in the `ports_used` bit array of the caller, independent of
+// how full the range is. The ring starts out shuffled and a random number of pairs is moved
+// to the back before each pop, so that the next port can't be predicted. Ports claimed through
+// other means are dropped from the ring when they come up, and come back once they're released
+// and port_ring_put() is called for them.
+
+struct port_ring_slot {
+	volatile unsigned int seq;
+	unsigned int port;
+};
+
+struct port_ring {
+	struct port_ring_slot *slots;
+	unsigned int mask;
+	unsigned int min, max;
+	volatile unsigned int head; // next slot to pop from
+	volatile unsigned int tail; // next slot to push to
+	BIT_ARRAY_DECLARE(queued, 0x10000); // even ports currently in the ring
+};
+
+// fills the ring with all pairs between `min` and `max`, in random order
+void port_ring_init(struct port_ring *, unsigned int min, unsigned int max);
+// returns an even port with both it and the next port claimed in `ports_used`, or -1
+int port_ring_get_pair(struct port_ring *, volatile unsigned int *ports_used);
+// to be called after a port was cleared in `ports_used`: requeues its pair if all of it is free
+void port_ring_put(struct port_ring *, volatile unsigned int *ports_used, unsigned int port);
+
+#endif
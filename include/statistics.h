@@ -22,6 +22,14 @@ struct stats {
 	atomic64			transcoded_media;
 };
 
+// call timer sweep instrumentation, updated once per interval
+struct call_sweep_stats {
+	atomic64			calls_ps; // calls checked per second
+	atomic64			backlog; // calls not checked within the last second
+	atomic64			avg_time; // usec per slice
+	atomic64			max_time; // ditto
+};
+
 
 struct request_time {
 	mutex_t lock;
@@ -72,6 +80,8 @@ struct totalstats {
 	struct requests_ps	offers_ps, answers_ps, deletes_ps;
 };
 
+#define RTP_STATS_PT_SLOTS 128 // 7-bit RTP payload type
+
 struct rtp_stats {
 	unsigned int		payload_type;
 	atomic64		packets;
@@ -91,6 +101,12 @@ struct codec_stats {
 	atomic64		packets_input[3];
 	atomic64		bytes_input[3];
 	atomic64		pcm_samples[3];
+	// packets processed by codec threads and their total time from reception to sending
+	atomic64		worker_packets[3];
+	atomic64		worker_latency_us[3];
+	// encoder/decoder instances taken from the pool or newly created
+	atomic64		pool_hits;
+	atomic64		pool_misses;
 };
 
 struct stats_metric {
@@ -112,6 +128,35 @@ struct call_stats {
 	struct stats	totals[4]; /* rtp in, rtcp in, rtp out, rtcp out */
 };
 
+struct stats_counters {
+	atomic64			packets;
+	atomic64			bytes;
+	atomic64			errors;
+};
+
+#define STATS_CACHE_LINE		64
+
+// Per-thread packet counters. Each shard is only ever written by its owning thread
+// (non-atomically) and summed up by call_timer() once per interval, so that media
+// threads don't have to bounce shared atomics between CPUs for every packet.
+// Shards and their arrays are cache line aligned and padded so that no two threads
+// write to the same line.
+struct stats_shard {
+	struct stats_counters		global;
+	struct stats_counters		*intf;		// indexed by local_intf->stats_idx
+	unsigned int			num_intfs;
+	struct stats_counters		*last;		// collector only: [0] global, [1..] interfaces
+} __attribute__ ((aligned (STATS_CACHE_LINE)));
+
+// per local interface, updated by statistics_collect_shards()
+struct intf_stats {
+	struct stats_counters		totals;
+	struct stats_counters		ps;		// per second, from last interval
+	struct stats_counters		interval;	// collector only, current interval
+};
+
+extern __thread struct stats_shard *rtpe_stats_shard;
+
 extern struct totalstats       rtpe_totalstats;
 extern struct totalstats       rtpe_totalstats_interval;
 extern mutex_t		       rtpe_totalstats_lastinterval_lock;
@@ -131,4 +176,40 @@ const char *statistics_ng(bencode_item_t *input, bencode_item_t *output);
 
 void statistics_init(void);
 
+struct stats_shard *stats_shard_new(void);
+void statistics_collect_shards(long long run_diff);
+
+INLINE struct stats_shard *stats_shard_get(void) {
+	if (G_LIKELY(rtpe_stats_shard))
+		return rtpe_stats_shard;
+	return stats_shard_new();
+}
+INLINE void stats_shard_add(unsigned int intf_idx, u_int64_t packets, u_int64_t bytes, u_int64_t errors) {
+	struct stats_shard *s = stats_shard_get();
+	atomic64_add_na(&s->global.packets, packets);
+	atomic64_add_na(&s->global.bytes, bytes);
+	atomic64_add_na(&s->global.errors, errors);
+	if (G_UNLIKELY(intf_idx >= s->num_intfs))
+		return;
+	atomic64_add_na(&s->intf[intf_idx].packets, packets);
+	atomic64_add_na(&s->intf[intf_idx].bytes, bytes);
+	atomic64_add_na(&s->intf[intf_idx].errors, errors);
+}
+INLINE void stats_shard_packet(unsigned int intf_idx, u_int64_t bytes) {
+	struct stats_shard *s = stats_shard_get();
+	atomic64_add_na(&s->global.packets, 1);
+	atomic64_add_na(&s->global.bytes, bytes);
+	if (G_UNLIKELY(intf_idx >= s->num_intfs))
+		return;
+	atomic64_add_na(&s->intf[intf_idx].packets, 1);
+	atomic64_add_na(&s->intf[intf_idx].bytes, bytes);
+}
+INLINE void stats_shard_error(unsigned int intf_idx) {
+	struct stats_shard *s = stats_shard_get();
+	atomic64_add_na(&s->global.errors, 1);
+	if (G_UNLIKELY(intf_idx >= s->num_intfs))
+		return;
+	atomic64_add_na(&s->intf[intf_idx].errors, 1);
+}
+
 #endif /* STATISTICS_H_ */
@@ -7,10 +7,31 @@
 #include "auxlib.h"
 
 
-struct timerthread {
-	GTree *tree;
+// hierarchical timing wheel: 4 levels of 256 slots, 64 us per tick at the lowest level
+#define TT_WHEEL_TICK_SHIFT	6
+#define TT_WHEEL_BITS		8
+#define TT_WHEEL_SLOTS		(1 << TT_WHEEL_BITS)
+#define TT_WHEEL_LEVELS		4
+
+struct timerthread_obj;
+struct timerthread;
+
+struct timerthread_thread {
+	struct timerthread *tt;
 	mutex_t lock;
 	cond_t cond;
+	u_int64_t cur_tick; // last tick processed
+	unsigned int num_objs;
+	struct timeval sleep_until;
+	struct timerthread_obj *slots[TT_WHEEL_LEVELS][TT_WHEEL_SLOTS];
+	struct timerthread_obj *expired; // due to run
+};
+
+struct timerthread {
+	unsigned int num_threads;
+	struct timerthread_thread *threads;
+	volatile unsigned int next_thread; // round robin for new objects
+	volatile unsigned int launched;
 	void (*func)(void *);
 };
 
@@ -18,15 +39,23 @@ struct timerthread_obj {
 	struct obj obj;
 
 	struct timerthread *tt;
-	struct timeval next_check; /* protected by ->lock */
+	struct timerthread_thread *thread; /* fixed once assigned */
+	struct timeval next_check; /* protected by thread->lock */
 	struct timeval last_run; /* ditto */
+	struct timerthread_obj *wheel_next, **wheel_pprev; /* ditto */
 };
 
+// queue entries are bucketed by millisecond, as anything less than 1 ms ahead is run early anyway
+#define TTQ_TICK_US		1000
+#define TTQ_SLOTS		64
+
 struct timerthread_queue {
 	struct timerthread_obj tt_obj;
 	const char *type;
 	mutex_t lock;
-	GTree *entries;
+	unsigned int num_entries;
+	u_int64_t cur_tick; // no entry is due before this
+	GQueue slots[TTQ_SLOTS]; // by tick, each ordered by `when`
 	void (*run_now_func)(struct timerthread_queue *, void *);
 	void (*run_later_func)(struct timerthread_queue *, void *);
 	void (*free_func)(void *);
@@ -36,13 +65,16 @@ struct timerthread_queue {
 struct timerthread_queue_entry {
 	struct timeval when;
 	void *source; // opaque
+	GList link; // in timerthread_queue->slots
 	char __rest[0];
 };
 
 
-void timerthread_init(struct timerthread *, void (*)(void *));
+// objects are spread across `num_threads` wheels, one per thread running timerthread_run()
+void timerthread_init(struct timerthread *, unsigned int num_threads, void (*)(void *));
 void timerthread_run(void *);
 
+struct timerthread_thread *__timerthread_obj_assign(struct timerthread_obj *);
 void timerthread_obj_schedule_abs_nl(struct timerthread_obj *, const struct timeval *);
 void timerthread_obj_deschedule(struct timerthread_obj *);
 
@@ -59,12 +91,26 @@ void timerthread_queue_flush_data(void *ptr);
 void timerthread_queue_push(struct timerthread_queue *, struct timerthread_queue_entry *);
 unsigned int timerthread_queue_flush(struct timerthread_queue *, void *);
 
+// the thread (and thus lock) an object is scheduled on never changes once assigned
+INLINE struct timerthread_thread *timerthread_obj_thread(struct timerthread_obj *tt_obj) {
+	struct timerthread_thread *tt_thread = g_atomic_pointer_get(&tt_obj->thread);
+	if (G_LIKELY(tt_thread))
+		return tt_thread;
+	return __timerthread_obj_assign(tt_obj);
+}
+INLINE void timerthread_obj_lock(struct timerthread_obj *tt_obj) {
+	mutex_lock(&timerthread_obj_thread(tt_obj)->lock);
+}
+INLINE void timerthread_obj_unlock(struct timerthread_obj *tt_obj) {
+	mutex_unlock(&timerthread_obj_thread(tt_obj)->lock);
+}
+
 INLINE void timerthread_obj_schedule_abs(struct timerthread_obj *tt_obj, const struct timeval *tv) {
 	if (!tt_obj)
 		return;
-	mutex_lock(&tt_obj->tt->lock);
+	timerthread_obj_lock(tt_obj);
 	timerthread_obj_schedule_abs_nl(tt_obj, tv);
-	mutex_unlock(&tt_obj->tt->lock);
+	timerthread_obj_unlock(tt_obj);
 }
 
 
@@ -0,0 +1,15 @@
+#ifndef _URING_H_
+#define _URING_H_
+
+struct uring;
+struct stream_fd;
+
+// returns -1 if io_uring is unavailable, in which case epoll is used as usual
+int uring_init(void);
+void uring_launch(void);
+struct uring *uring_get(void); // round robin, NULL if not in use
+
+int uring_add_sfd(struct uring *, struct stream_fd *);
+void uring_del_sfd(struct stream_fd *);
+
+#endif
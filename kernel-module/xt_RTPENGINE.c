@@ -10,6 +10,8 @@
 #include <linux/crypto.h>
 #include <crypto/aes.h>
 #include <crypto/hash.h>
+#include <crypto/aead.h>
+#include <linux/scatterlist.h>
 #include <net/icmp.h>
 #include <net/ip.h>
 #include <net/ipv6.h>
@@ -17,6 +19,10 @@
 #include <net/route.h>
 #include <net/dst.h>
 #include <linux/proc_fs.h>
+#include <linux/mm.h>
+#include <linux/vmalloc.h>
+#include <linux/rcupdate.h>
+#include <linux/workqueue.h>
 #include <linux/spinlock.h>
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(3,0,0)
 #include <linux/bsearch.h>
@@ -175,6 +181,10 @@ static uint stream_packets_list_limit = 10;
 module_param(stream_packets_list_limit, uint, 0);
 MODULE_PARM_DESC(stream_packets_list_limit, "maximum number of packets to retain for intercept streams");
 
+static uint stats_slots = 65536;
+module_param(stats_slots, uint, 0);
+MODULE_PARM_DESC(stats_slots, "maximum number of targets per table with counters in the shared stats area, also used if user space doesn't ask for a number");
+
 static bool log_errors = 0;
 module_param(log_errors, bool, 0);
 MODULE_PARM_DESC(log_errors, "generate kernel log lines from forwarding errors");
@@ -207,6 +217,8 @@ static void proc_list_stop(struct seq_file *, void *);
 static void *proc_list_next(struct seq_file *, void *, loff_t *);
 static int proc_list_show(struct seq_file *, void *);
 
+static int proc_stats_mmap(struct file *, struct vm_area_struct *);
+
 static int proc_blist_open(struct inode *, struct file *);
 static int proc_blist_close(struct inode *, struct file *);
 static ssize_t proc_blist_read(struct file *, char __user *, size_t, loff_t *);
@@ -230,6 +242,10 @@ static int is_valid_address(const struct re_address *rea);
 static int aes_f8_session_key_init(struct re_crypto_context *, struct rtpengine_srtp *);
 static int srtp_encrypt_aes_cm(struct re_crypto_context *, struct rtpengine_srtp *,
 		struct rtp_parsed *, u_int64_t);
+static int srtp_encrypt_aes_gcm(struct re_crypto_context *, struct rtpengine_srtp *,
+		struct rtp_parsed *, u_int64_t);
+static int srtp_decrypt_aes_gcm(struct re_crypto_context *, struct rtpengine_srtp *,
+		struct rtp_parsed *, u_int64_t);
 static int srtp_encrypt_aes_f8(struct re_crypto_context *, struct rtpengine_srtp *,
 		struct rtp_parsed *, u_int64_t);
 
@@ -252,11 +268,19 @@ struct re_crypto_context {
 	unsigned char			session_auth_key[20];
 	u_int32_t			roc;
 	struct crypto_cipher		*tfm[2];
+	struct crypto_aead		*aead;
+	spinlock_t			aead_lock; /* protects aead_req */
+	struct aead_request		*aead_req; /* preallocated, reused for every packet */
 	struct crypto_shash		*shash;
 	const struct re_cipher		*cipher;
 	const struct re_hmac		*hmac;
 };
 
+struct rtpengine_rtp_stats_a {
+	atomic64_t			packets;
+	atomic64_t			bytes;
+};
+/* same layout as struct rtpengine_stats_slot */
 struct rtpengine_stats_a {
 	atomic64_t			packets;
 	atomic64_t			bytes;
@@ -264,19 +288,23 @@ struct rtpengine_stats_a {
 	u_int64_t			delay_min;
 	u_int64_t			delay_avg;
 	u_int64_t			delay_max;
-	atomic_t          in_tos;
-};
-struct rtpengine_rtp_stats_a {
-	atomic64_t			packets;
-	atomic64_t			bytes;
+	u_int64_t			decrypt_last_index;
+	u_int64_t			encrypt_last_index;
+	atomic_t			in_tos;
+
+	u_int32_t			ssrc;
+	u_int32_t			non_forwarding;
+	u_int32_t			num_payload_types;
+	unsigned char			payload_types[NUM_PAYLOAD_TYPES];
+	struct rtpengine_rtp_stats_a	rtp_stats[NUM_PAYLOAD_TYPES];
 };
 struct rtpengine_target {
 	atomic_t			refcnt;
 	u_int32_t			table;
 	struct rtpengine_target_info	target;
 
-	struct rtpengine_stats_a	stats;
-	struct rtpengine_rtp_stats_a	rtp_stats[NUM_PAYLOAD_TYPES];
+	struct rtpengine_stats_a	*stats; /* in the table's stats area, or own_stats */
+	struct rtpengine_stats_a	own_stats;
 
 	struct re_crypto_context	decrypt;
 	struct re_crypto_context	encrypt;
@@ -369,8 +397,13 @@ struct rtpengine_table {
 	struct proc_dir_entry		*proc_control;
 	struct proc_dir_entry		*proc_list;
 	struct proc_dir_entry		*proc_blist;
+	struct proc_dir_entry		*proc_stats;
 	struct proc_dir_entry		*proc_calls;
 
+	struct rtpengine_stats_a	*stats_slots; /* vmalloc'd, mapped by user space */
+	unsigned long			*stats_slots_busy; /* bitmap, cleared one grace period after use */
+	unsigned int			num_stats_slots;
+
 	struct re_dest_addr_hash	dest_addr_hash;
 
 	unsigned int			num_targets;
@@ -387,6 +420,8 @@ struct re_cipher {
 	enum rtpengine_cipher		id;
 	const char			*name;
 	const char			*tfm_name;
+	const char			*aead_name;
+	unsigned int			aead_tag_len; /* appended to the payload by encrypt() */
 	int				(*decrypt)(struct re_crypto_context *, struct rtpengine_srtp *,
 			struct rtp_parsed *, u_int64_t);
 	int				(*encrypt)(struct re_crypto_context *, struct rtpengine_srtp *,
@@ -454,6 +489,7 @@ static struct re_auto_array streams;
 #  define PROC_RELEASE release
 #  define PROC_LSEEK llseek
 #  define PROC_POLL poll
+#  define PROC_MMAP mmap
 #else
 #  define PROC_OP_STRUCT proc_ops
 #  define PROC_OWNER
@@ -463,6 +499,7 @@ static struct re_auto_array streams;
 #  define PROC_RELEASE proc_release
 #  define PROC_LSEEK proc_lseek
 #  define PROC_POLL proc_poll
+#  define PROC_MMAP proc_mmap
 #endif
 
 static const struct PROC_OP_STRUCT proc_control_ops = {
@@ -502,6 +539,13 @@ static const struct PROC_OP_STRUCT proc_blist_ops = {
 	.PROC_RELEASE		= proc_blist_close,
 };
 
+static const struct PROC_OP_STRUCT proc_stats_ops = {
+	PROC_OWNER
+	.PROC_MMAP		= proc_stats_mmap,
+	.PROC_OPEN		= proc_generic_open_modref,
+	.PROC_RELEASE		= proc_generic_close_modref,
+};
+
 static const struct seq_operations proc_list_seq_ops = {
 	.start			= proc_list_start,
 	.next			= proc_list_next,
@@ -570,6 +614,22 @@ static const struct re_cipher re_ciphers[] = {
 		.decrypt	= srtp_encrypt_aes_cm,
 		.encrypt	= srtp_encrypt_aes_cm,
 	},
+	[REC_AEAD_AES_GCM_128] = {
+		.id		= REC_AEAD_AES_GCM_128,
+		.name		= "AEAD-AES-128-GCM",
+		.aead_name	= "gcm(aes)",
+		.aead_tag_len	= 16,
+		.decrypt	= srtp_decrypt_aes_gcm,
+		.encrypt	= srtp_encrypt_aes_gcm,
+	},
+	[REC_AEAD_AES_GCM_256] = {
+		.id		= REC_AEAD_AES_GCM_256,
+		.name		= "AEAD-AES-256-GCM",
+		.aead_name	= "gcm(aes)",
+		.aead_tag_len	= 16,
+		.decrypt	= srtp_decrypt_aes_gcm,
+		.encrypt	= srtp_encrypt_aes_gcm,
+	},
 };
 
 static const struct re_hmac re_hmacs[] = {
@@ -647,7 +707,29 @@ static void auto_array_free(struct re_auto_array *a) {
 		pop_free_list_entry(a);
 }
 
-static struct rtpengine_table *new_table(void) {
+static void new_table_stats(struct rtpengine_table *t, unsigned int num) {
+	if (!num || num > stats_slots)
+		num = stats_slots;
+	if (!num)
+		return;
+
+	t->stats_slots = vmalloc_user(PAGE_ALIGN(sizeof(*t->stats_slots) * num));
+	t->stats_slots_busy = vzalloc(BITS_TO_LONGS(num) * sizeof(unsigned long));
+	if (!t->stats_slots || !t->stats_slots_busy) {
+		/* user space falls back to reading the target list */
+		printk(KERN_WARNING "xt_RTPENGINE failed to allocate stats area for %u targets\n", num);
+		if (t->stats_slots)
+			vfree(t->stats_slots);
+		if (t->stats_slots_busy)
+			vfree(t->stats_slots_busy);
+		t->stats_slots = NULL;
+		t->stats_slots_busy = NULL;
+		return;
+	}
+	t->num_stats_slots = num;
+}
+
+static struct rtpengine_table *new_table(unsigned int num_stats_slots) {
 	struct rtpengine_table *t;
 	unsigned int i;
 
@@ -662,6 +744,8 @@ static struct rtpengine_table *new_table(void) {
 		return NULL;
 	}
 
+	new_table_stats(t, num_stats_slots);
+
 	atomic_set(&t->refcnt, 1);
 	rwlock_init(&t->target_lock);
 	INIT_LIST_HEAD(&t->calls);
@@ -758,6 +842,13 @@ static int table_create_proc(struct rtpengine_table *t, u_int32_t id) {
 	if (!t->proc_blist)
 		return -1;
 
+	t->proc_stats = proc_create_user("stats", S_IFREG | S_IRUSR | S_IRGRP, t->proc_root,
+			&proc_stats_ops, (void *) (unsigned long) id);
+	if (!t->proc_stats)
+		return -1;
+	/* exact size, the daemon takes the slot count from it */
+	proc_set_size(t->proc_stats, sizeof(*t->stats_slots) * t->num_stats_slots);
+
 	t->proc_calls = proc_mkdir_user("calls", S_IRUGO | S_IXUGO, t->proc_root);
 	if (!t->proc_calls)
 		return -1;
@@ -768,14 +859,14 @@ static int table_create_proc(struct rtpengine_table *t, u_int32_t id) {
 
 
 
-static struct rtpengine_table *new_table_link(u_int32_t id) {
+static struct rtpengine_table *new_table_link(u_int32_t id, unsigned int num_stats_slots) {
 	struct rtpengine_table *t;
 	unsigned long flags;
 
 	if (id >= MAX_ID)
 		return NULL;
 
-	t = new_table();
+	t = new_table(num_stats_slots);
 	if (!t) {
 		printk(KERN_WARNING "xt_RTPENGINE out of memory\n");
 		return NULL;
@@ -812,6 +903,10 @@ static void free_crypto_context(struct re_crypto_context *c) {
 		if (c->tfm[i])
 			crypto_free_cipher(c->tfm[i]);
 	}
+	if (c->aead_req)
+		aead_request_free(c->aead_req);
+	if (c->aead)
+		crypto_free_aead(c->aead);
 	if (c->shash)
 		crypto_free_shash(c->shash);
 }
@@ -842,6 +937,65 @@ static void target_get(struct rtpengine_target *t) {
 
 
 
+struct re_stats_slot_release {
+	union {
+		struct rcu_head		rcu;
+		struct work_struct	work;
+	};
+	struct rtpengine_table		*table;
+	unsigned int			idx;
+};
+
+static void stats_slot_release_work(struct work_struct *work) {
+	struct re_stats_slot_release *r = container_of(work, struct re_stats_slot_release, work);
+	struct rtpengine_table *t = r->table;
+
+	kfree(r);
+	table_put(t);
+}
+
+static void stats_slot_release_rcu(struct rcu_head *head) {
+	struct re_stats_slot_release *r = container_of(head, struct re_stats_slot_release, rcu);
+
+	clear_bit(r->idx, r->table->stats_slots_busy);
+
+	/* table_put() may sleep, so the last reference is dropped from process context */
+	if (atomic_add_unless(&r->table->refcnt, -1, 1)) {
+		kfree(r);
+		return;
+	}
+	INIT_WORK(&r->work, stats_slot_release_work);
+	schedule_work(&r->work);
+}
+
+/* Packets still being forwarded through a removed target may update its counters until
+ * the end of the current RCU grace period, as netfilter runs its hooks under
+ * rcu_read_lock(). Only after that can the slot be handed to a new target. Each pending
+ * release holds a table reference. */
+static void stats_slot_release(struct rtpengine_table *t, struct rtpengine_target *g) {
+	struct re_stats_slot_release *r;
+	unsigned int idx;
+
+	if (g->stats == &g->own_stats)
+		return;
+
+	idx = g->stats - t->stats_slots;
+
+	r = kmalloc(sizeof(*r), GFP_KERNEL);
+	if (!r) {
+		synchronize_rcu();
+		clear_bit(idx, t->stats_slots_busy);
+		return;
+	}
+
+	ref_get(t);
+	r->table = t;
+	r->idx = idx;
+	call_rcu(&r->rcu, stats_slot_release_rcu);
+}
+
+
+
 
 
 
@@ -868,6 +1022,7 @@ static void clear_table_proc_files(struct rtpengine_table *t) {
 	clear_proc(&t->proc_control);
 	clear_proc(&t->proc_list);
 	clear_proc(&t->proc_blist);
+	clear_proc(&t->proc_stats);
 	clear_proc(&t->proc_calls);
 	clear_proc(&t->proc_root);
 }
@@ -912,6 +1067,10 @@ static void table_put(struct rtpengine_table *t) {
 	}
 
 	clear_table_proc_files(t);
+	if (t->stats_slots)
+		vfree(t->stats_slots);
+	if (t->stats_slots_busy)
+		vfree(t->stats_slots_busy);
 	kfree(t);
 
 	module_put(THIS_MODULE);
@@ -1290,6 +1449,61 @@ next_rda:
 
 
 
+static void proc_stats_vm_open(struct vm_area_struct *vma) {
+	struct rtpengine_table *t = vma->vm_private_data;
+	ref_get(t);
+}
+static void proc_stats_vm_close(struct vm_area_struct *vma) {
+	table_put(vma->vm_private_data);
+}
+static const struct vm_operations_struct proc_stats_vm_ops = {
+	.open			= proc_stats_vm_open,
+	.close			= proc_stats_vm_close,
+};
+
+static int proc_stats_mmap(struct file *f, struct vm_area_struct *vma) {
+	struct inode *inode;
+	u_int32_t id;
+	struct rtpengine_table *t;
+	unsigned long size;
+	int err;
+
+	if ((vma->vm_flags & VM_WRITE))
+		return -EPERM;
+	/* no mprotect() to writable later on */
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6,3,0)
+	vm_flags_clear(vma, VM_MAYWRITE);
+#else
+	vma->vm_flags &= ~VM_MAYWRITE;
+#endif
+
+	inode = f->f_path.dentry->d_inode;
+	id = (u_int32_t) (unsigned long) PDE_DATA(inode);
+	t = get_table(id);
+	if (!t)
+		return -ENOENT;
+
+	err = -EINVAL;
+	size = PAGE_ALIGN(sizeof(*t->stats_slots) * t->num_stats_slots);
+	if (!t->stats_slots || vma->vm_pgoff > (size >> PAGE_SHIFT)
+			|| vma->vm_end - vma->vm_start > size - (vma->vm_pgoff << PAGE_SHIFT))
+		goto err;
+
+	err = remap_vmalloc_range(vma, t->stats_slots, vma->vm_pgoff);
+	if (err)
+		goto err;
+
+	/* the mapping holds our table reference */
+	vma->vm_private_data = t;
+	vma->vm_ops = &proc_stats_vm_ops;
+
+	return 0;
+
+err:
+	table_put(t);
+	return err;
+}
+
 static int proc_blist_open(struct inode *i, struct file *f) {
 	u_int32_t id;
 	struct rtpengine_table *t;
@@ -1356,17 +1570,17 @@ static ssize_t proc_blist_read(struct file *f, char __user *b, size_t l, loff_t
 
 	memcpy(&opp->target, &g->target, sizeof(opp->target));
 
-	opp->stats.packets = atomic64_read(&g->stats.packets);
-	opp->stats.bytes = atomic64_read(&g->stats.bytes);
-	opp->stats.errors = atomic64_read(&g->stats.errors);
-	opp->stats.delay_min = g->stats.delay_min;
-	opp->stats.delay_max = g->stats.delay_max;
-	opp->stats.delay_avg = g->stats.delay_avg;
-	opp->stats.in_tos = atomic_read(&g->stats.in_tos);
+	opp->stats.packets = atomic64_read(&g->stats->packets);
+	opp->stats.bytes = atomic64_read(&g->stats->bytes);
+	opp->stats.errors = atomic64_read(&g->stats->errors);
+	opp->stats.delay_min = g->stats->delay_min;
+	opp->stats.delay_max = g->stats->delay_max;
+	opp->stats.delay_avg = g->stats->delay_avg;
+	opp->stats.in_tos = atomic_read(&g->stats->in_tos);
 
 	for (i = 0; i < g->target.num_payload_types; i++) {
-		opp->rtp_stats[i].packets = atomic64_read(&g->rtp_stats[i].packets);
-		opp->rtp_stats[i].bytes = atomic64_read(&g->rtp_stats[i].bytes);
+		opp->rtp_stats[i].packets = atomic64_read(&g->stats->rtp_stats[i].packets);
+		opp->rtp_stats[i].bytes = atomic64_read(&g->stats->rtp_stats[i].bytes);
 	}
 
 	spin_lock_irqsave(&g->decrypt.lock, flags);
@@ -1549,14 +1763,14 @@ static int proc_list_show(struct seq_file *f, void *v) {
 	if (g->target.src_mismatch > 0 && g->target.src_mismatch <= ARRAY_SIZE(re_msm_strings))
 		seq_printf(f, "    src mismatch action: %s\n", re_msm_strings[g->target.src_mismatch]);
 	seq_printf(f, "    stats: %20llu bytes, %20llu packets, %20llu errors\n",
-		(unsigned long long) atomic64_read(&g->stats.bytes),
-		(unsigned long long) atomic64_read(&g->stats.packets),
-		(unsigned long long) atomic64_read(&g->stats.errors));
+		(unsigned long long) atomic64_read(&g->stats->bytes),
+		(unsigned long long) atomic64_read(&g->stats->packets),
+		(unsigned long long) atomic64_read(&g->stats->errors));
 	for (i = 0; i < g->target.num_payload_types; i++)
 		seq_printf(f, "        RTP payload type %3u: %20llu bytes, %20llu packets\n",
 			g->target.payload_types[i],
-			(unsigned long long) atomic64_read(&g->rtp_stats[i].bytes),
-			(unsigned long long) atomic64_read(&g->rtp_stats[i].packets));
+			(unsigned long long) atomic64_read(&g->stats->rtp_stats[i].bytes),
+			(unsigned long long) atomic64_read(&g->stats->rtp_stats[i].packets));
 	if (g->target.ssrc)
 		seq_printf(f, "  SSRC in: %08x\n", g->target.ssrc);
 	if (g->target.ssrc_out)
@@ -1703,6 +1917,7 @@ out:
 	if (b)
 		kfree(b);
 
+	stats_slot_release(t, g);
 	target_put(g);
 
 	return 0;
@@ -1975,6 +2190,31 @@ static int gen_session_keys(struct re_crypto_context *c, struct rtpengine_srtp *
 		crypto_cipher_setkey(c->tfm[0], c->session_key, s->session_key_len);
 	}
 
+	if (c->cipher->aead_name) {
+		err = "failed to load AEAD";
+		c->aead = crypto_alloc_aead(c->cipher->aead_name, 0, CRYPTO_ALG_ASYNC);
+		if (IS_ERR(c->aead)) {
+			ret = PTR_ERR(c->aead);
+			c->aead = NULL;
+			goto error;
+		}
+		err = "failed to set AEAD key";
+		ret = crypto_aead_setkey(c->aead, c->session_key, s->session_key_len);
+		if (ret)
+			goto error;
+		ret = crypto_aead_setauthsize(c->aead, c->cipher->aead_tag_len);
+		if (ret)
+			goto error;
+		/* sized for this tfm through crypto_aead_reqsize() */
+		err = "failed to allocate AEAD request";
+		ret = -ENOMEM;
+		c->aead_req = aead_request_alloc(c->aead, GFP_KERNEL);
+		if (!c->aead_req)
+			goto error;
+		aead_request_set_callback(c->aead_req, 0, NULL, NULL);
+		spin_lock_init(&c->aead_lock);
+	}
+
 	if (c->cipher->session_key_init) {
 		ret = c->cipher->session_key_init(c, s);
 		if (ret)
@@ -2089,7 +2329,8 @@ static int table_new_target(struct rtpengine_table *t, struct rtpengine_target_i
 	struct re_dest_addr *rda;
 	struct re_bucket *b, *ba = NULL;
 	struct rtpengine_target *og = NULL;
-	int err, j;
+	struct rtpengine_stats_a *stats;
+	int err, j, slot_claimed = 0;
 	unsigned long flags;
 
 	/* validation */
@@ -2114,6 +2355,8 @@ static int table_new_target(struct rtpengine_table *t, struct rtpengine_target_i
 		return -EINVAL;
 	if (validate_srtp(&i->encrypt))
 		return -EINVAL;
+	if (i->stats_slot && i->stats_idx >= t->num_stats_slots)
+		return -ERANGE;
 
 	DBG("Creating new target\n");
 
@@ -2129,6 +2372,18 @@ static int table_new_target(struct rtpengine_table *t, struct rtpengine_target_i
 	spin_lock_init(&g->decrypt.lock);
 	spin_lock_init(&g->encrypt.lock);
 	memcpy(&g->target, i, sizeof(*i));
+	g->stats = &g->own_stats;
+	if (i->stats_slot) {
+		g->stats = &t->stats_slots[i->stats_idx];
+		/* an update keeps the slot of the target it replaces, see below */
+		if (!update) {
+			err = -EBUSY;
+			if (test_and_set_bit(i->stats_idx, t->stats_slots_busy))
+				goto fail2;
+			slot_claimed = 1;
+			memset(g->stats, 0, sizeof(*g->stats));
+		}
+	}
 	crypto_context_init(&g->decrypt, &g->target.decrypt);
 	crypto_context_init(&g->encrypt, &g->target.encrypt);
 
@@ -2221,18 +2476,31 @@ got_bucket:
 		if (!og)
 			goto fail4;
 
-		atomic64_set(&g->stats.packets, atomic64_read(&og->stats.packets));
-		atomic64_set(&g->stats.bytes, atomic64_read(&og->stats.bytes));
-		atomic64_set(&g->stats.errors, atomic64_read(&og->stats.errors));
-		g->stats.delay_min = og->stats.delay_min;
-		g->stats.delay_max = og->stats.delay_max;
-		g->stats.delay_avg = og->stats.delay_avg;
-		atomic_set(&g->stats.in_tos, atomic_read(&og->stats.in_tos));
+		if (g->stats == og->stats)
+			goto stats_kept;
+
+		if (g->stats != &g->own_stats) {
+			err = -EBUSY;
+			if (test_and_set_bit(i->stats_idx, t->stats_slots_busy))
+				goto fail4;
+			slot_claimed = 1;
+			memset(g->stats, 0, sizeof(*g->stats));
+		}
+
+		atomic64_set(&g->stats->packets, atomic64_read(&og->stats->packets));
+		atomic64_set(&g->stats->bytes, atomic64_read(&og->stats->bytes));
+		atomic64_set(&g->stats->errors, atomic64_read(&og->stats->errors));
+		g->stats->delay_min = og->stats->delay_min;
+		g->stats->delay_max = og->stats->delay_max;
+		g->stats->delay_avg = og->stats->delay_avg;
+		atomic_set(&g->stats->in_tos, atomic_read(&og->stats->in_tos));
 
 		for (j = 0; j < NUM_PAYLOAD_TYPES; j++) {
-			atomic64_set(&g->rtp_stats[j].packets, atomic64_read(&og->rtp_stats[j].packets));
-			atomic64_set(&g->rtp_stats[j].bytes, atomic64_read(&og->rtp_stats[j].bytes));
+			atomic64_set(&g->stats->rtp_stats[j].packets, atomic64_read(&og->stats->rtp_stats[j].packets));
+			atomic64_set(&g->stats->rtp_stats[j].bytes, atomic64_read(&og->stats->rtp_stats[j].bytes));
 		}
+stats_kept:
+		;
 	}
 	else {
 		err = -EEXIST;
@@ -2242,14 +2510,23 @@ got_bucket:
 		t->num_targets++;
 	}
 
+	stats = g->stats;
+	stats->ssrc = i->ssrc;
+	stats->non_forwarding = i->non_forwarding;
+	stats->num_payload_types = i->num_payload_types;
+	memcpy(stats->payload_types, i->payload_types, sizeof(stats->payload_types));
+
 	b->ports_lo[lo] = g;
 	g = NULL;
 	write_unlock_irqrestore(&t->target_lock, flags);
 
 	if (ba)
 		kfree(ba);
-	if (og)
+	if (og) {
+		if (og->stats != stats)
+			stats_slot_release(t, og);
 		target_put(og);
+	}
 
 	return 0;
 
@@ -2258,6 +2535,9 @@ fail4:
 	if (ba)
 		kfree(ba);
 fail2:
+	/* never used for forwarding */
+	if (slot_claimed)
+		clear_bit(i->stats_idx, t->stats_slots_busy);
 	kfree(g);
 fail1:
 	return err;
@@ -2312,16 +2592,17 @@ static int proc_generic_seqrelease_modref(struct inode *inode, struct file *file
 
 static ssize_t proc_main_control_write(struct file *file, const char __user *buf, size_t buflen, loff_t *off) {
 	char b[30];
-	unsigned long id;
+	unsigned long id, num_stats_slots = 0;
 	char *endp;
 	struct rtpengine_table *t;
 	int err;
 
-	if (buflen < 6 || buflen > 20)
+	if (buflen < 6 || buflen >= sizeof(b))
 		return -EINVAL;
 
 	if (copy_from_user(&b, buf, buflen))
 		return -EFAULT;
+	b[buflen] = '\0';
 
 	if (!strncmp(b, "add ", 4)) {
 		id = simple_strtoul(b + 4, &endp, 10);
@@ -2329,7 +2610,10 @@ static ssize_t proc_main_control_write(struct file *file, const char __user *buf
 			return -EINVAL;
 		if (id >= MAX_ID)
 			return -EINVAL;
-		t = new_table_link((u_int32_t) id);
+		/* optional: number of stats slots wanted */
+		if (*endp == ' ')
+			num_stats_slots = simple_strtoul(endp + 1, &endp, 10);
+		t = new_table_link((u_int32_t) id, num_stats_slots);
 		if (!t)
 			return -EEXIST;
 		table_put(t);
@@ -3672,8 +3956,11 @@ static int srtp_authenticate(struct re_crypto_context *c,
 
 	if (!r->header)
 		return 0;
-	if (s->hmac == REH_NULL)
+	if (s->hmac == REH_NULL) {
+		/* AEAD ciphers have already appended their tag */
+		rtp_append_mki(r, s);
 		return 0;
+	}
 	if (!c->hmac)
 		return 0;
 	if (!c->shash)
@@ -3698,8 +3985,13 @@ static int srtp_auth_validate(struct re_crypto_context *c,
 	unsigned char hmac[20];
 	u_int64_t pkt_idx = *pkt_idx_p;
 
-	if (s->hmac == REH_NULL)
+	if (s->hmac == REH_NULL) {
+		/* AEAD ciphers verify their tag while decrypting */
+		if (r->payload_len < s->mki_len)
+			return -1;
+		r->payload_len -= s->mki_len;
 		return 0;
+	}
 	if (!c->hmac)
 		return 0;
 	if (!c->shash)
@@ -3785,6 +4077,87 @@ static int srtp_encrypt_aes_cm(struct re_crypto_context *c,
 	return 0;
 }
 
+/* XXX shared code */
+/* rfc 7714 section 8.1 */
+static void aes_gcm_iv(unsigned char *iv, struct re_crypto_context *c, struct rtp_parsed *r,
+		u_int64_t pkt_idx)
+{
+	u_int32_t roc;
+	int i;
+
+	iv[0] = iv[1] = 0;
+	memcpy(&iv[2], &r->header->ssrc, 4);
+	roc = htonl((pkt_idx & 0xffffffff0000ULL) >> 16);
+	memcpy(&iv[6], &roc, 4);
+	memcpy(&iv[10], &r->header->seq_num, 2);
+	for (i = 0; i < 12; i++)
+		iv[i] ^= c->session_salt[i];
+}
+
+/* rfc 7714 section 8.2: the whole RTP header is the AAD, which must directly
+ * precede the payload. the tag is appended to the payload. */
+static int aes_gcm_crypt(struct re_crypto_context *c, struct rtp_parsed *r, u_int64_t pkt_idx,
+		unsigned int crypt_len, unsigned int buf_len, int enc)
+{
+	unsigned char iv[12];
+	struct aead_request *req;
+	struct scatterlist sg;
+	unsigned long flags;
+	int ret;
+
+	if (!c->aead_req)
+		return -1;
+
+	aes_gcm_iv(iv, c, r, pkt_idx);
+	sg_init_one(&sg, r->header, r->header_len + buf_len);
+
+	/* the tfm is synchronous, so the request is done with once this returns. packets of
+	 * one stream rarely arrive on several CPUs at once, so the lock is hardly contended */
+	spin_lock_irqsave(&c->aead_lock, flags);
+	req = c->aead_req;
+	aead_request_set_ad(req, r->header_len);
+	aead_request_set_crypt(req, &sg, &sg, crypt_len, iv);
+	ret = enc ? crypto_aead_encrypt(req) : crypto_aead_decrypt(req);
+	spin_unlock_irqrestore(&c->aead_lock, flags);
+
+	return ret;
+}
+
+static int srtp_encrypt_aes_gcm(struct re_crypto_context *c,
+		struct rtpengine_srtp *s, struct rtp_parsed *r,
+		u_int64_t pkt_idx)
+{
+	unsigned int tag_len = c->cipher->aead_tag_len;
+
+	if (aes_gcm_crypt(c, r, pkt_idx, r->payload_len, r->payload_len + tag_len, 1))
+		return -1;
+	r->payload_len += tag_len;
+	return 0;
+}
+
+static int srtp_decrypt_aes_gcm(struct re_crypto_context *c,
+		struct rtpengine_srtp *s, struct rtp_parsed *r,
+		u_int64_t pkt_idx)
+{
+	unsigned int tag_len = c->cipher->aead_tag_len;
+	unsigned char tag[16];
+
+	if (r->payload_len < tag_len)
+		return -1;
+
+	if (!aes_gcm_crypt(c, r, pkt_idx, r->payload_len, r->payload_len, 0)) {
+		r->payload_len -= tag_len;
+		return 0;
+	}
+
+	/* the payload has been decrypted in place regardless. restore the original
+	 * packet for userspace by encrypting again, but keep the received tag */
+	memcpy(tag, r->payload + r->payload_len - tag_len, tag_len);
+	aes_gcm_crypt(c, r, pkt_idx, r->payload_len - tag_len, r->payload_len, 1);
+	memcpy(r->payload + r->payload_len - tag_len, tag, tag_len);
+	return -1;
+}
+
 static int srtp_encrypt_aes_f8(struct re_crypto_context *c,
 		struct rtpengine_srtp *s, struct rtp_parsed *r,
 		u_int64_t pkt_idx)
@@ -4046,7 +4419,7 @@ not_rtp:
 		err = send_proxy_packet(skb2, &g->target.src_addr, &g->target.mirror_addr, g->target.tos,
 				par);
 		if (err)
-			atomic64_inc(&g->stats.errors);
+			atomic64_inc(&g->stats->errors);
 	}
 
 	if (g->target.do_intercept) {
@@ -4077,25 +4450,32 @@ no_intercept:
 
 		pkt_idx = packet_index(&g->encrypt, &g->target.encrypt, rtp.header);
 		srtp_encrypt(&g->encrypt, &g->target.encrypt, &rtp, pkt_idx);
-		skb_put(skb, g->target.encrypt.mki_len + g->target.encrypt.auth_tag_len);
+		skb_put(skb, g->target.encrypt.mki_len + g->target.encrypt.auth_tag_len
+				+ g->encrypt.cipher->aead_tag_len);
 		srtp_authenticate(&g->encrypt, &g->target.encrypt, &rtp, pkt_idx);
 	}
 
 	err = send_proxy_packet(skb, &g->target.src_addr, &g->target.dst_addr, g->target.tos, par);
 
-	if (atomic64_read(&g->stats.packets)==0)
-		atomic_set(&g->stats.in_tos,in_tos);
+	if (rtp.ok) {
+		/* unlocked, for user space reading them from the stats area only */
+		g->stats->decrypt_last_index = g->target.decrypt.last_index;
+		g->stats->encrypt_last_index = g->target.encrypt.last_index;
+	}
+
+	if (atomic64_read(&g->stats->packets)==0)
+		atomic_set(&g->stats->in_tos,in_tos);
 
 	if (err)
-		atomic64_inc(&g->stats.errors);
+		atomic64_inc(&g->stats->errors);
 	else {
-		atomic64_inc(&g->stats.packets);
-		atomic64_add(datalen, &g->stats.bytes);
+		atomic64_inc(&g->stats->packets);
+		atomic64_add(datalen, &g->stats->bytes);
 	}
 
 	if (rtp_pt_idx >= 0) {
-		atomic64_inc(&g->rtp_stats[rtp_pt_idx].packets);
-		atomic64_add(datalen, &g->rtp_stats[rtp_pt_idx].bytes);
+		atomic64_inc(&g->stats->rtp_stats[rtp_pt_idx].packets);
+		atomic64_add(datalen, &g->stats->rtp_stats[rtp_pt_idx].bytes);
 
 #if (RE_HAS_MEASUREDELAY)
 		starttime = ktime_to_ns(skb->tstamp);
@@ -4104,28 +4484,28 @@ no_intercept:
 		delay = endtime - starttime;
 
 		/* XXX needs locking - not atomic */
-		if (atomic64_read(&g->stats.packets)==1) {
-			g->stats.delay_min=delay;
-			g->stats.delay_avg=delay;
-			g->stats.delay_max=delay;
+		if (atomic64_read(&g->stats->packets)==1) {
+			g->stats->delay_min=delay;
+			g->stats->delay_avg=delay;
+			g->stats->delay_max=delay;
 		} else {
-			if (g->stats.delay_min > delay) {
-				g->stats.delay_min = delay;
+			if (g->stats->delay_min > delay) {
+				g->stats->delay_min = delay;
 			}
-			if (g->stats.delay_max < delay) {
-				g->stats.delay_max = delay;
+			if (g->stats->delay_max < delay) {
+				g->stats->delay_max = delay;
 			}
 
-			g->stats.delay_avg = g->stats.delay_avg * (atomic64_read(&g->stats.packets)-1);
-			g->stats.delay_avg = g->stats.delay_avg + delay;
-			g->stats.delay_avg = g->stats.delay_avg / atomic64_read(&g->stats.packets);
+			g->stats->delay_avg = g->stats->delay_avg * (atomic64_read(&g->stats->packets)-1);
+			g->stats->delay_avg = g->stats->delay_avg + delay;
+			g->stats->delay_avg = g->stats->delay_avg / atomic64_read(&g->stats->packets);
 		}
 #endif
 	}
 	else if (rtp_pt_idx == -2)
 		/* not RTP */ ;
 	else if (rtp_pt_idx == -1)
-		atomic64_inc(&g->stats.errors);
+		atomic64_inc(&g->stats->errors);
 
 	target_put(g);
 	table_put(t);
@@ -4134,7 +4514,7 @@ no_intercept:
 
 skip_error:
 	log_err("x_tables action failed: %s", errstr);
-	atomic64_inc(&g->stats.errors);
+	atomic64_inc(&g->stats->errors);
 skip1:
 	target_put(g);
 skip2:
@@ -4285,6 +4665,8 @@ static int __init init(void) {
 	int ret;
 	const char *err;
 
+	BUILD_BUG_ON(sizeof(struct rtpengine_stats_a) != sizeof(struct rtpengine_stats_slot));
+
 	err = "stream_packets_list_limit parameter must be larger than 0";
 	ret = -EINVAL;
 	if (stream_packets_list_limit <= 0)
@@ -4343,6 +4725,10 @@ static void __exit fini(void) {
 
 	auto_array_free(&streams);
 	auto_array_free(&calls);
+
+	/* pending stats_slot_release_rcu(), a pending stats_slot_release_work() holds
+	 * a table and thereby a module reference */
+	rcu_barrier();
 }
 
 module_init(init);
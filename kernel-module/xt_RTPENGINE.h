@@ -25,6 +25,28 @@ struct rtpengine_rtp_stats {
 	u_int64_t			bytes;
 };
 
+// One of these per kernel target, in a shared area that the daemon maps from
+// /proc/rtpengine/<id>/stats. The slot is chosen by the daemon when adding the
+// target (stats_idx). The counters are updated by the kernel in place; the target
+// parameters below them are copied from the target when it's added or updated.
+struct rtpengine_stats_slot {
+	u_int64_t			packets;
+	u_int64_t			bytes;
+	u_int64_t			errors;
+	u_int64_t			delay_min;
+	u_int64_t			delay_avg;
+	u_int64_t			delay_max;
+	u_int64_t			decrypt_last_index;
+	u_int64_t			encrypt_last_index;
+	u_int32_t			in_tos;
+
+	u_int32_t			ssrc;
+	u_int32_t			non_forwarding;
+	u_int32_t			num_payload_types;
+	unsigned char			payload_types[NUM_PAYLOAD_TYPES];
+	struct rtpengine_rtp_stats	rtp_stats[NUM_PAYLOAD_TYPES];
+};
+
 struct re_address {
 	int				family;
 	union {
@@ -45,6 +67,8 @@ enum rtpengine_cipher {
 	REC_AES_F8,
 	REC_AES_CM_192,
 	REC_AES_CM_256,
+	REC_AEAD_AES_GCM_128,
+	REC_AEAD_AES_GCM_256,
 
 	__REC_LAST
 };
@@ -97,6 +121,8 @@ struct rtpengine_target_info {
 	unsigned char			payload_types[NUM_PAYLOAD_TYPES]; /* must be sorted */
 	unsigned int			num_payload_types;
 
+	unsigned int			stats_idx; // slot in the shared stats area, if stats_slot is set
+
 	unsigned char			tos;
 	int				rtcp_mux:1,
 					dtls:1,
@@ -105,7 +131,8 @@ struct rtpengine_target_info {
 					rtp_only:1,
 					do_intercept:1,
 					transcoding:1, // SSRC subst and RTP PT filtering
-					non_forwarding:1; // empty src/dst addr
+					non_forwarding:1, // empty src/dst addr
+					stats_slot:1;
 };
 
 struct rtpengine_call_info {
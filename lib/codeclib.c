@@ -20,6 +20,8 @@
 
 
 #define PACKET_SEQ_DUPE_THRES 100
+#define PACKET_SEQ_DEPTH 128 // reordering window, must not be less than PACKET_SEQ_DUPE_THRES
+#define PACKET_SEQ_MAX_DEPTH 0x8000
 #define PACKET_TS_RESET_THRES 5000 // milliseconds
 
 
@@ -52,9 +54,12 @@ static void avc_def_init(codec_def_t *);
 static const char *avc_decoder_init(decoder_t *, const str *);
 static int avc_decoder_input(decoder_t *dec, const str *data, GQueue *out);
 static void avc_decoder_close(decoder_t *);
+static int avc_decoder_reset(decoder_t *);
 static const char *avc_encoder_init(encoder_t *enc, const str *);
 static int avc_encoder_input(encoder_t *enc, AVFrame **frame);
 static void avc_encoder_close(encoder_t *enc);
+static int avc_encoder_reset(encoder_t *enc);
+static void avc_encoder_flush(encoder_t *enc);
 
 static int amr_decoder_input(decoder_t *dec, const str *data, GQueue *out);
 static int ilbc_decoder_input(decoder_t *dec, const str *data, GQueue *out);
@@ -62,6 +67,14 @@ static int ilbc_decoder_input(decoder_t *dec, const str *data, GQueue *out);
 static const char *dtmf_decoder_init(decoder_t *, const str *);
 static int dtmf_decoder_input(decoder_t *dec, const str *data, GQueue *out);
 
+static void g711_def_init(codec_def_t *);
+static const char *g711_decoder_init(decoder_t *, const str *);
+static int g711_decoder_input(decoder_t *dec, const str *data, GQueue *out);
+static int g711_decoder_reset(decoder_t *);
+static const char *g711_encoder_init(encoder_t *enc, const str *);
+static int g711_encoder_input(encoder_t *enc, AVFrame **frame);
+static int g711_encoder_reset(encoder_t *);
+
 
 
 
@@ -70,9 +83,12 @@ static const codec_type_t codec_type_avcodec = {
 	.decoder_init = avc_decoder_init,
 	.decoder_input = avc_decoder_input,
 	.decoder_close = avc_decoder_close,
+	.decoder_reset = avc_decoder_reset,
 	.encoder_init = avc_encoder_init,
 	.encoder_input = avc_encoder_input,
 	.encoder_close = avc_encoder_close,
+	.encoder_reset = avc_encoder_reset,
+	.encoder_flush = avc_encoder_flush,
 };
 static const codec_type_t codec_type_ilbc = {
 	.def_init = avc_def_init,
@@ -82,6 +98,7 @@ static const codec_type_t codec_type_ilbc = {
 	.encoder_init = avc_encoder_init,
 	.encoder_input = avc_encoder_input,
 	.encoder_close = avc_encoder_close,
+	.encoder_flush = avc_encoder_flush,
 };
 static const codec_type_t codec_type_amr = {
 	.def_init = avc_def_init,
@@ -91,11 +108,21 @@ static const codec_type_t codec_type_amr = {
 	.encoder_init = avc_encoder_init,
 	.encoder_input = avc_encoder_input,
 	.encoder_close = avc_encoder_close,
+	.encoder_flush = avc_encoder_flush,
 };
 static const codec_type_t codec_type_dtmf = {
 	.decoder_init = dtmf_decoder_init,
 	.decoder_input = dtmf_decoder_input,
 };
+static const codec_type_t codec_type_g711 = {
+	.def_init = g711_def_init,
+	.decoder_init = g711_decoder_init,
+	.decoder_input = g711_decoder_input,
+	.decoder_reset = g711_decoder_reset,
+	.encoder_init = g711_encoder_init,
+	.encoder_input = g711_encoder_input,
+	.encoder_reset = g711_encoder_reset,
+};
 
 #ifdef HAVE_BCG729
 static packetizer_f packetizer_g729; // aggregate some frames into packets
@@ -132,7 +159,8 @@ static codec_def_t __codec_defs[] = {
 		.packetizer = packetizer_samplestream,
 		.bits_per_sample = 8,
 		.media_type = MT_AUDIO,
-		.codec_type = &codec_type_avcodec,
+		.codec_type = &codec_type_g711,
+		.reusable = 1,
 	},
 	{
 		.rtpname = "PCMU",
@@ -144,7 +172,8 @@ static codec_def_t __codec_defs[] = {
 		.packetizer = packetizer_samplestream,
 		.bits_per_sample = 8,
 		.media_type = MT_AUDIO,
-		.codec_type = &codec_type_avcodec,
+		.codec_type = &codec_type_g711,
+		.reusable = 1,
 	},
 	{
 		.rtpname = "G723",
@@ -278,6 +307,8 @@ static codec_def_t __codec_defs[] = {
 		.codec_type = &codec_type_avcodec,
 		.init = opus_init,
 		.set_enc_options = opus_set_enc_options,
+		.reusable = 1,
+		.complexity = 1,
 	},
 	{
 		.rtpname = "vorbis",
@@ -426,6 +457,8 @@ static codec_def_t __codec_defs[] = {
 
 
 
+int encoder_complexity = -1;
+
 static GHashTable *codecs_ht;
 static GHashTable *codecs_ht_by_av;
 
@@ -550,6 +583,31 @@ void decoder_close(decoder_t *dec) {
 }
 
 
+static int avc_decoder_reset(decoder_t *dec) {
+	if (!dec->u.avc.avcctx)
+		return -1;
+	avcodec_flush_buffers(dec->u.avc.avcctx);
+	return 0;
+}
+
+
+// returns the decoder to the state it was in after decoder_new_fmtp(), or -1 if that's not possible
+int decoder_reset(decoder_t *dec) {
+	if (!dec->def->reusable || !dec->def->codec_type->decoder_reset)
+		return -1;
+	if (dec->def->codec_type->decoder_reset(dec))
+		return -1;
+
+	// drops any samples buffered in the resampler
+	if (dec->resampler.swresample && swr_init(dec->resampler.swresample) < 0)
+		resample_shutdown(&dec->resampler);
+
+	dec->pts = (uint64_t) -1LL;
+	dec->rtp_ts = (unsigned long) -1L;
+	return 0;
+}
+
+
 static int avc_decoder_input(decoder_t *dec, const str *data, GQueue *out) {
 	const char *err;
 	int av_ret = 0;
@@ -690,7 +748,12 @@ int decoder_input_data(decoder_t *dec, const str *data, unsigned long ts,
 	AVFrame *frame;
 	int ret = 0;
 	while ((frame = g_queue_pop_head(&frames))) {
-		AVFrame *rsmp_frame = resample_frame(&dec->resampler, frame, &dec->out_format);
+		AVFrame *rsmp_frame = resample_frame_noalloc(&dec->resampler, frame, &dec->out_format);
+		// the callback takes ownership of the frame
+		if (rsmp_frame == frame)
+			frame = NULL;
+		else if (rsmp_frame)
+			rsmp_frame = av_frame_clone(rsmp_frame);
 		if (!rsmp_frame) {
 			ilog(LOG_ERR | LOG_FLAG_LIMIT, "Resampling failed");
 			ret = -1;
@@ -837,103 +900,87 @@ void codeclib_init(int print) {
 
 
 
-static int ptr_cmp(const void *a, const void *b, void *dummy) {
-	if (a < b)
-		return -1;
-	if (a > b)
-		return 1;
-	return 0;
-}
+void __packet_sequencer_init_depth(packet_sequencer_t *ps, GDestroyNotify ffunc, unsigned int depth) {
+	// power of two, so that the slot is simply the lower bits of the seq
+	unsigned int d = 2;
+	while (d < depth && d < PACKET_SEQ_MAX_DEPTH)
+		d <<= 1;
 
-void __packet_sequencer_init(packet_sequencer_t *ps, GDestroyNotify ffunc) {
-	ps->packets = g_tree_new_full(ptr_cmp, NULL, NULL, ffunc);
+	ps->packets = g_malloc0(sizeof(*ps->packets) * d);
+	ps->ffunc = ffunc;
+	ps->depth = d;
+	ps->count = 0;
 	ps->seq = -1;
 }
+void __packet_sequencer_init(packet_sequencer_t *ps, GDestroyNotify ffunc) {
+	__packet_sequencer_init_depth(ps, ffunc, PACKET_SEQ_DEPTH);
+}
+static void packet_sequencer_clear(packet_sequencer_t *ps) {
+	for (unsigned int i = 0; ps->count && i < ps->depth; i++) {
+		if (!ps->packets[i])
+			continue;
+		if (ps->ffunc)
+			ps->ffunc(ps->packets[i]);
+		ps->packets[i] = NULL;
+		ps->count--;
+	}
+}
 void packet_sequencer_destroy(packet_sequencer_t *ps) {
-	if (ps->packets)
-		g_tree_destroy(ps->packets);
+	if (!ps->packets)
+		return;
+	packet_sequencer_clear(ps);
+	g_free(ps->packets);
 	ps->packets = NULL;
 }
-struct tree_searcher {
-	int find_seq,
-	    found_seq;
-};
-static int packet_tree_search(const void *testseq_p, const void *ts_p) {
-	struct tree_searcher *ts = (void *) ts_p;
-	int testseq = GPOINTER_TO_INT(testseq_p);
-	// called as a binary search test function. we're looking for the lowest
-	// seq number that is higher than find_seq. if our test number is too low,
-	// we proceed with higher numbers. if it's too high, we proceed to the lower
-	// numbers, but remember the lowest we've seen along that path.
-	if (G_UNLIKELY(testseq == ts->find_seq)) {
-		// we've struck gold
-		ts->found_seq = testseq;
-		return 0;
-	}
-	if (testseq < ts->find_seq)
-		return 1;
-	// testseq > ts->find_seq
-	if (ts->found_seq == -1 || testseq < ts->found_seq)
-		ts->found_seq = testseq;
-	return -1;
+// queued packets are always within `depth` of the next expected seq, so each seq maps to
+// a unique slot
+INLINE seq_packet_t **__packet_sequencer_slot(packet_sequencer_t *ps, int seq) {
+	return &ps->packets[seq & (ps->depth - 1)];
 }
 // caller must take care of locking
-static void *__packet_sequencer_next_packet(packet_sequencer_t *ps, int num_wait) {
+static void *__packet_sequencer_next_packet(packet_sequencer_t *ps, unsigned int num_wait) {
+	if (G_UNLIKELY(ps->seq == -1))
+		return NULL;
+
 	// see if we have a packet with the correct seq nr in the queue
-	seq_packet_t *packet = g_tree_lookup(ps->packets, GINT_TO_POINTER(ps->seq));
-	if (G_LIKELY(packet != NULL)) {
+	seq_packet_t **slot = __packet_sequencer_slot(ps, ps->seq);
+	if (G_LIKELY(*slot != NULL)) {
 		dbg("returning in-sequence packet (seq %i)", ps->seq);
 		goto out;
 	}
 
 	// why not? do we have anything? (we should)
-	int nnodes = g_tree_nnodes(ps->packets);
-	if (G_UNLIKELY(nnodes == 0)) {
+	if (G_UNLIKELY(ps->count == 0)) {
 		dbg("packet queue empty");
 		return NULL;
 	}
-	if (G_LIKELY(nnodes < num_wait)) {
-		dbg("only %i packets in queue - waiting for more", nnodes);
+	if (G_LIKELY(ps->count < num_wait)) {
+		dbg("only %u packets in queue - waiting for more", ps->count);
 		return NULL; // need to wait for more
 	}
 
-	// packet was probably lost. search for the next highest seq
-	struct tree_searcher ts = { .find_seq = ps->seq + 1, .found_seq = -1 };
-	packet = g_tree_search(ps->packets, packet_tree_search, &ts);
-	if (packet) {
-		// bullseye
-		dbg("lost packet - returning packet with next seq %i", packet->seq);
-		goto out;
-	}
-	if (G_UNLIKELY(ts.found_seq == -1)) {
-		// didn't find anything. seq must have wrapped around. retry
-		// starting from zero
-		ts.find_seq = 0;
-		packet = g_tree_search(ps->packets, packet_tree_search, &ts);
-		if (packet) {
-			dbg("lost packet - returning packet with next seq %i (after wrap)", packet->seq);
+	// packet was probably lost. return the next one we have
+	for (unsigned int i = 1; i < ps->depth; i++) {
+		slot = __packet_sequencer_slot(ps, ps->seq + i);
+		if (*slot) {
+			dbg("lost packet - returning packet with next seq %i", (*slot)->seq);
 			goto out;
 		}
-		if (G_UNLIKELY(ts.found_seq == -1))
-			abort();
 	}
-
-	// pull out the packet we found
-	packet = g_tree_lookup(ps->packets, GINT_TO_POINTER(ts.found_seq));
-	if (G_UNLIKELY(packet == NULL))
-		abort();
-
-	dbg("lost multiple packets - returning packet with next highest seq %i", packet->seq);
+	abort(); // count was non-zero
 
 out:
 	;
+	seq_packet_t *packet = *slot;
+	*slot = NULL;
+	ps->count--;
+
 	u_int16_t l = packet->seq - ps->seq;
 	ps->lost_count += l;
 
-	g_tree_steal(ps->packets, GINT_TO_POINTER(packet->seq));
 	ps->seq = (packet->seq + 1) & 0xffff;
 
-	if (packet->seq < ps->ext_seq)
+	if (packet->seq < (ps->ext_seq & 0xffff))
 		ps->roc++;
 	ps->ext_seq = ps->roc << 16 | packet->seq;
 
@@ -947,7 +994,9 @@ void *packet_sequencer_force_next_packet(packet_sequencer_t *ps) {
 }
 
 int packet_sequencer_next_ok(packet_sequencer_t *ps) {
-	if (g_tree_lookup(ps->packets, GINT_TO_POINTER(ps->seq)))
+	if (G_UNLIKELY(ps->seq == -1))
+		return 0;
+	if (*__packet_sequencer_slot(ps, ps->seq))
 		return 1;
 	return 0;
 }
@@ -962,30 +1011,35 @@ int packet_sequencer_insert(packet_sequencer_t *ps, seq_packet_t *p) {
 		goto seq_ok;
 	}
 
-	int diff = p->seq - ps->seq;
-	// early packet: p->seq = 200, ps->seq = 150, diff = 50
-	if (G_LIKELY(diff >= 0 && diff < PACKET_SEQ_DUPE_THRES))
-		goto seq_ok;
-	// early packet with wrap-around: p->seq = 20, ps->seq = 65530, diff = -65510
-	if (diff < (-0xffff + PACKET_SEQ_DUPE_THRES))
+	// the ring can only hold packets up to `depth` ahead
+	unsigned int window = MIN(ps->depth, PACKET_SEQ_DUPE_THRES);
+
+	// early packet, possibly with wrap-around: p->seq = 200, ps->seq = 150, ahead = 50
+	u_int16_t ahead = p->seq - ps->seq;
+	if (G_LIKELY(ahead < window))
 		goto seq_ok;
-	// recent duplicate: p->seq = 1000, ps->seq = 1080, diff = -80
-	if (diff < 0 && diff > -PACKET_SEQ_DUPE_THRES)
-		return -1;
-	// recent duplicate after wrap-around: p->seq = 65530, ps->seq = 30, diff = 65500
-	if (diff > (0xffff - PACKET_SEQ_DUPE_THRES))
+	// recent duplicate or late packet: p->seq = 1000, ps->seq = 1080, behind = 80
+	u_int16_t behind = ps->seq - p->seq;
+	if (behind < PACKET_SEQ_DUPE_THRES) {
+		ps->late_count++;
 		return -1;
+	}
 
 	// everything else we consider a seq reset
 	ilog(LOG_DEBUG, "Seq reset detected: expected seq %i, received seq %i", ps->seq, p->seq);
 	ps->seq = p->seq;
 	ret = 1;
 	// seq ok - fall through
-	g_tree_clear(ps->packets);
+	packet_sequencer_clear(ps);
 seq_ok:
-	if (g_tree_lookup(ps->packets, GINT_TO_POINTER(p->seq)))
+	;
+	seq_packet_t **slot = __packet_sequencer_slot(ps, p->seq);
+	if (*slot) {
+		ps->dupe_count++;
 		return -1;
-	g_tree_insert(ps->packets, GINT_TO_POINTER(p->seq), p);
+	}
+	*slot = p;
+	ps->count++;
 
 	return ret;
 }
@@ -1035,6 +1089,8 @@ static const char *avc_encoder_init(encoder_t *enc, const str *fmtp) {
 		enc->samples_per_frame = enc->u.avc.avcctx->frame_size;
 	enc->samples_per_packet = enc->samples_per_frame;
 
+	enc->complexity = g_atomic_int_get(&encoder_complexity);
+
 	if (enc->def->set_enc_options)
 		enc->def->set_enc_options(enc, fmtp);
 
@@ -1072,6 +1128,8 @@ int encoder_config_fmtp(encoder_t *enc, const codec_def_t *def, int bitrate, int
 	enc->def = def;
 	enc->ptime = ptime / def->clockrate_mult;
 	enc->bitrate = bitrate;
+	if (fmtp)
+		enc->fmtp = str_dup(fmtp);
 
 	err = def->codec_type->encoder_init ? def->codec_type->encoder_init(enc, fmtp) : 0;
 	if (err)
@@ -1130,6 +1188,8 @@ void encoder_close(encoder_t *enc) {
 	format_init(&enc->actual_format);
 	av_audio_fifo_free(enc->fifo);
 	av_frame_free(&enc->frame);
+	free(enc->fmtp);
+	enc->fmtp = NULL;
 	enc->mux_dts = 0;
 	enc->fifo = NULL;
 	enc->fifo_pts = 0;
@@ -1139,6 +1199,44 @@ void encoder_free(encoder_t *enc) {
 	g_slice_free1(sizeof(*enc), enc);
 }
 
+static int avc_encoder_reset(encoder_t *enc) {
+	if (!enc->u.avc.avcctx)
+		return -1;
+	// nothing buffered inside the codec
+	if (!(enc->u.avc.codec->capabilities & AV_CODEC_CAP_DELAY))
+		return 0;
+#ifdef AV_CODEC_CAP_ENCODER_FLUSH
+	if ((enc->u.avc.codec->capabilities & AV_CODEC_CAP_ENCODER_FLUSH)) {
+		avcodec_flush_buffers(enc->u.avc.avcctx);
+		return 0;
+	}
+#endif
+	return -1;
+}
+
+// signals the end of input, so that the codec hands out everything it still holds
+static void avc_encoder_flush(encoder_t *enc) {
+#if LIBAVCODEC_VERSION_INT >= AV_VERSION_INT(57, 36, 0)
+	if (enc->u.avc.avcctx)
+		avcodec_send_frame(enc->u.avc.avcctx, NULL);
+#endif
+}
+
+// returns the encoder to the state it was in after encoder_config_fmtp(), or -1 if that's not possible
+int encoder_reset(encoder_t *enc) {
+	if (!enc->def || !enc->def->reusable || !enc->def->codec_type->encoder_reset)
+		return -1;
+	if (enc->def->codec_type->encoder_reset(enc))
+		return -1;
+
+	if (enc->fifo)
+		av_audio_fifo_reset(enc->fifo);
+	av_packet_unref(&enc->avpkt);
+	enc->fifo_pts = 0;
+	enc->mux_dts = 0;
+	return 0;
+}
+
 static int avc_encoder_input(encoder_t *enc, AVFrame **frame) {
 	int keep_going = 0;
 	int got_packet = 0;
@@ -1172,8 +1270,8 @@ static int avc_encoder_input(encoder_t *enc, AVFrame **frame) {
 		got_packet = 1;
 	}
 	else {
-		if (av_ret == AVERROR(EAGAIN))
-			; // try again if there's still more input
+		if (av_ret == AVERROR(EAGAIN) || av_ret == AVERROR_EOF)
+			; // try again if there's still more input, or flushed out
 		else
 			goto err;
 	}
@@ -1214,9 +1312,39 @@ err:
 	return -1;
 }
 
+// replaces the codec context only, so that the fifo and the timestamps carry on. the old
+// context is drained through the callback first, and the new one gets the original fmtp.
+static int encoder_reopen(encoder_t *enc,
+		int (*callback)(encoder_t *, void *u1, void *u2), void *u1, void *u2)
+{
+	ilog(LOG_DEBUG, "Reopening %s encoder with complexity %i", enc->def->rtpname,
+			g_atomic_int_get(&encoder_complexity));
+
+	if (enc->def->codec_type->encoder_flush)
+		enc->def->codec_type->encoder_flush(enc);
+	encoder_input_data(enc, NULL, callback, u1, u2);
+
+	enc->def->codec_type->encoder_close(enc);
+	const char *err = enc->def->codec_type->encoder_init(enc, enc->fmtp);
+	if (!err)
+		return 0;
+
+	enc->complexity = -2; // try again next time
+	ilog(LOG_ERR | LOG_FLAG_LIMIT, "Error reconfiguring media output for codec %s: %s",
+			enc->def->rtpname, err);
+	return -1;
+}
+
 int encoder_input_data(encoder_t *enc, AVFrame *frame,
 		int (*callback)(encoder_t *, void *u1, void *u2), void *u1, void *u2)
 {
+	if (G_UNLIKELY(frame && enc->def->complexity
+				&& enc->complexity != g_atomic_int_get(&encoder_complexity)))
+	{
+		if (encoder_reopen(enc, callback, u1, u2))
+			return -1;
+	}
+
 	enc->avpkt.size = 0;
 
 	while (1) {
@@ -1368,6 +1496,8 @@ static void opus_set_enc_options(encoder_t *enc, const str *fmtp) {
 						AV_OPT_SEARCH_CHILDREN)))
 			ilog(LOG_WARN, "Failed to set Opus frame_duration option to %i: %s",
 					enc->ptime, av_error(ret));
+	if (enc->complexity >= 0)
+		enc->u.avc.avcctx->compression_level = enc->complexity;
 	// XXX additional opus options
 }
 
@@ -1714,6 +1844,162 @@ static int packetizer_amr(AVPacket *pkt, GString *buf, str *output, encoder_t *e
 
 
 
+// G.711 is done natively through lookup tables instead of going through libavcodec. Encoding
+// only looks at the top 14 bits of each sample, so the tables are indexed by those. The tables
+// are built the same way as libavcodec does it, so that the output doesn't change.
+static int16_t g711_alaw_s16[256], g711_ulaw_s16[256];
+static unsigned char g711_s16_alaw[1 << 14], g711_s16_ulaw[1 << 14];
+static unsigned char g711_alaw_ulaw[256], g711_ulaw_alaw[256];
+
+static int16_t __alaw2linear(unsigned char a) {
+	a ^= 0x55;
+	int t = (a & 0x0f) << 4;
+	int seg = (a & 0x70) >> 4;
+	if (seg == 0)
+		t += 8;
+	else
+		t = (t + 0x108) << (seg - 1);
+	return (a & 0x80) ? t : -t;
+}
+static int16_t __ulaw2linear(unsigned char u) {
+	u = ~u;
+	int t = ((u & 0x0f) << 3) + 0x84;
+	t <<= (u & 0x70) >> 4;
+	return (u & 0x80) ? (0x84 - t) : (t - 0x84);
+}
+// picks the nearest code for each 14-bit value, with 0 in the middle of the table
+static void __g711_encode_table(unsigned char *out, int16_t (*decode)(unsigned char), unsigned char mask) {
+	int j = 1;
+
+	out[8192] = mask;
+	for (int i = 0; i < 127; i++) {
+		int v1 = decode(i ^ mask);
+		int v2 = decode((i + 1) ^ mask);
+		int v = (v1 + v2 + 4) >> 3;
+		for (; j < v; j++) {
+			out[8192 - j] = i ^ (mask ^ 0x80);
+			out[8192 + j] = i ^ mask;
+		}
+	}
+	for (; j < 8192; j++) {
+		out[8192 - j] = 127 ^ (mask ^ 0x80);
+		out[8192 + j] = 127 ^ mask;
+	}
+	out[0] = out[1];
+}
+INLINE unsigned char __g711_encode(const unsigned char *table, int16_t s) {
+	return table[(s + 32768) >> 2];
+}
+
+static void g711_def_init(codec_def_t *def) {
+	static int tables_done;
+
+	if (!tables_done) {
+		for (int i = 0; i < 256; i++) {
+			g711_alaw_s16[i] = __alaw2linear(i);
+			g711_ulaw_s16[i] = __ulaw2linear(i);
+		}
+		__g711_encode_table(g711_s16_alaw, __alaw2linear, 0xd5);
+		__g711_encode_table(g711_s16_ulaw, __ulaw2linear, 0xff);
+		// same result as decoding and encoding again
+		for (int i = 0; i < 256; i++) {
+			g711_alaw_ulaw[i] = __g711_encode(g711_s16_ulaw, g711_alaw_s16[i]);
+			g711_ulaw_alaw[i] = __g711_encode(g711_s16_alaw, g711_ulaw_s16[i]);
+		}
+		tables_done = 1;
+	}
+
+	def->support_encoding = 1;
+	def->support_decoding = 1;
+}
+
+INLINE int g711_is_alaw(const codec_def_t *def) {
+	return def->avcodec_id == AV_CODEC_ID_PCM_ALAW;
+}
+
+const unsigned char *g711_transcode_table(const codec_def_t *src, const codec_def_t *dst) {
+	if (!src || !dst || src == dst)
+		return NULL;
+	if (src->codec_type != &codec_type_g711 || dst->codec_type != &codec_type_g711)
+		return NULL;
+	return g711_is_alaw(src) ? g711_alaw_ulaw : g711_ulaw_alaw;
+}
+
+static const char *g711_decoder_init(decoder_t *dec, const str *fmtp) {
+	if (dec->in_format.channels <= 0)
+		return "invalid number of channels";
+	return NULL;
+}
+
+static int g711_decoder_input(decoder_t *dec, const str *data, GQueue *out) {
+	const int16_t *table = g711_is_alaw(dec->def) ? g711_alaw_s16 : g711_ulaw_s16;
+	unsigned int samples = data->len / dec->in_format.channels;
+	if (!samples)
+		return 0;
+
+	AVFrame *frame = av_frame_alloc();
+	frame->nb_samples = samples;
+	frame->format = AV_SAMPLE_FMT_S16;
+	frame->sample_rate = dec->in_format.clockrate;
+	frame->channel_layout = av_get_default_channel_layout(dec->in_format.channels);
+	frame->pts = dec->pts;
+	if (av_frame_get_buffer(frame, 0) < 0)
+		abort();
+
+	const unsigned char *in = (unsigned char *) data->s;
+	int16_t *s16 = (int16_t *) frame->extended_data[0];
+	unsigned int len = samples * dec->in_format.channels;
+	for (unsigned int i = 0; i < len; i++)
+		s16[i] = table[in[i]];
+
+	g_queue_push_tail(out, frame);
+	return 0;
+}
+
+static int g711_decoder_reset(decoder_t *dec) {
+	return 0; // stateless
+}
+
+static const char *g711_encoder_init(encoder_t *enc, const str *fmtp) {
+	enc->actual_format = enc->requested_format;
+	enc->actual_format.format = AV_SAMPLE_FMT_S16;
+	if (enc->actual_format.channels <= 0)
+		return "invalid number of channels";
+
+	enc->samples_per_frame = enc->actual_format.clockrate * enc->ptime / 1000;
+	enc->samples_per_packet = enc->samples_per_frame;
+
+	return NULL;
+}
+
+static int g711_encoder_input(encoder_t *enc, AVFrame **frame) {
+	if (!*frame)
+		return 0;
+
+	const unsigned char *table = g711_is_alaw(enc->def) ? g711_s16_alaw : g711_s16_ulaw;
+	unsigned int len = (*frame)->nb_samples * enc->actual_format.channels;
+
+	if (av_new_packet(&enc->avpkt, len) < 0)
+		return -1;
+
+	const int16_t *s16 = (const int16_t *) (*frame)->extended_data[0];
+	unsigned char *out = enc->avpkt.data;
+	for (unsigned int i = 0; i < len; i++)
+		out[i] = __g711_encode(table, s16[i]);
+
+	enc->avpkt.pts = (*frame)->pts;
+	enc->avpkt.dts = (*frame)->pts;
+
+	return 0;
+}
+
+static int g711_encoder_reset(encoder_t *enc) {
+	return 0; // stateless
+}
+
+
+
+
 #ifdef HAVE_BCG729
 static void bcg729_def_init(codec_def_t *def) {
 	// test init
@@ -78,10 +78,13 @@ struct codec_type_s {
 	const char *(*decoder_init)(decoder_t *, const str *);
 	int (*decoder_input)(decoder_t *, const str *data, GQueue *);
 	void (*decoder_close)(decoder_t *);
+	int (*decoder_reset)(decoder_t *); // optional
 
 	const char *(*encoder_init)(encoder_t *, const str *);
 	int (*encoder_input)(encoder_t *, AVFrame **);
 	void (*encoder_close)(encoder_t *);
+	int (*encoder_reset)(encoder_t *); // optional
+	void (*encoder_flush)(encoder_t *); // optional, end of input before encoder_close
 };
 
 union codec_options_u {
@@ -122,7 +125,9 @@ struct codec_def_s {
 
 	// flags
 	int supplemental:1,
-	    dtmf:1; // special case
+	    dtmf:1, // special case
+	    reusable:1, // no state is left over after a reset, so instances can be reused
+	    complexity:1; // encoder honours `encoder_complexity`
 
 	const codec_type_t *codec_type;
 
@@ -139,6 +144,9 @@ struct format_s {
 
 struct resample_s {
 	SwrContext *swresample;
+	int low_quality; // `resample_low_quality` when the context was set up
+	AVFrame *out_frame; // reused for converted output
+	int out_samples; // capacity of out_frame
 };
 
 struct decoder_s {
@@ -195,14 +203,21 @@ struct encoder_s {
 	int samples_per_packet; // for frame packetizer
 	AVFrame *frame; // to pull samples from the fifo
 	int64_t mux_dts; // last dts passed to muxer
+	int complexity; // `encoder_complexity` when the encoder was opened
+	str *fmtp; // as configured, for reopening
 };
 
 struct seq_packet_s {
 	int seq;
 };
 struct packet_sequencer_s {
-	GTree *packets;
+	seq_packet_t **packets; // ring buffer of `depth` slots, indexed by seq
+	GDestroyNotify ffunc;
+	unsigned int depth; // power of two
+	unsigned int count; // packets currently queued
 	unsigned int lost_count;
+	unsigned int late_count; // seq was already passed, packet dropped
+	unsigned int dupe_count; // seq was already queued, packet dropped
 	int seq; // next expected
 	unsigned int ext_seq; // last received
 	int roc; // rollover counter XXX duplicate with SRTP encryption context
@@ -210,6 +225,11 @@ struct packet_sequencer_s {
 
 
 
+// complexity for encoders that support it, or -1 for the codec default. encoders opened
+// with a different value are reconfigured before their next frame.
+extern int encoder_complexity;
+
+
 void codeclib_init(int);
 
 
@@ -221,6 +241,7 @@ decoder_t *decoder_new_fmt(const codec_def_t *def, int clockrate, int channels,
 decoder_t *decoder_new_fmtp(const codec_def_t *def, int clockrate, int channels, int ptime, const format_t *resample_fmt,
 		const str *fmtp);
 void decoder_close(decoder_t *dec);
+int decoder_reset(decoder_t *dec);
 int decoder_input_data(decoder_t *dec, const str *data, unsigned long ts,
 		int (*callback)(decoder_t *, AVFrame *, void *u1, void *u2), void *u1, void *u2);
 
@@ -232,14 +253,21 @@ int encoder_config_fmtp(encoder_t *enc, const codec_def_t *def, int bitrate, int
 		const format_t *requested_format, format_t *actual_format, const str *fmtp);
 void encoder_close(encoder_t *);
 void encoder_free(encoder_t *);
+int encoder_reset(encoder_t *);
 int encoder_input_data(encoder_t *enc, AVFrame *frame,
 		int (*callback)(encoder_t *, void *u1, void *u2), void *u1, void *u2);
 int encoder_input_fifo(encoder_t *enc, AVFrame *frame,
 		int (*callback)(encoder_t *, void *u1, void *u2), void *u1, void *u2);
 
+// returns the 256-byte table to convert between two different G.711 variants, or NULL
+const unsigned char *g711_transcode_table(const codec_def_t *src, const codec_def_t *dst);
+INLINE void g711_transcode(const unsigned char *table, str *data);
+
 
 void __packet_sequencer_init(packet_sequencer_t *ps, GDestroyNotify);
+void __packet_sequencer_init_depth(packet_sequencer_t *ps, GDestroyNotify, unsigned int depth);
 INLINE void packet_sequencer_init(packet_sequencer_t *ps, GDestroyNotify);
+INLINE void packet_sequencer_init_depth(packet_sequencer_t *ps, GDestroyNotify, unsigned int depth);
 void packet_sequencer_destroy(packet_sequencer_t *ps);
 void *packet_sequencer_next_packet(packet_sequencer_t *ps);
 int packet_sequencer_next_ok(packet_sequencer_t *ps);
@@ -256,6 +284,12 @@ INLINE void packet_sequencer_init(packet_sequencer_t *ps, GDestroyNotify n) {
 		return;
 	__packet_sequencer_init(ps, n);
 }
+// `depth` is rounded up to a power of two
+INLINE void packet_sequencer_init_depth(packet_sequencer_t *ps, GDestroyNotify n, unsigned int depth) {
+	if (ps->packets)
+		return;
+	__packet_sequencer_init_depth(ps, n, depth);
+}
 INLINE int format_eq(const format_t *a, const format_t *b) {
 	if (G_UNLIKELY(a->clockrate != b->clockrate))
 		return 0;
@@ -270,6 +304,11 @@ INLINE void format_init(format_t *f) {
 	f->channels = -1;
 	f->format = -1;
 }
+INLINE void g711_transcode(const unsigned char *table, str *data) {
+	unsigned char *p = (unsigned char *) data->s;
+	for (unsigned int i = 0; i < data->len; i++)
+		p[i] = table[p[i]];
+}
 INLINE char *av_error(int no) {
 	char *buf = get_thread_buf();
 	av_strerror(no, buf, THREAD_BUF_SIZE);
@@ -16,7 +16,51 @@
 
 
 
-AVFrame *resample_frame(resample_t *resample, AVFrame *frame, const format_t *to_format) {
+int resample_low_quality;
+
+
+
+// returns a writable frame with room for at least `samples` samples, reallocating the buffers
+// only if required
+static AVFrame *resample_out_frame(resample_t *resample, const format_t *to_format,
+		uint64_t to_channel_layout, int samples)
+{
+	AVFrame *out = resample->out_frame;
+
+	if (out && out->format == to_format->format && out->channel_layout == to_channel_layout
+			&& resample->out_samples >= samples && av_frame_is_writable(out))
+	{
+		// same size as if freshly allocated
+		av_samples_get_buffer_size(&out->linesize[0], to_format->channels, samples,
+				to_format->format, 0);
+		goto done;
+	}
+
+	if (!out) {
+		out = resample->out_frame = av_frame_alloc();
+		if (!out)
+			return NULL;
+	}
+	else
+		av_frame_unref(out); // still referenced elsewhere, or too small
+
+	out->format = to_format->format;
+	out->channel_layout = to_channel_layout;
+	out->nb_samples = samples;
+	if (av_frame_get_buffer(out, 0) < 0) {
+		av_frame_free(&resample->out_frame);
+		resample->out_samples = 0;
+		return NULL;
+	}
+	resample->out_samples = samples;
+
+done:
+	out->sample_rate = to_format->clockrate;
+	return out;
+}
+
+
+AVFrame *resample_frame_noalloc(resample_t *resample, AVFrame *frame, const format_t *to_format) {
 	const char *err;
 	int errcode = 0;
 
@@ -30,9 +74,13 @@ AVFrame *resample_frame(resample_t *resample, AVFrame *frame, const format_t *to
 	if (frame->channel_layout != to_channel_layout)
 		goto resample;
 
-	return av_frame_clone(frame);
+	return frame;
 
 resample:
+	;
+	int low_quality = g_atomic_int_get(&resample_low_quality);
+	if (G_UNLIKELY(resample->swresample && resample->low_quality != low_quality))
+		swr_free(&resample->swresample);
 
 	if (G_UNLIKELY(!resample->swresample)) {
 		resample->swresample = swr_alloc_set_opts(NULL,
@@ -47,6 +95,13 @@ resample:
 		if (!resample->swresample)
 			goto err;
 
+		resample->low_quality = low_quality;
+		if (low_quality) {
+			// defaults are 32 and 10
+			av_opt_set_int(resample->swresample, "filter_size", 8, 0);
+			av_opt_set_int(resample->swresample, "phase_shift", 6, 0);
+		}
+
 		err = "failed to init resample context";
 		if ((errcode = swr_init(resample->swresample)) < 0)
 			goto err;
@@ -58,18 +113,10 @@ resample:
 			+ frame->nb_samples,
 				to_format->clockrate, frame->sample_rate, AV_ROUND_UP);
 
-	AVFrame *swr_frame = av_frame_alloc();
+	AVFrame *swr_frame = resample_out_frame(resample, to_format, to_channel_layout, dst_samples);
 
-	err = "failed to alloc resampling frame";
-	if (!swr_frame)
-		goto err;
-	av_frame_copy_props(swr_frame, frame);
-	swr_frame->format = to_format->format;
-	swr_frame->channel_layout = to_channel_layout;
-	swr_frame->nb_samples = dst_samples;
-	swr_frame->sample_rate = to_format->clockrate;
 	err = "failed to get resample buffers";
-	if ((errcode = av_frame_get_buffer(swr_frame, 0)) < 0)
+	if (!swr_frame)
 		goto err;
 
 	int ret_samples = swr_convert(resample->swresample, swr_frame->extended_data,
@@ -94,6 +141,17 @@ err:
 }
 
 
+AVFrame *resample_frame(resample_t *resample, AVFrame *frame, const format_t *to_format) {
+	AVFrame *ret = resample_frame_noalloc(resample, frame, to_format);
+	if (!ret)
+		return NULL;
+	// the buffers are shared with our output frame until the caller lets go of them
+	return av_frame_clone(ret);
+}
+
+
 void resample_shutdown(resample_t *resample) {
 	swr_free(&resample->swresample);
+	av_frame_free(&resample->out_frame);
+	resample->out_samples = 0;
 }
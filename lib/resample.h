@@ -6,7 +6,16 @@
 #include <libavutil/frame.h>
 
 
+// use a shorter filter for sample rate conversion. existing contexts are set up again on
+// their next frame.
+extern int resample_low_quality;
+
+
+// returns a new frame that must be freed by the caller
 AVFrame *resample_frame(resample_t *resample, AVFrame *frame, const format_t *to_format);
+// returns either `frame` itself if no conversion is needed, or a frame owned by `resample`
+// which is valid until the next call. the returned frame must not be freed.
+AVFrame *resample_frame_noalloc(resample_t *resample, AVFrame *frame, const format_t *to_format);
 void resample_shutdown(resample_t *resample);
 
 
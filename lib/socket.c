@@ -7,6 +7,7 @@
 #include <netinet/ip6.h>
 #include <netinet/udp.h>
 #include <sys/socket.h>
+#include <linux/sock_diag.h>
 #include "str.h"
 #include "xt_RTPENGINE.h"
 #include "log.h"
@@ -35,8 +36,10 @@ static int __ip4_addrport2sockaddr(void *, const sockaddr_t *, unsigned int);
 static int __ip6_addrport2sockaddr(void *, const sockaddr_t *, unsigned int);
 static ssize_t __ip_recvfrom(socket_t *s, void *buf, size_t len, endpoint_t *ep);
 static ssize_t __ip_recvfrom_ts(socket_t *s, void *buf, size_t len, endpoint_t *ep, struct timeval *);
+static int __ip_recvmmsg_ts(socket_t *s, struct iovec *, unsigned int, endpoint_t *, struct timeval *);
 static ssize_t __ip_sendmsg(socket_t *s, struct msghdr *mh, const endpoint_t *ep);
 static ssize_t __ip_sendto(socket_t *s, const void *buf, size_t len, const endpoint_t *ep);
+static int __ip_sendmmsg(socket_t *s, const struct iovec *, unsigned int, const endpoint_t *);
 static int __ip4_tos(socket_t *, unsigned int);
 static int __ip6_tos(socket_t *, unsigned int);
 static int __ip_error(socket_t *s);
@@ -82,8 +85,10 @@ static struct socket_family __socket_families[__SF_LAST] = {
 		.timestamping		= __ip_timestamping,
 		.recvfrom		= __ip_recvfrom,
 		.recvfrom_ts		= __ip_recvfrom_ts,
+		.recvmmsg_ts		= __ip_recvmmsg_ts,
 		.sendmsg		= __ip_sendmsg,
 		.sendto			= __ip_sendto,
+		.sendmmsg		= __ip_sendmmsg,
 		.tos			= __ip4_tos,
 		.error			= __ip_error,
 		.endpoint2kernel	= __ip4_endpoint2kernel,
@@ -113,8 +118,10 @@ static struct socket_family __socket_families[__SF_LAST] = {
 		.timestamping		= __ip_timestamping,
 		.recvfrom		= __ip_recvfrom,
 		.recvfrom_ts		= __ip_recvfrom_ts,
+		.recvmmsg_ts		= __ip_recvmmsg_ts,
 		.sendmsg		= __ip_sendmsg,
 		.sendto			= __ip_sendto,
+		.sendmmsg		= __ip_sendmmsg,
 		.tos			= __ip6_tos,
 		.error			= __ip_error,
 		.endpoint2kernel	= __ip6_endpoint2kernel,
@@ -334,6 +341,63 @@ static ssize_t __ip_recvfrom_ts(socket_t *s, void *buf, size_t len, endpoint_t *
 
 	return ret;
 }
+static int __ip_recvmmsg_ts(socket_t *s, struct iovec *iov, unsigned int num, endpoint_t *eps,
+		struct timeval *tvs)
+{
+	int ret, i;
+	struct mmsghdr mmsg[MAX_RECVMMSG];
+	struct sockaddr_storage sin[MAX_RECVMMSG];
+	char ctrl[MAX_RECVMMSG][64];
+	struct msghdr *msg;
+	struct cmsghdr *cm;
+	struct timeval *tv;
+
+	if (num > MAX_RECVMMSG)
+		num = MAX_RECVMMSG;
+
+	for (i = 0; i < num; i++) {
+		msg = &mmsg[i].msg_hdr;
+		ZERO(*msg);
+		msg->msg_name = &sin[i];
+		msg->msg_namelen = s->family->sockaddr_size;
+		msg->msg_iov = &iov[i];
+		msg->msg_iovlen = 1;
+		msg->msg_control = ctrl[i];
+		msg->msg_controllen = sizeof(ctrl[i]);
+		mmsg[i].msg_len = 0;
+	}
+
+	ret = recvmmsg(s->fd, mmsg, num, 0, NULL);
+	if (ret <= 0)
+		return ret;
+
+	for (i = 0; i < ret; i++) {
+		msg = &mmsg[i].msg_hdr;
+		iov[i].iov_len = mmsg[i].msg_len;
+		s->family->sockaddr2endpoint(&eps[i], &sin[i]);
+
+		if (tvs) {
+			tv = &tvs[i];
+			for (cm = CMSG_FIRSTHDR(msg); cm; cm = CMSG_NXTHDR(msg, cm)) {
+				if (cm->cmsg_level == SOL_SOCKET && cm->cmsg_type == SO_TIMESTAMP) {
+					*tv = *((struct timeval *) CMSG_DATA(cm));
+					tv = NULL;
+					break;
+				}
+			}
+			if (G_UNLIKELY(tv)) {
+				ilog(LOG_WARNING, "No receive timestamp received from kernel");
+				ZERO(*tv);
+			}
+		}
+		if (G_UNLIKELY((msg->msg_flags & MSG_TRUNC)))
+			ilog(LOG_WARNING, "Kernel indicates that data was truncated");
+		if (G_UNLIKELY((msg->msg_flags & MSG_CTRUNC)))
+			ilog(LOG_WARNING, "Kernel indicates that ancillary data was truncated");
+	}
+
+	return ret;
+}
 static ssize_t __ip_recvfrom(socket_t *s, void *buf, size_t len, endpoint_t *ep) {
 	return __ip_recvfrom_ts(s, buf, len, ep, NULL);
 }
@@ -352,6 +416,28 @@ static ssize_t __ip_sendto(socket_t *s, const void *buf, size_t len, const endpo
 	s->family->endpoint2sockaddr(&sin, ep);
 	return sendto(s->fd, buf, len, 0, (void *) &sin, s->family->sockaddr_size);
 }
+static int __ip_sendmmsg(socket_t *s, const struct iovec *iov, unsigned int num, const endpoint_t *eps) {
+	struct mmsghdr mmsg[MAX_SENDMMSG];
+	struct sockaddr_storage sin[MAX_SENDMMSG];
+	struct msghdr *msg;
+	unsigned int i;
+
+	if (num > MAX_SENDMMSG)
+		num = MAX_SENDMMSG;
+
+	for (i = 0; i < num; i++) {
+		msg = &mmsg[i].msg_hdr;
+		ZERO(*msg);
+		s->family->endpoint2sockaddr(&sin[i], &eps[i]);
+		msg->msg_name = &sin[i];
+		msg->msg_namelen = s->family->sockaddr_size;
+		msg->msg_iov = (void *) &iov[i];
+		msg->msg_iovlen = 1;
+		mmsg[i].msg_len = 0;
+	}
+
+	return sendmmsg(s->fd, mmsg, num, 0);
+}
 static int __ip4_tos(socket_t *s, unsigned int tos) {
 	unsigned char ctos;
 	ctos = tos;
@@ -746,6 +832,22 @@ int close_socket(socket_t *r) {
 	return 0;
 }
 
+int socket_rx_queued(socket_t *r) {
+#ifdef SO_MEMINFO
+	// FIONREAD only reports the first datagram for UDP sockets
+	uint32_t mi[SK_MEMINFO_VARS];
+	socklen_t len = sizeof(mi);
+
+	if (!r || r->fd == -1)
+		return -1;
+	if (getsockopt(r->fd, SOL_SOCKET, SO_MEMINFO, mi, &len))
+		return -1;
+	return mi[SK_MEMINFO_RMEM_ALLOC];
+#else
+	return -1;
+#endif
+}
+
 
 
 
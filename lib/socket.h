@@ -37,6 +37,8 @@ typedef const struct socket_family sockfamily_t;
 
 
 #define MAX_PACKET_HEADER_LEN 48 // 40 bytes IPv6 + 8 bytes UDP
+#define MAX_RECVMMSG 64 // upper limit for one batched receive
+#define MAX_SENDMMSG 64 // same for sending
 
 
 
@@ -71,8 +73,14 @@ struct socket_family {
 	int				(*timestamping)(socket_t *);
 	ssize_t				(*recvfrom)(socket_t *, void *, size_t, endpoint_t *);
 	ssize_t				(*recvfrom_ts)(socket_t *, void *, size_t, endpoint_t *, struct timeval *);
+	// iov_len of each iovec is updated to the length of the received datagram
+	int				(*recvmmsg_ts)(socket_t *, struct iovec *, unsigned int, endpoint_t *,
+						struct timeval *);
 	ssize_t				(*sendmsg)(socket_t *, struct msghdr *, const endpoint_t *);
 	ssize_t				(*sendto)(socket_t *, const void *, size_t, const endpoint_t *);
+	// one datagram per iovec, each with its own destination
+	int				(*sendmmsg)(socket_t *, const struct iovec *, unsigned int,
+						const endpoint_t *);
 	int				(*tos)(socket_t *, unsigned int);
 	int				(*error)(socket_t *);
 	void				(*endpoint2kernel)(struct re_address *, const endpoint_t *);
@@ -164,8 +172,10 @@ INLINE int is_addr_unspecified(const sockaddr_t *a) {
 }
 #define socket_recvfrom(s,a...) (s)->family->recvfrom((s), a)
 #define socket_recvfrom_ts(s,a...) (s)->family->recvfrom_ts((s), a)
+#define socket_recvmmsg_ts(s,a...) (s)->family->recvmmsg_ts((s), a)
 #define socket_sendmsg(s,a...) (s)->family->sendmsg((s), a)
 #define socket_sendto(s,a...) (s)->family->sendto((s), a)
+#define socket_sendmmsg(s,a...) (s)->family->sendmmsg((s), a)
 #define socket_error(s) (s)->family->error((s))
 #define socket_timestamping(s) (s)->family->timestamping((s))
 INLINE ssize_t socket_sendiov(socket_t *s, const struct iovec *v, unsigned int len, const endpoint_t *dst) {
@@ -202,6 +212,7 @@ int connect_socket(socket_t *r, int type, const endpoint_t *ep);
 int connect_socket_nb(socket_t *r, int type, const endpoint_t *ep); // 1 == in progress
 int connect_socket_retry(socket_t *r); // retries connect() while in progress
 int close_socket(socket_t *r);
+int socket_rx_queued(socket_t *r); // bytes waiting in the receive buffer, or -1
 
 sockfamily_t *get_socket_family_rfc(const str *s);
 sockfamily_t *__get_socket_family_enum(enum socket_families);
@@ -139,7 +139,10 @@ no_recording:
 	if (ssrc->tls_fwd_stream) {
 		// XXX might be a second resampling to same format
 		dbg("SSRC %lx of stream #%lu has TLS forwarding stream", ssrc->ssrc, stream->id);
-		AVFrame *dec_frame = resample_frame(&ssrc->tls_fwd_resampler, frame, &ssrc->tls_fwd_format);
+		AVFrame *dec_frame = resample_frame_noalloc(&ssrc->tls_fwd_resampler, frame,
+				&ssrc->tls_fwd_format);
+		if (!dec_frame)
+			goto err;
 
 		ssrc_tls_state(ssrc);
 
@@ -158,7 +161,6 @@ no_recording:
 		dbg("Writing %u bytes PCM to TLS", dec_frame->linesize[0]);
 		streambuf_write(ssrc->tls_fwd_stream, (char *) dec_frame->extended_data[0],
 				dec_frame->linesize[0]);
-		av_frame_free(&dec_frame);
 
 	}
 
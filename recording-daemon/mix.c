@@ -276,12 +276,11 @@ int mix_add(mix_t *mix, AVFrame *frame, unsigned int idx, output_t *output) {
 			else
 				goto err;
 		}
-		frame = resample_frame(&mix->resample, mix->sink_frame, &mix->format);
+		AVFrame *out_frame = resample_frame_noalloc(&mix->resample, mix->sink_frame, &mix->format);
 
-		ret = output_add(output, frame);
+		ret = out_frame ? output_add(output, out_frame) : -1;
 
 		av_frame_unref(mix->sink_frame);
-		av_frame_free(&frame);
 
 		if (ret)
 			return -1;
@@ -293,7 +293,7 @@ static void ssrc_run(ssrc_t *ssrc) {
 		packet_decode(ssrc, packet);
 
 		packet_free(packet);
-		dbg("packets left in queue: %i", g_tree_nnodes(ssrc->sequencer.packets));
+		dbg("packets left in queue: %u", ssrc->sequencer.count);
 	}
 
 	pthread_mutex_unlock(&ssrc->lock);
@@ -1,5 +1,10 @@
 #include <assert.h>
 #include <stdio.h>
+#include <string.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
 
 #include "crypto.h"
 #include "rtplib.h"
@@ -111,6 +116,37 @@ uint8_t aes_256_srtp_ciphertext[38] = {
         0x5b, 0x3a, 0x55, 0xd8, 0x87, 0x3b
 };
 
+// RFC 7714 section 16.1.1: AEAD_AES_128_GCM with session key and salt given directly
+uint8_t gcm_128_key[16] = {
+	0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+	0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f
+};
+uint8_t gcm_128_salt[12] = {
+	0x51, 0x75, 0x69, 0x64, 0x20, 0x70, 0x72, 0x6f,
+	0x20, 0x71, 0x75, 0x6f
+};
+uint8_t gcm_rtp_plaintext[50] = {
+	0x80, 0x40, 0xf1, 0x7b, 0x80, 0x41, 0xf8, 0xd3,
+	0x55, 0x01, 0xa0, 0xb2, 0x47, 0x61, 0x6c, 0x6c,
+	0x69, 0x61, 0x20, 0x65, 0x73, 0x74, 0x20, 0x6f,
+	0x6d, 0x6e, 0x69, 0x73, 0x20, 0x64, 0x69, 0x76,
+	0x69, 0x73, 0x61, 0x20, 0x69, 0x6e, 0x20, 0x70,
+	0x61, 0x72, 0x74, 0x65, 0x73, 0x20, 0x74, 0x72,
+	0x65, 0x73
+};
+
+uint8_t gcm_128_srtp_ciphertext[66] = {
+	0x80, 0x40, 0xf1, 0x7b, 0x80, 0x41, 0xf8, 0xd3,
+	0x55, 0x01, 0xa0, 0xb2, 0xf2, 0x4d, 0xe3, 0xa3,
+	0xfb, 0x34, 0xde, 0x6c, 0xac, 0xba, 0x86, 0x1c,
+	0x9d, 0x7e, 0x4b, 0xca, 0xbe, 0x63, 0x3b, 0xd5,
+	0x0d, 0x29, 0x4e, 0x6f, 0x42, 0xa5, 0xf4, 0x7a,
+	0x51, 0xc7, 0xd1, 0x9b, 0x36, 0xde, 0x3a, 0xdf,
+	0x88, 0x33, 0x89, 0x9d, 0x7f, 0x27, 0xbe, 0xb1,
+	0x6a, 0x91, 0x52, 0xcf, 0x76, 0x5e, 0xe4, 0x39,
+	0x0c, 0xce
+};
+
 
 #define RTP_HEADER_LEN 12
 #define RTCP_HEADER_LEN 8
@@ -178,6 +214,84 @@ void srtp_validate (struct crypto_context *c, struct crypto_context *c2, char* m
 	printf("%s RTCP decrypt: PASS\n", message);
 }
 
+// cycles where the TSC is available, nanoseconds otherwise
+static uint64_t bench_clock(void) {
+#if defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+}
+
+#define BENCH_ITERATIONS 20000
+
+static uint64_t ctr_bench_run(struct crypto_context *c, char *pkt, unsigned int len) {
+	str payload;
+	uint64_t start;
+
+	start = bench_clock();
+	for (unsigned int i = 0; i < BENCH_ITERATIONS; i++) {
+		payload.s = pkt + RTP_HEADER_LEN;
+		payload.len = len;
+		crypto_encrypt_rtp(c, (struct rtp_header *) pkt, &payload, i);
+	}
+	return (bench_clock() - start) / BENCH_ITERATIONS;
+}
+
+// Compares the whole-packet CTR keystream against the block-by-block ECB fallback:
+// both must produce identical output, and the per-packet cost of each is reported.
+void ctr_bench(struct crypto_context *c, char *message) {
+	static const unsigned int sizes[] = { 20, 160, 320, 1280 }; // G.729, G.711, L16, video
+	char a[RTP_HEADER_LEN + 1400], b[RTP_HEADER_LEN + 1400];
+	void *ctr = c->session_key_ctx[2];
+	str payload;
+
+	assert(ctr);
+
+	for (unsigned int len = 1; len <= 1400; len += 7) {
+		memset(a, 0xab, sizeof(a));
+		memcpy(a, rtp_plaintext_ref, RTP_HEADER_LEN);
+		memcpy(b, a, sizeof(b));
+
+		payload.s = a + RTP_HEADER_LEN;
+		payload.len = len;
+		crypto_encrypt_rtp(c, (struct rtp_header *) a, &payload, len);
+
+		c->session_key_ctx[2] = NULL;
+		payload.s = b + RTP_HEADER_LEN;
+		payload.len = len;
+		crypto_encrypt_rtp(c, (struct rtp_header *) b, &payload, len);
+		c->session_key_ctx[2] = ctr;
+
+		assert(memcmp(a, b, sizeof(a)) == 0);
+	}
+
+	printf("%s whole-packet keystream: PASS\n", message);
+
+	for (unsigned int i = 0; i < G_N_ELEMENTS(sizes); i++) {
+		uint64_t fast, slow;
+
+		memset(a, 0xab, sizeof(a));
+		memcpy(a, rtp_plaintext_ref, RTP_HEADER_LEN);
+
+		fast = ctr_bench_run(c, a, sizes[i]);
+		c->session_key_ctx[2] = NULL;
+		slow = ctr_bench_run(c, a, sizes[i]);
+		c->session_key_ctx[2] = ctr;
+
+		printf("%s %4u bytes: %6llu %s/packet whole-packet, %6llu block-by-block\n",
+				message, sizes[i], (unsigned long long) fast,
+#if defined(__x86_64__) || defined(__i386__)
+				"cycles",
+#else
+				"ns",
+#endif
+				(unsigned long long) slow);
+	}
+}
+
 extern void crypto_init_main(void);
 
 void check_session_keys(struct crypto_context *c, int i) {
@@ -199,6 +313,131 @@ error:
 	return;
 }
 
+void gcm_validate(void) {
+	str suite, payload;
+	struct crypto_context ctx;
+	char pkt[RTP_HEADER_LEN + 64];
+
+	str_init(&suite, "AEAD_AES_128_GCM");
+	memset(&ctx, 0, sizeof(ctx));
+	ctx.params.crypto_suite = crypto_find_suite(&suite);
+	assert(ctx.params.crypto_suite);
+	memcpy(ctx.session_key, gcm_128_key, sizeof(gcm_128_key));
+	memcpy(ctx.session_salt, gcm_128_salt, sizeof(gcm_128_salt));
+	ctx.have_session_key = 1;
+	crypto_init_session_key(&ctx);
+
+	// in-place crypto, the tag is appended to the payload
+	memcpy(pkt, gcm_rtp_plaintext, sizeof(gcm_rtp_plaintext));
+	payload.s = pkt + RTP_HEADER_LEN;
+	payload.len = sizeof(gcm_rtp_plaintext) - RTP_HEADER_LEN;
+	assert(crypto_encrypt_rtp(&ctx, (struct rtp_header *) pkt, &payload, 0xf17b) == 0);
+	assert(payload.len == sizeof(gcm_128_srtp_ciphertext) - RTP_HEADER_LEN);
+	assert(memcmp(pkt, gcm_128_srtp_ciphertext, sizeof(gcm_128_srtp_ciphertext)) == 0);
+
+	printf("SRTP AEAD-AES-128-GCM RTP encrypt: PASS\n");
+
+	assert(crypto_decrypt_rtp(&ctx, (struct rtp_header *) pkt, &payload, 0xf17b) == 0);
+	assert(payload.len == sizeof(gcm_rtp_plaintext) - RTP_HEADER_LEN);
+	assert(memcmp(pkt, gcm_rtp_plaintext, sizeof(gcm_rtp_plaintext)) == 0);
+
+	printf("SRTP AEAD-AES-128-GCM RTP decrypt: PASS\n");
+
+	// modified cipher text, and modified header (AAD)
+	memcpy(pkt, gcm_128_srtp_ciphertext, sizeof(gcm_128_srtp_ciphertext));
+	pkt[RTP_HEADER_LEN + 3] ^= 0x01;
+	payload.s = pkt + RTP_HEADER_LEN;
+	payload.len = sizeof(gcm_128_srtp_ciphertext) - RTP_HEADER_LEN;
+	assert(crypto_decrypt_rtp(&ctx, (struct rtp_header *) pkt, &payload, 0xf17b) != 0);
+
+	memcpy(pkt, gcm_128_srtp_ciphertext, sizeof(gcm_128_srtp_ciphertext));
+	pkt[1] ^= 0x80;
+	payload.len = sizeof(gcm_128_srtp_ciphertext) - RTP_HEADER_LEN;
+	assert(crypto_decrypt_rtp(&ctx, (struct rtp_header *) pkt, &payload, 0xf17b) != 0);
+
+	printf("SRTP AEAD-AES-128-GCM RTP authentication: PASS\n");
+
+	// RTCP round trip, the SRTCP index is part of the AAD
+	memcpy(pkt, rtcp_plaintext_ref, sizeof(rtcp_plaintext_ref));
+	payload.s = pkt + RTCP_HEADER_LEN;
+	payload.len = sizeof(rtcp_plaintext_ref) - RTCP_HEADER_LEN;
+	assert(crypto_encrypt_rtcp(&ctx, (struct rtcp_packet *) pkt, &payload, 1) == 0);
+	assert(payload.len == sizeof(rtcp_plaintext_ref) - RTCP_HEADER_LEN + 16);
+	assert(crypto_decrypt_rtcp(&ctx, (struct rtcp_packet *) pkt, &payload, 2) != 0);
+
+	memcpy(pkt, rtcp_plaintext_ref, sizeof(rtcp_plaintext_ref));
+	payload.len = sizeof(rtcp_plaintext_ref) - RTCP_HEADER_LEN;
+	assert(crypto_encrypt_rtcp(&ctx, (struct rtcp_packet *) pkt, &payload, 1) == 0);
+	assert(crypto_decrypt_rtcp(&ctx, (struct rtcp_packet *) pkt, &payload, 1) == 0);
+	assert(payload.len == sizeof(rtcp_plaintext_ref) - RTCP_HEADER_LEN);
+	assert(memcmp(pkt, rtcp_plaintext_ref, sizeof(rtcp_plaintext_ref)) == 0);
+
+	printf("SRTP AEAD-AES-128-GCM RTCP round trip: PASS\n");
+
+	crypto_cleanup(&ctx);
+}
+
+// encryption plus authentication, as done by rtp_avp2savp()
+static uint64_t srtp_bench_run(struct crypto_context *c, unsigned int len) {
+	char pkt[RTP_HEADER_LEN + 1400 + 32];
+	str payload, to_auth;
+	uint64_t start;
+
+	memset(pkt, 0xab, sizeof(pkt));
+	memcpy(pkt, rtp_plaintext_ref, RTP_HEADER_LEN);
+
+	start = bench_clock();
+	for (unsigned int i = 0; i < BENCH_ITERATIONS; i++) {
+		payload.s = pkt + RTP_HEADER_LEN;
+		payload.len = len;
+		crypto_encrypt_rtp(c, (struct rtp_header *) pkt, &payload, i);
+		if (!c->params.crypto_suite->srtp_auth_tag)
+			continue;
+		to_auth.s = pkt;
+		to_auth.len = RTP_HEADER_LEN + payload.len;
+		c->params.crypto_suite->hash_rtp(c, pkt + to_auth.len, &to_auth, i);
+	}
+	return (bench_clock() - start) / BENCH_ITERATIONS;
+}
+
+// AEAD_AES_128_GCM compared to AES_CM_128_HMAC_SHA1_80
+void gcm_bench(void) {
+	static const unsigned int sizes[] = { 20, 160, 320, 1280 };
+	struct crypto_context cm, gcm;
+	str suite;
+
+	memset(&cm, 0, sizeof(cm));
+	str_init(&suite, "AES_CM_128_HMAC_SHA1_80");
+	cm.params.crypto_suite = crypto_find_suite(&suite);
+	memcpy(cm.params.master_key, test_key, 16);
+	memcpy(cm.params.master_salt, (uint8_t*)test_key+16, 14);
+	check_session_keys(&cm, 0);
+
+	memset(&gcm, 0, sizeof(gcm));
+	str_init(&suite, "AEAD_AES_128_GCM");
+	gcm.params.crypto_suite = crypto_find_suite(&suite);
+	memcpy(gcm.params.master_key, test_key, 16);
+	memcpy(gcm.params.master_salt, (uint8_t*)test_key+16, 12);
+	check_session_keys(&gcm, 0);
+
+	for (unsigned int i = 0; i < G_N_ELEMENTS(sizes); i++) {
+		uint64_t t_cm = srtp_bench_run(&cm, sizes[i]);
+		uint64_t t_gcm = srtp_bench_run(&gcm, sizes[i]);
+
+		printf("SRTP %4u bytes: %6llu %s/packet AEAD_AES_128_GCM, %6llu AES_CM_128_HMAC_SHA1_80\n",
+				sizes[i], (unsigned long long) t_gcm,
+#if defined(__x86_64__) || defined(__i386__)
+				"cycles",
+#else
+				"ns",
+#endif
+				(unsigned long long) t_cm);
+	}
+
+	crypto_cleanup(&cm);
+	crypto_cleanup(&gcm);
+}
+
 int main(int argc, char** argv) {
 
 	str suite;
@@ -229,6 +468,7 @@ int main(int argc, char** argv) {
 	
 	srtp_validate(&ctx, &ctx2, "SRTP AES-CM-128", rtp_plaintext_ref, srtp_ciphertext_128,
 		      rtcp_plaintext_ref, srtcp_ciphertext_128);
+	ctr_bench(&ctx, "SRTP AES-CM-128");
 	
 	str_init(&suite, "AES_192_CM_HMAC_SHA1_80");
 	c = crypto_find_suite(&suite);
@@ -275,6 +515,7 @@ int main(int argc, char** argv) {
 
 	srtp_validate(&ctx, &ctx2, "SRTP AES-CM-256", rtp_plaintext_ref, srtp_ciphertext_256,
 		      rtcp_plaintext_ref, srtcp_ciphertext_256);
+	ctr_bench(&ctx, "SRTP AES-CM-256");
 
 
 	memset(&ctx, 0, sizeof(ctx));
@@ -288,4 +529,7 @@ int main(int argc, char** argv) {
 	srtp_validate(&ctx, NULL, "extra AES-CM-256", aes_256_rtp_plaintext_ref, aes_256_srtp_ciphertext,
 		      NULL, NULL);
 
+	gcm_validate();
+	gcm_bench();
+
 }
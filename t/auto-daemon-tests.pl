@@ -87,6 +87,8 @@ a=crypto:7 F8_128_HMAC_SHA1_80 inline:CRYPTO128
 a=crypto:8 F8_128_HMAC_SHA1_32 inline:CRYPTO128
 a=crypto:9 NULL_HMAC_SHA1_80 inline:CRYPTO128
 a=crypto:10 NULL_HMAC_SHA1_32 inline:CRYPTO128
+a=crypto:11 AEAD_AES_128_GCM inline:CRYPTO128S
+a=crypto:12 AEAD_AES_256_GCM inline:CRYPTO256S
 a=ptime:20
 SDP
 
@@ -181,6 +183,8 @@ a=crypto:7 F8_128_HMAC_SHA1_80 inline:CRYPTO128
 a=crypto:8 F8_128_HMAC_SHA1_32 inline:CRYPTO128
 a=crypto:9 NULL_HMAC_SHA1_80 inline:CRYPTO128
 a=crypto:10 NULL_HMAC_SHA1_32 inline:CRYPTO128
+a=crypto:11 AEAD_AES_128_GCM inline:CRYPTO128S
+a=crypto:12 AEAD_AES_256_GCM inline:CRYPTO256S
 a=ptime:20
 SDP
 
@@ -279,6 +283,8 @@ a=crypto:7 F8_128_HMAC_SHA1_80 inline:CRYPTO128
 a=crypto:8 F8_128_HMAC_SHA1_32 inline:CRYPTO128
 a=crypto:9 NULL_HMAC_SHA1_80 inline:CRYPTO128
 a=crypto:10 NULL_HMAC_SHA1_32 inline:CRYPTO128
+a=crypto:11 AEAD_AES_128_GCM inline:CRYPTO128S
+a=crypto:12 AEAD_AES_256_GCM inline:CRYPTO256S
 a=ptime:20
 SDP
 
@@ -339,6 +345,8 @@ a=crypto:7 F8_128_HMAC_SHA1_80 inline:CRYPTO128
 a=crypto:8 F8_128_HMAC_SHA1_32 inline:CRYPTO128
 a=crypto:9 NULL_HMAC_SHA1_80 inline:CRYPTO128
 a=crypto:10 NULL_HMAC_SHA1_32 inline:CRYPTO128
+a=crypto:11 AEAD_AES_128_GCM inline:CRYPTO128S
+a=crypto:12 AEAD_AES_256_GCM inline:CRYPTO256S
 a=ptime:20
 SDP
 
@@ -578,6 +586,8 @@ a=crypto:7 F8_128_HMAC_SHA1_80 inline:CRYPTO128
 a=crypto:8 F8_128_HMAC_SHA1_32 inline:CRYPTO128
 a=crypto:9 NULL_HMAC_SHA1_80 inline:CRYPTO128
 a=crypto:10 NULL_HMAC_SHA1_32 inline:CRYPTO128
+a=crypto:11 AEAD_AES_128_GCM inline:CRYPTO128S
+a=crypto:12 AEAD_AES_256_GCM inline:CRYPTO256S
 SDP
 
 ($port_b, undef, $srtp_key_b) = answer('reg SRTP offer, accept, diff suite',
@@ -663,6 +673,8 @@ a=crypto:7 F8_128_HMAC_SHA1_80 inline:CRYPTO128
 a=crypto:8 F8_128_HMAC_SHA1_32 inline:CRYPTO128
 a=crypto:9 NULL_HMAC_SHA1_80 inline:CRYPTO128
 a=crypto:10 NULL_HMAC_SHA1_32 inline:CRYPTO128
+a=crypto:11 AEAD_AES_128_GCM inline:CRYPTO128S
+a=crypto:12 AEAD_AES_256_GCM inline:CRYPTO256S
 SDP
 
 ($port_b) = answer('OSRTP offer, accept, same suite',
@@ -736,6 +748,8 @@ a=crypto:7 F8_128_HMAC_SHA1_80 inline:CRYPTO128
 a=crypto:8 F8_128_HMAC_SHA1_32 inline:CRYPTO128
 a=crypto:9 NULL_HMAC_SHA1_80 inline:CRYPTO128
 a=crypto:10 NULL_HMAC_SHA1_32 inline:CRYPTO128
+a=crypto:11 AEAD_AES_128_GCM inline:CRYPTO128S
+a=crypto:12 AEAD_AES_256_GCM inline:CRYPTO256S
 SDP
 
 ($port_b, undef, $srtp_key_b) = answer('OSRTP offer, accept, diff suite',
@@ -818,6 +832,8 @@ a=crypto:7 F8_128_HMAC_SHA1_80 inline:CRYPTO128
 a=crypto:8 F8_128_HMAC_SHA1_32 inline:CRYPTO128
 a=crypto:9 NULL_HMAC_SHA1_80 inline:CRYPTO128
 a=crypto:10 NULL_HMAC_SHA1_32 inline:CRYPTO128
+a=crypto:11 AEAD_AES_128_GCM inline:CRYPTO128S
+a=crypto:12 AEAD_AES_256_GCM inline:CRYPTO256S
 SDP
 
 ($port_b) = answer('OSRTP offer, reject',
@@ -880,6 +896,8 @@ a=crypto:7 F8_128_HMAC_SHA1_80 inline:CRYPTO128
 a=crypto:8 F8_128_HMAC_SHA1_32 inline:CRYPTO128
 a=crypto:9 NULL_HMAC_SHA1_80 inline:CRYPTO128
 a=crypto:10 NULL_HMAC_SHA1_32 inline:CRYPTO128
+a=crypto:11 AEAD_AES_128_GCM inline:CRYPTO128S
+a=crypto:12 AEAD_AES_256_GCM inline:CRYPTO256S
 SDP
 
 ($port_b, undef, $srtp_key_a) = answer('OSRTP offer, reject w/ accept flag',
@@ -953,6 +971,8 @@ a=crypto:7 F8_128_HMAC_SHA1_80 inline:CRYPTO128
 a=crypto:8 F8_128_HMAC_SHA1_32 inline:CRYPTO128
 a=crypto:9 NULL_HMAC_SHA1_80 inline:CRYPTO128
 a=crypto:10 NULL_HMAC_SHA1_32 inline:CRYPTO128
+a=crypto:11 AEAD_AES_128_GCM inline:CRYPTO128S
+a=crypto:12 AEAD_AES_256_GCM inline:CRYPTO256S
 SDP
 
 ($port_b) = answer('non-OSRTP offer with offer flag, accept',
@@ -1026,6 +1046,8 @@ a=crypto:7 F8_128_HMAC_SHA1_80 inline:CRYPTO128
 a=crypto:8 F8_128_HMAC_SHA1_32 inline:CRYPTO128
 a=crypto:9 NULL_HMAC_SHA1_80 inline:CRYPTO128
 a=crypto:10 NULL_HMAC_SHA1_32 inline:CRYPTO128
+a=crypto:11 AEAD_AES_128_GCM inline:CRYPTO128S
+a=crypto:12 AEAD_AES_256_GCM inline:CRYPTO256S
 SDP
 
 ($port_b) = answer('non-OSRTP offer with offer flag and protocol, accept',
@@ -1100,6 +1122,8 @@ a=crypto:7 F8_128_HMAC_SHA1_80 inline:CRYPTO128
 a=crypto:8 F8_128_HMAC_SHA1_32 inline:CRYPTO128
 a=crypto:9 NULL_HMAC_SHA1_80 inline:CRYPTO128
 a=crypto:10 NULL_HMAC_SHA1_32 inline:CRYPTO128
+a=crypto:11 AEAD_AES_128_GCM inline:CRYPTO128S
+a=crypto:12 AEAD_AES_256_GCM inline:CRYPTO256S
 SDP
 
 ($port_b) = answer('non-OSRTP offer with offer flag, reject',
@@ -1287,6 +1311,8 @@ a=crypto:7 F8_128_HMAC_SHA1_80 inline:CRYPTO128|2^31
 a=crypto:8 F8_128_HMAC_SHA1_32 inline:CRYPTO128|2^31
 a=crypto:9 NULL_HMAC_SHA1_80 inline:CRYPTO128|2^31
 a=crypto:10 NULL_HMAC_SHA1_32 inline:CRYPTO128|2^31
+a=crypto:11 AEAD_AES_128_GCM inline:CRYPTO128S|2^31
+a=crypto:12 AEAD_AES_256_GCM inline:CRYPTO256S|2^31
 SDP
 
 
@@ -2683,6 +2709,8 @@ a=crypto:9 F8_128_HMAC_SHA1_80 inline:CRYPTO128
 a=crypto:10 F8_128_HMAC_SHA1_32 inline:CRYPTO128
 a=crypto:11 NULL_HMAC_SHA1_80 inline:CRYPTO128
 a=crypto:12 NULL_HMAC_SHA1_32 inline:CRYPTO128
+a=crypto:13 AEAD_AES_128_GCM inline:CRYPTO128S==
+a=crypto:14 AEAD_AES_256_GCM inline:CRYPTO256S=
 SDP
 
 ($port_b) = answer('gh829 control',
@@ -2758,6 +2786,8 @@ a=crypto:7 F8_128_HMAC_SHA1_80 inline:CRYPTO128
 a=crypto:8 F8_128_HMAC_SHA1_32 inline:CRYPTO128
 a=crypto:9 NULL_HMAC_SHA1_80 inline:CRYPTO128
 a=crypto:10 NULL_HMAC_SHA1_32 inline:CRYPTO128
+a=crypto:11 AEAD_AES_128_GCM inline:CRYPTO128S==
+a=crypto:12 AEAD_AES_256_GCM inline:CRYPTO256S=
 SDP
 
 ($port_b) = answer('gh829',
@@ -3927,6 +3957,8 @@ a=crypto:7 F8_128_HMAC_SHA1_80 inline:CRYPTO128
 a=crypto:8 F8_128_HMAC_SHA1_32 inline:CRYPTO128
 a=crypto:9 NULL_HMAC_SHA1_80 inline:CRYPTO128
 a=crypto:10 NULL_HMAC_SHA1_32 inline:CRYPTO128
+a=crypto:11 AEAD_AES_128_GCM inline:CRYPTO128S
+a=crypto:12 AEAD_AES_256_GCM inline:CRYPTO256S
 SDP
 
 answer('gh 661 plain', { ICE => 'remove' }, <<SDP);
@@ -3984,6 +4016,8 @@ a=crypto:6 AES_192_CM_HMAC_SHA1_32 inline:CRYPTO192
 a=crypto:7 F8_128_HMAC_SHA1_32 inline:CRYPTO128
 a=crypto:8 NULL_HMAC_SHA1_80 inline:CRYPTO128
 a=crypto:9 NULL_HMAC_SHA1_32 inline:CRYPTO128
+a=crypto:10 AEAD_AES_128_GCM inline:CRYPTO128S
+a=crypto:11 AEAD_AES_256_GCM inline:CRYPTO256S
 SDP
 
 answer('gh 661 suppress one', { ICE => 'remove' }, <<SDP);
@@ -4041,6 +4075,8 @@ a=crypto:7 F8_128_HMAC_SHA1_80 inline:CRYPTO128
 a=crypto:8 F8_128_HMAC_SHA1_32 inline:CRYPTO128
 a=crypto:9 NULL_HMAC_SHA1_80 inline:CRYPTO128
 a=crypto:10 NULL_HMAC_SHA1_32 inline:CRYPTO128
+a=crypto:11 AEAD_AES_128_GCM inline:CRYPTO128S
+a=crypto:12 AEAD_AES_256_GCM inline:CRYPTO256S
 SDP
 
 answer('gh 661 remove one', { ICE => 'remove' }, <<SDP);
@@ -4098,6 +4134,8 @@ a=crypto:7 F8_128_HMAC_SHA1_80 inline:CRYPTO128
 a=crypto:8 F8_128_HMAC_SHA1_32 inline:CRYPTO128
 a=crypto:9 NULL_HMAC_SHA1_80 inline:CRYPTO128
 a=crypto:10 NULL_HMAC_SHA1_32 inline:CRYPTO128
+a=crypto:11 AEAD_AES_128_GCM inline:CRYPTO128S
+a=crypto:12 AEAD_AES_256_GCM inline:CRYPTO256S
 SDP
 
 answer('gh 661 remove first', { ICE => 'remove' }, <<SDP);
@@ -4295,6 +4333,8 @@ a=crypto:7 F8_128_HMAC_SHA1_80 inline:CRYPTO128
 a=crypto:8 F8_128_HMAC_SHA1_32 inline:CRYPTO128
 a=crypto:9 NULL_HMAC_SHA1_80 inline:CRYPTO128
 a=crypto:10 NULL_HMAC_SHA1_32 inline:CRYPTO128
+a=crypto:11 AEAD_AES_128_GCM inline:CRYPTO128S
+a=crypto:12 AEAD_AES_256_GCM inline:CRYPTO256S
 SDP
 
 answer('gh 661 plain from RTP', { ICE => 'remove' }, <<SDP);
@@ -4347,6 +4387,8 @@ a=crypto:6 AES_256_CM_HMAC_SHA1_32 inline:CRYPTO256
 a=crypto:7 F8_128_HMAC_SHA1_32 inline:CRYPTO128
 a=crypto:8 NULL_HMAC_SHA1_80 inline:CRYPTO128
 a=crypto:9 NULL_HMAC_SHA1_32 inline:CRYPTO128
+a=crypto:10 AEAD_AES_128_GCM inline:CRYPTO128S
+a=crypto:11 AEAD_AES_256_GCM inline:CRYPTO256S
 SDP
 
 answer('gh 661 from RTP suppress one', { ICE => 'remove' }, <<SDP);
@@ -4399,6 +4441,8 @@ a=crypto:6 F8_128_HMAC_SHA1_80 inline:CRYPTO128
 a=crypto:7 F8_128_HMAC_SHA1_32 inline:CRYPTO128
 a=crypto:8 NULL_HMAC_SHA1_80 inline:CRYPTO128
 a=crypto:9 NULL_HMAC_SHA1_32 inline:CRYPTO128
+a=crypto:10 AEAD_AES_128_GCM inline:CRYPTO128S
+a=crypto:11 AEAD_AES_256_GCM inline:CRYPTO256S
 SDP
 
 answer('gh 661 from RTP suppress first', { ICE => 'remove' }, <<SDP);
@@ -5149,6 +5193,8 @@ a=crypto:7 F8_128_HMAC_SHA1_80 inline:CRYPTO128
 a=crypto:8 F8_128_HMAC_SHA1_32 inline:CRYPTO128
 a=crypto:9 NULL_HMAC_SHA1_80 inline:CRYPTO128
 a=crypto:10 NULL_HMAC_SHA1_32 inline:CRYPTO128
+a=crypto:11 AEAD_AES_128_GCM inline:CRYPTO128S
+a=crypto:12 AEAD_AES_256_GCM inline:CRYPTO256S
 SDP
 
 answer('media playback, SRTP', { replace => ['origin'] }, <<SDP);
@@ -0,0 +1,37 @@
+#ifndef _BENCH_H_
+#define _BENCH_H_
+
+#include <stdlib.h>
+#include <time.h>
+#include <sys/types.h>
+#include "compat.h"
+
+
+// helpers shared by the *-bench programs
+
+
+INLINE u_int64_t now_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (u_int64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// numeric command line argument number `idx`, `def` if not given, and no less than `min`
+INLINE unsigned int bench_arg(int argc, char **argv, int idx, unsigned int def, unsigned int min) {
+	unsigned int ret = def;
+	if (argc > idx)
+		ret = atoi(argv[idx]);
+	if (ret < min)
+		ret = min;
+	return ret;
+}
+
+INLINE double bench_ns_per_op(u_int64_t ns, u_int64_t ops) {
+	return ops ? (double) ns / ops : 0;
+}
+
+INLINE double bench_ops_per_sec(u_int64_t ops, u_int64_t ns) {
+	return ns ? (double) ops * 1000000000.0 / ns : 0;
+}
+
+#endif
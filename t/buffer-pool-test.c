@@ -0,0 +1,156 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <glib.h>
+#include "buffer_pool.h"
+#include "test.h"
+
+#define NUM_BUFS 64
+#define NUM_THREADS 4
+
+
+static struct packet_buf *bufs[NUM_BUFS];
+
+static void stats_diff(struct buffer_pool_stats *out, const struct buffer_pool_stats *before) {
+	struct buffer_pool_stats now;
+	buffer_pool_stats(&now);
+	out->hits = now.hits - before->hits;
+	out->exhausted = now.exhausted - before->exhausted;
+}
+
+static void *reader(void *p) {
+	unsigned int idx = GPOINTER_TO_UINT(p);
+
+	for (unsigned int i = 0; i < NUM_BUFS; i++) {
+		unsigned int j = (i + idx * 7) % NUM_BUFS;
+		check(packet_buf_data(bufs[j])[0] == (char) j);
+		packet_buf_put(bufs[j]);
+	}
+	return NULL;
+}
+
+// buffers are released by other threads and find their way back to the allocating thread's pool
+static void handoff(void) {
+	pthread_t threads[NUM_THREADS];
+	struct buffer_pool_stats before, diff;
+	GHashTable *orig = g_hash_table_new(g_direct_hash, g_direct_equal);
+
+	// runs first, so the pool starts out empty
+	buffer_pool_stats(&before);
+	for (unsigned int i = 0; i < NUM_BUFS; i++) {
+		bufs[i] = packet_buf_new();
+		packet_buf_data(bufs[i])[0] = i;
+		g_hash_table_add(orig, bufs[i]);
+		for (unsigned int j = 0; j < NUM_THREADS; j++)
+			packet_buf_get(bufs[i]);
+	}
+	stats_diff(&diff, &before);
+	check(diff.exhausted == NUM_BUFS);
+	check(diff.hits == 0);
+
+	for (unsigned int i = 0; i < NUM_THREADS; i++)
+		pthread_create(&threads[i], NULL, reader, GUINT_TO_POINTER(i));
+	// our own references go away while the readers still hold theirs
+	for (unsigned int i = 0; i < NUM_BUFS; i++)
+		packet_buf_put(bufs[i]);
+	for (unsigned int i = 0; i < NUM_THREADS; i++)
+		pthread_join(threads[i], NULL);
+
+	// every buffer is back, whichever thread dropped the last reference
+	buffer_pool_stats(&before);
+	for (unsigned int i = 0; i < NUM_BUFS; i++) {
+		bufs[i] = packet_buf_new();
+		check(bufs[i]->ref == 1);
+		check(g_hash_table_remove(orig, bufs[i]));
+	}
+	stats_diff(&diff, &before);
+	check(diff.exhausted == 0);
+	check(diff.hits == NUM_BUFS);
+	check(g_hash_table_size(orig) == 0);
+
+	for (unsigned int i = 0; i < NUM_BUFS; i++)
+		packet_buf_put(bufs[i]);
+	g_hash_table_destroy(orig);
+
+	test_ok("handoff");
+}
+
+static void get_put(void) {
+	struct buffer_pool_stats before, diff;
+	struct packet_buf *pb, *pb2;
+	str s;
+
+	buffer_pool_stats(&before);
+
+	pb = packet_buf_new();
+	check(pb->ref == 1);
+	check(pb->pool != NULL);
+	check(packet_buf_data(pb) == pb->buf + RTP_BUFFER_HEAD_ROOM);
+
+	str_init_len(&s, packet_buf_data(pb), MAX_RTP_PACKET_SIZE);
+	check(packet_buf_contains(pb, &s));
+	check(packet_buf_head_room(pb, &s) == RTP_BUFFER_HEAD_ROOM);
+	str_init_len(&s, pb->buf + sizeof(pb->buf) - 10, 20);
+	check(!packet_buf_contains(pb, &s));
+	check(packet_buf_head_room(pb, &s) == 0);
+
+	// the most recently released buffer is handed out next
+	packet_buf_put(pb);
+	pb2 = packet_buf_new();
+	check(pb2 == pb);
+
+	// a buffer with another reference stays out of the pool
+	packet_buf_get(pb);
+	check(pb->ref == 2);
+	packet_buf_put(pb);
+	check(pb->ref == 1);
+	pb2 = packet_buf_new();
+	check(pb2 != pb);
+	packet_buf_put(pb2);
+	packet_buf_put(pb);
+
+	stats_diff(&diff, &before);
+	check(diff.exhausted == 0);
+	check(diff.hits == 3);
+
+	test_ok("get_put");
+}
+
+static void exhaustion(void) {
+	const unsigned int num = BUFFER_POOL_MAX_FREE + NUM_BUFS;
+	struct packet_buf **all = g_new(struct packet_buf *, num);
+	struct buffer_pool_stats before, diff;
+
+	// more than the pool holds, so some are newly allocated
+	buffer_pool_stats(&before);
+	for (unsigned int i = 0; i < num; i++)
+		all[i] = packet_buf_new();
+	stats_diff(&diff, &before);
+	check(diff.hits + diff.exhausted == num);
+	check(diff.exhausted >= NUM_BUFS);
+
+	// only up to the limit is kept around
+	for (unsigned int i = 0; i < num; i++)
+		packet_buf_put(all[i]);
+
+	buffer_pool_stats(&before);
+	for (unsigned int i = 0; i < num; i++)
+		all[i] = packet_buf_new();
+	stats_diff(&diff, &before);
+	check(diff.hits == BUFFER_POOL_MAX_FREE);
+	check(diff.exhausted == NUM_BUFS);
+
+	for (unsigned int i = 0; i < num; i++)
+		packet_buf_put(all[i]);
+	g_free(all);
+
+	test_ok("exhaustion");
+}
+
+int main(void) {
+	handoff();
+	get_put();
+	exhaustion();
+	return 0;
+}
@@ -0,0 +1,149 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <glib.h>
+#include "cookie_cache.h"
+#include "test.h"
+
+
+static str *lookup(struct cookie_cache *c, const char *cookie) {
+	str s;
+	str_init(&s, (char *) cookie);
+	return cookie_cache_lookup(c, &s);
+}
+
+static void insert(struct cookie_cache *c, const char *cookie, const char *reply) {
+	str s, r;
+	str_init(&s, (char *) cookie);
+	str_init(&r, (char *) reply);
+	cookie_cache_insert(c, &s, &r);
+}
+
+static void basic(void) {
+	struct cookie_cache c = {0};
+	struct cookie_cache_stats stats;
+	str *ret;
+	str s;
+
+	rtpe_now.tv_sec = 1000;
+	cookie_cache_init(&c, 0);
+
+	check(lookup(&c, "abc") == NULL);
+	insert(&c, "abc", "reply one");
+	ret = lookup(&c, "abc");
+	check(ret != NULL);
+	check(!str_cmp(ret, "reply one"));
+	free(ret);
+
+	check(lookup(&c, "def") == NULL);
+	str_init(&s, "def");
+	cookie_cache_remove(&c, &s);
+	check(lookup(&c, "def") == NULL);
+	insert(&c, "def", "reply two");
+
+	cookie_cache_stats(&c, &stats);
+	check(stats.hits == 1);
+	check(stats.misses == 3);
+	check(stats.in_flight == 0);
+	check(stats.entries == 2);
+
+	// expired after 30 seconds
+	rtpe_now.tv_sec += 29;
+	ret = lookup(&c, "abc");
+	check(ret != NULL);
+	free(ret);
+	rtpe_now.tv_sec += 1;
+	check(lookup(&c, "abc") == NULL);
+	insert(&c, "abc", "reply three");
+	ret = lookup(&c, "abc");
+	check(ret != NULL);
+	check(!str_cmp(ret, "reply three"));
+	free(ret);
+
+	cookie_cache_stats(&c, &stats);
+	check(stats.evicted == 0);
+
+	test_ok("basic");
+}
+
+static void size_limit(void) {
+	struct cookie_cache c = {0};
+	struct cookie_cache_stats stats;
+	char cookie[32], reply[512];
+
+	rtpe_now.tv_sec = 2000;
+	cookie_cache_init(&c, 64 * 1024);
+
+	memset(reply, 'x', sizeof(reply) - 1);
+	reply[sizeof(reply) - 1] = '\0';
+
+	for (int i = 0; i < 10000; i++) {
+		sprintf(cookie, "cookie%i", i);
+		check(lookup(&c, cookie) == NULL);
+		insert(&c, cookie, reply);
+	}
+
+	cookie_cache_stats(&c, &stats);
+	check(stats.bytes <= 64 * 1024);
+	check(stats.evicted > 0);
+	check(stats.entries + stats.evicted == 10000);
+
+	// most recent ones are kept
+	str *ret = lookup(&c, "cookie9999");
+	check(ret != NULL);
+	free(ret);
+
+	test_ok("size_limit");
+}
+
+static struct cookie_cache wait_cache;
+static str *wait_ret;
+
+static void *waiter(void *p) {
+	rtpe_now.tv_sec = 3000;
+	wait_ret = lookup(&wait_cache, "inflight");
+	return NULL;
+}
+
+static void in_flight(void) {
+	struct cookie_cache_stats stats;
+	pthread_t thr;
+
+	rtpe_now.tv_sec = 3000;
+	cookie_cache_init(&wait_cache, 0);
+
+	check(lookup(&wait_cache, "inflight") == NULL);
+	pthread_create(&thr, NULL, waiter, NULL);
+
+	// wait for the second lookup to block on the first one
+	for (int i = 0; i < 1000; i++) {
+		cookie_cache_stats(&wait_cache, &stats);
+		if (stats.in_flight)
+			break;
+		usleep(1000);
+	}
+	check(stats.in_flight == 1);
+	check(wait_ret == NULL);
+
+	// other cookies are not held up
+	check(lookup(&wait_cache, "other") == NULL);
+
+	insert(&wait_cache, "inflight", "the reply");
+	pthread_join(thr, NULL);
+	check(wait_ret != NULL);
+	check(!str_cmp(wait_ret, "the reply"));
+	free(wait_ret);
+
+	cookie_cache_stats(&wait_cache, &stats);
+	check(stats.hits == 1);
+
+	test_ok("in_flight");
+}
+
+int main(void) {
+	basic();
+	size_limit();
+	in_flight();
+	return 0;
+}
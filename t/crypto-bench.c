@@ -0,0 +1,281 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <arpa/inet.h>
+#include <glib.h>
+#include "crypto.h"
+#include "rtp.h"
+#include "rtcp.h"
+#include "rtplib.h"
+#include "rtcplib.h"
+#include "ssrc.h"
+#include "call.h"
+#include "log.h"
+#include "main.h"
+#include "bench.h"
+
+int _log_facility_rtcp;
+int _log_facility_cdr;
+int _log_facility_dtmf;
+struct rtpengine_config rtpe_config;
+struct poller *rtpe_poller;
+struct poller **rtpe_media_pollers;
+GString *dtmf_logs;
+
+
+// SRTP/SRTCP throughput for all crypto suites, using local buffers only.
+//
+// usage: crypto-bench [threads] [packets]
+
+
+#define BATCH		64
+#define MAX_PAYLOAD	1200
+#define BUF_SIZE	(MAX_PAYLOAD + 128) // header, tag, MKI, SRTCP index
+
+enum bench_op {
+	OP_RTP_PROTECT = 0,
+	OP_RTP_UNPROTECT,
+	OP_RTCP_PROTECT,
+	OP_RTCP_UNPROTECT,
+
+	__OP_LAST
+};
+
+static const char *op_names[__OP_LAST] = {
+	[OP_RTP_PROTECT]	= "rtp_avp2savp",
+	[OP_RTP_UNPROTECT]	= "rtp_savp2avp",
+	[OP_RTCP_PROTECT]	= "rtcp_avp2savp",
+	[OP_RTCP_UNPROTECT]	= "rtcp_savp2avp",
+};
+
+static const unsigned int payload_sizes[] = { 60, 160, 320, 640, 1200 };
+
+static unsigned int num_packets = 20000;
+
+struct bench_thread {
+	pthread_t thread;
+	pthread_barrier_t *barrier;
+	const struct crypto_suite *cs;
+	unsigned int payload_len;
+	unsigned int idx;
+
+	u_int64_t ns[__OP_LAST];
+	u_int64_t kdf_ns;
+	unsigned int kdf_num;
+	unsigned int failures;
+};
+
+static void bench_params(struct crypto_params *p, const struct crypto_suite *cs, unsigned int seed) {
+	ZERO(*p);
+	p->crypto_suite = cs;
+	for (unsigned int i = 0; i < cs->master_key_len; i++)
+		p->master_key[i] = seed + i * 7;
+	for (unsigned int i = 0; i < cs->master_salt_len; i++)
+		p->master_salt[i] = seed + i * 13;
+}
+
+// same as the session key setup done for the first RTP packet
+static void bench_kdf(struct bench_thread *bt, const struct crypto_params *p) {
+	struct crypto_context c;
+	str s;
+	u_int64_t start;
+
+	ZERO(c);
+	start = now_ns();
+	for (unsigned int i = 0; i < bt->kdf_num; i++) {
+		crypto_init(&c, p);
+		str_init_len_assert(&s, c.session_key, p->crypto_suite->session_key_len);
+		crypto_gen_session_key(&c, &s, 0x00, 6);
+		str_init_len_assert(&s, c.session_auth_key, p->crypto_suite->srtp_auth_key_len);
+		crypto_gen_session_key(&c, &s, 0x01, 6);
+		str_init_len_assert(&s, c.session_salt, p->crypto_suite->session_salt_len);
+		crypto_gen_session_key(&c, &s, 0x02, 6);
+		c.have_session_key = 1;
+		crypto_init_session_key(&c);
+	}
+	bt->kdf_ns = now_ns() - start;
+	crypto_cleanup(&c);
+}
+
+static void *bench_thread_run(void *p) {
+	struct bench_thread *bt = p;
+	static __thread char bufs[BATCH][BUF_SIZE];
+	unsigned int lens[BATCH];
+	struct crypto_params params;
+	struct crypto_context rtp_tx, rtp_rx, rtcp_tx, rtcp_rx;
+	struct ssrc_entry_call entry;
+	struct ssrc_ctx tx_ctx, rx_ctx;
+	u_int32_t ssrc = htonl(0x12340000 + bt->idx);
+	u_int16_t seq = 1000;
+	u_int64_t t0, t1, t2;
+	str s;
+
+	bench_params(&params, bt->cs, bt->idx);
+	ZERO(rtp_tx);
+	ZERO(rtp_rx);
+	ZERO(rtcp_tx);
+	ZERO(rtcp_rx);
+	crypto_init(&rtp_tx, &params);
+	crypto_init(&rtp_rx, &params);
+	crypto_init(&rtcp_tx, &params);
+	crypto_init(&rtcp_rx, &params);
+
+	ZERO(entry);
+	entry.h.ssrc = ntohl(ssrc);
+	ZERO(tx_ctx);
+	ZERO(rx_ctx);
+	tx_ctx.parent = &entry;
+	rx_ctx.parent = &entry;
+
+	pthread_barrier_wait(bt->barrier);
+
+	bench_kdf(bt, &params);
+
+	for (unsigned int done = 0; done < num_packets; done += BATCH) {
+		// RTP
+		for (unsigned int i = 0; i < BATCH; i++) {
+			struct rtp_header *rtp = (void *) bufs[i];
+			memset(bufs[i], 0x55, RTP_HEADER_LENGTH + bt->payload_len);
+			rtp->v_p_x_cc = 0x80;
+			rtp->m_pt = 0;
+			rtp->seq_num = htons(seq++);
+			rtp->timestamp = htonl(seq * 160);
+			rtp->ssrc = ssrc;
+			lens[i] = RTP_HEADER_LENGTH + bt->payload_len;
+		}
+
+		t0 = now_ns();
+		for (unsigned int i = 0; i < BATCH; i++) {
+			str_init_len(&s, bufs[i], lens[i]);
+			if (rtp_avp2savp(&s, &rtp_tx, &tx_ctx))
+				bt->failures++;
+			lens[i] = s.len;
+		}
+		t1 = now_ns();
+		for (unsigned int i = 0; i < BATCH; i++) {
+			str_init_len(&s, bufs[i], lens[i]);
+			if (rtp_savp2avp(&s, &rtp_rx, &rx_ctx))
+				bt->failures++;
+			else if (s.len != RTP_HEADER_LENGTH + bt->payload_len || bufs[i][s.len - 1] != 0x55)
+				bt->failures++;
+		}
+		t2 = now_ns();
+		bt->ns[OP_RTP_PROTECT] += t1 - t0;
+		bt->ns[OP_RTP_UNPROTECT] += t2 - t1;
+
+		// RTCP
+		for (unsigned int i = 0; i < BATCH; i++) {
+			struct rtcp_packet *rtcp = (void *) bufs[i];
+			memset(bufs[i], 0x55, sizeof(*rtcp) + bt->payload_len);
+			rtcp->header.version = 2;
+			rtcp->header.p = 0;
+			rtcp->header.count = 0;
+			rtcp->header.pt = 201; // RR
+			rtcp->header.length = htons((sizeof(*rtcp) + bt->payload_len) / 4 - 1);
+			rtcp->ssrc = ssrc;
+			lens[i] = sizeof(*rtcp) + bt->payload_len;
+		}
+
+		t0 = now_ns();
+		for (unsigned int i = 0; i < BATCH; i++) {
+			str_init_len(&s, bufs[i], lens[i]);
+			if (rtcp_avp2savp(&s, &rtcp_tx, &tx_ctx) < 0)
+				bt->failures++;
+			lens[i] = s.len;
+		}
+		t1 = now_ns();
+		for (unsigned int i = 0; i < BATCH; i++) {
+			str_init_len(&s, bufs[i], lens[i]);
+			if (rtcp_savp2avp(&s, &rtcp_rx, &rx_ctx))
+				bt->failures++;
+			else if (s.len != sizeof(struct rtcp_packet) + bt->payload_len
+					|| bufs[i][s.len - 1] != 0x55)
+				bt->failures++;
+		}
+		t2 = now_ns();
+		bt->ns[OP_RTCP_PROTECT] += t1 - t0;
+		bt->ns[OP_RTCP_UNPROTECT] += t2 - t1;
+	}
+
+	crypto_cleanup(&rtp_tx);
+	crypto_cleanup(&rtp_rx);
+	crypto_cleanup(&rtcp_tx);
+	crypto_cleanup(&rtcp_rx);
+
+	return NULL;
+}
+
+static unsigned int bench_run(const struct crypto_suite *cs, unsigned int payload_len, unsigned int num_threads) {
+	struct bench_thread bts[num_threads];
+	pthread_barrier_t barrier;
+	unsigned int failures = 0;
+	unsigned int packets = (num_packets + BATCH - 1) / BATCH * BATCH;
+	double ns, pps, kdf_ns;
+
+	pthread_barrier_init(&barrier, NULL, num_threads);
+
+	for (unsigned int i = 0; i < num_threads; i++) {
+		bts[i] = (struct bench_thread) {
+			.barrier = &barrier,
+			.cs = cs,
+			.payload_len = payload_len,
+			.idx = i,
+			.kdf_num = num_packets / 100 + 1,
+		};
+		pthread_create(&bts[i].thread, NULL, bench_thread_run, &bts[i]);
+	}
+	for (unsigned int i = 0; i < num_threads; i++)
+		pthread_join(bts[i].thread, NULL);
+
+	pthread_barrier_destroy(&barrier);
+
+	for (unsigned int op = 0; op < __OP_LAST; op++) {
+		ns = 0;
+		pps = 0;
+		for (unsigned int i = 0; i < num_threads; i++) {
+			ns += bench_ns_per_op(bts[i].ns[op], packets) / num_threads;
+			pps += bench_ops_per_sec(packets, bts[i].ns[op]);
+		}
+		printf("%-24s %5u %3u  %-14s %10.1f ns/packet %12.0f packets/s\n",
+				cs->name, payload_len, num_threads, op_names[op], ns, pps);
+	}
+
+	kdf_ns = 0;
+	for (unsigned int i = 0; i < num_threads; i++) {
+		kdf_ns += (double) bts[i].kdf_ns / bts[i].kdf_num / num_threads;
+		failures += bts[i].failures;
+	}
+	printf("%-24s %5s %3u  %-14s %10.1f ns/context\n",
+			cs->name, "-", num_threads, "session keys", kdf_ns);
+
+	return failures;
+}
+
+int main(int argc, char **argv) {
+	unsigned int num_threads = bench_arg(argc, argv, 1, g_get_num_processors(), 1);
+	unsigned int failures = 0;
+
+	num_packets = bench_arg(argc, argv, 2, num_packets, BATCH);
+
+	crypto_init_main();
+
+	printf("%-24s %5s %3s  %-14s\n", "suite", "bytes", "thr", "operation");
+
+	for (unsigned int i = 0; i < num_crypto_suites; i++) {
+		const struct crypto_suite *cs = &crypto_suites[i];
+
+		for (unsigned int j = 0; j < G_N_ELEMENTS(payload_sizes); j++) {
+			failures += bench_run(cs, payload_sizes[j], 1);
+			if (num_threads > 1)
+				failures += bench_run(cs, payload_sizes[j], num_threads);
+		}
+	}
+
+	if (failures) {
+		printf("%u packets failed to round trip\n", failures);
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,231 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <glib.h>
+#include "codeclib.h"
+#include "test.h"
+
+struct test_packet {
+	seq_packet_t p;
+	int freed;
+};
+
+static struct test_packet packets[0x10000];
+static unsigned int num_freed;
+
+static void packet_free(void *p) {
+	struct test_packet *tp = p;
+	tp->freed = 1;
+	num_freed++;
+}
+
+
+static int __insert(packet_sequencer_t *ps, int seq) {
+	struct test_packet *tp = &packets[seq];
+	tp->p.seq = seq;
+	tp->freed = 0;
+	return packet_sequencer_insert(ps, &tp->p);
+}
+
+#define insert(seq, exp) do { check(__insert(&ps, seq) == (exp)); } while (0)
+#define next(exp) do { \
+		seq_packet_t *__p = packet_sequencer_next_packet(&ps); \
+		check(__p != NULL); \
+		check(__p->seq == (exp)); \
+	} while (0)
+#define force_next(exp) do { \
+		seq_packet_t *__p = packet_sequencer_force_next_packet(&ps); \
+		check(__p != NULL); \
+		check(__p->seq == (exp)); \
+	} while (0)
+#define next_none() do { check(packet_sequencer_next_packet(&ps) == NULL); } while (0)
+
+static void in_order(void) {
+	packet_sequencer_t ps = {0};
+	packet_sequencer_init(&ps, packet_free);
+	check(ps.depth == 128);
+
+	for (int i = 1000; i < 1500; i++) {
+		insert(i, 0);
+		check(packet_sequencer_next_ok(&ps));
+		next(i);
+		next_none();
+	}
+	check(ps.count == 0);
+	check(ps.lost_count == 0);
+	check(ps.ext_seq == 1499);
+
+	packet_sequencer_destroy(&ps);
+	test_ok("in_order");
+}
+
+static void reorder(void) {
+	packet_sequencer_t ps = {0};
+	packet_sequencer_init(&ps, packet_free);
+
+	insert(100, 0);
+	next(100);
+	insert(102, 0);
+	check(!packet_sequencer_next_ok(&ps));
+	next_none();
+	insert(103, 0);
+	next_none();
+	insert(101, 0);
+	next(101);
+	next(102);
+	next(103);
+	next_none();
+	check(ps.lost_count == 0);
+
+	packet_sequencer_destroy(&ps);
+	test_ok("reorder");
+}
+
+static void loss(void) {
+	packet_sequencer_t ps = {0};
+	packet_sequencer_init(&ps, packet_free);
+
+	insert(500, 0);
+	next(500);
+	// 501 and 502 lost: returned only after 10 packets are queued
+	for (int i = 503; i < 512; i++) {
+		insert(i, 0);
+		next_none();
+	}
+	insert(512, 0);
+	next(503);
+	check(ps.lost_count == 2);
+	for (int i = 504; i <= 512; i++)
+		next(i);
+	next_none();
+
+	// force skips the wait
+	insert(520, 0);
+	next_none();
+	force_next(520);
+	check(ps.lost_count == 9);
+
+	// late arrival of a lost packet
+	insert(501, -1);
+	check(ps.late_count == 1);
+	check(packets[501].freed == 0);
+
+	packet_sequencer_destroy(&ps);
+	test_ok("loss");
+}
+
+static void dupes(void) {
+	packet_sequencer_t ps = {0};
+	packet_sequencer_init(&ps, packet_free);
+
+	insert(10, 0);
+	insert(12, 0);
+	insert(12, -1);
+	check(ps.dupe_count == 1);
+	next(10);
+	insert(10, -1);
+	check(ps.late_count == 1);
+	insert(11, 0);
+	next(11);
+	next(12);
+	insert(12, -1);
+	check(ps.late_count == 2);
+	check(ps.count == 0);
+
+	packet_sequencer_destroy(&ps);
+	test_ok("dupes");
+}
+
+static void wrap(void) {
+	packet_sequencer_t ps = {0};
+	packet_sequencer_init(&ps, packet_free);
+
+	// pairs swapped
+	insert(65530, 0);
+	for (int i = 65531; i < 65536 + 10; i += 2) {
+		if (i + 1 < 65536 + 10)
+			insert((i + 1) & 0xffff, 0);
+		insert(i & 0xffff, 0);
+	}
+	for (int i = 65530; i < 65536 + 10; i++)
+		next(i & 0xffff);
+	next_none();
+	check(ps.roc == 1);
+	check(ps.ext_seq == 0x10000 + 9);
+
+	// lost packets across the wrap
+	insert(65535, -1);
+	check(ps.late_count == 1);
+	for (int i = 12; i < 22; i++)
+		insert(i, 0);
+	next(12);
+	check(ps.lost_count == 2);
+
+	packet_sequencer_destroy(&ps);
+	test_ok("wrap");
+}
+
+static void seq_reset(void) {
+	packet_sequencer_t ps = {0};
+	packet_sequencer_init(&ps, packet_free);
+
+	num_freed = 0;
+	insert(1000, 0);
+	next(1000);
+	insert(1002, 0);
+	insert(1003, 0);
+	insert(30000, 1);
+	check(num_freed == 2);
+	check(packets[1002].freed && packets[1003].freed);
+	check(ps.count == 1);
+	next(30000);
+
+	// too far ahead for the queue
+	insert(30000 + 200, 1);
+	next(30200);
+
+	// queued packets are freed on destroy
+	num_freed = 0;
+	insert(30205, 0);
+	insert(30206, 0);
+	packet_sequencer_destroy(&ps);
+	check(num_freed == 2);
+	check(ps.packets == NULL);
+	test_ok("seq_reset");
+}
+
+static void depth(void) {
+	packet_sequencer_t ps = {0};
+	packet_sequencer_init_depth(&ps, packet_free, 20);
+	check(ps.depth == 32);
+
+	insert(0, 0);
+	next(0);
+	// beyond the reordering window
+	insert(33, 1);
+	next(33);
+	// fill up all slots
+	insert(34 + 31, 0);
+	insert(34 + 30, 0);
+	check(ps.count == 2);
+	for (int i = 34; i < 34 + 30; i++)
+		insert(i, 0);
+	check(ps.count == 32);
+	for (int i = 34; i < 34 + 32; i++)
+		next(i);
+	next_none();
+	check(ps.lost_count == 0);
+
+	packet_sequencer_destroy(&ps);
+	test_ok("depth");
+}
+
+int main(void) {
+	in_order();
+	reorder();
+	loss();
+	dupes();
+	wrap();
+	seq_reset();
+	depth();
+	return 0;
+}
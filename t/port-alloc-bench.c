@@ -0,0 +1,229 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <glib.h>
+#include "aux.h"
+#include "port_ring.h"
+#include "bench.h"
+
+
+// Cost of allocating a pair of media ports while the port range is filled up to a given
+// level, with one random pair released before each allocation. Compares the free pair ring
+// with a model of the previous allocator, which searched the range from the last used port
+// on. The model ("scan (model)" below) mirrors that search on a bit array and doesn't
+// include the bind() attempts the real code made for each candidate port.
+//
+// usage: port-alloc-bench [fill percentage] [allocations]
+
+
+#define PORT_MIN 30000
+#define PORT_MAX 39999
+#define NUM_PAIRS ((PORT_MAX - PORT_MIN + 1) / 2)
+
+#define RING_NAME "ring"
+#define SCAN_NAME "scan (model)"
+
+static unsigned int num_allocs = 1000000;
+static unsigned int rng = 1;
+
+static unsigned int bench_rand(void) {
+	rng ^= rng << 13;
+	rng ^= rng >> 17;
+	rng ^= rng << 5;
+	return rng;
+}
+
+
+// model of the previous allocator: start after the last used port, try the free list if
+// that's taken, then probe port by port
+struct scan_alloc {
+	BIT_ARRAY_DECLARE(ports_used, 0x10000);
+	unsigned int last_used;
+	mutex_t free_list_lock;
+	GQueue free_list;
+	BIT_ARRAY_DECLARE(free_list_used, 0x10000);
+	u_int64_t probes;
+};
+
+static int scan_get(struct scan_alloc *s) {
+	unsigned int port = s->last_used + 6 + (bench_rand() % 14);
+	int cycle = 0;
+
+	if (bit_array_isset(s->ports_used, port)) {
+		mutex_lock(&s->free_list_lock);
+		unsigned int fport = GPOINTER_TO_UINT(g_queue_pop_head(&s->free_list));
+		if (fport)
+			bit_array_clear(s->free_list_used, fport);
+		mutex_unlock(&s->free_list_lock);
+		if (fport)
+			port = fport;
+	}
+
+	while (1) {
+		if (port < PORT_MIN)
+			port = PORT_MIN;
+		if ((port & 1))
+			port++;
+		s->probes++;
+		if (port + 1 > PORT_MAX) {
+			port = 0;
+			if (++cycle >= 2)
+				return -1;
+			continue;
+		}
+		if (bit_array_set(s->ports_used, port)) {
+			port++;
+			continue;
+		}
+		if (bit_array_set(s->ports_used, port + 1)) {
+			bit_array_clear(s->ports_used, port);
+			port += 2;
+			continue;
+		}
+		s->last_used = port + 2;
+		return port;
+	}
+}
+
+static void scan_put(struct scan_alloc *s, unsigned int port) {
+	for (unsigned int p = port; p < port + 2; p++) {
+		bit_array_clear(s->ports_used, p);
+		if ((p & 1) == 0) {
+			mutex_lock(&s->free_list_lock);
+			if (!bit_array_isset(s->free_list_used, p)) {
+				g_queue_push_tail(&s->free_list, GUINT_TO_POINTER(p));
+				bit_array_set(s->free_list_used, p);
+			}
+			mutex_unlock(&s->free_list_lock);
+		}
+	}
+}
+
+
+struct ring_alloc {
+	BIT_ARRAY_DECLARE(ports_used, 0x10000);
+	struct port_ring ring;
+};
+
+static int ring_get(struct ring_alloc *r) {
+	return port_ring_get_pair(&r->ring, r->ports_used);
+}
+
+static void ring_put(struct ring_alloc *r, unsigned int port) {
+	for (unsigned int p = port; p < port + 2; p++) {
+		bit_array_clear(r->ports_used, p);
+		port_ring_put(&r->ring, r->ports_used, p);
+	}
+}
+
+
+static int bench_run(unsigned int fill, int ring) {
+	static struct scan_alloc scan;
+	static struct ring_alloc ra;
+	unsigned int num_used = NUM_PAIRS * fill / 100;
+	unsigned int *used = g_malloc(sizeof(*used) * NUM_PAIRS);
+	int failed = 0;
+
+	rng = 1;
+	if (ring) {
+		ZERO(ra);
+		port_ring_init(&ra.ring, PORT_MIN, PORT_MAX);
+	}
+	else {
+		ZERO(scan);
+		mutex_init(&scan.free_list_lock);
+		g_queue_init(&scan.free_list);
+	}
+
+	for (unsigned int i = 0; i < num_used; i++) {
+		int port = ring ? ring_get(&ra) : scan_get(&scan);
+		if (port < 0) {
+			failed = 1;
+			goto out;
+		}
+		used[i] = port;
+	}
+	// churn before measuring, so that free ports are spread across the range
+	for (unsigned int i = 0; i < num_used; i++) {
+		unsigned int idx = bench_rand() % num_used;
+		if (ring)
+			ring_put(&ra, used[idx]);
+		else
+			scan_put(&scan, used[idx]);
+		int port = ring ? ring_get(&ra) : scan_get(&scan);
+		if (port < 0) {
+			failed = 1;
+			goto out;
+		}
+		used[idx] = port;
+	}
+
+	u_int64_t probes = scan.probes;
+	u_int64_t start = now_ns();
+
+	for (unsigned int i = 0; i < num_allocs; i++) {
+		unsigned int idx = bench_rand() % num_used;
+		if (ring)
+			ring_put(&ra, used[idx]);
+		else
+			scan_put(&scan, used[idx]);
+		int port = ring ? ring_get(&ra) : scan_get(&scan);
+		if (port < 0) {
+			failed = 1;
+			goto out;
+		}
+		used[idx] = port;
+	}
+
+	u_int64_t ns = now_ns() - start;
+
+	if (ring)
+		printf("%-12s %3u%% full %10.1f ns/alloc %12.0f allocs/s\n", RING_NAME, fill,
+				bench_ns_per_op(ns, num_allocs),
+				bench_ops_per_sec(num_allocs, ns));
+	else
+		printf("%-12s %3u%% full %10.1f ns/alloc %12.0f allocs/s %8.1f probes/alloc\n",
+				SCAN_NAME, fill,
+				bench_ns_per_op(ns, num_allocs),
+				bench_ops_per_sec(num_allocs, ns),
+				(double) (scan.probes - probes) / num_allocs);
+
+out:
+	if (failed)
+		printf("%s: no free ports at %u%% full\n", ring ? RING_NAME : SCAN_NAME, fill);
+	if (ring)
+		g_free(ra.ring.slots);
+	else
+		g_queue_clear(&scan.free_list);
+	g_free(used);
+	return failed;
+}
+
+int main(int argc, char **argv) {
+	static const unsigned int fills[] = { 50, 80, 95, 99 };
+	int failures = 0;
+
+	num_allocs = bench_arg(argc, argv, 2, num_allocs, 1);
+
+	if (argc > 1) {
+		unsigned int fill = atoi(argv[1]);
+		if (fill < 1 || fill > 99) {
+			printf("fill percentage must be between 1 and 99\n");
+			return 1;
+		}
+		failures += bench_run(fill, 0);
+		failures += bench_run(fill, 1);
+	}
+	else {
+		for (unsigned int i = 0; i < G_N_ELEMENTS(fills); i++) {
+			failures += bench_run(fills[i], 0);
+			failures += bench_run(fills[i], 1);
+		}
+	}
+
+	if (failures) {
+		printf("allocation failed\n");
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,104 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <glib.h>
+#include "aux.h"
+#include "port_ring.h"
+#include "test.h"
+
+#define PORT_MIN 1001
+#define PORT_MAX 1200
+#define NUM_THREADS 4
+#define ROUNDS 200000
+
+
+static BIT_ARRAY_DECLARE(ports_used, 0x10000);
+static struct port_ring ring;
+static volatile int owners[0x10000];
+
+static void release(unsigned int port, unsigned int first) {
+	// release both ports separately, in either order, like release_port() does
+	bit_array_clear(ports_used, port + first);
+	port_ring_put(&ring, ports_used, port + first);
+	bit_array_clear(ports_used, port + !first);
+	port_ring_put(&ring, ports_used, port + !first);
+}
+
+static void *worker(void *p) {
+	unsigned int seed = GPOINTER_TO_UINT(p);
+	unsigned int held[32];
+	unsigned int num = 0;
+
+	for (unsigned int i = 0; i < ROUNDS; i++) {
+		if (num < G_N_ELEMENTS(held) && (rand_r(&seed) & 1)) {
+			int port = port_ring_get_pair(&ring, ports_used);
+			if (port < 0)
+				continue;
+			check((port & 1) == 0);
+			check(port >= PORT_MIN && port + 1 <= PORT_MAX);
+			check(bit_array_isset(ports_used, port));
+			check(bit_array_isset(ports_used, port + 1));
+			// never handed out twice
+			check(g_atomic_int_add(&owners[port], 1) == 0);
+			held[num++] = port;
+		}
+		else if (num) {
+			unsigned int idx = rand_r(&seed) % num;
+			unsigned int port = held[idx];
+			held[idx] = held[--num];
+			check(g_atomic_int_add(&owners[port], -1) == 1);
+			release(port, rand_r(&seed) & 1);
+		}
+	}
+
+	while (num) {
+		unsigned int port = held[--num];
+		check(g_atomic_int_add(&owners[port], -1) == 1);
+		release(port, 0);
+	}
+
+	return NULL;
+}
+
+static void concurrent(void) {
+	pthread_t threads[NUM_THREADS];
+	unsigned int num = 0, excluded = 0;
+
+	port_ring_init(&ring, PORT_MIN, PORT_MAX);
+
+	// taken by something else
+	bit_array_set(ports_used, 1100);
+
+	for (unsigned int i = 0; i < NUM_THREADS; i++)
+		pthread_create(&threads[i], NULL, worker, GUINT_TO_POINTER(i + 1));
+	for (unsigned int i = 0; i < NUM_THREADS; i++)
+		pthread_join(threads[i], NULL);
+
+	// every pair except the excluded one is back in the ring
+	for (unsigned int port = PORT_MIN + 1; port + 1 <= PORT_MAX; port += 2) {
+		if (port == 1100) {
+			excluded++;
+			continue;
+		}
+		check(!bit_array_isset(ports_used, port));
+		check(!bit_array_isset(ports_used, port + 1));
+		check(bit_array_isset(ring.queued, port));
+	}
+	check(excluded == 1);
+
+	int port;
+	while ((port = port_ring_get_pair(&ring, ports_used)) >= 0) {
+		check(port != 1100);
+		num++;
+	}
+	check(num == (PORT_MAX - PORT_MIN) / 2 - 1);
+
+	g_free(ring.slots);
+
+	test_ok("concurrent");
+}
+
+int main(void) {
+	concurrent();
+	return 0;
+}
@@ -0,0 +1,147 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <glib.h>
+#include <libavutil/frame.h>
+#include <libavutil/channel_layout.h>
+#include "codeclib.h"
+#include "resample.h"
+#include "bench.h"
+
+
+// Time and heap allocations per resampled 20 ms frame, for the owning resample_frame() and
+// for resample_frame_noalloc().
+//
+// usage: resample-bench [frames]
+
+
+// count all heap allocations, including the ones made from within libav*
+extern void *__libc_malloc(size_t);
+extern void *__libc_calloc(size_t, size_t);
+extern void *__libc_realloc(void *, size_t);
+extern void *__libc_memalign(size_t, size_t);
+
+static unsigned long num_allocs;
+
+void *malloc(size_t size) {
+	num_allocs++;
+	return __libc_malloc(size);
+}
+void *calloc(size_t n, size_t size) {
+	num_allocs++;
+	return __libc_calloc(n, size);
+}
+void *realloc(void *p, size_t size) {
+	if (!p)
+		num_allocs++;
+	return __libc_realloc(p, size);
+}
+void *memalign(size_t align, size_t size) {
+	num_allocs++;
+	return __libc_memalign(align, size);
+}
+void *aligned_alloc(size_t align, size_t size) {
+	num_allocs++;
+	return __libc_memalign(align, size);
+}
+int posix_memalign(void **p, size_t align, size_t size) {
+	num_allocs++;
+	*p = __libc_memalign(align, size);
+	return *p ? 0 : ENOMEM;
+}
+
+
+struct bench_case {
+	const char *name;
+	int from_rate;
+	int to_rate;
+};
+
+static const struct bench_case bench_cases[] = {
+	{ "identity",	8000,	8000 },
+	{ "8k->16k",	8000,	16000 },
+	{ "48k->8k",	48000,	8000 },
+};
+
+static unsigned int num_frames = 200000;
+static volatile int sink;
+
+static AVFrame *bench_frame(int rate) {
+	AVFrame *frame = av_frame_alloc();
+	frame->format = AV_SAMPLE_FMT_S16;
+	frame->sample_rate = rate;
+	frame->channel_layout = AV_CH_LAYOUT_MONO;
+	frame->nb_samples = rate / 50;
+	if (av_frame_get_buffer(frame, 0) < 0)
+		abort();
+	int16_t *s = (void *) frame->extended_data[0];
+	for (int i = 0; i < frame->nb_samples; i++)
+		s[i] = (i * 397) & 0x3fff;
+	return frame;
+}
+
+static int bench_run(const struct bench_case *bc, int noalloc) {
+	resample_t resample;
+	format_t to_format = {
+		.clockrate = bc->to_rate,
+		.channels = 1,
+		.format = AV_SAMPLE_FMT_S16,
+	};
+	AVFrame *in = bench_frame(bc->from_rate);
+	AVFrame *out;
+
+	memset(&resample, 0, sizeof(resample));
+
+	// warm up, so that the resampler setup isn't counted
+	out = resample_frame_noalloc(&resample, in, &to_format);
+	if (!out)
+		return 1;
+
+	unsigned long allocs = num_allocs;
+	u_int64_t start = now_ns();
+
+	for (unsigned int i = 0; i < num_frames; i++) {
+		in->pts = (u_int64_t) i * in->nb_samples;
+		if (noalloc)
+			out = resample_frame_noalloc(&resample, in, &to_format);
+		else
+			out = resample_frame(&resample, in, &to_format);
+		if (!out)
+			return 1;
+		sink = out->extended_data[0][0];
+		if (!noalloc)
+			av_frame_free(&out);
+	}
+
+	u_int64_t ns = now_ns() - start;
+	allocs = num_allocs - allocs;
+
+	printf("%-10s %-24s %10.1f ns/frame %8.2f allocs/frame %12.0f allocs/s\n",
+			bc->name, noalloc ? "resample_frame_noalloc" : "resample_frame",
+			bench_ns_per_op(ns, num_frames),
+			(double) allocs / num_frames,
+			bench_ops_per_sec(allocs, ns));
+
+	resample_shutdown(&resample);
+	av_frame_free(&in);
+	return 0;
+}
+
+int main(int argc, char **argv) {
+	int failures = 0;
+
+	num_frames = bench_arg(argc, argv, 1, num_frames, 1);
+
+	for (unsigned int i = 0; i < G_N_ELEMENTS(bench_cases); i++) {
+		failures += bench_run(&bench_cases[i], 0);
+		failures += bench_run(&bench_cases[i], 1);
+	}
+
+	if (failures) {
+		printf("resampling failed\n");
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,152 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <glib.h>
+#include "codeclib.h"
+#include "bench.h"
+
+
+// Cost of one insert and pop through the packet sequencer, for different arrival patterns,
+// next to the same operations done on a GTree as previously used by the sequencer.
+//
+// usage: sequencer-bench [packets]
+
+
+enum bench_pattern {
+	PAT_IN_ORDER = 0,
+	PAT_REORDER, // every other pair of packets swapped
+	PAT_LOSS, // one packet in 100 lost
+
+	__PAT_LAST
+};
+
+static const char *pattern_names[__PAT_LAST] = {
+	[PAT_IN_ORDER]	= "in order",
+	[PAT_REORDER]	= "reordered",
+	[PAT_LOSS]	= "1% loss",
+};
+
+static unsigned int num_packets = 2000000;
+static seq_packet_t packets[0x10000];
+static volatile int sink;
+
+// arrival order of packet number `i`
+static unsigned int bench_seq(enum bench_pattern pat, unsigned int i) {
+	switch (pat) {
+		case PAT_REORDER:
+			if ((i & 3) == 2)
+				return i + 1;
+			if ((i & 3) == 3)
+				return i - 1;
+			return i;
+		default:
+			return i;
+	}
+}
+
+static unsigned int bench_ring(enum bench_pattern pat) {
+	packet_sequencer_t ps = {0};
+	unsigned int out = 0;
+
+	packet_sequencer_init(&ps, NULL);
+
+	for (unsigned int i = 0; i < num_packets; i++) {
+		if (pat == PAT_LOSS && i % 100 == 50)
+			continue;
+		seq_packet_t *p = &packets[bench_seq(pat, i) & 0xffff];
+		p->seq = bench_seq(pat, i) & 0xffff;
+		if (packet_sequencer_insert(&ps, p) < 0)
+			continue;
+		while ((p = packet_sequencer_next_packet(&ps))) {
+			sink = p->seq;
+			out++;
+		}
+	}
+	while (packet_sequencer_force_next_packet(&ps))
+		out++;
+
+	packet_sequencer_destroy(&ps);
+	return out;
+}
+
+static int ptr_cmp(const void *a, const void *b, void *dummy) {
+	if (a < b)
+		return -1;
+	if (a > b)
+		return 1;
+	return 0;
+}
+
+// lookups, inserts and removals as done by the tree based sequencer, without loss handling
+static unsigned int bench_tree(enum bench_pattern pat) {
+	GTree *t = g_tree_new_full(ptr_cmp, NULL, NULL, NULL);
+	unsigned int out = 0;
+	int seq = 0;
+
+	for (unsigned int i = 0; i < num_packets; i++) {
+		if (pat == PAT_LOSS && i % 100 == 50)
+			continue;
+		seq_packet_t *p = &packets[bench_seq(pat, i) & 0xffff];
+		p->seq = bench_seq(pat, i) & 0xffff;
+		if (g_tree_lookup(t, GINT_TO_POINTER(p->seq)))
+			continue;
+		g_tree_insert(t, GINT_TO_POINTER(p->seq), p);
+		while (1) {
+			p = g_tree_lookup(t, GINT_TO_POINTER(seq));
+			if (!p) {
+				if (g_tree_nnodes(t) < 10)
+					break;
+				seq = (seq + 1) & 0xffff;
+				continue;
+			}
+			g_tree_steal(t, GINT_TO_POINTER(seq));
+			sink = p->seq;
+			seq = (p->seq + 1) & 0xffff;
+			out++;
+		}
+	}
+	out += g_tree_nnodes(t);
+
+	g_tree_destroy(t);
+	return out;
+}
+
+static int bench_run(enum bench_pattern pat, int tree) {
+	unsigned int expected = num_packets;
+	if (pat == PAT_LOSS)
+		expected -= (num_packets + 49) / 100;
+
+	u_int64_t start = now_ns();
+	unsigned int out = tree ? bench_tree(pat) : bench_ring(pat);
+	u_int64_t ns = now_ns() - start;
+
+	printf("%-10s %-10s %10.1f ns/packet %12.0f packets/s\n",
+			tree ? "gtree" : "ring", pattern_names[pat],
+			bench_ns_per_op(ns, num_packets),
+			bench_ops_per_sec(num_packets, ns));
+
+	if (out != expected) {
+		printf("%u packets out of %u returned\n", out, expected);
+		return 1;
+	}
+	return 0;
+}
+
+int main(int argc, char **argv) {
+	int failures = 0;
+
+	num_packets = bench_arg(argc, argv, 1, num_packets, 100);
+	// complete reordered groups
+	num_packets &= ~3;
+
+	for (unsigned int pat = 0; pat < __PAT_LAST; pat++) {
+		failures += bench_run(pat, 0);
+		failures += bench_run(pat, 1);
+	}
+
+	if (failures) {
+		printf("sequencing failed\n");
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,172 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <glib.h>
+#include "socket.h"
+#include "iptables.h"
+#include "media_socket.h"
+#include "log.h"
+#include "main.h"
+#include "test.h"
+
+int _log_facility_rtcp;
+int _log_facility_cdr;
+int _log_facility_dtmf;
+struct rtpengine_config rtpe_config;
+struct poller *rtpe_poller;
+struct poller **rtpe_media_pollers;
+GString *dtmf_logs;
+
+#define PORT_MIN 31000
+#define PORT_MAX 31099
+#define POOL 4
+
+
+static struct intf_spec *spec;
+static struct port_pool *pp;
+
+static void setup(void) {
+	static struct intf_config ifa;
+	GQueue q = G_QUEUE_INIT;
+
+	socket_init(); // needed for socktype_udp
+	iptables_init();
+	rtpe_config.socket_pool = POOL;
+
+	str_init(&ifa.name, "default");
+	ifa.name_base = ifa.name;
+	check(sockaddr_parse_any(&ifa.local_address.addr, "127.0.0.1") == 0);
+	ifa.local_address.type = socktype_udp;
+	ifa.advertised_address = ifa.local_address;
+	ifa.port_min = PORT_MIN;
+	ifa.port_max = PORT_MAX;
+	g_queue_push_tail(&q, &ifa);
+
+	interfaces_init(&q);
+	g_queue_clear(&q);
+
+	check(all_intf_specs.length == 1);
+	spec = all_intf_specs.head->data;
+	pp = &spec->port_pool;
+}
+
+static void check_pair(GQueue *q) {
+	check(q->length == 2);
+	socket_t *rtp = q->head->data;
+	socket_t *rtcp = q->tail->data;
+	check((rtp->local.port & 1) == 0);
+	check(rtcp->local.port == rtp->local.port + 1);
+	check(rtp->local.port >= PORT_MIN && rtcp->local.port <= PORT_MAX);
+}
+
+static void release_pair(GQueue *q) {
+	socket_t *sock;
+	// ports stay marked as used, which is fine for this test
+	while ((sock = g_queue_pop_head(q))) {
+		close_socket(sock);
+		g_slice_free1(sizeof(*sock), sock);
+	}
+}
+
+static void refill(void) {
+	socket_pool_refill(spec);
+
+	check(pp->sock_pool_pairs == POOL);
+	check(atomic64_get(&pp->sock_pool_refills) == POOL);
+	check(pp->sock_pool.length == 2 * POOL);
+	check(pp->free_ports == PORT_MAX - PORT_MIN + 1 - 2 * POOL);
+
+	for (GList *l = pp->sock_pool.head; l; l = l->next->next) {
+		socket_t *rtp = l->data;
+		socket_t *rtcp = l->next->data;
+		check((rtp->local.port & 1) == 0);
+		check(rtcp->local.port == rtp->local.port + 1);
+	}
+
+	test_ok("refill");
+}
+
+static void hit(void) {
+	GQueue q = G_QUEUE_INIT;
+	str label = STR_CONST_INIT("test");
+	char buf[16];
+
+	// stale datagram queued on a pooled socket before it's handed out
+	socket_t *pooled = pp->sock_pool.head->data;
+	unsigned int port = pooled->local.port;
+	int fd = socket(AF_INET, SOCK_DGRAM, 0);
+	check(fd >= 0);
+	struct sockaddr_in sin = {
+		.sin_family = AF_INET,
+		.sin_port = htons(port),
+		.sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+	};
+	check(sendto(fd, "stale", 5, 0, (struct sockaddr *) &sin, sizeof(sin)) == 5);
+	close(fd);
+
+	check(__get_consecutive_ports(&q, 2, 0, spec, &label) == 0);
+	check_pair(&q);
+	socket_t *rtp = q.head->data;
+	check(rtp->local.port == port);
+	check(atomic64_get(&pp->sock_pool_hits) == 1);
+	check(atomic64_get(&pp->sock_pool_misses) == 0);
+	check(pp->sock_pool_pairs == POOL - 1);
+
+	// drained on the way out
+	check(recv(rtp->fd, buf, sizeof(buf), MSG_DONTWAIT) < 0);
+	check(errno == EAGAIN || errno == EWOULDBLOCK);
+
+	release_pair(&q);
+
+	test_ok("hit");
+}
+
+static void miss(void) {
+	GQueue q = G_QUEUE_INIT;
+
+	for (unsigned int i = 1; i < POOL; i++) {
+		check(__get_consecutive_ports(&q, 2, 0, spec, NULL) == 0);
+		check_pair(&q);
+		release_pair(&q);
+	}
+	check(atomic64_get(&pp->sock_pool_hits) == POOL);
+	check(pp->sock_pool_pairs == 0);
+	check(pp->sock_pool.length == 0);
+
+	// empty pool falls back to binding on demand
+	check(__get_consecutive_ports(&q, 2, 0, spec, NULL) == 0);
+	check_pair(&q);
+	check(atomic64_get(&pp->sock_pool_misses) == 1);
+	release_pair(&q);
+
+	test_ok("miss");
+}
+
+static void teardown(void) {
+	unsigned int free_ports;
+
+	socket_pool_refill(spec);
+	check(pp->sock_pool_pairs == POOL);
+	check(atomic64_get(&pp->sock_pool_refills) == 2 * POOL);
+	free_ports = pp->free_ports;
+
+	interfaces_free();
+	check(pp->sock_pool_pairs == 0);
+	check(pp->sock_pool.length == 0);
+	check(pp->free_ports == free_ports + 2 * POOL);
+
+	test_ok("teardown");
+}
+
+int main(void) {
+	setup();
+	refill();
+	hit();
+	miss();
+	teardown();
+	return 0;
+}
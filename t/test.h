@@ -0,0 +1,26 @@
+#ifndef _TEST_H_
+#define _TEST_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "compat.h"
+
+
+// helpers shared by the unit tests: abort on the first failed check, and report
+// each finished test the way the test runner expects
+
+
+INLINE void __check(int ok, const char *what, const char *file, int line) {
+	if (!ok) {
+		printf("test nok: %s:%i: %s\n", file, line, what);
+		fflush(stdout);
+		abort();
+	}
+}
+#define check(x) __check(x, #x, __FILE__, __LINE__)
+
+INLINE void test_ok(const char *name) {
+	printf("test ok: %s\n", name);
+}
+
+#endif